@@ -2,9 +2,12 @@
 #include <CL/opencl.hpp>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <time.h>
 
+#include "../reduction/reduction.hpp"
+
 // =================================================================
 // ---------------------- Secondary Functions ----------------------
 // =================================================================
@@ -16,9 +19,15 @@ void initializeDevice();
 // Sequentially performs the N-dimensional operation c = a + b.
 void seqSumArrays( const int* a, const int* b, int* c, const size_t n );
 // Parallelly performs the N-dimensional operation c = a + b.
-void parSumArrays( int* a, int* b, int* c, const size_t n );
-// Check if the N-dimensional arrays c1 and c2 are equal.
-bool checkEquality( const int* c1, const int* c2, const size_t n );
+void parSumArrays( int* a,
+                   int* b,
+                   int* c,
+                   const size_t n,
+                   cl::Buffer* c_output = nullptr );
+// Check on the device if the N-dimensional arrays c1 and c2 are equal.
+bool checkEquality( const cl::Buffer& c1_buf,
+                    const cl::Buffer& c2_buf,
+                    const size_t n );
 
 // =================================================================
 // ------------------------ Global Variables ------------------------
@@ -28,6 +37,8 @@ cl::Program program;   // The program that will run on the device.
 cl::Context context;   // The context which holds the device.
 cl::Device device;     // The device where the kernel will run.
 
+std::unique_ptr< Reduction > reduction;   // Compares the outputs.
+
 // =================================================================
 // ------------------------- Main Function -------------------------
 // =================================================================
@@ -79,22 +90,29 @@ int main() {
    initializeDevice();
 
    /**
-    * Parallelly sum arrays.
+    * Parallelly sum arrays, keeping the last output on the device.
     * */
 
+   cl::Buffer cp_buf;
    start = clock();
    for( int i = 0; i < executions; i++ ) {
-      parSumArrays( a.data(), b.data(), cp.data(), arrays_dim );
+      parSumArrays( a.data(), b.data(), cp.data(), arrays_dim, &cp_buf );
    }
    end = clock();
    double par_time = ( 10e3 * static_cast< double >( end - start ) )
                    / CLOCKS_PER_SEC / executions;
 
    /**
-    * Check if outputs are equal.
+    * Check if outputs are equal on the device, uploading only the
+    * sequential output.
     * */
 
-   bool equal = checkEquality( cs.data(), cp.data(), arrays_dim );
+   cl::Buffer cs_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      arrays_dim * sizeof( int ),
+      cs.data() );
+   bool equal = checkEquality( cs_buf, cp_buf, arrays_dim );
 
    /**
     * Print results.
@@ -191,6 +209,12 @@ void initializeDevice() {
                 << std::endl;
       exit( 1 );
    }
+
+   /**
+    * Compile the reduction which compares the outputs.
+    * */
+
+   reduction = std::make_unique< Reduction >( context, device );
 }
 
 /**
@@ -204,10 +228,16 @@ void seqSumArrays( const int* a, const int* b, int* c, const size_t n ) {
 }
 
 /**
- * Parallelly performs the N-dimensional operation c = a + b.
+ * Parallelly performs the N-dimensional operation c = a + b. When c_output
+ * is not NULL, it receives the device buffer of c, so it can be checked
+ * without uploading it again.
  * */
 
-void parSumArrays( int* a, int* b, int* c, const size_t n ) {
+void parSumArrays( int* a,
+                   int* b,
+                   int* c,
+                   const size_t n,
+                   cl::Buffer* c_output ) {
 
    /**
     * Create buffers and allocate memory on the device.
@@ -224,7 +254,7 @@ void parSumArrays( int* a, int* b, int* c, const size_t n ) {
       n * sizeof( int ),
       b );
    cl::Buffer c_buf( context,
-                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY,
                      n * sizeof( int ) );
 
    /**
@@ -243,18 +273,19 @@ void parSumArrays( int* a, int* b, int* c, const size_t n ) {
    cl::CommandQueue queue( context, device );
    queue.enqueueNDRangeKernel( kernel, cl::NullRange, cl::NDRange( n ) );
    queue.enqueueReadBuffer( c_buf, CL_TRUE, 0, n * sizeof( int ), c );
+   if( c_output ) {
+      *c_output = c_buf;
+   }
 }
 
 /**
- * Check if the N-dimensional arrays c1 and c2 are equal.
+ * Check on the device if the N-dimensional arrays c1 and c2 are equal, by
+ * counting their differences with a parallel reduction.
  * */
 
-bool checkEquality( const int* c1, const int* c2, const size_t n ) {
-   for( size_t i = 0; i < n; i++ ) {
-      if( c1[i] != c2[i] ) {
-         return false;
-      }
-   }
-   return true;
+bool checkEquality( const cl::Buffer& c1_buf,
+                    const cl::Buffer& c2_buf,
+                    const size_t n ) {
+   cl::CommandQueue queue( context, device );
+   return reduction->countDifferences< int >( queue, c1_buf, c2_buf, n ) == 0;
 }
-
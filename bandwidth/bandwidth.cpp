@@ -0,0 +1,479 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;      // The context which holds the device.
+cl::Device device;        // The device where the transfers go.
+cl::CommandQueue queue;   // The in-order queue of every transfer.
+
+// Transferred sizes go from MIN_SIZE to MAX_SIZE bytes, multiplied by 4.
+constexpr size_t MIN_SIZE = 4 << 10;
+constexpr size_t MAX_SIZE = 1 << 30;
+// Bytes moved by every measure: small transfers are repeated up to
+// MAX_REPETITIONS times, large ones at least MIN_REPETITIONS times.
+constexpr size_t TRANSFER_BUDGET = 256 << 20;
+constexpr size_t MIN_REPETITIONS = 2;
+constexpr size_t MAX_REPETITIONS = 100;
+// Alignment of the aligned host memory: a page.
+constexpr size_t HOST_ALIGNMENT = 4096;
+
+// The host memory kinds: allocated with new, page-aligned, and mapped from
+// a CL_MEM_ALLOC_HOST_PTR buffer, which the runtime may pin.
+const std::vector< std::string > HOST_KINDS
+   = { "pageable", "aligned", "host ptr" };
+
+// The columns of every bandwidth curve.
+const std::vector< std::string > COLUMNS = { "H2D pageable",
+                                             "H2D aligned",
+                                             "H2D host ptr",
+                                             "D2H pageable",
+                                             "D2H aligned",
+                                             "D2H host ptr",
+                                             "D2D" };
+
+// A way to move size bytes between the host and two device allocations,
+// source and destination, as one of the examples of this repository does.
+struct TransferMode {
+   // Enqueue a copy from host memory to the source.
+   std::function< void( const unsigned char* ) > write;
+   // Enqueue a copy from the destination to host memory.
+   std::function< void( unsigned char* ) > read;
+   // Enqueue a copy from the source to the destination.
+   std::function< void() > copy;
+   // Release the device allocations.
+   std::function< void() > release;
+};
+
+// A host allocation of one of HOST_KINDS.
+struct HostMemory {
+   unsigned char* data;
+   std::function< void() > release;
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Return the transfer modes of the repository which the device supports.
+std::vector< std::string > getModes();
+// Return whether mode can move size bytes on the device.
+bool fits( const std::string& mode, const size_t size );
+// Create the device allocations of mode for size bytes.
+TransferMode createMode( const std::string& mode, const size_t size );
+// Allocate size bytes of host memory of kind.
+HostMemory allocateHost( const std::string& kind, const size_t size );
+// Return the bandwidth of transfer, which moves size bytes, in GB/s.
+double measureBandwidth( const size_t size,
+                         const std::function< void() >& transfer );
+// Return whether mode moves a pattern of size bytes from source to
+// destination intact.
+bool checkMode( TransferMode& mode,
+                const size_t size,
+                unsigned char* source,
+                unsigned char* destination );
+// Print the bandwidth curve of mode.
+void printCurve( const std::string& mode,
+                 const std::vector< std::vector< double > >& curve );
+// Return size in KiB, MiB or GiB.
+std::string formatSize( const size_t size );
+// Return the seconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   queue = cl::CommandQueue( context, device );
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << std::endl;
+
+   std::vector< std::string > modes = getModes();
+   std::map< std::string, std::vector< std::vector< double > > > curves;
+   for( const std::string& mode : modes ) {
+      curves[mode].resize( COLUMNS.size() );
+   }
+
+   /**
+    * Measure every mode at every size, from every kind of host memory,
+    * and check that it moves data intact. Sizes which do not fit in a mode
+    * are recorded as 0.
+    * */
+
+   bool equal = true;
+   for( size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 4 ) {
+      bool host_fits = fits( "copy", size );
+      std::vector< HostMemory > hosts;
+      for( size_t k = 0; host_fits && k < HOST_KINDS.size(); k++ ) {
+         hosts.push_back( allocateHost( HOST_KINDS[k], size ) );
+      }
+
+      for( const std::string& name : modes ) {
+         std::vector< std::vector< double > >& curve = curves[name];
+         if( !host_fits || !fits( name, size ) ) {
+            for( std::vector< double >& column : curve ) {
+               column.push_back( 0.0 );
+            }
+            continue;
+         }
+
+         TransferMode mode = createMode( name, size );
+         for( size_t k = 0; k < hosts.size(); k++ ) {
+            unsigned char* host = hosts[k].data;
+            curve[k].push_back(
+               measureBandwidth( size, [&] { mode.write( host ); } ) );
+            curve[hosts.size() + k].push_back(
+               measureBandwidth( size, [&] { mode.read( host ); } ) );
+         }
+         curve.back().push_back( measureBandwidth( size, mode.copy ) );
+         equal = equal && checkMode( mode, size, hosts[0].data, hosts[1].data );
+         mode.release();
+      }
+
+      for( HostMemory& host : hosts ) {
+         host.release();
+      }
+   }
+
+   /**
+    * Print results.
+    * */
+
+   for( const std::string& mode : modes ) {
+      printCurve( mode, curves[mode] );
+   }
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Return the transfer modes of the repository which the device supports:
+ *    - "copy": read, write and copy buffer commands, as array_addition;
+ *    - "map": memcpy through mapped buffers, as map;
+ *    - "sub-buffer": copy commands on two sub-buffers of one buffer, as
+ *      sub_buffer;
+ *    - "coarse-grained SVM": SVM memcpy commands, as coarse_grained_svm.
+ * */
+
+std::vector< std::string > getModes() {
+   std::vector< std::string > modes = { "copy", "map", "sub-buffer" };
+   if( device.getInfo< CL_DEVICE_SVM_CAPABILITIES >()
+       & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER ) {
+      modes.push_back( "coarse-grained SVM" );
+   }
+   return modes;
+}
+
+/**
+ * Return whether mode can move size bytes on the device: every allocation
+ * must be allowed, and the two of the mode together with the host ptr
+ * buffer must fit in the global memory.
+ * */
+
+bool fits( const std::string& mode, const size_t size ) {
+   cl_ulong max_alloc = device.getInfo< CL_DEVICE_MAX_MEM_ALLOC_SIZE >();
+   cl_ulong global_mem = device.getInfo< CL_DEVICE_GLOBAL_MEM_SIZE >();
+   if( 3 * static_cast< cl_ulong >( size ) > global_mem ) {
+      return false;
+   }
+   if( mode == "sub-buffer" ) {
+      size_t align = device.getInfo< CL_DEVICE_MEM_BASE_ADDR_ALIGN >() / 8;
+      size_t offset = ( size + align - 1 ) / align * align;
+      return offset + size <= max_alloc;
+   }
+   return size <= max_alloc;
+}
+
+/**
+ * Create the source and destination of mode for size bytes, and the
+ * commands which move data through them. The sub-buffers start at the
+ * beginning of their parent and at the first offset past size aligned to
+ * CL_DEVICE_MEM_BASE_ADDR_ALIGN, as every sub-buffer must.
+ * */
+
+TransferMode createMode( const std::string& mode, const size_t size ) {
+   TransferMode transfer;
+
+   if( mode == "coarse-grained SVM" ) {
+      void* source = clSVMAlloc( context(), CL_MEM_READ_WRITE, size, 0 );
+      void* destination = clSVMAlloc( context(), CL_MEM_READ_WRITE, size, 0 );
+      if( !source || !destination ) {
+         std::cerr << "Failed to allocate SVM buffer" << std::endl;
+         exit( 1 );
+      }
+      transfer.write = [=]( const unsigned char* host ) {
+         clEnqueueSVMMemcpy(
+            queue(), CL_FALSE, source, host, size, 0, nullptr, nullptr );
+      };
+      transfer.read = [=]( unsigned char* host ) {
+         clEnqueueSVMMemcpy(
+            queue(), CL_FALSE, host, destination, size, 0, nullptr, nullptr );
+      };
+      transfer.copy = [=] {
+         clEnqueueSVMMemcpy(
+            queue(), CL_FALSE, destination, source, size, 0, nullptr, nullptr );
+      };
+      transfer.release = [=] {
+         queue.finish();
+         clSVMFree( context(), source );
+         clSVMFree( context(), destination );
+      };
+      return transfer;
+   }
+
+   cl::Buffer source, destination;
+   if( mode == "sub-buffer" ) {
+      size_t align = device.getInfo< CL_DEVICE_MEM_BASE_ADDR_ALIGN >() / 8;
+      cl_buffer_region source_region = { 0, size };
+      cl_buffer_region destination_region
+         = { ( size + align - 1 ) / align * align, size };
+      cl::Buffer parent( context,
+                         CL_MEM_READ_WRITE,
+                         destination_region.origin + size );
+      source = parent.createSubBuffer(
+         CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &source_region );
+      destination = parent.createSubBuffer( CL_MEM_READ_WRITE,
+                                            CL_BUFFER_CREATE_TYPE_REGION,
+                                            &destination_region );
+   } else {
+      source = cl::Buffer( context, CL_MEM_READ_WRITE, size );
+      destination = cl::Buffer( context, CL_MEM_READ_WRITE, size );
+   }
+
+   if( mode == "map" ) {
+
+      /**
+       * The host copies the data in and out of the mapped buffers; the
+       * device to device copy goes through the host as well.
+       * */
+
+      transfer.write = [=]( const unsigned char* host ) {
+         void* ptr = queue.enqueueMapBuffer(
+            source, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, size );
+         std::memcpy( ptr, host, size );
+         queue.enqueueUnmapMemObject( source, ptr );
+      };
+      transfer.read = [=]( unsigned char* host ) {
+         void* ptr = queue.enqueueMapBuffer(
+            destination, CL_TRUE, CL_MAP_READ, 0, size );
+         std::memcpy( host, ptr, size );
+         queue.enqueueUnmapMemObject( destination, ptr );
+      };
+      transfer.copy = [=] {
+         void* from
+            = queue.enqueueMapBuffer( source, CL_TRUE, CL_MAP_READ, 0, size );
+         void* to = queue.enqueueMapBuffer(
+            destination, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, size );
+         std::memcpy( to, from, size );
+         queue.enqueueUnmapMemObject( source, from );
+         queue.enqueueUnmapMemObject( destination, to );
+      };
+   } else {
+      transfer.write = [=]( const unsigned char* host ) {
+         queue.enqueueWriteBuffer( source, CL_FALSE, 0, size, host );
+      };
+      transfer.read = [=]( unsigned char* host ) {
+         queue.enqueueReadBuffer( destination, CL_FALSE, 0, size, host );
+      };
+      transfer.copy = [=] {
+         queue.enqueueCopyBuffer( source, destination, 0, 0, size );
+      };
+   }
+   transfer.release = [] { queue.finish(); };
+   return transfer;
+}
+
+/**
+ * Allocate size bytes of host memory of kind. The host ptr memory is a
+ * CL_MEM_ALLOC_HOST_PTR buffer mapped for the whole run, the usual way to
+ * obtain memory the device can reach directly.
+ * */
+
+HostMemory allocateHost( const std::string& kind, const size_t size ) {
+   HostMemory host;
+   if( kind == "pageable" ) {
+      host.data = new unsigned char[size];
+      host.release = [=] { delete[] host.data; };
+   } else if( kind == "aligned" ) {
+      size_t aligned_size
+         = ( size + HOST_ALIGNMENT - 1 ) / HOST_ALIGNMENT * HOST_ALIGNMENT;
+      host.data = static_cast< unsigned char* >(
+         std::aligned_alloc( HOST_ALIGNMENT, aligned_size ) );
+      host.release = [=] { std::free( host.data ); };
+   } else {
+      cl::Buffer buffer(
+         context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size );
+      host.data = static_cast< unsigned char* >( queue.enqueueMapBuffer(
+         buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size ) );
+      host.release = [=] {
+         queue.enqueueUnmapMemObject( buffer, host.data );
+         queue.finish();
+      };
+   }
+
+   if( !host.data ) {
+      std::cerr << "Failed to allocate " << kind << " host memory"
+                << std::endl;
+      exit( 1 );
+   }
+   return host;
+}
+
+/**
+ * Return the bandwidth of transfer, which moves size bytes, in GB/s. The
+ * transfer runs once to warm up, then is enqueued repeatedly and waited
+ * for at once, so that small transfers are not dominated by the round
+ * trip of every command.
+ * */
+
+double measureBandwidth( const size_t size,
+                         const std::function< void() >& transfer ) {
+   size_t repetitions
+      = std::clamp( TRANSFER_BUDGET / size, MIN_REPETITIONS, MAX_REPETITIONS );
+   transfer();
+   queue.finish();
+
+   auto start = std::chrono::steady_clock::now();
+   for( size_t i = 0; i < repetitions; i++ ) {
+      transfer();
+   }
+   queue.finish();
+   return repetitions * size / getElapsedTime( start ) / 1e9;
+}
+
+/**
+ * Return whether mode moves a pattern of size bytes from source, through
+ * its device allocations, to destination intact.
+ * */
+
+bool checkMode( TransferMode& mode,
+                const size_t size,
+                unsigned char* source,
+                unsigned char* destination ) {
+   for( size_t i = 0; i < size; i++ ) {
+      source[i] = static_cast< unsigned char >( i * 7 + 1 );
+   }
+   std::memset( destination, 0, size );
+   mode.write( source );
+   mode.copy();
+   mode.read( destination );
+   queue.finish();
+   return std::memcmp( source, destination, size ) == 0;
+}
+
+/**
+ * Print the bandwidth curve of mode: a row per size, with the bandwidth of
+ * every column in GB/s, or "-" when the size does not fit.
+ * */
+
+void printCurve( const std::string& mode,
+                 const std::vector< std::vector< double > >& curve ) {
+   std::cout << "\nBandwidth of " << mode << " (GB/s):\n"
+             << std::setw( 8 ) << "Size";
+   for( const std::string& column : COLUMNS ) {
+      std::cout << std::setw( 14 ) << column;
+   }
+   std::cout << "\n" << std::fixed << std::setprecision( 2 );
+
+   size_t row = 0;
+   for( size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 4, row++ ) {
+      std::cout << std::setw( 8 ) << formatSize( size );
+      for( const std::vector< double >& column : curve ) {
+         if( column[row] > 0.0 ) {
+            std::cout << std::setw( 14 ) << column[row];
+         } else {
+            std::cout << std::setw( 14 ) << "-";
+         }
+      }
+      std::cout << "\n";
+   }
+   std::cout << std::flush;
+}
+
+/**
+ * Return size in KiB, MiB or GiB.
+ * */
+
+std::string formatSize( const size_t size ) {
+   if( size >= ( 1 << 30 ) ) {
+      return std::to_string( size >> 30 ) + " GiB";
+   } else if( size >= ( 1 << 20 ) ) {
+      return std::to_string( size >> 20 ) + " MiB";
+   }
+   return std::to_string( size >> 10 ) + " KiB";
+}
+
+/**
+ * Return the seconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double >( std::chrono::steady_clock::now()
+                                           - start )
+      .count();
+}
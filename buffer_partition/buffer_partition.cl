@@ -0,0 +1,28 @@
+/**
+ * This kernel function adds 3 to every element of its partition, as the
+ * add_one kernel of sub_buffer does.
+ */
+
+__kernel void addOne( __global uint* data ) {
+   int index = (int)get_global_id( 0 );
+   data[index] += 3;
+}
+
+/**
+ * This kernel function smooths a partition: every element becomes the sum
+ * of itself and its two neighbors, which are 0 past the ends of the whole
+ * buffer. The elements are read from window, which widens the partition
+ * into its neighbors and holds window_size elements; the partition starts
+ * shift elements into it.
+ */
+
+__kernel void smooth( const __global uint* window,
+                      const uint shift,
+                      const uint window_size,
+                      __global uint* data ) {
+   uint index = (uint)get_global_id( 0 );
+   uint center = index + shift;
+   uint left = center > 0 ? window[center - 1] : 0;
+   uint right = center + 1 < window_size ? window[center + 1] : 0;
+   data[index] = left + window[center] + right;
+}
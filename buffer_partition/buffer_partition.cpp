@@ -0,0 +1,419 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../device_fission/device_fission.hpp"
+#include "buffer_partition.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first CPU device found, or the first device when there is no
+// CPU device.
+cl::Device getCpuDevice();
+// Compile kernel code for every device of context.
+cl::Program buildProgram( const cl::Context& context );
+// Run ITERATIONS steps on buffers split into count partitions, partition p
+// on queues[p], store the final elements in result and return the time
+// taken in ms.
+double runPartitions( const cl::Context& context,
+                      const cl::Program& program,
+                      std::vector< cl::CommandQueue >& queues,
+                      const size_t count,
+                      std::vector< cl_uint >& result );
+// Run ITERATIONS steps sequentially and store the final elements in
+// result.
+void seqRun( std::vector< cl_uint >& result );
+// Fill the initial elements, as sub_buffer does.
+std::vector< cl_uint > getInitialElements();
+// Return the time elapsed since start, in ms.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Device device;   // The CPU device whose buffers are partitioned.
+
+// Elements of the buffers, which no partition count divides evenly, and
+// steps of addOne followed by smooth.
+constexpr size_t ELEMENTS = ( 1 << 24 ) + 1234;
+constexpr int ITERATIONS = 20;
+// Partitions, queues and sub-devices by default.
+constexpr size_t PARTITIONS = 4;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main( int argc, char* argv[] ) {
+
+   /**
+    * Read the number of partitions.
+    * */
+
+   size_t partitions = PARTITIONS;
+   bool valid = true;
+   for( int i = 1; i < argc && valid; i++ ) {
+      long count = 0;
+      if( strcmp( argv[i], "--partitions" ) == 0 && i + 1 < argc ) {
+         try {
+            count = std::stol( argv[++i] );
+         } catch( const std::logic_error& ) {
+         }
+      }
+      valid = count > 0;
+      partitions = static_cast< size_t >( count );
+   }
+   if( !valid ) {
+      std::cerr << "Usage: " << argv[0] << " [--partitions n], n > 0"
+                << std::endl;
+      return 1;
+   }
+
+   /**
+    * Initialize the CPU device, with a context and a queue on the whole
+    * device and a queue per partition.
+    * */
+
+   device = getCpuDevice();
+   cl::Context context( device );
+   cl::Program program = buildProgram( context );
+   std::vector< cl::CommandQueue > whole_queue(
+      1, cl::CommandQueue( context, device ) );
+   std::vector< cl::CommandQueue > queues;
+   for( size_t p = 0; p < partitions; p++ ) {
+      queues.emplace_back( context, device );
+   }
+
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << "\n"
+             << ELEMENTS << " elements, " << ITERATIONS << " iterations, "
+             << partitions << " partitions aligned to "
+             << BufferPartitioner::getAlignment( device ) << " bytes"
+             << std::endl;
+
+   /**
+    * Run the steps sequentially, then with a single launch over the whole
+    * buffer and with a partition per queue. The first run of each warms
+    * it up.
+    * */
+
+   std::vector< cl_uint > expected;
+   seqRun( expected );
+
+   std::vector< cl_uint > result;
+   runPartitions( context, program, whole_queue, 1, result );
+   double whole_time
+      = runPartitions( context, program, whole_queue, 1, result );
+   bool equal = result == expected;
+
+   runPartitions( context, program, queues, partitions, result );
+   double queues_time
+      = runPartitions( context, program, queues, partitions, result );
+   equal = equal && result == expected;
+
+   /**
+    * Run with a partition per sub-device, when the device can be split
+    * into as many.
+    * */
+
+   std::vector< cl::Device > sub_devices = DeviceFission::partition(
+      device, DeviceFission::Mode::Equally, partitions );
+   double sub_devices_time = 0;
+   if( !sub_devices.empty() ) {
+      cl::Context sub_context( sub_devices );
+      cl::Program sub_program = buildProgram( sub_context );
+      std::vector< cl::CommandQueue > sub_queues;
+      for( const cl::Device& sub_device : sub_devices ) {
+         sub_queues.emplace_back( sub_context, sub_device );
+      }
+      runPartitions( sub_context, sub_program, sub_queues, partitions,
+                     result );
+      sub_devices_time = runPartitions(
+         sub_context, sub_program, sub_queues, partitions, result );
+      equal = equal && result == expected;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tWhole buffer: " << whole_time
+             << " ms;\n\t" << partitions << " queues: " << queues_time
+             << " ms";
+   if( !sub_devices.empty() ) {
+      std::cout << ";\n\t" << partitions << " sub-devices: "
+                << sub_devices_time << " ms";
+   }
+   std::cout << "." << std::endl;
+   std::cout << "Performance gain: \n\t" << partitions << " queues: "
+             << ( 100 * ( whole_time - queues_time ) / queues_time ) << "%";
+   if( !sub_devices.empty() ) {
+      std::cout << ";\n\t" << partitions << " sub-devices: "
+                << ( 100 * ( whole_time - sub_devices_time )
+                     / sub_devices_time )
+                << "%";
+   } else {
+      std::cout << ".\nThe device cannot be split into " << partitions
+                << " sub-devices";
+   }
+   std::cout << "." << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first CPU device found, or the first device when there is no
+ * CPU device.
+ * */
+
+cl::Device getCpuDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for a CPU device on every platform.
+    * */
+
+   std::vector< cl::Device > devices;
+   for( const cl::Platform& platform : platforms ) {
+      platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+      for( const cl::Device& candidate : devices ) {
+         if( candidate.getInfo< CL_DEVICE_TYPE >() & CL_DEVICE_TYPE_CPU ) {
+            return candidate;
+         }
+      }
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   platforms.front().getDevices( CL_DEVICE_TYPE_ALL, &devices );
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+   std::cerr << "No CPU device found, using the first device." << std::endl;
+   return devices.front();
+}
+
+/**
+ * Compile kernel code for every device of context.
+ * */
+
+cl::Program buildProgram( const cl::Context& context ) {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "buffer_partition.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the devices.
+    * */
+
+   cl::Program::Sources sources{ src };
+   cl::Program program( context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      cl::Device built = context.getInfo< CL_CONTEXT_DEVICES >().front();
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( built )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( built )
+                << std::endl;
+      exit( 1 );
+   }
+   return program;
+}
+
+/**
+ * Run ITERATIONS steps on two buffers split into count partitions: each
+ * step adds 3 to every element of the source buffer, then smooths it into
+ * the other buffer, which is the source of the next step. Partition p runs
+ * on queues[p]. Its smooth reads a window which overlaps the partitions
+ * next to it, so it waits for their addOne events; the writes which must
+ * wait for those reads come later on the same queues, after the events
+ * they wait for. Store the final elements in result and return the time
+ * taken in ms.
+ * */
+
+double runPartitions( const cl::Context& context,
+                      const cl::Program& program,
+                      std::vector< cl::CommandQueue >& queues,
+                      const size_t count,
+                      std::vector< cl_uint >& result ) {
+
+   /**
+    * Create the buffers, split them into partitions and create the window
+    * of every partition, which holds one more element on each side.
+    * */
+
+   std::vector< cl_uint > initial = getInitialElements();
+   const size_t bytes = ELEMENTS * sizeof( cl_uint );
+   cl::Buffer buffers[2]
+      = { cl::Buffer( context,
+                      CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                      bytes,
+                      initial.data() ),
+          cl::Buffer( context, CL_MEM_READ_WRITE, bytes ) };
+
+   std::vector< BufferPartitioner::Partition > partitions[2], windows[2];
+   for( int i = 0; i < 2; i++ ) {
+      partitions[i]
+         = BufferPartitioner::partition( buffers[i], device, count );
+      for( const auto& partition : partitions[i] ) {
+         windows[i].push_back( BufferPartitioner::widen(
+            buffers[i], device, partition, sizeof( cl_uint ) ) );
+      }
+   }
+   const size_t used = partitions[0].size();
+   bool created = used > 0;
+   for( const auto& window : windows[0] ) {
+      created = created && window.buffer() != nullptr;
+   }
+   for( const auto& window : windows[1] ) {
+      created = created && window.buffer() != nullptr;
+   }
+   if( !created ) {
+      std::cerr << "Failed to partition the buffers!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Run the steps, flushing every queue after each phase so that the
+    * events other queues wait for are submitted.
+    * */
+
+   cl::Kernel add_one( program, "addOne" );
+   cl::Kernel smooth( program, "smooth" );
+   std::vector< cl::Event > updates( used );
+
+   auto start = std::chrono::steady_clock::now();
+   for( int k = 0; k < ITERATIONS; k++ ) {
+      const int source = k % 2;
+      const int target = 1 - source;
+
+      for( size_t p = 0; p < used; p++ ) {
+         const auto& partition = partitions[source][p];
+         add_one.setArg( 0, partition.buffer );
+         queues[p].enqueueNDRangeKernel(
+            add_one,
+            cl::NullRange,
+            cl::NDRange( partition.size / sizeof( cl_uint ) ),
+            cl::NullRange,
+            nullptr,
+            &updates[p] );
+         queues[p].flush();
+      }
+
+      for( size_t p = 0; p < used; p++ ) {
+         const auto& partition = partitions[source][p];
+         const auto& window = windows[source][p];
+         std::vector< cl::Event > neighbors;
+         if( p > 0 ) {
+            neighbors.push_back( updates[p - 1] );
+         }
+         if( p + 1 < used ) {
+            neighbors.push_back( updates[p + 1] );
+         }
+
+         smooth.setArg( 0, window.buffer );
+         smooth.setArg( 1, static_cast< cl_uint >(
+                              ( partition.offset - window.offset )
+                              / sizeof( cl_uint ) ) );
+         smooth.setArg(
+            2, static_cast< cl_uint >( window.size / sizeof( cl_uint ) ) );
+         smooth.setArg( 3, partitions[target][p].buffer );
+         queues[p].enqueueNDRangeKernel(
+            smooth,
+            cl::NullRange,
+            cl::NDRange( partition.size / sizeof( cl_uint ) ),
+            cl::NullRange,
+            &neighbors );
+         queues[p].flush();
+      }
+   }
+   for( size_t p = 0; p < used; p++ ) {
+      queues[p].finish();
+   }
+   double time = getElapsedTime( start );
+
+   /**
+    * Read the buffer written by the last smooth.
+    * */
+
+   result.resize( ELEMENTS );
+   queues[0].enqueueReadBuffer(
+      buffers[ITERATIONS % 2], CL_TRUE, 0, bytes, result.data() );
+   return time;
+}
+
+/**
+ * Run ITERATIONS steps sequentially and store the final elements in
+ * result.
+ * */
+
+void seqRun( std::vector< cl_uint >& result ) {
+   result = getInitialElements();
+   std::vector< cl_uint > next( ELEMENTS );
+   for( int k = 0; k < ITERATIONS; k++ ) {
+      for( cl_uint& element : result ) {
+         element += 3;
+      }
+      for( size_t i = 0; i < ELEMENTS; i++ ) {
+         cl_uint left = i > 0 ? result[i - 1] : 0;
+         cl_uint right = i + 1 < ELEMENTS ? result[i + 1] : 0;
+         next[i] = left + result[i] + right;
+      }
+      result.swap( next );
+   }
+}
+
+/**
+ * Fill the initial elements, as sub_buffer does.
+ * */
+
+std::vector< cl_uint > getInitialElements() {
+   std::vector< cl_uint > elements( ELEMENTS );
+   for( size_t i = 0; i < ELEMENTS; i++ ) {
+      elements[i] = static_cast< cl_uint >( i * 4 );
+   }
+   return elements;
+}
+
+/**
+ * Return the time elapsed since start, in ms.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
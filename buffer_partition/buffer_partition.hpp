@@ -0,0 +1,111 @@
+#ifndef BUFFER_PARTITION_HPP
+#define BUFFER_PARTITION_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <vector>
+
+/**
+ * Split a buffer into sub-buffers with clCreateSubBuffer, as sub_buffer
+ * does for a single half, so that each can be processed by its own queue
+ * or sub-device. Sub-buffers must start at a multiple of the base address
+ * alignment of the device, so the partitions are as even as that
+ * alignment allows: a size which does not divide evenly gives the first
+ * partitions one more aligned unit, and the last partition ends at the
+ * end of the buffer.
+ *
+ *    auto partitions = BufferPartitioner::partition( buffer, device, 4 );
+ *    for( size_t p = 0; p < partitions.size(); p++ ) {
+ *       kernel.setArg( 0, partitions[p].buffer );
+ *       queues[p].enqueueNDRangeKernel(
+ *          kernel, cl::NullRange, cl::NDRange( partitions[p].size / 4 ) );
+ *    }
+ *
+ * Kernels which read the neighbors of their partition use a window: a
+ * read-only sub-buffer which widens the partition into its neighbors. The
+ * window overlaps the partitions next to it, so its reads must wait for
+ * their writes with events. The element size must divide the alignment.
+ * */
+
+class BufferPartitioner {
+ public:
+   // A region of the parent buffer.
+   struct Partition {
+      cl::Buffer buffer;   // The sub-buffer of the region.
+      size_t offset;       // First byte of the region in the parent.
+      size_t size;         // Bytes of the region.
+   };
+
+   // Return the alignment of the sub-buffers of device, in bytes.
+   static size_t getAlignment( const cl::Device& device ) {
+      return std::max< size_t >(
+         1, device.getInfo< CL_DEVICE_MEM_BASE_ADDR_ALIGN >() / 8 );
+   }
+
+   // Split parent into count partitions aligned for device. Return fewer
+   // when parent holds fewer aligned units than count, and none when a
+   // sub-buffer cannot be created.
+   static std::vector< Partition > partition(
+      const cl::Buffer& parent,
+      const cl::Device& device,
+      const size_t count,
+      const cl_mem_flags flags = CL_MEM_READ_WRITE ) {
+      const size_t size = parent.getInfo< CL_MEM_SIZE >();
+      const size_t alignment = getAlignment( device );
+      const size_t units = ( size + alignment - 1 ) / alignment;
+      const size_t partitions = std::min( count, units );
+
+      std::vector< Partition > result;
+      size_t offset = 0;
+      for( size_t p = 0; p < partitions; p++ ) {
+         size_t share = units / partitions + ( p < units % partitions );
+         size_t end = std::min( size, offset + share * alignment );
+         cl::Buffer buffer = createRegion( parent, offset, end, flags );
+         if( buffer() == nullptr ) {
+            return {};
+         }
+         result.push_back( { buffer, offset, end - offset } );
+         offset = end;
+      }
+      return result;
+   }
+
+   // Return a read-only window of parent which holds partition and at
+   // least halo bytes on each side of it, within parent. Its offset is
+   // aligned for device, so the partition starts partition.offset -
+   // window.offset bytes into it. Return a null buffer when it fails.
+   static Partition widen( const cl::Buffer& parent,
+                           const cl::Device& device,
+                           const Partition& partition,
+                           const size_t halo ) {
+      const size_t size = parent.getInfo< CL_MEM_SIZE >();
+      const size_t alignment = getAlignment( device );
+      const size_t aligned_halo
+         = ( halo + alignment - 1 ) / alignment * alignment;
+      size_t begin = partition.offset - std::min( partition.offset,
+                                                  aligned_halo );
+      size_t end = std::min( size, partition.offset + partition.size + halo );
+      return { createRegion( parent, begin, end, CL_MEM_READ_ONLY ),
+               begin,
+               end - begin };
+   }
+
+ private:
+   // Create the sub-buffer of parent from byte begin to byte end.
+   static cl::Buffer createRegion( const cl::Buffer& parent,
+                                   const size_t begin,
+                                   const size_t end,
+                                   const cl_mem_flags flags ) {
+      cl_int err;
+      cl_buffer_region region = { begin, end - begin };
+      cl::Buffer buffer = parent;
+      cl::Buffer sub_buffer = buffer.createSubBuffer(
+         flags, CL_BUFFER_CREATE_TYPE_REGION, &region, &err );
+      return err == CL_SUCCESS ? sub_buffer : cl::Buffer();
+   }
+};
+
+#endif
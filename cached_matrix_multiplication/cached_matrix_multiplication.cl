@@ -1,21 +1,59 @@
 /**
- * This kernel function efficiently multiplies two matrices a[m,k] and b[k,n]
- * by caching submatrices from those input matrices in the device local memory.
+ * Declare the size of each submatrix (it must be the same work-group size
+ * declared in the host code).
  */
 
-__kernel void multiplyMatricesWithCache( const __global int* a,
-                                         const __global int* b,
-                                         __global int* c,
-                                         const unsigned int m,
-                                         const unsigned int n,
-                                         const unsigned int k ) {
+#define SUB_SIZE 16
 
-   /**
-    * Declare the size of each submatrix (it must be
-    * the same work-group size declared in the host code).
-    */
+/**
+ * Declare the layouts of the input matrices. When TRANSPOSE_A is defined, a
+ * is given transposed, as a_t[k,m]; when TRANSPOSE_B is defined, b is given
+ * transposed, as b_t[n,k]. Tiles are then read along the rows of the stored
+ * matrix and transposed while being written to local memory, whose extra
+ * column avoids bank conflicts.
+ */
+
+/**
+ * Declare the epilogue applied by multiplyMatricesWithEpilogue. Each stage is
+ * selected at compile time by the host code, so the disabled ones cost
+ * nothing:
+ *    - EPILOGUE_SCALE: c = alpha * (a * b) + beta * c;
+ *    - EPILOGUE_ROW_BIAS: add row_bias[row] to every element of a row;
+ *    - EPILOGUE_COL_BIAS: add col_bias[col] to every element of a column;
+ *    - ACTIVATION: one of the ACTIVATION_* values below;
+ *    - OUTPUT_TYPE and OUTPUT_CONVERT: the type of the matrix c and the
+ *      conversion used to store the result (e.g. short and
+ *      convert_short_sat_rte).
+ */
+
+#define ACTIVATION_NONE 0
+#define ACTIVATION_RELU 1
+#define ACTIVATION_CLAMP 2
+#define ACTIVATION_GELU 3
+
+#ifndef ACTIVATION
+   #define ACTIVATION ACTIVATION_NONE
+#endif
 
-   const int sub_size = 16;
+#ifndef OUTPUT_TYPE
+   #define OUTPUT_TYPE int
+   #define OUTPUT_CONVERT convert_int_sat_rte
+#endif
+
+/**
+ * Accumulate the product of the row global_row_index of a[m,k] by the column
+ * global_col_index of b[k,n] by caching submatrices from those input matrices
+ * in the device local memory. The local submatrices must be declared by the
+ * calling kernel.
+ */
+
+int accumulateWithCache( const __global int* a,
+                         const __global int* b,
+                         const unsigned int m,
+                         const unsigned int n,
+                         const unsigned int k,
+                         __local int ( *a_sub )[SUB_SIZE + 1],
+                         __local int ( *b_sub )[SUB_SIZE + 1] ) {
 
    /**
     * Get work-item identifiers.
@@ -25,14 +63,8 @@ __kernel void multiplyMatricesWithCache( const __global int* a,
    int row_index = (int)get_local_id( 1 );
    int global_col_index = (int)get_global_id( 0 );
    int global_row_index = (int)get_global_id( 1 );
-   int index = ( global_row_index * (int)n ) + global_col_index;
-
-   /**
-    * Create submatrices that will cache the matrices A and B in local memory.
-    */
-
-   __local int a_sub[sub_size][sub_size];
-   __local int b_sub[sub_size][sub_size];
+   int group_col_index = (int)get_group_id( 0 ) * SUB_SIZE;
+   int group_row_index = (int)get_group_id( 1 ) * SUB_SIZE;
 
    /**
     * Initialize accumulator register.
@@ -48,17 +80,27 @@ __kernel void multiplyMatricesWithCache( const __global int* a,
    // Utilize sliding window technique to calcuate the target result.
    // If the dimension of one of these two arrays decreases to 1, just the
    // one-dimension array is need to be cached.
-   const int n_sub = (int)k / sub_size;
+   const int n_sub = (int)k / SUB_SIZE;
    for( int i = 0; i < n_sub; i++ ) {
 
       /**
        * Load submatrices into local memory.
        */
 
-      const int s_col = sub_size * i + col_index;
-      const int s_row = sub_size * i + row_index;
+      const int s_col = SUB_SIZE * i + col_index;
+      const int s_row = SUB_SIZE * i + row_index;
+#ifdef TRANSPOSE_A
+      a_sub[col_index][row_index]
+         = a[s_row * (int)m + group_row_index + col_index];
+#else
       a_sub[row_index][col_index] = a[global_row_index * (int)k + s_col];
+#endif
+#ifdef TRANSPOSE_B
+      b_sub[col_index][row_index]
+         = b[( group_col_index + row_index ) * (int)k + s_col];
+#else
       b_sub[row_index][col_index] = b[s_row * (int)n + global_col_index];
+#endif
 
       /**
        * Synchronize all work-items in this work-group.
@@ -70,7 +112,7 @@ __kernel void multiplyMatricesWithCache( const __global int* a,
        * Perform the computation for a single submatrix.
        */
 
-      for( int j = 0; j < sub_size; j++ ) {
+      for( int j = 0; j < SUB_SIZE; j++ ) {
          sum += a_sub[row_index][j] * b_sub[j][col_index];
       }
 
@@ -81,9 +123,92 @@ __kernel void multiplyMatricesWithCache( const __global int* a,
       barrier( CLK_LOCAL_MEM_FENCE );
    }
 
+   return sum;
+}
+
+/**
+ * This kernel function efficiently multiplies two matrices a[m,k] and b[k,n]
+ * by caching submatrices from those input matrices in the device local memory.
+ */
+
+__kernel void multiplyMatricesWithCache( const __global int* a,
+                                         const __global int* b,
+                                         __global int* c,
+                                         const unsigned int m,
+                                         const unsigned int n,
+                                         const unsigned int k ) {
+
+   /**
+    * Create submatrices that will cache the matrices A and B in local memory.
+    */
+
+   __local int a_sub[SUB_SIZE][SUB_SIZE + 1];
+   __local int b_sub[SUB_SIZE][SUB_SIZE + 1];
+
+   /**
+    * Store the final result in the matrix C.
+    */
+
+   int index = (int)get_global_id( 1 ) * (int)n + (int)get_global_id( 0 );
+   c[index] = accumulateWithCache( a, b, m, n, k, a_sub, b_sub );
+}
+
+/**
+ * This kernel function multiplies two matrices a[m,k] and b[k,n] like
+ * multiplyMatricesWithCache, but applies the epilogue selected at compile
+ * time to the accumulator register before storing it in c[m,n]. Buffers of
+ * disabled stages are never read and may be NULL.
+ */
+
+__kernel void multiplyMatricesWithEpilogue( const __global int* a,
+                                            const __global int* b,
+                                            __global OUTPUT_TYPE* c,
+                                            const unsigned int m,
+                                            const unsigned int n,
+                                            const unsigned int k,
+                                            const __global float* row_bias,
+                                            const __global float* col_bias,
+                                            const float alpha,
+                                            const float beta,
+                                            const float clamp_min,
+                                            const float clamp_max ) {
+
+   /**
+    * Create submatrices that will cache the matrices A and B in local memory.
+    */
+
+   __local int a_sub[SUB_SIZE][SUB_SIZE + 1];
+   __local int b_sub[SUB_SIZE][SUB_SIZE + 1];
+
+   int col = (int)get_global_id( 0 );
+   int row = (int)get_global_id( 1 );
+   int index = row * (int)n + col;
+   float value = (float)accumulateWithCache( a, b, m, n, k, a_sub, b_sub );
+
+   /**
+    * Apply the epilogue in registers.
+    */
+
+#ifdef EPILOGUE_SCALE
+   value = alpha * value + beta * (float)c[index];
+#endif
+#ifdef EPILOGUE_ROW_BIAS
+   value += row_bias[row];
+#endif
+#ifdef EPILOGUE_COL_BIAS
+   value += col_bias[col];
+#endif
+#if ACTIVATION == ACTIVATION_RELU
+   value = fmax( value, 0.0f );
+#elif ACTIVATION == ACTIVATION_CLAMP
+   value = clamp( value, clamp_min, clamp_max );
+#elif ACTIVATION == ACTIVATION_GELU
+   value = 0.5f * value * ( 1.0f + erf( value * M_SQRT1_2_F ) );
+#endif
+
    /**
     * Store the final result in the matrix C.
     */
 
-   c[index] = sum;
+   c[index] = OUTPUT_CONVERT( value );
 }
@@ -1,7 +1,37 @@
 #define CL_HPP_TARGET_OPENCL_VERSION 300
 #include <CL/opencl.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+
+// =================================================================
+// ---------------------------- Types -----------------------------
+// =================================================================
+
+// Layouts of the input matrices: TN takes a transposed, as a_t[k,m], and NT
+// takes b transposed, as b_t[n,k].
+enum class Layout { NN, TN, NT };
+
+// Activation functions supported by the GEMM epilogue.
+enum class Activation { None, Relu, Clamp, Gelu };
+
+// Post-processing fused into the GEMM before the result is stored.
+struct Epilogue {
+   bool scale = false;                       // c = alpha * a * b + beta * c.
+   float alpha = 1.0f;                       // Scale of the product.
+   float beta = 0.0f;                        // Scale of the existing c.
+   bool row_bias = false;                    // Add a bias per row.
+   bool col_bias = false;                    // Add a bias per column.
+   Activation activation = Activation::None; // Activation function.
+   float clamp_min = 0.0f;                   // Lower bound of the clamp.
+   float clamp_max = 0.0f;                   // Upper bound of the clamp.
+};
 
 // =================================================================
 // ---------------------- Secondary Functions ----------------------
@@ -24,12 +54,52 @@ void parMultiplyMatrices( int* a,
                           int* c,
                           const size_t m,
                           const size_t n,
-                          const size_t k );
+                          const size_t k,
+                          const Layout layout = Layout::NN );
+// Store a[rows,cols] transposed, as a_t[cols,rows].
+void transposeMatrix( const int* a,
+                      int* a_t,
+                      const size_t rows,
+                      const size_t cols );
+// Return the program compiled with some build options, compiling it once.
+cl::Program& getProgram( const std::string& options );
 // Check if the matrices c1 and c2 are equal.
 bool checkEquality( const int* c1,
                     const int* c2,
                     const size_t m,
                     const size_t n );
+// Return the build options which specialize the kernel for an epilogue.
+template< typename T >
+std::string getEpilogueOptions( const Epilogue& epilogue );
+// Sequentially applies an epilogue to the product acc[m,n], storing it in c.
+template< typename T >
+void seqApplyEpilogue( const int* acc,
+                       const float* row_bias,
+                       const float* col_bias,
+                       const Epilogue& epilogue,
+                       T* c,
+                       const size_t m,
+                       const size_t n );
+// Parallelly performs c[m,n] = epilogue( a[m,k] * b[k,n] ) in one kernel.
+template< typename T >
+void parMultiplyMatricesWithEpilogue( int* a,
+                                      int* b,
+                                      float* row_bias,
+                                      float* col_bias,
+                                      const Epilogue& epilogue,
+                                      T* c,
+                                      const size_t m,
+                                      const size_t n,
+                                      const size_t k );
+// Check if the matrices c1 and c2 differ by at most tolerance.
+template< typename T >
+bool checkEquality( const T* c1,
+                    const T* c2,
+                    const size_t m,
+                    const size_t n,
+                    const double tolerance );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
 
 // =================================================================
 // ------------------------ Global Variables ------------------------
@@ -39,6 +109,8 @@ cl::Program program;   // The program that will run on the device.
 cl::Context context;   // The context which holds the device.
 cl::Device device;     // The device where the kernel will run.
 const size_t WG_SIZE[2] = { 16, 16 };   // The size of work-groups.
+std::string source;   // The source code of the kernels.
+std::map< std::string, cl::Program > programs;   // Per build options.
 
 // =================================================================
 // ------------------------- Main Function -------------------------
@@ -123,17 +195,168 @@ int main() {
 
    bool equal = checkEquality( cs.data(), cp.data(), rows_c, cols_c );
 
+   /**
+    * Multiply matrices given transposed, without transposing them back.
+    * */
+
+   std::vector< int > a_t( rows_a * cols_a );
+   transposeMatrix( a.data(), a_t.data(), rows_a, cols_a );
+   parMultiplyMatrices( a_t.data(), b.data(), cp.data(), m, n, k, Layout::TN );
+   bool tn_equal = checkEquality( cs.data(), cp.data(), rows_c, cols_c );
+
+   std::vector< int > b_t( rows_b * cols_b );
+   transposeMatrix( b.data(), b_t.data(), rows_b, cols_b );
+   parMultiplyMatrices( a.data(), b_t.data(), cp.data(), m, n, k, Layout::NT );
+   bool nt_equal = checkEquality( cs.data(), cp.data(), rows_c, cols_c );
+
    /**
     * Print results.
     * */
 
-   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Status: "
+             << ( equal && tn_equal && nt_equal ? "SUCCESS!" : "FAILED!" )
+             << "\n\tNN: " << ( equal ? "SUCCESS" : "FAILED" )
+             << "\n\tTN: " << ( tn_equal ? "SUCCESS" : "FAILED" )
+             << "\n\tNT: " << ( nt_equal ? "SUCCESS" : "FAILED" ) << std::endl;
    std::cout << "Results: \n\tA[0] = " << a[0] << "\n\tB[0] = " << b[0]
              << "\n\tC[0] = " << cp[0] << std::endl;
    std::cout << "Mean execution time: \n\tSequential: " << seq_time
              << " ms;\n\tParallel: " << par_time << " ms." << std::endl;
    std::cout << "Performance gain: "
              << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+
+   /**
+    * Prepare small valued matrices, biases and an existing matrix c for the
+    * epilogues, so their results are not saturated.
+    * */
+
+   std::vector< int > qa( rows_a * cols_a );
+   for( size_t i = 0; i < rows_a * cols_a; i++ ) {
+      qa[i] = static_cast< int >( ( i + i / k ) % 8 ) - 4;
+   }
+   std::vector< int > qb( rows_b * cols_b );
+   for( size_t i = 0; i < rows_b * cols_b; i++ ) {
+      qb[i] = static_cast< int >( ( i / n + i % n ) % 8 ) - 4;
+   }
+   std::vector< float > row_bias( m );
+   for( size_t i = 0; i < m; i++ ) {
+      row_bias[i] = 0.5f * static_cast< float >( i ) - 4.0f;
+   }
+   std::vector< float > col_bias( n );
+   for( size_t i = 0; i < n; i++ ) {
+      col_bias[i] = 2.0f - 0.25f * static_cast< float >( i );
+   }
+   std::vector< int > acc( rows_c * cols_c );
+   seqMultiplyMatrices( qa.data(), qb.data(), acc.data(), m, n, k );
+
+   /**
+    * Fuse scaling, both biases, GELU and a conversion to 8-bit integers.
+    * */
+
+   Epilogue gelu;
+   gelu.scale = true;
+   gelu.alpha = 1.0f / 512.0f;
+   gelu.beta = 0.5f;
+   gelu.row_bias = true;
+   gelu.col_bias = true;
+   gelu.activation = Activation::Gelu;
+
+   std::vector< int8_t > gs( rows_c * cols_c, 3 );
+   std::vector< int8_t > gp( rows_c * cols_c, 3 );
+   seqApplyEpilogue( acc.data(),
+                     row_bias.data(),
+                     col_bias.data(),
+                     gelu,
+                     gs.data(),
+                     m,
+                     n );
+   parMultiplyMatricesWithEpilogue( qa.data(),
+                                    qb.data(),
+                                    row_bias.data(),
+                                    col_bias.data(),
+                                    gelu,
+                                    gp.data(),
+                                    m,
+                                    n,
+                                    k );
+   bool gelu_equal = checkEquality( gs.data(), gp.data(), m, n, 1.0 );
+
+   /**
+    * Fuse a column bias and a clamp, keeping a float output, and compare the
+    * fused kernel against the product followed by a host pass.
+    * */
+
+   Epilogue clamped;
+   clamped.col_bias = true;
+   clamped.activation = Activation::Clamp;
+   clamped.clamp_min = -100.0f;
+   clamped.clamp_max = 100.0f;
+
+   std::vector< float > fs( rows_c * cols_c );
+   std::vector< float > fp( rows_c * cols_c );
+   seqApplyEpilogue( acc.data(),
+                     row_bias.data(),
+                     col_bias.data(),
+                     clamped,
+                     fs.data(),
+                     m,
+                     n );
+
+   /**
+    * The first call compiles the program of the epilogue, so it is not
+    * measured.
+    * */
+
+   parMultiplyMatricesWithEpilogue( qa.data(),
+                                    qb.data(),
+                                    row_bias.data(),
+                                    col_bias.data(),
+                                    clamped,
+                                    fp.data(),
+                                    m,
+                                    n,
+                                    k );
+   auto epilogue_start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      parMultiplyMatricesWithEpilogue( qa.data(),
+                                       qb.data(),
+                                       row_bias.data(),
+                                       col_bias.data(),
+                                       clamped,
+                                       fp.data(),
+                                       m,
+                                       n,
+                                       k );
+   }
+   double fused_time = getElapsedTime( epilogue_start ) / executions;
+
+   std::vector< float > fu( rows_c * cols_c );
+   epilogue_start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      parMultiplyMatrices( qa.data(), qb.data(), cp.data(), m, n, k );
+      seqApplyEpilogue( cp.data(),
+                        row_bias.data(),
+                        col_bias.data(),
+                        clamped,
+                        fu.data(),
+                        m,
+                        n );
+   }
+   double unfused_time = getElapsedTime( epilogue_start ) / executions;
+   bool clamp_equal = checkEquality( fs.data(), fp.data(), m, n, 1e-4 )
+                   && checkEquality( fs.data(), fu.data(), m, n, 1e-4 );
+
+   /**
+    * Print epilogue results.
+    * */
+
+   std::cout << "Epilogues: \n\tScale + bias + GELU -> char: "
+             << ( gelu_equal ? "SUCCESS" : "FAILED" )
+             << "\n\tColumn bias + clamp -> float: "
+             << ( clamp_equal ? "SUCCESS" : "FAILED" ) << std::endl;
+   std::cout << "Mean execution time: \n\tFused epilogue: " << fused_time
+             << " ms;\n\tHost epilogue: " << unfused_time << " ms."
+             << std::endl;
    return 0;
 }
 
@@ -198,14 +421,14 @@ void initializeDevice() {
     * */
 
    std::ifstream kernel_file( "cached_matrix_multiplication.cl" );
-   std::string src( std::istreambuf_iterator< char >( kernel_file ),
-                    ( std::istreambuf_iterator< char >() ) );
+   source.assign( std::istreambuf_iterator< char >( kernel_file ),
+                  std::istreambuf_iterator< char >() );
 
    /**
     * Compile kernel program which will run on the device.
     * */
 
-   cl::Program::Sources sources{ src };
+   cl::Program::Sources sources{ source };
    context = cl::Context( device );
    program = cl::Program( context, sources );
 
@@ -242,7 +465,9 @@ void seqMultiplyMatrices( const int* a,
 }
 
 /**
- * Parallelly performs the operation c[m,n] = a[m,k] * b[k,n].
+ * Parallelly performs the operation c[m,n] = a[m,k] * b[k,n]. With the TN
+ * layout a is given as a_t[k,m] and with the NT layout b is given as
+ * b_t[n,k]; the kernel transposes their tiles while loading them.
  * */
 
 void parMultiplyMatrices( int* a,
@@ -250,7 +475,8 @@ void parMultiplyMatrices( int* a,
                           int* c,
                           const size_t m,
                           const size_t n,
-                          const size_t k ) {
+                          const size_t k,
+                          const Layout layout ) {
 
    /**
     * Create buffers and allocate memory on the device.
@@ -274,7 +500,10 @@ void parMultiplyMatrices( int* a,
     * Set kernel arguments.
     * */
 
-   cl::Kernel kernel( program, "multiplyMatricesWithCache" );
+   cl::Kernel kernel( layout == Layout::TN   ? getProgram( "-DTRANSPOSE_A" )
+                      : layout == Layout::NT ? getProgram( "-DTRANSPOSE_B" )
+                                             : program,
+                      "multiplyMatricesWithCache" );
    kernel.setArg( 0, a_buf );
    kernel.setArg( 1, b_buf );
    kernel.setArg( 2, c_buf );
@@ -310,3 +539,286 @@ bool checkEquality( const int* c1,
    return true;
 }
 
+
+/**
+ * Store a[rows,cols] transposed, as a_t[cols,rows].
+ * */
+
+void transposeMatrix( const int* a,
+                      int* a_t,
+                      const size_t rows,
+                      const size_t cols ) {
+   for( size_t i = 0; i < rows; i++ ) {
+      for( size_t j = 0; j < cols; j++ ) {
+         a_t[j * rows + i] = a[i * cols + j];
+      }
+   }
+}
+
+/**
+ * Return the program compiled from the kernel source with some build
+ * options. Every set of options is compiled only once.
+ * */
+
+cl::Program& getProgram( const std::string& options ) {
+   auto found = programs.find( options );
+   if( found == programs.end() ) {
+      cl::Program::Sources sources{ source };
+      cl::Program specialized( context, sources );
+      if( specialized.build( options.c_str() ) != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Options: " << options << "\nBuild Log:\t "
+                   << specialized.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                   << std::endl;
+         exit( 1 );
+      }
+      found = programs.emplace( options, specialized ).first;
+   }
+   return found->second;
+}
+
+/**
+ * Return the build options which specialize multiplyMatricesWithEpilogue for
+ * an epilogue and an output type. Integer outputs are rounded to the nearest
+ * value and saturated.
+ * */
+
+template< typename T >
+std::string getEpilogueOptions( const Epilogue& epilogue ) {
+   static_assert( std::is_same_v< T, float > || std::is_same_v< T, int >
+                     || std::is_same_v< T, int16_t >
+                     || std::is_same_v< T, int8_t >
+                     || std::is_same_v< T, uint8_t >,
+                  "Unsupported output type." );
+
+   std::string options;
+   if constexpr( std::is_same_v< T, float > ) {
+      options = "-DOUTPUT_TYPE=float -DOUTPUT_CONVERT=convert_float";
+   } else if constexpr( std::is_same_v< T, int > ) {
+      options = "-DOUTPUT_TYPE=int -DOUTPUT_CONVERT=convert_int_sat_rte";
+   } else if constexpr( std::is_same_v< T, int16_t > ) {
+      options = "-DOUTPUT_TYPE=short -DOUTPUT_CONVERT=convert_short_sat_rte";
+   } else if constexpr( std::is_same_v< T, int8_t > ) {
+      options = "-DOUTPUT_TYPE=char -DOUTPUT_CONVERT=convert_char_sat_rte";
+   } else {
+      options = "-DOUTPUT_TYPE=uchar -DOUTPUT_CONVERT=convert_uchar_sat_rte";
+   }
+
+   if( epilogue.scale ) {
+      options += " -DEPILOGUE_SCALE";
+   }
+   if( epilogue.row_bias ) {
+      options += " -DEPILOGUE_ROW_BIAS";
+   }
+   if( epilogue.col_bias ) {
+      options += " -DEPILOGUE_COL_BIAS";
+   }
+   switch( epilogue.activation ) {
+      case Activation::Relu:
+         options += " -DACTIVATION=ACTIVATION_RELU";
+         break;
+      case Activation::Clamp:
+         options += " -DACTIVATION=ACTIVATION_CLAMP";
+         break;
+      case Activation::Gelu:
+         options += " -DACTIVATION=ACTIVATION_GELU";
+         break;
+      case Activation::None:
+         break;
+   }
+   return options;
+}
+
+/**
+ * Sequentially applies an epilogue to the product acc[m,n] and stores it in
+ * c[m,n], which also holds the existing matrix scaled by beta.
+ * */
+
+template< typename T >
+void seqApplyEpilogue( const int* acc,
+                       const float* row_bias,
+                       const float* col_bias,
+                       const Epilogue& epilogue,
+                       T* c,
+                       const size_t m,
+                       const size_t n ) {
+   for( size_t i = 0; i < m; i++ ) {
+      for( size_t j = 0; j < n; j++ ) {
+         float value = static_cast< float >( acc[i * n + j] );
+         if( epilogue.scale ) {
+            value = epilogue.alpha * value
+                  + epilogue.beta * static_cast< float >( c[i * n + j] );
+         }
+         if( epilogue.row_bias ) {
+            value += row_bias[i];
+         }
+         if( epilogue.col_bias ) {
+            value += col_bias[j];
+         }
+         switch( epilogue.activation ) {
+            case Activation::Relu:
+               value = std::fmax( value, 0.0f );
+               break;
+            case Activation::Clamp:
+               value = std::fmin( std::fmax( value, epilogue.clamp_min ),
+                                  epilogue.clamp_max );
+               break;
+            case Activation::Gelu:
+               value = 0.5f * value
+                     * ( 1.0f + std::erf( value * 0.70710678f ) );
+               break;
+            case Activation::None:
+               break;
+         }
+
+         if constexpr( std::is_floating_point_v< T > ) {
+            c[i * n + j] = value;
+         } else {
+            double rounded = std::nearbyint( static_cast< double >( value ) );
+            rounded = std::fmax( rounded, std::numeric_limits< T >::min() );
+            rounded = std::fmin( rounded, std::numeric_limits< T >::max() );
+            c[i * n + j] = static_cast< T >( rounded );
+         }
+      }
+   }
+}
+
+/**
+ * Parallelly performs the operation c[m,n] = epilogue( a[m,k] * b[k,n] ) in
+ * a single kernel. The matrix c is read as well when the epilogue scales the
+ * existing c by beta. Programs are compiled once per epilogue and output
+ * type.
+ * */
+
+template< typename T >
+void parMultiplyMatricesWithEpilogue( int* a,
+                                      int* b,
+                                      float* row_bias,
+                                      float* col_bias,
+                                      const Epilogue& epilogue,
+                                      T* c,
+                                      const size_t m,
+                                      const size_t n,
+                                      const size_t k ) {
+
+   /**
+    * Get the program specialized for this epilogue, compiling it if needed.
+    * */
+
+   cl::Program& specialized = getProgram( getEpilogueOptions< T >( epilogue ) );
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      m * k * sizeof( int ),
+      a );
+   cl::Buffer b_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      k * n * sizeof( int ),
+      b );
+   cl::Buffer c_buf
+      = epilogue.scale
+           ? cl::Buffer( context,
+                         CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                         m * n * sizeof( T ),
+                         c )
+           : cl::Buffer( context,
+                         CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                         m * n * sizeof( T ) );
+
+   /**
+    * Set kernel arguments. Biases of disabled stages are passed as NULL.
+    * */
+
+   cl_uint m_arg = static_cast< cl_uint >( m );
+   cl_uint n_arg = static_cast< cl_uint >( n );
+   cl_uint k_arg = static_cast< cl_uint >( k );
+   cl::Kernel kernel( specialized, "multiplyMatricesWithEpilogue" );
+   kernel.setArg( 0, a_buf );
+   kernel.setArg( 1, b_buf );
+   kernel.setArg( 2, c_buf );
+   kernel.setArg( 3, m_arg );
+   kernel.setArg( 4, n_arg );
+   kernel.setArg( 5, k_arg );
+
+   cl::Buffer row_bias_buf;
+   if( epilogue.row_bias ) {
+      row_bias_buf = cl::Buffer(
+         context,
+         CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+         m * sizeof( float ),
+         row_bias );
+      kernel.setArg( 6, row_bias_buf );
+   } else {
+      kernel.setArg( 6, sizeof( cl_mem ), nullptr );
+   }
+
+   cl::Buffer col_bias_buf;
+   if( epilogue.col_bias ) {
+      col_bias_buf = cl::Buffer(
+         context,
+         CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+         n * sizeof( float ),
+         col_bias );
+      kernel.setArg( 7, col_bias_buf );
+   } else {
+      kernel.setArg( 7, sizeof( cl_mem ), nullptr );
+   }
+
+   kernel.setArg( 8, epilogue.alpha );
+   kernel.setArg( 9, epilogue.beta );
+   kernel.setArg( 10, epilogue.clamp_min );
+   kernel.setArg( 11, epilogue.clamp_max );
+
+   /**
+    * Execute the kernel function and collect its result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( n, m ),
+                               cl::NDRange( WG_SIZE[0], WG_SIZE[1] ) );
+   queue.enqueueReadBuffer( c_buf, CL_TRUE, 0, m * n * sizeof( T ), c );
+}
+
+/**
+ * Check if the matrices C1 and C2 differ by at most tolerance. The tolerance
+ * is absolute for integer matrices and relative to the magnitude of C1, when
+ * it is greater than one, for floating point matrices.
+ * */
+
+template< typename T >
+bool checkEquality( const T* c1,
+                    const T* c2,
+                    const size_t m,
+                    const size_t n,
+                    const double tolerance ) {
+   for( size_t i = 0; i < m * n; i++ ) {
+      double expected = static_cast< double >( c1[i] );
+      double actual = static_cast< double >( c2[i] );
+      double difference = std::fabs( expected - actual );
+      double limit = tolerance;
+      if constexpr( std::is_floating_point_v< T > ) {
+         limit *= std::fmax( 1.0, std::fabs( expected ) );
+      }
+      if( difference > limit ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,719 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "co_execution.hpp"
+
+// =================================================================
+// ---------------------------- Types -----------------------------
+// =================================================================
+
+// An OpenCL device which takes part in the co-execution, with the programs
+// of the three workloads compiled for it.
+struct Accelerator {
+   cl::Device device;
+   cl::Context context;
+   cl::CommandQueue queue;
+   cl::Program sum_program;        // array_addition.
+   cl::Program multiply_program;   // cached_matrix_multiplication.
+   cl::Program filter_program;     // image_filtering.
+};
+
+// A workload split by rows or elements: its host function, its device
+// function, and the chunks each of them takes.
+struct Workload {
+   std::string name;
+   size_t items;         // Size of the range.
+   size_t granularity;   // Chunks are aligned to it.
+   size_t host_chunk;    // Items taken by a host thread at a time.
+   size_t device_chunk;  // Items taken by a device at a time.
+   size_t calibration;   // Items every executor runs alone to calibrate.
+   // Process [begin, end) on the host.
+   std::function< void( size_t, size_t ) > host;
+   // Process [begin, end) on accelerators[a].
+   std::function< void( size_t, size_t, size_t ) > device;
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Find the devices of type in every platform and compile the kernels.
+void initializeDevices( const cl_device_type type );
+// Compile the kernel file on accelerator.
+cl::Program buildProgram( const Accelerator& accelerator,
+                          const std::string& file_name );
+// Run workload on the host threads, on the devices and on both, and check
+// every output against expected; return whether all of them were equal.
+bool runWorkload( const Workload& workload,
+                  const std::function< void() >& reset,
+                  const std::function< bool() >& check );
+// Create a scheduler with the executors of workload: host threads, devices
+// or both.
+CoExecution createScheduler( const Workload& workload,
+                             const bool host,
+                             const bool devices );
+// Return the workload of sumArrays on arrays of n elements.
+Workload createSumWorkload( const size_t n,
+                            const std::vector< int >& a,
+                            const std::vector< int >& b,
+                            std::vector< int >& c );
+// Return the workload of multiplyMatricesWithCache on matrices of size n.
+Workload createMultiplyWorkload( const size_t n,
+                                 const std::vector< int >& a,
+                                 const std::vector< int >& b,
+                                 std::vector< int >& c );
+// Return the workload of filterImage on an image of width x height pixels.
+Workload createFilterWorkload( const size_t width,
+                               const size_t height,
+                               const std::vector< unsigned char >& input,
+                               std::vector< unsigned char >& output );
+// Sequentially convolve the rows [begin, end) of an image with a mask.
+void seqConvolveRows( const size_t width,
+                      const size_t height,
+                      const size_t begin,
+                      const size_t end,
+                      const unsigned char* input_img,
+                      const float* mask,
+                      unsigned char* output_img );
+// Fill output with the complement of every element of expected.
+template< typename T >
+void fillComplement( const std::vector< T >& expected,
+                     std::vector< T >& output );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+std::vector< Accelerator > accelerators;   // The devices taking part.
+size_t host_threads;                        // The host threads taking part.
+
+// Runs measured of every configuration, after a warm-up run.
+constexpr int EXECUTIONS = 5;
+// Sizes of the workloads.
+constexpr size_t ARRAY_SIZE = 1 << 25;
+constexpr size_t MATRIX_SIZE = 1024;
+constexpr size_t IMG_WIDTH = 4096;
+constexpr size_t IMG_HEIGHT = 4096;
+// Work-group side of multiplyMatricesWithCache, its SUB_SIZE.
+constexpr size_t SUB_SIZE = 16;
+// Side of the high-pass mask of image_filtering. Its weights are integers,
+// so the host and the devices compute the same pixels.
+constexpr size_t MASK_SIZE = 5;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main( int argc, char** argv ) {
+
+   /**
+    * Parse the host threads and the type of the devices taking part. A
+    * CPU device shares its cores with the host threads, so --devices gpu
+    * leaves them to the host.
+    * */
+
+   host_threads = std::max( std::thread::hardware_concurrency(), 1u );
+   cl_device_type type = CL_DEVICE_TYPE_ALL;
+   bool valid = true;
+   for( int i = 1; i < argc && valid; i++ ) {
+      if( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+         long threads = 0;
+         try {
+            threads = std::stol( argv[++i] );
+         } catch( const std::logic_error& ) {
+         }
+         valid = threads > 0;
+         host_threads = static_cast< size_t >( threads );
+      } else if( strcmp( argv[i], "--devices" ) == 0 && i + 1 < argc
+                 && strcmp( argv[i + 1], "gpu" ) == 0 ) {
+         type = CL_DEVICE_TYPE_GPU;
+         i++;
+      } else if( strcmp( argv[i], "--devices" ) == 0 && i + 1 < argc
+                 && strcmp( argv[i + 1], "cpu" ) == 0 ) {
+         type = CL_DEVICE_TYPE_CPU;
+         i++;
+      } else if( strcmp( argv[i], "--devices" ) == 0 && i + 1 < argc
+                 && strcmp( argv[i + 1], "all" ) == 0 ) {
+         i++;
+      } else {
+         valid = false;
+      }
+   }
+   if( !valid ) {
+      std::cerr << "Usage: " << argv[0]
+                << " [--threads n] [--devices all|gpu|cpu], n > 0"
+                << std::endl;
+      return 1;
+   }
+
+   initializeDevices( type );
+   std::cout << "Host threads: " << host_threads << "\nDevices:";
+   for( const Accelerator& accelerator : accelerators ) {
+      std::cout << "\n\t" << accelerator.device.getInfo< CL_DEVICE_NAME >();
+   }
+   std::cout << std::endl;
+
+   /**
+    * Sum arrays.
+    * */
+
+   bool equal = true;
+   {
+      std::vector< int > a( ARRAY_SIZE ), b( ARRAY_SIZE );
+      std::vector< int > expected( ARRAY_SIZE ), c( ARRAY_SIZE );
+      for( size_t i = 0; i < ARRAY_SIZE; i++ ) {
+         a[i] = 2 * static_cast< int >( i );
+         b[i] = 3 * static_cast< int >( i );
+         expected[i] = a[i] + b[i];
+      }
+      equal = runWorkload( createSumWorkload( ARRAY_SIZE, a, b, c ),
+                           [&] { fillComplement( expected, c ); },
+                           [&] { return c == expected; } )
+           && equal;
+   }
+
+   /**
+    * Multiply matrices.
+    * */
+
+   {
+      constexpr size_t n = MATRIX_SIZE;
+      std::vector< int > a( n * n ), b( n * n );
+      std::vector< int > expected( n * n ), c( n * n );
+      for( size_t i = 0; i < n * n; i++ ) {
+         a[i] = static_cast< int >( i % 7 ) - 3;
+         b[i] = static_cast< int >( i % 5 ) - 2;
+      }
+      Workload workload = createMultiplyWorkload( n, a, b, expected );
+      workload.host( 0, n );
+      equal = runWorkload( createMultiplyWorkload( n, a, b, c ),
+                           [&] { fillComplement( expected, c ); },
+                           [&] { return c == expected; } )
+           && equal;
+   }
+
+   /**
+    * Filter an image.
+    * */
+
+   {
+      std::vector< unsigned char > input( IMG_WIDTH * IMG_HEIGHT );
+      std::vector< unsigned char > expected( input.size() );
+      std::vector< unsigned char > output( input.size() );
+      for( size_t i = 0; i < input.size(); i++ ) {
+         input[i] = static_cast< unsigned char >( ( i * 7 ) ^ ( i >> 12 ) );
+      }
+      Workload workload
+         = createFilterWorkload( IMG_WIDTH, IMG_HEIGHT, input, expected );
+      workload.host( 0, IMG_HEIGHT );
+      equal = runWorkload( createFilterWorkload(
+                              IMG_WIDTH, IMG_HEIGHT, input, output ),
+                           [&] { fillComplement( expected, output ); },
+                           [&] { return output == expected; } )
+           && equal;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Find the devices of type in every platform, and create a context, a
+ * queue and the programs of the three workloads for each of them.
+ * */
+
+void initializeDevices( const cl_device_type type ) {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Initialize every device of type found.
+    * */
+
+   for( const cl::Platform& platform : platforms ) {
+      std::vector< cl::Device > devices;
+      platform.getDevices( type, &devices );
+      for( const cl::Device& device : devices ) {
+         Accelerator accelerator;
+         accelerator.device = device;
+         accelerator.context = cl::Context( device );
+         accelerator.queue
+            = cl::CommandQueue( accelerator.context, device );
+         accelerator.sum_program = buildProgram(
+            accelerator, "../array_addition/array_addition.cl" );
+         accelerator.multiply_program = buildProgram(
+            accelerator,
+            "../cached_matrix_multiplication/cached_matrix_multiplication.cl" );
+         accelerator.filter_program = buildProgram(
+            accelerator, "../image_filtering/image_filtering.cl" );
+         accelerators.push_back( accelerator );
+      }
+   }
+
+   if( accelerators.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Compile the kernel file file_name on the device of accelerator.
+ * */
+
+cl::Program buildProgram( const Accelerator& accelerator,
+                          const std::string& file_name ) {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( file_name );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   cl::Program program( accelerator.context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >(
+                      accelerator.device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >(
+                      accelerator.device )
+                << std::endl;
+      exit( 1 );
+   }
+   return program;
+}
+
+/**
+ * Run workload on the host threads alone, on the devices alone and on
+ * both, EXECUTIONS times each after a warm-up run, and print the mean times
+ * and the share of the range every executor got in the co-execution. check
+ * compares the output with the expected one after a last, untimed run of
+ * every configuration, which starts from the output cleared by reset.
+ * */
+
+bool runWorkload( const Workload& workload,
+                  const std::function< void() >& reset,
+                  const std::function< bool() >& check ) {
+   std::cout << "\n" << workload.name << ":\n"
+             << std::fixed << std::setprecision( 2 ) << std::setw( 16 )
+             << "Executors" << std::setw( 12 ) << "Time (ms)"
+             << std::setw( 12 ) << "Stolen" << std::endl;
+
+   bool equal = true;
+   double times[3];
+   const char* names[3] = { "host threads", "devices", "co-execution" };
+   std::vector< std::string > shares;
+   for( int config = 0; config < 3; config++ ) {
+      CoExecution scheduler
+         = createScheduler( workload, config != 1, config != 0 );
+      scheduler.calibrate( workload.calibration );
+      std::vector< double > ratios;
+      for( size_t e = 0; e < scheduler.size(); e++ ) {
+         ratios.push_back( scheduler.ratio( e ) );
+      }
+
+      scheduler.run( workload.items );
+      size_t stolen = 0;
+      auto start = std::chrono::steady_clock::now();
+      for( int i = 0; i < EXECUTIONS; i++ ) {
+         scheduler.run( workload.items );
+         for( size_t e = 0; e < scheduler.size(); e++ ) {
+            stolen += scheduler.stats( e ).stolen;
+         }
+      }
+      times[config] = getElapsedTime( start ) / EXECUTIONS;
+
+      /**
+       * Check a last run on an output cleared of the previous results, so
+       * that only the range this configuration writes can pass.
+       * */
+
+      reset();
+      scheduler.run( workload.items );
+      equal = check() && equal;
+
+      std::cout << std::setw( 16 ) << names[config] << std::setw( 12 )
+                << times[config] << std::setw( 12 )
+                << static_cast< double >( stolen ) / EXECUTIONS << std::endl;
+
+      /**
+       * Show how the co-execution split the range: the share given by the
+       * calibration and the share taken in the last run.
+       * */
+
+      for( size_t e = 0; config == 2 && e < scheduler.size(); e++ ) {
+         std::cout << std::setw( 28 ) << scheduler.name( e ) << ": "
+                   << 100 * ratios[e] << "% calibrated, "
+                   << 100.0 * scheduler.stats( e ).items / workload.items
+                   << "% run" << std::endl;
+      }
+   }
+
+   double best_time = std::min( times[0], times[1] );
+   std::cout << "Mean execution time: \n\tHost threads: " << times[0]
+             << " ms;\n\tDevices: " << times[1] << " ms;\n\tCo-execution: "
+             << times[2] << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( best_time - times[2] ) / times[2] ) << "%\n";
+   return equal;
+}
+
+/**
+ * Create a scheduler with the executors of workload: a host executor per
+ * host thread, and a device executor per accelerator.
+ * */
+
+CoExecution createScheduler( const Workload& workload,
+                             const bool host,
+                             const bool devices ) {
+   CoExecution scheduler( workload.granularity );
+   for( size_t t = 0; host && t < host_threads; t++ ) {
+      scheduler.add(
+         "host " + std::to_string( t ), workload.host, workload.host_chunk );
+   }
+   for( size_t a = 0; devices && a < accelerators.size(); a++ ) {
+      scheduler.add( accelerators[a].device.getInfo< CL_DEVICE_NAME >(),
+                     std::bind( workload.device,
+                                std::placeholders::_1,
+                                std::placeholders::_2,
+                                a ),
+                     workload.device_chunk );
+   }
+   return scheduler;
+}
+
+/**
+ * Return the workload of sumArrays, c = a + b, split by elements. Every
+ * device has buffers of a chunk, which it fills with the elements of a
+ * chunk, sums with sumArrays and reads back.
+ * */
+
+Workload createSumWorkload( const size_t n,
+                            const std::vector< int >& a,
+                            const std::vector< int >& b,
+                            std::vector< int >& c ) {
+   Workload workload;
+   workload.name = "sumArrays";
+   workload.items = n;
+   workload.granularity = 1;
+   workload.host_chunk = 1 << 16;
+   workload.device_chunk = 1 << 21;
+   workload.calibration = 1 << 21;
+   workload.host = [&a, &b, &c]( size_t begin, size_t end ) {
+      for( size_t i = begin; i < end; i++ ) {
+         c[i] = a[i] + b[i];
+      }
+   };
+
+   auto buffers = std::make_shared< std::vector< cl::Buffer > >();
+   const size_t bytes = workload.device_chunk * sizeof( int );
+   for( const Accelerator& accelerator : accelerators ) {
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY,
+                             bytes );
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY,
+                             bytes );
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                             bytes );
+   }
+
+   workload.device
+      = [&a, &b, &c, buffers]( size_t begin, size_t end, size_t index ) {
+           Accelerator& accelerator = accelerators[index];
+           cl::Buffer* chunk_bufs = &( *buffers )[3 * index];
+           const size_t size = ( end - begin ) * sizeof( int );
+           accelerator.queue.enqueueWriteBuffer(
+              chunk_bufs[0], CL_FALSE, 0, size, &a[begin] );
+           accelerator.queue.enqueueWriteBuffer(
+              chunk_bufs[1], CL_FALSE, 0, size, &b[begin] );
+
+           cl::Kernel kernel( accelerator.sum_program, "sumArrays" );
+           kernel.setArg( 0, chunk_bufs[0] );
+           kernel.setArg( 1, chunk_bufs[1] );
+           kernel.setArg( 2, chunk_bufs[2] );
+           accelerator.queue.enqueueNDRangeKernel(
+              kernel, cl::NullRange, cl::NDRange( end - begin ) );
+           accelerator.queue.enqueueReadBuffer(
+              chunk_bufs[2], CL_TRUE, 0, size, &c[begin] );
+        };
+   return workload;
+}
+
+/**
+ * Return the workload of multiplyMatricesWithCache, c = a * b on square
+ * matrices of size n, split by rows of c in blocks of SUB_SIZE rows. Every
+ * device holds the whole b, uploaded once when its buffers are created, as
+ * the weights of a layer would be, and multiplies the rows of a of every
+ * chunk by it.
+ * */
+
+Workload createMultiplyWorkload( const size_t n,
+                                 const std::vector< int >& a,
+                                 const std::vector< int >& b,
+                                 std::vector< int >& c ) {
+   Workload workload;
+   workload.name = "multiplyMatricesWithCache";
+   workload.items = n;
+   workload.granularity = SUB_SIZE;
+   workload.host_chunk = SUB_SIZE;
+   workload.device_chunk = 8 * SUB_SIZE;
+   workload.calibration = 8 * SUB_SIZE;
+   workload.host = [&a, &b, &c, n]( size_t begin, size_t end ) {
+      for( size_t row = begin; row < end; row++ ) {
+         int* c_row = &c[row * n];
+         std::fill( c_row, c_row + n, 0 );
+         for( size_t z = 0; z < n; z++ ) {
+            const int a_value = a[row * n + z];
+            const int* b_row = &b[z * n];
+            for( size_t col = 0; col < n; col++ ) {
+               c_row[col] += a_value * b_row[col];
+            }
+         }
+      }
+   };
+
+   auto buffers = std::make_shared< std::vector< cl::Buffer > >();
+   const size_t bytes = workload.device_chunk * n * sizeof( int );
+   for( const Accelerator& accelerator : accelerators ) {
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY,
+                             bytes );
+      buffers->emplace_back(
+         accelerator.context,
+         CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+         n * n * sizeof( int ),
+         const_cast< int* >( b.data() ) );
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                             bytes );
+   }
+
+   workload.device
+      = [&a, &c, n, buffers]( size_t begin, size_t end, size_t index ) {
+           Accelerator& accelerator = accelerators[index];
+           cl::Buffer* chunk_bufs = &( *buffers )[3 * index];
+           const size_t rows = end - begin;
+           const size_t size = rows * n * sizeof( int );
+           accelerator.queue.enqueueWriteBuffer(
+              chunk_bufs[0], CL_FALSE, 0, size, &a[begin * n] );
+
+           cl::Kernel kernel( accelerator.multiply_program,
+                              "multiplyMatricesWithCache" );
+           kernel.setArg( 0, chunk_bufs[0] );
+           kernel.setArg( 1, chunk_bufs[1] );
+           kernel.setArg( 2, chunk_bufs[2] );
+           kernel.setArg( 3, static_cast< cl_uint >( rows ) );
+           kernel.setArg( 4, static_cast< cl_uint >( n ) );
+           kernel.setArg( 5, static_cast< cl_uint >( n ) );
+           accelerator.queue.enqueueNDRangeKernel( kernel,
+                                                   cl::NullRange,
+                                                   cl::NDRange( n, rows ),
+                                                   cl::NDRange( SUB_SIZE,
+                                                                SUB_SIZE ) );
+           accelerator.queue.enqueueReadBuffer(
+              chunk_bufs[2], CL_TRUE, 0, size, &c[begin * n] );
+        };
+   return workload;
+}
+
+/**
+ * Return the workload of filterImage with the high-pass mask of
+ * image_filtering, split by rows. A device filters the rows of a chunk
+ * with MASK_SIZE / 2 halo rows above and below as an image of its own:
+ * filterImage blanks the border rows of that band, which are real borders
+ * only at the top and the bottom of the image, so only the rows of the
+ * chunk are read back.
+ * */
+
+Workload createFilterWorkload( const size_t width,
+                               const size_t height,
+                               const std::vector< unsigned char >& input,
+                               std::vector< unsigned char >& output ) {
+   constexpr size_t halo = MASK_SIZE / 2;
+   auto mask = std::make_shared< std::vector< float > >(
+      MASK_SIZE * MASK_SIZE, -1.0f );
+   ( *mask )[MASK_SIZE * MASK_SIZE / 2] = MASK_SIZE * MASK_SIZE - 1.0f;
+
+   Workload workload;
+   workload.name = "filterImage";
+   workload.items = height;
+   workload.granularity = 1;
+   workload.host_chunk = 16;
+   workload.device_chunk = 512;
+   workload.calibration = 512;
+   workload.host
+      = [&input, &output, width, height, mask]( size_t begin, size_t end ) {
+           seqConvolveRows( width,
+                            height,
+                            begin,
+                            end,
+                            input.data(),
+                            mask->data(),
+                            output.data() );
+        };
+
+   auto buffers = std::make_shared< std::vector< cl::Buffer > >();
+   const size_t bytes = ( workload.device_chunk + 2 * halo ) * width;
+   for( const Accelerator& accelerator : accelerators ) {
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY,
+                             bytes );
+      buffers->emplace_back(
+         accelerator.context,
+         CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+         mask->size() * sizeof( float ),
+         mask->data() );
+      buffers->emplace_back( accelerator.context,
+                             CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                             bytes );
+   }
+
+   workload.device = [&input, &output, width, height, buffers](
+                        size_t begin, size_t end, size_t index ) {
+      Accelerator& accelerator = accelerators[index];
+      cl::Buffer* chunk_bufs = &( *buffers )[3 * index];
+      const size_t band_begin = begin < halo ? 0 : begin - halo;
+      const size_t band_end = std::min( height, end + halo );
+      accelerator.queue.enqueueWriteBuffer( chunk_bufs[0],
+                                            CL_FALSE,
+                                            0,
+                                            ( band_end - band_begin ) * width,
+                                            &input[band_begin * width] );
+
+      cl::Kernel kernel( accelerator.filter_program, "filterImage" );
+      kernel.setArg( 0, static_cast< cl_uint >( MASK_SIZE ) );
+      kernel.setArg( 1, chunk_bufs[0] );
+      kernel.setArg( 2, chunk_bufs[1] );
+      kernel.setArg( 3, chunk_bufs[2] );
+      accelerator.queue.enqueueNDRangeKernel(
+         kernel, cl::NullRange, cl::NDRange( width, band_end - band_begin ) );
+      accelerator.queue.enqueueReadBuffer( chunk_bufs[2],
+                                           CL_TRUE,
+                                           ( begin - band_begin ) * width,
+                                           ( end - begin ) * width,
+                                           &output[begin * width] );
+   };
+   return workload;
+}
+
+/**
+ * Sequentially convolve the rows [begin, end) of the image input_img with
+ * a mask, as seqConvolve of image_filtering does for the whole image.
+ * */
+
+void seqConvolveRows( const size_t width,
+                      const size_t height,
+                      const size_t begin,
+                      const size_t end,
+                      const unsigned char* input_img,
+                      const float* mask,
+                      unsigned char* output_img ) {
+   for( size_t i = begin; i < end; i++ ) {
+      for( size_t j = 0; j < width; j++ ) {
+
+         /**
+          * Check if the mask cannot be applied to the
+          * current image pixel.
+          * */
+
+         if( i < MASK_SIZE / 2 || j < MASK_SIZE / 2
+             || i >= height - MASK_SIZE / 2 || j >= width - MASK_SIZE / 2 ) {
+            output_img[i * width + j] = 0;
+            continue;
+         }
+
+         /**
+          * Apply mask based on the neighborhood of pixel inputImg(j,i).
+          * */
+
+         int out_sum = 0;
+         for( size_t k = 0; k < MASK_SIZE; k++ ) {
+            for( size_t l = 0; l < MASK_SIZE; l++ ) {
+               size_t row_idx = i - MASK_SIZE / 2 + k;
+               size_t col_idx = j - MASK_SIZE / 2 + l;
+               size_t mask_idx
+                  = ( MASK_SIZE - 1 - l ) + ( MASK_SIZE - 1 - k ) * MASK_SIZE;
+               out_sum += static_cast< int >(
+                  static_cast< float >( input_img[row_idx * width + col_idx] )
+                  * mask[mask_idx] );
+            }
+         }
+
+         /**
+          * Update output pixel.
+          * */
+
+         output_img[i * width + j]
+            = static_cast< unsigned char >( std::min( std::max( out_sum, 0 ),
+                                                      255 ) );
+      }
+   }
+}
+
+/**
+ * Fill output with the complement of every element of expected, so that any
+ * element which is not written again differs from the expected one.
+ * */
+
+template< typename T >
+void fillComplement( const std::vector< T >& expected,
+                     std::vector< T >& output ) {
+   std::transform( expected.begin(),
+                   expected.end(),
+                   output.begin(),
+                   []( T value ) { return static_cast< T >( ~value ); } );
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
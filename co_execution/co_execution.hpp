@@ -0,0 +1,235 @@
+#ifndef CO_EXECUTION_HPP
+#define CO_EXECUTION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Split a range of independent items between several executors, such as
+ * host threads and OpenCL devices, which run at once. Every executor is a
+ * function which processes the items [begin, end) and returns when they
+ * are done, called from a host thread of its own:
+ *
+ *    CoExecution scheduler( 16 );
+ *    scheduler.add( "host", hostFunction, 64 );
+ *    scheduler.add( "gpu", deviceFunction, 1024 );
+ *    scheduler.calibrate( 2048 );
+ *    scheduler.run( n );
+ *
+ * The range starts split in contiguous segments, one per executor, sized by
+ * the ratios of the calibration run. Executors take chunks from the front
+ * of their own segment and, once it is empty, steal chunks from the back of
+ * the largest segment left, so a wrong ratio only costs the items stolen.
+ * After a run the ratios become the shares the executors actually got, so
+ * the next run starts from them.
+ * */
+
+class CoExecution {
+ public:
+   // Process the items [begin, end) of the range.
+   using Function = std::function< void( size_t, size_t ) >;
+
+   // What an executor did in the last run or calibration.
+   struct Stats {
+      size_t items = 0;    // Items processed.
+      size_t chunks = 0;   // Chunks processed.
+      size_t stolen = 0;   // Chunks stolen from the segments of others.
+      double busy = 0.0;   // Milliseconds spent in its function.
+   };
+
+   // Chunks and segments are aligned to granularity items, e.g. the rows
+   // of a work-group.
+   explicit CoExecution( const size_t granularity = 1 )
+      : granularity_( std::max< size_t >( granularity, 1 ) ) {}
+
+   // Add an executor which takes chunk items at a time, rounded up to the
+   // granularity, and return its index.
+   size_t add( const std::string& name,
+               const Function& function,
+               const size_t chunk ) {
+      executors_.push_back(
+         { name, function, std::max( roundUp( chunk ), granularity_ ) } );
+      ratios_.assign( executors_.size(), 1.0 / executors_.size() );
+      stats_.assign( executors_.size(), Stats() );
+      return executors_.size() - 1;
+   }
+
+   // Run every executor alone on the first items of the range, once to
+   // warm it up and once measured, and set the ratios to their
+   // throughputs.
+   void calibrate( const size_t items ) {
+      size_t end = std::max( roundUp( items ), granularity_ );
+      std::vector< double > throughputs;
+      double total = 0.0;
+      for( size_t e = 0; e < executors_.size(); e++ ) {
+         executors_[e].function( 0, end );
+         auto start = std::chrono::steady_clock::now();
+         executors_[e].function( 0, end );
+         double time = getElapsedTime( start );
+         stats_[e] = { end, 1, 0, time };
+         throughputs.push_back( end / std::max( time, 1e-6 ) );
+         total += throughputs.back();
+      }
+      for( size_t e = 0; e < executors_.size(); e++ ) {
+         ratios_[e] = throughputs[e] / total;
+      }
+   }
+
+   // Process the items [0, n) with every executor at once and return when
+   // all of them are done.
+   void run( const size_t n ) {
+      if( executors_.empty() || n == 0 ) {
+         return;
+      }
+
+      /**
+       * Split the range in a segment per executor, sized by its ratio.
+       * */
+
+      segments_.clear();
+      size_t begin = 0;
+      for( size_t e = 0; e < executors_.size(); e++ ) {
+         size_t end = e + 1 == executors_.size()
+                         ? n
+                         : std::min( n, begin + roundUp( static_cast< size_t >(
+                                                  n * ratios_[e] ) ) );
+         segments_.emplace_back( new Segment{ begin, end, {} } );
+         begin = end;
+      }
+
+      /**
+       * Run every executor from a thread of its own.
+       * */
+
+      stats_.assign( executors_.size(), Stats() );
+      std::vector< std::thread > threads;
+      for( size_t e = 0; e < executors_.size(); e++ ) {
+         threads.emplace_back( [this, e] { work( e ); } );
+      }
+      for( std::thread& thread : threads ) {
+         thread.join();
+      }
+
+      for( size_t e = 0; e < executors_.size(); e++ ) {
+         ratios_[e] = static_cast< double >( stats_[e].items ) / n;
+      }
+   }
+
+   // Number of executors.
+   size_t size() const { return executors_.size(); }
+
+   // The name of the executor with index.
+   const std::string& name( const size_t index ) const {
+      return executors_[index].name;
+   }
+
+   // The share of the range the executor with index starts with.
+   double ratio( const size_t index ) const { return ratios_[index]; }
+
+   // What the executor with index did in the last run or calibration.
+   const Stats& stats( const size_t index ) const { return stats_[index]; }
+
+ private:
+   struct Executor {
+      std::string name;
+      Function function;
+      size_t chunk;
+   };
+
+   // The items [begin, end) not yet taken from the segment of an executor.
+   struct Segment {
+      size_t begin;
+      size_t end;
+      std::mutex mutex;
+   };
+
+   // Process chunks of the segment of executor, then steal chunks from the
+   // others until none is left.
+   void work( const size_t executor ) {
+      size_t begin, end;
+      while( take( executor, begin, end ) || steal( executor, begin, end ) ) {
+         auto start = std::chrono::steady_clock::now();
+         executors_[executor].function( begin, end );
+         stats_[executor].busy += getElapsedTime( start );
+         stats_[executor].items += end - begin;
+         stats_[executor].chunks++;
+      }
+   }
+
+   // Take a chunk from the front of the segment of executor.
+   bool take( const size_t executor, size_t& begin, size_t& end ) {
+      Segment& segment = *segments_[executor];
+      std::lock_guard< std::mutex > lock( segment.mutex );
+      if( segment.begin >= segment.end ) {
+         return false;
+      }
+      begin = segment.begin;
+      end = std::min( segment.end, begin + executors_[executor].chunk );
+      segment.begin = end;
+      return true;
+   }
+
+   // Steal a chunk from the back of the largest segment left: the chunk of
+   // the thief, but at most half of what is left, so the owner and the
+   // thief finish at about the same time.
+   bool steal( const size_t thief, size_t& begin, size_t& end ) {
+      for( ;; ) {
+         size_t victim = 0, largest = 0;
+         for( size_t e = 0; e < segments_.size(); e++ ) {
+            std::lock_guard< std::mutex > lock( segments_[e]->mutex );
+            if( segments_[e]->end - segments_[e]->begin > largest ) {
+               largest = segments_[e]->end - segments_[e]->begin;
+               victim = e;
+            }
+         }
+         if( largest == 0 ) {
+            return false;
+         }
+
+         Segment& segment = *segments_[victim];
+         std::lock_guard< std::mutex > lock( segment.mutex );
+         size_t left = segment.end - segment.begin;
+         if( left == 0 ) {
+            continue;
+         }
+         size_t wanted = std::max(
+            granularity_, std::min( executors_[thief].chunk, left / 2 ) );
+         end = segment.end;
+         begin = std::max(
+            segment.begin, roundDown( end - std::min( wanted, left ) ) );
+         segment.end = begin;
+         stats_[thief].stolen++;
+         return true;
+      }
+   }
+
+   // Round items up or down to the granularity.
+   size_t roundUp( const size_t items ) const {
+      return ( items + granularity_ - 1 ) / granularity_ * granularity_;
+   }
+   size_t roundDown( const size_t items ) const {
+      return items / granularity_ * granularity_;
+   }
+
+   // Return the milliseconds elapsed since start.
+   static double getElapsedTime(
+      const std::chrono::steady_clock::time_point& start ) {
+      return std::chrono::duration< double, std::milli >(
+                std::chrono::steady_clock::now() - start )
+         .count();
+   }
+
+   size_t granularity_;
+   std::vector< Executor > executors_;
+   std::vector< double > ratios_;
+   std::vector< Stats > stats_;
+   std::vector< std::unique_ptr< Segment > > segments_;
+};
+
+#endif
@@ -0,0 +1,362 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "command_buffer.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Initialize device and compile the kernels of image_filtering.
+void initializeDevice();
+// Filter a number of frames with mode, alternating between sets of buffers,
+// and return the result of the last one.
+std::vector< unsigned char > filterFrames( const std::string& mode,
+                                           const int frames,
+                                           double& issue_time,
+                                           double& frame_time );
+// Return the microseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// Small frames, where launch overhead matters, as at high frame rates.
+constexpr unsigned int IMG_WIDTH = 256;
+constexpr unsigned int IMG_HEIGHT = 128;
+constexpr unsigned int MASK_SIZE = 5;
+// Sets of buffers in flight: frame i uses set i % FRAMES_IN_FLIGHT.
+constexpr int FRAMES_IN_FLIGHT = 2;
+
+// The slots of the buffers rebound every frame.
+enum Slot { R_SLOT, G_SLOT, B_SLOT, OUTPUT_SLOT };
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int frames = 2000;
+   initializeDevice();
+   std::cout << "Command buffers: "
+             << ( CommandRecorder::isSupported( device )
+                     ? "cl_khr_command_buffer"
+                     : "not supported, replay lists only" )
+             << std::endl;
+
+   /**
+    * Filter the frames re-enqueueing every kernel, as parFilter does, and
+    * replaying the recorded pipeline.
+    * */
+
+   std::vector< std::string > modes = { "Re-enqueue", "Replay list" };
+   if( CommandRecorder::isSupported( device ) ) {
+      modes.push_back( "Command buffer" );
+   }
+
+   bool equal = true;
+   std::vector< unsigned char > expected;
+   double base_issue_time = 0.0;
+   double best_issue_time = 0.0;
+   std::string best_mode;
+   std::cout << std::fixed << std::setprecision( 2 )
+             << "Launch overhead of the 3 kernels of " << frames
+             << " frames of " << IMG_WIDTH << "x" << IMG_HEIGHT
+             << " pixels, per frame:" << std::endl;
+   for( const std::string& mode : modes ) {
+      double issue_time, frame_time;
+      std::vector< unsigned char > output
+         = filterFrames( mode, frames, issue_time, frame_time );
+      if( expected.empty() ) {
+         expected = output;
+         base_issue_time = issue_time;
+      } else if( best_mode.empty() || issue_time < best_issue_time ) {
+         best_issue_time = issue_time;
+         best_mode = mode;
+      }
+      bool mode_equal = output == expected;
+      equal = equal && mode_equal;
+
+      std::cout << "\t" << std::setw( 14 ) << mode << ": " << issue_time
+                << " us to enqueue, " << frame_time << " us per frame"
+                << ( mode_equal ? "" : " (FAILED)" ) << std::endl;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean launch overhead per frame: \n\tBefore: "
+             << base_issue_time << " us;\n\tAfter (" << best_mode
+             << "): " << best_issue_time << " us." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( base_issue_time - best_issue_time )
+                  / best_issue_time )
+             << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Initialize device and compile the kernels of image_filtering.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device.
+    * */
+
+   device = getDefaultDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "../image_filtering/image_filtering.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Filter a number of frames with the rgb2gray, low-pass and high-pass pipeline
+ * of image_filtering, alternating between FRAMES_IN_FLIGHT sets of input
+ * and output buffers, and return the result of the last frame. mode is:
+ *    - "Re-enqueue": create the kernels, set their arguments and enqueue
+ *      them every frame, as parFilter does;
+ *    - "Replay list": record the pipeline once in a host replay list;
+ *    - "Command buffer": record it once in a command buffer.
+ * issue_time is the mean host time spent enqueueing a frame and frame_time
+ * the mean time of a frame, both in microseconds.
+ * */
+
+std::vector< unsigned char > filterFrames( const std::string& mode,
+                                           const int frames,
+                                           double& issue_time,
+                                           double& frame_time ) {
+   constexpr size_t pixels = IMG_WIDTH * IMG_HEIGHT;
+
+   /**
+    * Create the input frames, different in every set, the masks, the
+    * intermediate images and the outputs.
+    * */
+
+   std::vector< unsigned char > channel( pixels );
+   std::vector< cl::Buffer > channels[3];
+   std::vector< cl::Buffer > outputs;
+   for( int set = 0; set < FRAMES_IN_FLIGHT; set++ ) {
+      for( int c = 0; c < 3; c++ ) {
+         for( size_t i = 0; i < pixels; i++ ) {
+            channel[i] = static_cast< unsigned char >( i * ( c + 1 ) + set );
+         }
+         channels[c].push_back( cl::Buffer(
+            context,
+            CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+            pixels,
+            channel.data() ) );
+      }
+      outputs.push_back( cl::Buffer(
+         context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, pixels ) );
+   }
+
+   std::vector< float > lp_mask( MASK_SIZE * MASK_SIZE, .04f );
+   std::vector< float > hp_mask( MASK_SIZE * MASK_SIZE, -1.0f );
+   hp_mask[MASK_SIZE * MASK_SIZE / 2] = MASK_SIZE * MASK_SIZE - 1.0f;
+   cl::Buffer lp_mask_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      lp_mask.size() * sizeof( float ),
+      lp_mask.data() );
+   cl::Buffer hp_mask_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      hp_mask.size() * sizeof( float ),
+      hp_mask.data() );
+   cl::Buffer gray_buf(
+      context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, pixels );
+   cl::Buffer lp_buf(
+      context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, pixels );
+
+   /**
+    * Record the pipeline: the channels and the output are rebound every
+    * frame.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   const cl::NDRange global( IMG_WIDTH, IMG_HEIGHT );
+   CommandRecorder recorder(
+      context, device, queue, mode == "Command buffer" );
+
+   cl::Kernel gray_kernel( program, "rgb2gray" );
+   gray_kernel.setArg( 3, gray_buf );
+   cl::Kernel lp_kernel( program, "filterImage" );
+   lp_kernel.setArg( 0, MASK_SIZE );
+   lp_kernel.setArg( 1, gray_buf );
+   lp_kernel.setArg( 2, lp_mask_buf );
+   lp_kernel.setArg( 3, lp_buf );
+   cl::Kernel hp_kernel( program, "filterImage" );
+   hp_kernel.setArg( 0, MASK_SIZE );
+   hp_kernel.setArg( 1, lp_buf );
+   hp_kernel.setArg( 2, hp_mask_buf );
+
+   recorder.recordKernel( gray_kernel,
+                          global,
+                          cl::NullRange,
+                          { { 0, R_SLOT }, { 1, G_SLOT }, { 2, B_SLOT } } );
+   recorder.recordKernel( lp_kernel, global );
+   recorder.recordKernel(
+      hp_kernel, global, cl::NullRange, { { 3, OUTPUT_SLOT } } );
+
+   /**
+    * Filter the frames; the first FRAMES_IN_FLIGHT ones record the
+    * command buffers, so they are not measured.
+    * */
+
+   auto enqueueFrame = [&]( const int frame ) {
+      const int set = frame % FRAMES_IN_FLIGHT;
+      if( mode == "Re-enqueue" ) {
+         cl::Kernel gray( program, "rgb2gray" );
+         gray.setArg( 0, channels[0][set] );
+         gray.setArg( 1, channels[1][set] );
+         gray.setArg( 2, channels[2][set] );
+         gray.setArg( 3, gray_buf );
+         cl::Kernel lp( program, "filterImage" );
+         lp.setArg( 0, MASK_SIZE );
+         lp.setArg( 1, gray_buf );
+         lp.setArg( 2, lp_mask_buf );
+         lp.setArg( 3, lp_buf );
+         cl::Kernel hp( program, "filterImage" );
+         hp.setArg( 0, MASK_SIZE );
+         hp.setArg( 1, lp_buf );
+         hp.setArg( 2, hp_mask_buf );
+         hp.setArg( 3, outputs[set] );
+         queue.enqueueNDRangeKernel( gray, cl::NullRange, global );
+         queue.enqueueNDRangeKernel( lp, cl::NullRange, global );
+         queue.enqueueNDRangeKernel( hp, cl::NullRange, global );
+      } else {
+         recorder.bind( R_SLOT, channels[0][set] );
+         recorder.bind( G_SLOT, channels[1][set] );
+         recorder.bind( B_SLOT, channels[2][set] );
+         recorder.bind( OUTPUT_SLOT, outputs[set] );
+         recorder.replay();
+      }
+   };
+
+   for( int frame = 0; frame < FRAMES_IN_FLIGHT; frame++ ) {
+      enqueueFrame( frame );
+   }
+   queue.finish();
+
+   issue_time = 0.0;
+   auto start = std::chrono::steady_clock::now();
+   for( int frame = 0; frame < frames; frame++ ) {
+      auto issue_start = std::chrono::steady_clock::now();
+      enqueueFrame( frame );
+      issue_time += getElapsedTime( issue_start );
+   }
+   queue.finish();
+   frame_time = getElapsedTime( start ) / frames;
+   issue_time /= frames;
+
+   /**
+    * Collect the result of the last frame.
+    * */
+
+   std::vector< unsigned char > output( pixels );
+   queue.enqueueReadBuffer( outputs[( frames - 1 ) % FRAMES_IN_FLIGHT],
+                            CL_TRUE,
+                            0,
+                            pixels,
+                            output.data() );
+   return output;
+}
+
+/**
+ * Return the microseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::micro >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
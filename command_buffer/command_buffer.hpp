@@ -0,0 +1,345 @@
+#ifndef COMMAND_BUFFER_HPP
+#define COMMAND_BUFFER_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Declare the part of cl_khr_command_buffer used here, for headers which do
+ * not provide it. The entry points are always loaded at run time, since
+ * the extension is provisional and not exported by the ICD loader.
+ */
+
+#ifndef cl_khr_command_buffer
+typedef struct _cl_command_buffer_khr* cl_command_buffer_khr;
+typedef cl_uint cl_sync_point_khr;
+typedef struct _cl_mutable_command_khr* cl_mutable_command_khr;
+typedef cl_properties cl_command_buffer_properties_khr;
+typedef cl_bitfield cl_device_command_buffer_capabilities_khr;
+
+   #define CL_DEVICE_COMMAND_BUFFER_CAPABILITIES_KHR 0x12A9
+   #define CL_COMMAND_BUFFER_CAPABILITY_SIMULTANEOUS_USE_KHR ( 1 << 2 )
+   #define CL_COMMAND_BUFFER_FLAGS_KHR 0x1293
+   #define CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR ( 1 << 0 )
+#endif
+
+/**
+ * Record a fixed sequence of kernel launches once and replay it every
+ * frame. With cl_khr_command_buffer the sequence becomes a finalized
+ * command buffer, so a replay is a single enqueue; otherwise it is kept in
+ * a host replay list, which still saves creating kernels and setting their
+ * arguments. Buffer arguments can be bound to slots, which every replay
+ * reads, so frames can rotate their buffers:
+ *
+ *    CommandRecorder recorder( context, device, queue );
+ *    recorder.recordKernel( kernel, cl::NDRange( n ), cl::NullRange,
+ *                           { { 0, INPUT_SLOT } } );
+ *    recorder.bind( INPUT_SLOT, frames[i % 2] );
+ *    recorder.replay();
+ *
+ * A command buffer captures the arguments of its kernels, so each set of
+ * bound buffers gets its own command buffer, recorded the first time it is
+ * replayed and kept for the next ones, up to MAX_COMMAND_BUFFERS sets.
+ * */
+
+// =================================================================
+// ------------------------ CommandRecorder ------------------------
+// =================================================================
+
+class CommandRecorder {
+ public:
+   // A kernel argument which replays take from a slot of buffers.
+   struct Binding {
+      cl_uint arg_index;
+      size_t slot;
+   };
+
+   // Maximum number of command buffers kept for different sets of bound
+   // buffers; double or triple buffering needs only a few.
+   static constexpr size_t MAX_COMMAND_BUFFERS = 16;
+
+   // Record commands for queue, in a command buffer when use_command_buffer
+   // is set and the device supports it.
+   CommandRecorder( const cl::Context& context,
+                    const cl::Device& device,
+                    const cl::CommandQueue& queue,
+                    const bool use_command_buffer = true )
+      : context_( context ), device_( device ), queue_( queue ) {
+      if( use_command_buffer && isSupported( device ) ) {
+         use_command_buffer_ = loadFunctions();
+      }
+   }
+
+   ~CommandRecorder() { releaseCommandBuffers(); }
+
+   CommandRecorder( const CommandRecorder& ) = delete;
+   CommandRecorder& operator=( const CommandRecorder& ) = delete;
+
+   // Check whether device supports cl_khr_command_buffer.
+   static bool isSupported( const cl::Device& device ) {
+      std::string extensions = device.getInfo< CL_DEVICE_EXTENSIONS >();
+      return extensions.find( "cl_khr_command_buffer" ) != std::string::npos;
+   }
+
+   // Whether replays enqueue a command buffer instead of the replay list.
+   bool usesCommandBuffer() const { return use_command_buffer_; }
+
+   // Record a launch of kernel over global, with the arguments it has now
+   // except bindings, which every replay sets from their slots. Return the
+   // index of the command.
+   size_t recordKernel( const cl::Kernel& kernel,
+                        const cl::NDRange& global,
+                        const cl::NDRange& local = cl::NullRange,
+                        const std::vector< Binding >& bindings = {} ) {
+      commands_.push_back( { kernel, global, local, bindings } );
+      for( const Binding& binding : bindings ) {
+         if( binding.slot >= slots_.size() ) {
+            slots_.resize( binding.slot + 1 );
+         }
+      }
+      releaseCommandBuffers();
+      return commands_.size() - 1;
+   }
+
+   // Bind buffer to slot for the next replays.
+   void bind( const size_t slot, const cl::Buffer& buffer ) {
+      if( slot >= slots_.size() ) {
+         slots_.resize( slot + 1 );
+      }
+      slots_[slot] = buffer;
+   }
+
+   // Enqueue the recorded commands with the bound buffers.
+   void replay() {
+      if( use_command_buffer_ ) {
+         replayCommandBuffer();
+      } else {
+         replayList();
+      }
+   }
+
+ private:
+   // A recorded kernel launch.
+   struct Command {
+      cl::Kernel kernel;
+      cl::NDRange global;
+      cl::NDRange local;
+      std::vector< Binding > bindings;
+   };
+
+   // A finalized command buffer and the event of its last replay.
+   struct RecordedBuffer {
+      cl_command_buffer_khr command_buffer;
+      cl_event last_replay;
+   };
+
+   // The entry points of cl_khr_command_buffer; the properties of commands
+   // are passed as NULL, so their exact type does not matter.
+   typedef cl_command_buffer_khr( CL_API_CALL* CreateCommandBufferFn )(
+      cl_uint,
+      const cl_command_queue*,
+      const cl_command_buffer_properties_khr*,
+      cl_int* );
+   typedef cl_int( CL_API_CALL* CommandNDRangeKernelFn )(
+      cl_command_buffer_khr,
+      cl_command_queue,
+      const cl_properties*,
+      cl_kernel,
+      cl_uint,
+      const size_t*,
+      const size_t*,
+      const size_t*,
+      cl_uint,
+      const cl_sync_point_khr*,
+      cl_sync_point_khr*,
+      cl_mutable_command_khr* );
+   typedef cl_int( CL_API_CALL* FinalizeCommandBufferFn )(
+      cl_command_buffer_khr );
+   typedef cl_int( CL_API_CALL* EnqueueCommandBufferFn )( cl_uint,
+                                                          cl_command_queue*,
+                                                          cl_command_buffer_khr,
+                                                          cl_uint,
+                                                          const cl_event*,
+                                                          cl_event* );
+   typedef cl_int( CL_API_CALL* ReleaseCommandBufferFn )(
+      cl_command_buffer_khr );
+
+   // Load the entry points of cl_khr_command_buffer and the capabilities
+   // of the device; return whether they are all available.
+   bool loadFunctions() {
+      cl_platform_id platform = device_.getInfo< CL_DEVICE_PLATFORM >();
+      create_ = reinterpret_cast< CreateCommandBufferFn >(
+         clGetExtensionFunctionAddressForPlatform(
+            platform, "clCreateCommandBufferKHR" ) );
+      command_nd_range_kernel_ = reinterpret_cast< CommandNDRangeKernelFn >(
+         clGetExtensionFunctionAddressForPlatform(
+            platform, "clCommandNDRangeKernelKHR" ) );
+      finalize_ = reinterpret_cast< FinalizeCommandBufferFn >(
+         clGetExtensionFunctionAddressForPlatform(
+            platform, "clFinalizeCommandBufferKHR" ) );
+      enqueue_ = reinterpret_cast< EnqueueCommandBufferFn >(
+         clGetExtensionFunctionAddressForPlatform(
+            platform, "clEnqueueCommandBufferKHR" ) );
+      release_ = reinterpret_cast< ReleaseCommandBufferFn >(
+         clGetExtensionFunctionAddressForPlatform(
+            platform, "clReleaseCommandBufferKHR" ) );
+
+      cl_device_command_buffer_capabilities_khr capabilities = 0;
+      clGetDeviceInfo( device_(),
+                       CL_DEVICE_COMMAND_BUFFER_CAPABILITIES_KHR,
+                       sizeof( capabilities ),
+                       &capabilities,
+                       nullptr );
+      simultaneous_use_
+         = capabilities & CL_COMMAND_BUFFER_CAPABILITY_SIMULTANEOUS_USE_KHR;
+      return create_ && command_nd_range_kernel_ && finalize_ && enqueue_
+          && release_;
+   }
+
+   // Enqueue the command buffer of the bound buffers, recording it first
+   // when they were never bound together.
+   void replayCommandBuffer() {
+      std::vector< cl_mem > key( slots_.size() );
+      for( size_t i = 0; i < slots_.size(); i++ ) {
+         key[i] = slots_[i]();
+      }
+
+      auto found = command_buffers_.find( key );
+      if( found == command_buffers_.end() ) {
+         if( command_buffers_.size() == MAX_COMMAND_BUFFERS ) {
+            releaseCommandBuffers();
+         }
+         cl_command_buffer_khr command_buffer = recordCommandBuffer();
+         if( !command_buffer ) {
+            std::cerr << "Fail to record the command buffer; replaying the "
+                         "host list instead."
+                      << std::endl;
+            use_command_buffer_ = false;
+            replayList();
+            return;
+         }
+         found
+            = command_buffers_.emplace( key, RecordedBuffer{ command_buffer,
+                                                             nullptr } )
+                 .first;
+      }
+
+      /**
+       * Without simultaneous use, a command buffer cannot be enqueued
+       * while its last replay is pending, so wait for it.
+       * */
+
+      RecordedBuffer& recorded = found->second;
+      if( recorded.last_replay ) {
+         clWaitForEvents( 1, &recorded.last_replay );
+         clReleaseEvent( recorded.last_replay );
+         recorded.last_replay = nullptr;
+      }
+      cl_event* event = simultaneous_use_ ? nullptr : &recorded.last_replay;
+      cl_int err
+         = enqueue_( 0, nullptr, recorded.command_buffer, 0, nullptr, event );
+      if( err != CL_SUCCESS ) {
+         std::cerr << "Fail to enqueue the command buffer: " << err
+                   << std::endl;
+         exit( 1 );
+      }
+   }
+
+   // Set the bound arguments, add every command to a new command buffer
+   // and finalize it; return NULL on failure.
+   cl_command_buffer_khr recordCommandBuffer() {
+      cl_command_buffer_properties_khr properties[]
+         = { CL_COMMAND_BUFFER_FLAGS_KHR,
+             CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR,
+             0 };
+      cl_command_queue queue = queue_();
+      cl_int err;
+      cl_command_buffer_khr command_buffer
+         = create_( 1, &queue, simultaneous_use_ ? properties : nullptr, &err );
+      if( err != CL_SUCCESS ) {
+         return nullptr;
+      }
+
+      for( Command& command : commands_ ) {
+         setBindings( command );
+         err = command_nd_range_kernel_(
+            command_buffer,
+            nullptr,
+            nullptr,
+            command.kernel(),
+            static_cast< cl_uint >( command.global.dimensions() ),
+            nullptr,
+            command.global.get(),
+            command.local.dimensions() ? command.local.get() : nullptr,
+            0,
+            nullptr,
+            nullptr,
+            nullptr );
+         if( err != CL_SUCCESS ) {
+            release_( command_buffer );
+            return nullptr;
+         }
+      }
+      if( finalize_( command_buffer ) != CL_SUCCESS ) {
+         release_( command_buffer );
+         return nullptr;
+      }
+      return command_buffer;
+   }
+
+   // Enqueue every command of the replay list, setting only the bound
+   // arguments whose buffer changed since the last replay.
+   void replayList() {
+      for( Command& command : commands_ ) {
+         setBindings( command );
+         queue_.enqueueNDRangeKernel(
+            command.kernel, cl::NullRange, command.global, command.local );
+      }
+   }
+
+   // Set the bound arguments of command from their slots.
+   void setBindings( Command& command ) {
+      for( const Binding& binding : command.bindings ) {
+         auto& last = last_bound_[{ command.kernel(), binding.arg_index }];
+         if( last != slots_[binding.slot]() ) {
+            command.kernel.setArg( binding.arg_index, slots_[binding.slot] );
+            last = slots_[binding.slot]();
+         }
+      }
+   }
+
+   // Release every recorded command buffer; the runtime deletes them once
+   // their pending replays finish.
+   void releaseCommandBuffers() {
+      for( auto& entry : command_buffers_ ) {
+         if( entry.second.last_replay ) {
+            clReleaseEvent( entry.second.last_replay );
+         }
+         release_( entry.second.command_buffer );
+      }
+      command_buffers_.clear();
+   }
+
+   cl::Context context_;
+   cl::Device device_;
+   cl::CommandQueue queue_;
+   bool use_command_buffer_ = false;
+   bool simultaneous_use_ = false;
+   std::vector< Command > commands_;
+   std::vector< cl::Buffer > slots_;
+   std::map< std::pair< cl_kernel, cl_uint >, cl_mem > last_bound_;
+   std::map< std::vector< cl_mem >, RecordedBuffer > command_buffers_;
+   CreateCommandBufferFn create_ = nullptr;
+   CommandNDRangeKernelFn command_nd_range_kernel_ = nullptr;
+   FinalizeCommandBufferFn finalize_ = nullptr;
+   EnqueueCommandBufferFn enqueue_ = nullptr;
+   ReleaseCommandBufferFn release_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,248 @@
+/**
+ * Declare the compaction performed by this program. The host code defines:
+ *    - VALUE_TYPE: the type of the compacted values (e.g. uchar, int, float);
+ *    - WG_SIZE: the work-group size, a power of two.
+ * Every work-group handles a tile of TILE_SIZE elements in
+ * ITEMS_PER_WORK_ITEM rounds of WG_SIZE consecutive elements.
+ */
+
+#ifndef VALUE_TYPE
+   #define VALUE_TYPE int
+#endif
+
+#ifndef WG_SIZE
+   #define WG_SIZE 256
+#endif
+
+#define ITEMS_PER_WORK_ITEM 4
+#define TILE_SIZE ( WG_SIZE * ITEMS_PER_WORK_ITEM )
+
+/**
+ * Select how the selected work-items of a work-group are ranked, unless the
+ * host code forces one path with COMPACT_BALLOT, COMPACT_SUB_GROUP or
+ * COMPACT_TREE:
+ *    - sub_group_ballot and the bit counts of the ballot when
+ *      cl_khr_subgroup_ballot is supported, one mask per sub-group;
+ *    - sub_group_scan_exclusive_add when sub-groups are supported (OpenCL C
+ *      3.0 feature or cl_khr_subgroups);
+ *    - a scan in local memory otherwise.
+ * The sub-group paths then only scan one count per sub-group.
+ */
+
+#if !defined( COMPACT_BALLOT ) && !defined( COMPACT_SUB_GROUP ) \
+   && !defined( COMPACT_TREE )
+   #if defined( cl_khr_subgroup_ballot )
+      #define COMPACT_BALLOT
+   #elif defined( __opencl_c_subgroups ) || defined( cl_khr_subgroups )
+      #define COMPACT_SUB_GROUP
+   #else
+      #define COMPACT_TREE
+   #endif
+#endif
+
+#if ( defined( COMPACT_BALLOT ) || defined( COMPACT_SUB_GROUP ) ) \
+   && !defined( __opencl_c_subgroups )
+   #pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+/**
+ * The selections the kernels can perform; they must match
+ * Compaction::Predicate, followed by unique.
+ */
+
+#define SELECT_GREATER 0
+#define SELECT_GREATER_EQUAL 1
+#define SELECT_LESS 2
+#define SELECT_LESS_EQUAL 3
+#define SELECT_EQUAL 4
+#define SELECT_NOT_EQUAL 5
+#define SELECT_UNIQUE 6
+
+/**
+ * Return whether value, the element index of input, is selected: compared
+ * with threshold, or, for unique, different from the previous element.
+ */
+
+bool isSelected( const VALUE_TYPE value,
+                 const __global VALUE_TYPE* input,
+                 const uint index,
+                 const uint selection,
+                 const VALUE_TYPE threshold ) {
+   switch( selection ) {
+      case SELECT_GREATER:
+         return value > threshold;
+      case SELECT_GREATER_EQUAL:
+         return value >= threshold;
+      case SELECT_LESS:
+         return value < threshold;
+      case SELECT_LESS_EQUAL:
+         return value <= threshold;
+      case SELECT_EQUAL:
+         return value == threshold;
+      case SELECT_NOT_EQUAL:
+         return value != threshold;
+      default:
+         return index == 0 || value != input[index - 1];
+   }
+}
+
+/**
+ * Return the number of selected work-items of the work-group before this one
+ * and store the number of all of them in total. Every work-item of the
+ * work-group must call it; scratch must hold WG_SIZE elements.
+ */
+
+uint rankWorkGroup( const bool selected, __local uint* scratch, uint* total ) {
+#if defined( COMPACT_BALLOT ) || defined( COMPACT_SUB_GROUP )
+
+   /**
+    * Rank the work-item within its sub-group and store the count of the
+    * sub-group.
+    */
+
+   #if defined( COMPACT_BALLOT )
+   uint4 ballot = sub_group_ballot( selected );
+   uint rank = sub_group_ballot_exclusive_scan( ballot );
+   uint count = sub_group_ballot_bit_count( ballot );
+   #else
+   uint rank = sub_group_scan_exclusive_add( (uint)selected );
+   uint count = sub_group_reduce_add( (uint)selected );
+   #endif
+   if( get_sub_group_local_id() == 0 ) {
+      scratch[get_sub_group_id()] = count;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Add the counts of the previous sub-groups; there are few of them.
+    */
+
+   uint sub_group_index = get_sub_group_id();
+   uint sum = 0;
+   for( uint i = 0; i < get_num_sub_groups(); i++ ) {
+      if( i == sub_group_index ) {
+         rank += sum;
+      }
+      sum += scratch[i];
+   }
+   *total = sum;
+   barrier( CLK_LOCAL_MEM_FENCE );
+   return rank;
+
+#else
+
+   uint local_index = get_local_id( 0 );
+   scratch[local_index] = selected;
+   for( uint offset = 1; offset < WG_SIZE; offset *= 2 ) {
+      barrier( CLK_LOCAL_MEM_FENCE );
+      uint prev = local_index >= offset ? scratch[local_index - offset] : 0;
+      barrier( CLK_LOCAL_MEM_FENCE );
+      scratch[local_index] += prev;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+   *total = scratch[WG_SIZE - 1];
+   uint rank = scratch[local_index] - selected;
+   barrier( CLK_LOCAL_MEM_FENCE );
+   return rank;
+
+#endif
+}
+
+/**
+ * This kernel function counts the selected elements of every tile of
+ * input[n] in counts[group]; their exclusive scan gives the first output
+ * position of every tile.
+ */
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+countSelected( const __global VALUE_TYPE* input,
+               __global uint* counts,
+               const unsigned int n,
+               const unsigned int selection,
+               const VALUE_TYPE threshold ) {
+   __local uint scratch[WG_SIZE];
+
+   uint tile_start = get_group_id( 0 ) * TILE_SIZE;
+   uint count = 0;
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint index = tile_start + i * WG_SIZE + get_local_id( 0 );
+      bool selected = index < n
+                   && isSelected( input[index],
+                                  input,
+                                  index,
+                                  selection,
+                                  threshold );
+      uint total;
+      rankWorkGroup( selected, scratch, &total );
+      count += total;
+   }
+
+   if( get_local_id( 0 ) == 0 ) {
+      counts[get_group_id( 0 )] = count;
+   }
+}
+
+/**
+ * This kernel function packs the selected elements of input[n], in order,
+ * at the front of values and their positions in input at the front of
+ * indices; either output may be NULL. offsets is the exclusive scan of the
+ * counts of countSelected. When partition is set, the other elements
+ * follow them, also in order. The first work-item stores the number of
+ * selected elements in count.
+ */
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+scatterSelected( const __global VALUE_TYPE* input,
+                 const __global uint* counts,
+                 const __global uint* offsets,
+                 __global VALUE_TYPE* values,
+                 __global uint* indices,
+                 __global uint* count,
+                 const unsigned int n,
+                 const unsigned int selection,
+                 const VALUE_TYPE threshold,
+                 const unsigned int partition ) {
+   __local uint scratch[WG_SIZE];
+
+   /**
+    * Find the first output position of the tile and the number of
+    * selected elements, where the others start.
+    */
+
+   uint last_group = get_num_groups( 0 ) - 1;
+   uint selected_count = offsets[last_group] + counts[last_group];
+   uint offset = offsets[get_group_id( 0 )];
+   if( get_global_id( 0 ) == 0 ) {
+      *count = selected_count;
+   }
+
+   /**
+    * Store every round of the tile: selected work-items have consecutive
+    * ranks, so their writes stay contiguous.
+    */
+
+   uint tile_start = get_group_id( 0 ) * TILE_SIZE;
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint index = tile_start + i * WG_SIZE + get_local_id( 0 );
+      VALUE_TYPE value = index < n ? input[index] : 0;
+      bool selected = index < n
+                   && isSelected( value, input, index, selection, threshold );
+      uint total;
+      uint position = offset + rankWorkGroup( selected, scratch, &total );
+      offset += total;
+
+      if( index >= n || ( !selected && !partition ) ) {
+         continue;
+      }
+      if( !selected ) {
+         // The elements before index which were not selected.
+         position = selected_count + index - position;
+      }
+      if( values ) {
+         values[position] = value;
+      }
+      if( indices ) {
+         indices[position] = index;
+      }
+   }
+}
@@ -0,0 +1,362 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compaction.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Sequentially pack the elements of a[n] for which select( i ) holds into
+// values and indices, followed by the others when partition is set, and
+// return how many were selected.
+template< typename Select >
+size_t seqCompact( const int* a,
+                   const size_t n,
+                   Select select,
+                   const bool partition,
+                   int* values,
+                   unsigned int* indices );
+// Parallelly run copyIf, partition and unique on a buffer of n elements and
+// read back the packed elements; return whether they match the expected
+// ones.
+bool parCompact( Compaction& compaction,
+                 const cl::CommandQueue& queue,
+                 const cl::Buffer& a_buf,
+                 const cl::Buffer& values_buf,
+                 const cl::Buffer& indices_buf,
+                 const size_t n,
+                 const std::vector< std::vector< int > >& expected_values,
+                 const std::vector< std::vector< unsigned int > >&
+                    expected_indices,
+                 const std::vector< size_t >& expected_counts );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+constexpr int GREATER_THRESHOLD = 750;   // copyIf keeps the greater values.
+constexpr int LESS_THRESHOLD = 250;      // partition moves the lesser ones.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 10;
+   bool equal = true;
+
+   /**
+    * Prepare the input: values from 0 to 999, in runs of about 3 equal
+    * values for unique.
+    * */
+
+   constexpr size_t n = 1 << 24;
+   std::vector< int > a( n );
+   for( size_t i = 0; i < n; i++ ) {
+      a[i] = static_cast< int >( ( ( i / 3 ) * 7919 ) % 1000 );
+   }
+
+   /**
+    * Sequentially compact the input.
+    * */
+
+   std::vector< std::vector< int > > values( 3, std::vector< int >( n ) );
+   std::vector< std::vector< unsigned int > > indices(
+      3, std::vector< unsigned int >( n ) );
+   std::vector< size_t > counts( 3 );
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      counts[0] = seqCompact(
+         a.data(),
+         n,
+         [&]( size_t j ) { return a[j] > GREATER_THRESHOLD; },
+         false,
+         values[0].data(),
+         indices[0].data() );
+      counts[1] = seqCompact(
+         a.data(),
+         n,
+         [&]( size_t j ) { return a[j] < LESS_THRESHOLD; },
+         true,
+         values[1].data(),
+         indices[1].data() );
+      counts[2] = seqCompact(
+         a.data(),
+         n,
+         [&]( size_t j ) { return j == 0 || a[j] != a[j - 1]; },
+         false,
+         values[2].data(),
+         indices[2].data() );
+   }
+   double seq_time = getElapsedTime( start ) / executions;
+
+   /**
+    * Initialize OpenCL device and upload the input.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   cl::CommandQueue queue( context, device );
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      n * sizeof( int ),
+      a.data() );
+   cl::Buffer values_buf( context,
+                          CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                          n * sizeof( int ) );
+   cl::Buffer indices_buf( context,
+                           CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                           n * sizeof( cl_uint ) );
+
+   /**
+    * Parallelly compact the input with every ranking path the device
+    * supports.
+    * */
+
+   const std::vector< std::pair< Compaction::Path, std::string > > paths = {
+      { Compaction::Path::Auto, "Auto" },
+      { Compaction::Path::Ballot, "Ballot" },
+      { Compaction::Path::SubGroup, "Sub-group" },
+      { Compaction::Path::Tree, "Local scan" },
+   };
+   double par_time = 0.0;
+   std::cout << std::fixed << std::setprecision( 3 )
+             << "Mean execution time of copyIf, partition and unique of " << n
+             << " ints, with the packed elements read back:" << std::endl;
+   for( const auto& path : paths ) {
+      if( !Compaction::isSupported( device, path.first ) ) {
+         std::cout << "\t" << std::setw( 10 ) << path.second
+                   << ": not supported." << std::endl;
+         continue;
+      }
+      Compaction compaction( context, device, path.first );
+
+      // The first run compiles the programs, so it is not measured.
+      bool path_equal = true;
+      for( int i = 0; i <= executions; i++ ) {
+         if( i == 1 ) {
+            start = std::chrono::steady_clock::now();
+         }
+         path_equal = parCompact( compaction,
+                                  queue,
+                                  a_buf,
+                                  values_buf,
+                                  indices_buf,
+                                  n,
+                                  values,
+                                  indices,
+                                  counts )
+                   && path_equal;
+      }
+      double path_time = getElapsedTime( start ) / executions;
+      if( path.first == Compaction::Path::Auto ) {
+         par_time = path_time;
+      }
+      equal = equal && path_equal;
+
+      std::cout << "\t" << std::setw( 10 ) << path.second << ": "
+                << path_time << " ms" << ( path_equal ? "" : " (FAILED)" )
+                << std::endl;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Results: \n\tcopyIf( a > " << GREATER_THRESHOLD
+             << " ): " << counts[0] << " elements\n\tpartition( a < "
+             << LESS_THRESHOLD << " ): " << counts[1]
+             << " elements first\n\tunique( a ): " << counts[2]
+             << " elements" << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << seq_time
+             << " ms;\n\tParallel: " << par_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Sequentially pack the elements of a[n] for which select( i ) holds into
+ * values and indices, followed by the others when partition is set, and
+ * return how many were selected. Both groups keep the input order, like
+ * std::stable_partition.
+ * */
+
+template< typename Select >
+size_t seqCompact( const int* a,
+                   const size_t n,
+                   Select select,
+                   const bool partition,
+                   int* values,
+                   unsigned int* indices ) {
+   size_t count = 0;
+   for( size_t i = 0; i < n; i++ ) {
+      if( select( i ) ) {
+         values[count] = a[i];
+         indices[count++] = static_cast< unsigned int >( i );
+      }
+   }
+   if( partition ) {
+      size_t position = count;
+      for( size_t i = 0; i < n; i++ ) {
+         if( !select( i ) ) {
+            values[position] = a[i];
+            indices[position++] = static_cast< unsigned int >( i );
+         }
+      }
+   }
+   return count;
+}
+
+/**
+ * Parallelly run copyIf, partition and unique on a buffer of n elements and
+ * read back the packed elements, only count of them except for partition;
+ * return whether they match the expected ones.
+ * */
+
+bool parCompact( Compaction& compaction,
+                 const cl::CommandQueue& queue,
+                 const cl::Buffer& a_buf,
+                 const cl::Buffer& values_buf,
+                 const cl::Buffer& indices_buf,
+                 const size_t n,
+                 const std::vector< std::vector< int > >& expected_values,
+                 const std::vector< std::vector< unsigned int > >&
+                    expected_indices,
+                 const std::vector< size_t >& expected_counts ) {
+   bool equal = true;
+   std::vector< int > values( n );
+   std::vector< unsigned int > indices( n );
+   for( size_t run = 0; run < 3; run++ ) {
+
+      /**
+       * Compact the input.
+       * */
+
+      size_t count;
+      size_t read;
+      if( run == 0 ) {
+         count = compaction.copyIf< int >( queue,
+                                           a_buf,
+                                           n,
+                                           Compaction::Predicate::Greater,
+                                           GREATER_THRESHOLD,
+                                           values_buf,
+                                           indices_buf );
+         read = count;
+      } else if( run == 1 ) {
+         count = compaction.partition< int >( queue,
+                                              a_buf,
+                                              n,
+                                              Compaction::Predicate::Less,
+                                              LESS_THRESHOLD,
+                                              values_buf,
+                                              indices_buf );
+         read = n;
+      } else {
+         count = compaction.unique< int >(
+            queue, a_buf, n, values_buf, indices_buf );
+         read = count;
+      }
+
+      /**
+       * Read back the packed elements and compare them.
+       * */
+
+      if( read > 0 ) {
+         queue.enqueueReadBuffer( values_buf,
+                                  CL_FALSE,
+                                  0,
+                                  read * sizeof( int ),
+                                  values.data() );
+         queue.enqueueReadBuffer( indices_buf,
+                                  CL_TRUE,
+                                  0,
+                                  read * sizeof( cl_uint ),
+                                  indices.data() );
+      }
+      equal = equal && count == expected_counts[run]
+           && std::equal( values.begin(),
+                          values.begin() + read,
+                          expected_values[run].begin() )
+           && std::equal( indices.begin(),
+                          indices.begin() + read,
+                          expected_indices[run].begin() );
+   }
+   return equal;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
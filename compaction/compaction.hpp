@@ -0,0 +1,335 @@
+#ifndef COMPACTION_HPP
+#define COMPACTION_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "../scan/scan.hpp"
+
+/**
+ * Compact device buffers with the kernels of compaction.cl: copyIf packs
+ * the elements which satisfy a predicate, partition packs them before the
+ * others and unique packs the first element of every run of equal ones.
+ * They write the packed values and their positions in the input, in input
+ * order, and return how many were selected, so only the packed elements
+ * need to be read back:
+ *    1. countSelected counts the selected elements of every tile;
+ *    2. Scan turns the counts into the first output position of every tile;
+ *    3. scatterSelected ranks the selected elements of every tile, with
+ *       sub-group ballots when the device supports them, and stores them.
+ *
+ *    Compaction compaction( context, device );
+ *    size_t count = compaction.copyIf< cl_uchar >(
+ *       queue, input, n, Compaction::Predicate::Greater, 128, values,
+ *       indices );
+ * */
+
+// =================================================================
+// ---------------------------- Traits -----------------------------
+// =================================================================
+
+// The OpenCL C name of the compacted types.
+template< typename T >
+struct CompactionType;
+
+template<>
+struct CompactionType< int > {
+   static constexpr const char* name = "int";
+};
+
+template<>
+struct CompactionType< unsigned int > {
+   static constexpr const char* name = "uint";
+};
+
+template<>
+struct CompactionType< float > {
+   static constexpr const char* name = "float";
+};
+
+template<>
+struct CompactionType< unsigned char > {
+   static constexpr const char* name = "uchar";
+};
+
+// =================================================================
+// -------------------------- Compaction ---------------------------
+// =================================================================
+
+class Compaction {
+ public:
+   // The comparisons of an element with the threshold which select it; they
+   // must match the SELECT_* values of compaction.cl.
+   enum class Predicate {
+      Greater,
+      GreaterEqual,
+      Less,
+      LessEqual,
+      Equal,
+      NotEqual
+   };
+
+   // How the selected elements of a work-group are ranked: Auto lets the
+   // kernel pick the fastest path the device compiler supports; the others
+   // force one path.
+   enum class Path { Auto, Ballot, SubGroup, Tree };
+
+   // Elements per work-item; it must match compaction.cl.
+   static constexpr size_t ITEMS_PER_WORK_ITEM = 4;
+
+   Compaction( const cl::Context& context,
+               const cl::Device& device,
+               const Path path = Path::Auto,
+               const std::string& file_name = "../compaction/compaction.cl" )
+      : context_( context ), device_( device ), scan_( context, device ) {
+
+      /**
+       * Read the kernel file and select the language version, which makes
+       * the sub-group features visible to the compiler.
+       * */
+
+      std::ifstream kernel_file( file_name );
+      if( !kernel_file.is_open() ) {
+         std::cerr << "Fail to open " << file_name << "." << std::endl;
+         exit( 1 );
+      }
+      source_ = std::string( std::istreambuf_iterator< char >( kernel_file ),
+                             ( std::istreambuf_iterator< char >() ) );
+
+      std::string version = device.getInfo< CL_DEVICE_VERSION >();
+      if( version.compare( 0, 8, "OpenCL 3" ) == 0 ) {
+         base_options_ = "-cl-std=CL3.0";
+      } else if( version.compare( 0, 8, "OpenCL 2" ) == 0 ) {
+         base_options_ = "-cl-std=CL2.0";
+      }
+      if( path == Path::Ballot ) {
+         base_options_ += " -DCOMPACT_BALLOT";
+      } else if( path == Path::SubGroup ) {
+         base_options_ += " -DCOMPACT_SUB_GROUP";
+      } else if( path == Path::Tree ) {
+         base_options_ += " -DCOMPACT_TREE";
+      }
+
+      /**
+       * Select the largest power-of-two work-group size up to 256 and
+       * allocate the selected count.
+       * */
+
+      size_t limit = std::min< size_t >(
+         256, device.getInfo< CL_DEVICE_MAX_WORK_GROUP_SIZE >() );
+      local_size_ = 1;
+      while( 2 * local_size_ <= limit ) {
+         local_size_ *= 2;
+      }
+      tile_size_ = local_size_ * ITEMS_PER_WORK_ITEM;
+      count_ = cl::Buffer( context, CL_MEM_READ_WRITE, sizeof( cl_uint ) );
+   }
+
+   // Check whether device can compile a path forced by the constructor.
+   static bool isSupported( const cl::Device& device, const Path path ) {
+      std::string version = device.getInfo< CL_DEVICE_VERSION >();
+      bool is_3x = version.compare( 0, 8, "OpenCL 3" ) == 0;
+      std::string extensions = device.getInfo< CL_DEVICE_EXTENSIONS >();
+      switch( path ) {
+         case Path::Ballot:
+            return extensions.find( "cl_khr_subgroup_ballot" )
+                != std::string::npos;
+         case Path::SubGroup:
+            return extensions.find( "cl_khr_subgroups" ) != std::string::npos
+                || ( is_3x
+                     && device.getInfo< CL_DEVICE_MAX_NUM_SUB_GROUPS >() > 0 );
+         default:
+            return true;
+      }
+   }
+
+   // Pack the elements of input[n] which satisfy predicate with threshold
+   // into values and their positions into indices, and return how many
+   // there are; an empty values or indices buffer is not written.
+   template< typename T >
+   size_t copyIf( const cl::CommandQueue& queue,
+                  const cl::Buffer& input,
+                  const size_t n,
+                  const Predicate predicate,
+                  const T threshold,
+                  const cl::Buffer& values,
+                  const cl::Buffer& indices ) {
+      return run< T >( queue,
+                       input,
+                       n,
+                       static_cast< cl_uint >( predicate ),
+                       threshold,
+                       values,
+                       indices,
+                       false );
+   }
+
+   // Like copyIf, but the other elements follow the selected ones, so
+   // values and indices hold n elements; return how many were selected.
+   template< typename T >
+   size_t partition( const cl::CommandQueue& queue,
+                     const cl::Buffer& input,
+                     const size_t n,
+                     const Predicate predicate,
+                     const T threshold,
+                     const cl::Buffer& values,
+                     const cl::Buffer& indices ) {
+      return run< T >( queue,
+                       input,
+                       n,
+                       static_cast< cl_uint >( predicate ),
+                       threshold,
+                       values,
+                       indices,
+                       true );
+   }
+
+   // Pack the first element of every run of equal elements of input[n]
+   // into values and its position into indices, and return how many
+   // there are.
+   template< typename T >
+   size_t unique( const cl::CommandQueue& queue,
+                  const cl::Buffer& input,
+                  const size_t n,
+                  const cl::Buffer& values,
+                  const cl::Buffer& indices ) {
+      return run< T >(
+         queue, input, n, SELECT_UNIQUE, T( 0 ), values, indices, false );
+   }
+
+ private:
+   // The selection of unique in compaction.cl, after the predicates.
+   static constexpr cl_uint SELECT_UNIQUE = 6;
+
+   // Count, scan and scatter the elements of input[n] selected by
+   // selection, and return how many were selected.
+   template< typename T >
+   size_t run( const cl::CommandQueue& queue,
+               const cl::Buffer& input,
+               const size_t n,
+               const cl_uint selection,
+               const T threshold,
+               const cl::Buffer& values,
+               const cl::Buffer& indices,
+               const bool partition ) {
+      if( n == 0 ) {
+         return 0;
+      }
+
+      /**
+       * Get the program and grow the tile counts when needed.
+       * */
+
+      std::string options = base_options_ + " -DVALUE_TYPE="
+                          + CompactionType< T >::name
+                          + " -DWG_SIZE=" + std::to_string( local_size_ );
+      cl::Program& program = getProgram( options );
+      size_t tiles = ( n + tile_size_ - 1 ) / tile_size_;
+      if( tiles > tiles_capacity_ ) {
+         counts_ = cl::Buffer( context_,
+                               CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                               tiles * sizeof( cl_uint ) );
+         offsets_ = cl::Buffer( context_,
+                                CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                tiles * sizeof( cl_uint ) );
+         tiles_capacity_ = tiles;
+      }
+
+      /**
+       * Count the selected elements of every tile and scan the counts.
+       * */
+
+      cl::Kernel count_kernel( program, "countSelected" );
+      count_kernel.setArg( 0, input );
+      count_kernel.setArg( 1, counts_ );
+      count_kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      count_kernel.setArg( 3, selection );
+      count_kernel.setArg( 4, threshold );
+      queue.enqueueNDRangeKernel( count_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( tiles * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+
+      scan_.exclusiveScan< cl_uint >( queue, counts_, offsets_, tiles );
+
+      /**
+       * Store the selected elements and read back their number.
+       * */
+
+      cl::Kernel scatter_kernel( program, "scatterSelected" );
+      scatter_kernel.setArg( 0, input );
+      scatter_kernel.setArg( 1, counts_ );
+      scatter_kernel.setArg( 2, offsets_ );
+      setBufferArg( scatter_kernel, 3, values );
+      setBufferArg( scatter_kernel, 4, indices );
+      scatter_kernel.setArg( 5, count_ );
+      scatter_kernel.setArg( 6, static_cast< cl_uint >( n ) );
+      scatter_kernel.setArg( 7, selection );
+      scatter_kernel.setArg( 8, threshold );
+      scatter_kernel.setArg( 9, static_cast< cl_uint >( partition ) );
+      queue.enqueueNDRangeKernel( scatter_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( tiles * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+
+      cl_uint count;
+      queue.enqueueReadBuffer( count_, CL_TRUE, 0, sizeof( cl_uint ), &count );
+      return count;
+   }
+
+   // Set the argument index of kernel to buffer, or to NULL when buffer is
+   // empty.
+   static void setBufferArg( cl::Kernel& kernel,
+                             const cl_uint index,
+                             const cl::Buffer& buffer ) {
+      if( buffer() ) {
+         kernel.setArg( index, buffer );
+      } else {
+         kernel.setArg( index, sizeof( cl_mem ), nullptr );
+      }
+   }
+
+   // Return the program built with options, compiling it on first use.
+   cl::Program& getProgram( const std::string& options ) {
+      auto found = programs_.find( options );
+      if( found != programs_.end() ) {
+         return found->second;
+      }
+
+      cl::Program::Sources sources{ source_ };
+      cl::Program program( context_, sources );
+      auto err = program.build( device_, options.c_str() );
+      if( err != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Status: "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device_ )
+                   << "\nBuild Options: " << options << "\nBuild Log:\t "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device_ )
+                   << std::endl;
+         exit( 1 );
+      }
+      return programs_.emplace( options, program ).first->second;
+   }
+
+   cl::Context context_;
+   cl::Device device_;
+   Scan scan_;
+   std::string source_;
+   std::string base_options_;
+   std::map< std::string, cl::Program > programs_;
+   size_t local_size_;
+   size_t tile_size_;
+   cl::Buffer counts_;
+   cl::Buffer offsets_;
+   size_t tiles_capacity_ = 0;
+   cl::Buffer count_;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * Include the tiled matrix multiplication kernels, which perform the
+ * lowered convolution. The host code must add the folder
+ * cached_matrix_multiplication to the include path.
+ */
+
+#include "cached_matrix_multiplication.cl"
+
+/**
+ * This kernel function lowers the convolution of input[channels,height,width]
+ * with masks of size mask_size to a matrix multiplication (im2col). Row
+ * (c * mask_size + i) * mask_size + j of cols[rows,cols_width] holds, for
+ * every output pixel (y, x), the input pixel input[c, y + i, x + j]. Rows
+ * and columns added to reach the padded dimensions are filled with zeros.
+ */
+
+__kernel void im2col( const __global int* input,
+                      __global int* cols,
+                      const unsigned int channels,
+                      const unsigned int height,
+                      const unsigned int width,
+                      const unsigned int mask_size ) {
+
+   /**
+    * Get work-item identifiers.
+    */
+
+   int col = (int)get_global_id( 0 );
+   int row = (int)get_global_id( 1 );
+   int cols_width = (int)get_global_size( 0 );
+   int out_width = (int)width - (int)mask_size + 1;
+   int out_height = (int)height - (int)mask_size + 1;
+   int mask_area = (int)( mask_size * mask_size );
+
+   /**
+    * Fill the padding with zeros.
+    */
+
+   if( row >= (int)channels * mask_area || col >= out_width * out_height ) {
+      cols[row * cols_width + col] = 0;
+      return;
+   }
+
+   /**
+    * Copy the input pixel covered by this mask element.
+    */
+
+   int c = row / mask_area;
+   int i = ( row % mask_area ) / (int)mask_size;
+   int j = row % (int)mask_size;
+   int y = col / out_width + i;
+   int x = col % out_width + j;
+   cols[row * cols_width + col]
+      = input[( c * (int)height + y ) * (int)width + x];
+}
+
+/**
+ * This kernel function directly convolves input[channels,height,width] with
+ * the masks filters[num_filters,channels,mask_size,mask_size], storing the
+ * valid region of every output channel in
+ * output[num_filters,height - mask_size + 1,width - mask_size + 1]. Each
+ * work-item computes one output pixel of one filter.
+ */
+
+__kernel void convolveDirect( const __global int* input,
+                              const __global int* filters,
+                              __global int* output,
+                              const unsigned int channels,
+                              const unsigned int height,
+                              const unsigned int width,
+                              const unsigned int mask_size ) {
+
+   /**
+    * Get work-item identifiers.
+    */
+
+   int x = (int)get_global_id( 0 );
+   int y = (int)get_global_id( 1 );
+   int filter = (int)get_global_id( 2 );
+   int out_width = (int)get_global_size( 0 );
+   int out_height = (int)get_global_size( 1 );
+
+   /**
+    * Apply every channel of the mask to the neighborhood of the pixel.
+    */
+
+   const __global int* mask
+      = filters + filter * (int)( channels * mask_size * mask_size );
+   int sum = 0;
+   for( int c = 0; c < (int)channels; c++ ) {
+      for( int i = 0; i < (int)mask_size; i++ ) {
+         const __global int* input_row
+            = input + ( c * (int)height + y + i ) * (int)width + x;
+         for( int j = 0; j < (int)mask_size; j++ ) {
+            sum += input_row[j] * mask[j];
+         }
+         mask += mask_size;
+      }
+   }
+
+   /**
+    * Write output pixel.
+    */
+
+   output[( filter * out_height + y ) * out_width + x] = sum;
+}
@@ -0,0 +1,513 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code.
+void initializeDevice();
+// Round value up to a multiple of WG_SIZE.
+size_t roundUp( const size_t value );
+// Sequentially convolves input[channels,height,width] with every filter.
+void seqConvolve( const int* input,
+                  const int* filters,
+                  int* output,
+                  const size_t channels,
+                  const size_t height,
+                  const size_t width,
+                  const size_t num_filters );
+// Parallelly convolves the input through im2col and the tiled GEMM.
+double parConvolveIm2col( int* input,
+                          int* filters,
+                          int* output,
+                          const size_t channels,
+                          const size_t height,
+                          const size_t width,
+                          const size_t num_filters,
+                          const int executions );
+// Parallelly convolves the input directly, one work-item per output pixel.
+double parConvolveDirect( int* input,
+                          int* filters,
+                          int* output,
+                          const size_t channels,
+                          const size_t height,
+                          const size_t width,
+                          const size_t num_filters,
+                          const int executions );
+// Return the execution time of a profiled command in milliseconds.
+double getEventTime( const cl::Event& event );
+// Check if the tensors out1 and out2 are equal.
+bool checkEquality( const int* out1, const int* out2, const size_t size );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+const size_t WG_SIZE[2] = { 16, 16 };   // The size of work-groups.
+constexpr size_t MASK_SIZE = 3;         // The size of the masks.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 10;
+
+   /**
+    * Prepare input constants related to the dimensions of the tensors.
+    * */
+
+   constexpr size_t height = 66;
+   constexpr size_t width = 66;
+   constexpr size_t num_filters = 128;
+   constexpr size_t out_size
+      = num_filters * ( height - MASK_SIZE + 1 ) * ( width - MASK_SIZE + 1 );
+   const std::vector< size_t > channel_counts = { 1, 3, 8, 16, 32, 64 };
+
+   /**
+    * Initialize OpenCL device.
+    * */
+
+   initializeDevice();
+
+   /**
+    * Convolve inputs with an increasing number of channels.
+    * */
+
+   bool equal = true;
+   std::cout << "Convolution of " << height << " x " << width
+             << " inputs with " << num_filters << " filters of " << MASK_SIZE
+             << " x " << MASK_SIZE << ":" << std::fixed
+             << std::setprecision( 3 ) << std::endl;
+   for( size_t channels : channel_counts ) {
+
+      /**
+       * Prepare the input tensor and the filters.
+       * */
+
+      std::vector< int > input( channels * height * width );
+      for( size_t i = 0; i < input.size(); i++ ) {
+         input[i] = static_cast< int >( i % 255 );
+      }
+      std::vector< int > filters( num_filters * channels * MASK_SIZE
+                                  * MASK_SIZE );
+      for( size_t i = 0; i < filters.size(); i++ ) {
+         filters[i] = static_cast< int >( i % 7 ) - 3;
+      }
+
+      /**
+       * Convolve sequentially, directly and through the GEMM.
+       * */
+
+      std::vector< int > outs( out_size );
+      std::vector< int > outd( out_size );
+      std::vector< int > outg( out_size );
+      seqConvolve( input.data(),
+                   filters.data(),
+                   outs.data(),
+                   channels,
+                   height,
+                   width,
+                   num_filters );
+      double direct_time = parConvolveDirect( input.data(),
+                                              filters.data(),
+                                              outd.data(),
+                                              channels,
+                                              height,
+                                              width,
+                                              num_filters,
+                                              executions );
+      double gemm_time = parConvolveIm2col( input.data(),
+                                            filters.data(),
+                                            outg.data(),
+                                            channels,
+                                            height,
+                                            width,
+                                            num_filters,
+                                            executions );
+
+      /**
+       * Check if outputs are equal and print results.
+       * */
+
+      bool direct_equal = checkEquality( outs.data(), outd.data(), out_size );
+      bool gemm_equal = checkEquality( outs.data(), outg.data(), out_size );
+      equal = equal && direct_equal && gemm_equal;
+      std::cout << "\tChannels: " << std::setw( 3 ) << channels
+                << "; Direct: " << direct_time << " ms"
+                << ( direct_equal ? "" : " (FAILED)" )
+                << "; im2col + GEMM: " << gemm_time << " ms"
+                << ( gemm_equal ? "" : " (FAILED)" )
+                << "; Speedup: " << direct_time / gemm_time << "x"
+                << std::endl;
+   }
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code. The tiled matrix multiplication
+ * kernels are included from the cached_matrix_multiplication example.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device.
+    * */
+
+   device = getDefaultDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "convolution.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build( "-I../cached_matrix_multiplication" );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Round value up to a multiple of WG_SIZE, the size of the GEMM tiles.
+ * */
+
+size_t roundUp( const size_t value ) {
+   return ( value + WG_SIZE[0] - 1 ) / WG_SIZE[0] * WG_SIZE[0];
+}
+
+/**
+ * Sequentially convolves input[channels,height,width] with the masks
+ * filters[num_filters,channels,MASK_SIZE,MASK_SIZE], storing the valid region
+ * of every output channel in output[num_filters,out_height,out_width].
+ * */
+
+void seqConvolve( const int* input,
+                  const int* filters,
+                  int* output,
+                  const size_t channels,
+                  const size_t height,
+                  const size_t width,
+                  const size_t num_filters ) {
+   const size_t out_height = height - MASK_SIZE + 1;
+   const size_t out_width = width - MASK_SIZE + 1;
+   for( size_t f = 0; f < num_filters; f++ ) {
+      for( size_t y = 0; y < out_height; y++ ) {
+         for( size_t x = 0; x < out_width; x++ ) {
+            const int* mask = filters + f * channels * MASK_SIZE * MASK_SIZE;
+            int sum = 0;
+            for( size_t c = 0; c < channels; c++ ) {
+               for( size_t i = 0; i < MASK_SIZE; i++ ) {
+                  for( size_t j = 0; j < MASK_SIZE; j++ ) {
+                     sum += input[( c * height + y + i ) * width + x + j]
+                          * mask[( c * MASK_SIZE + i ) * MASK_SIZE + j];
+                  }
+               }
+            }
+            output[( f * out_height + y ) * out_width + x] = sum;
+         }
+      }
+   }
+}
+
+/**
+ * Parallelly convolves input[channels,height,width] with the filters by
+ * lowering the convolution to c[num_filters,pixels] =
+ * filters[num_filters,channels * MASK_SIZE^2] * cols[channels * MASK_SIZE^2,
+ * pixels], where cols is built by the im2col kernel. Every dimension is
+ * padded with zeros to a multiple of the GEMM tiles. Return the mean
+ * execution time of both kernels in milliseconds.
+ * */
+
+double parConvolveIm2col( int* input,
+                          int* filters,
+                          int* output,
+                          const size_t channels,
+                          const size_t height,
+                          const size_t width,
+                          const size_t num_filters,
+                          const int executions ) {
+
+   /**
+    * Compute the dimensions of the padded matrices.
+    * */
+
+   const size_t pixels = ( height - MASK_SIZE + 1 ) * ( width - MASK_SIZE + 1 );
+   const size_t depth = channels * MASK_SIZE * MASK_SIZE;
+   const size_t m = roundUp( num_filters );
+   const size_t n = roundUp( pixels );
+   const size_t k = roundUp( depth );
+
+   /**
+    * Pad the filters with zeros.
+    * */
+
+   std::vector< int > a( m * k, 0 );
+   for( size_t f = 0; f < num_filters; f++ ) {
+      std::copy( filters + f * depth, filters + ( f + 1 ) * depth, &a[f * k] );
+   }
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer input_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      channels * height * width * sizeof( int ),
+      input );
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      m * k * sizeof( int ),
+      a.data() );
+   cl::Buffer cols_buf( context,
+                        CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                        k * n * sizeof( int ) );
+   cl::Buffer c_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     m * n * sizeof( int ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel im2col_kernel( program, "im2col" );
+   im2col_kernel.setArg( 0, input_buf );
+   im2col_kernel.setArg( 1, cols_buf );
+   im2col_kernel.setArg( 2, static_cast< cl_uint >( channels ) );
+   im2col_kernel.setArg( 3, static_cast< cl_uint >( height ) );
+   im2col_kernel.setArg( 4, static_cast< cl_uint >( width ) );
+   im2col_kernel.setArg( 5, static_cast< cl_uint >( MASK_SIZE ) );
+
+   cl::Kernel gemm_kernel( program, "multiplyMatricesWithCache" );
+   gemm_kernel.setArg( 0, a_buf );
+   gemm_kernel.setArg( 1, cols_buf );
+   gemm_kernel.setArg( 2, c_buf );
+   gemm_kernel.setArg( 3, static_cast< cl_uint >( m ) );
+   gemm_kernel.setArg( 4, static_cast< cl_uint >( n ) );
+   gemm_kernel.setArg( 5, static_cast< cl_uint >( k ) );
+
+   /**
+    * Execute the kernel functions, measuring them with profiling events.
+    * */
+
+   cl::CommandQueue queue( context, device, CL_QUEUE_PROFILING_ENABLE );
+   cl::NDRange local( WG_SIZE[0], WG_SIZE[1] );
+   double time = 0.0;
+   for( int i = 0; i < executions; i++ ) {
+      cl::Event im2col_event, gemm_event;
+      queue.enqueueNDRangeKernel( im2col_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( n, k ),
+                                  local,
+                                  nullptr,
+                                  &im2col_event );
+      queue.enqueueNDRangeKernel( gemm_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( n, m ),
+                                  local,
+                                  nullptr,
+                                  &gemm_event );
+      gemm_event.wait();
+      time += getEventTime( im2col_event ) + getEventTime( gemm_event );
+   }
+
+   /**
+    * Collect the result, dropping the padded rows and columns.
+    * */
+
+   std::vector< int > c( m * n );
+   queue.enqueueReadBuffer( c_buf,
+                            CL_TRUE,
+                            0,
+                            m * n * sizeof( int ),
+                            c.data() );
+   for( size_t f = 0; f < num_filters; f++ ) {
+      std::copy( &c[f * n], &c[f * n] + pixels, output + f * pixels );
+   }
+   return time / executions;
+}
+
+/**
+ * Parallelly convolves input[channels,height,width] with the filters, one
+ * work-item per output pixel of every filter. Return the mean execution time
+ * of the kernel in milliseconds.
+ * */
+
+double parConvolveDirect( int* input,
+                          int* filters,
+                          int* output,
+                          const size_t channels,
+                          const size_t height,
+                          const size_t width,
+                          const size_t num_filters,
+                          const int executions ) {
+   const size_t out_height = height - MASK_SIZE + 1;
+   const size_t out_width = width - MASK_SIZE + 1;
+   const size_t out_size = num_filters * out_height * out_width;
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer input_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      channels * height * width * sizeof( int ),
+      input );
+   cl::Buffer filters_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      num_filters * channels * MASK_SIZE * MASK_SIZE * sizeof( int ),
+      filters );
+   cl::Buffer output_buf( context,
+                          CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                          out_size * sizeof( int ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, "convolveDirect" );
+   kernel.setArg( 0, input_buf );
+   kernel.setArg( 1, filters_buf );
+   kernel.setArg( 2, output_buf );
+   kernel.setArg( 3, static_cast< cl_uint >( channels ) );
+   kernel.setArg( 4, static_cast< cl_uint >( height ) );
+   kernel.setArg( 5, static_cast< cl_uint >( width ) );
+   kernel.setArg( 6, static_cast< cl_uint >( MASK_SIZE ) );
+
+   /**
+    * Execute the kernel function, measuring it with profiling events.
+    * */
+
+   cl::CommandQueue queue( context, device, CL_QUEUE_PROFILING_ENABLE );
+   cl::NDRange global( out_width, out_height, num_filters );
+   double time = 0.0;
+   for( int i = 0; i < executions; i++ ) {
+      cl::Event event;
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  global,
+                                  cl::NullRange,
+                                  nullptr,
+                                  &event );
+      event.wait();
+      time += getEventTime( event );
+   }
+
+   /**
+    * Collect the result.
+    * */
+
+   queue.enqueueReadBuffer( output_buf,
+                            CL_TRUE,
+                            0,
+                            out_size * sizeof( int ),
+                            output );
+   return time / executions;
+}
+
+/**
+ * Return the execution time of a profiled command in milliseconds.
+ * */
+
+double getEventTime( const cl::Event& event ) {
+   return 1e-6
+        * static_cast< double >(
+             event.getProfilingInfo< CL_PROFILING_COMMAND_END >()
+             - event.getProfilingInfo< CL_PROFILING_COMMAND_START >() );
+}
+
+/**
+ * Check if the tensors OUT1 and OUT2 are equal.
+ * */
+
+bool checkEquality( const int* out1, const int* out2, const size_t size ) {
+   for( size_t i = 0; i < size; i++ ) {
+      if( out1[i] != out2[i] ) {
+         return false;
+      }
+   }
+   return true;
+}
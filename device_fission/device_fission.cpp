@@ -0,0 +1,492 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "device_fission.hpp"
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Device device;   // The device which is partitioned.
+
+// The pipelines of the engines: the image filter of image_filtering and
+// the matrix product of matrix_multiplication.
+enum class Kind { Filter, Multiply };
+
+// Frames of the filter engines and matrices of the product engines; both
+// jobs take a few million operations.
+constexpr unsigned int IMG_WIDTH = 256;
+constexpr unsigned int IMG_HEIGHT = 128;
+constexpr unsigned int MASK_SIZE = 5;
+constexpr int MATRIX_SIZE = 128;
+// Jobs run by every engine, and by every kind of engine alone to weigh it.
+constexpr int JOBS = 200;
+constexpr int CALIBRATION_JOBS = 20;
+// Workers of the thread pool of every engine, so that the transfers of a
+// job overlap the kernels of another.
+constexpr size_t ENGINE_WORKERS = 2;
+// Default number of engines running at once.
+constexpr size_t ENGINES = 4;
+
+// =================================================================
+// ----------------------------- Engine ----------------------------
+// =================================================================
+
+/**
+ * A pipeline pinned to a device, which may be a sub-device: it has its own
+ * context, program and thread pool on it, so its kernels only run on the
+ * compute units of the device.
+ * */
+
+class Engine {
+ public:
+   Engine( const cl::Device& engine_device, const Kind kind );
+
+   // Run jobs jobs and return the output of the last one.
+   std::vector< unsigned char > run( const int jobs );
+
+ private:
+   // Filter frame job and return the output image.
+   std::vector< unsigned char > filter( Worker& worker, const int job );
+   // Multiply the matrices of job and return their product.
+   std::vector< unsigned char > multiply( Worker& worker, const int job );
+
+   Kind kind_;
+   cl::Context context_;
+   cl::Program program_;
+   cl::Buffer lp_mask_buf_;
+   cl::Buffer hp_mask_buf_;
+   std::unique_ptr< ThreadPool > pool_;
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first CPU device found, or the first device when there is none.
+cl::Device getCpuDevice();
+// Run an engine of every kind on devices[i] at once, and return the
+// outputs of their last jobs; time is the time until all of them finished,
+// in ms.
+std::vector< std::vector< unsigned char > > runEngines(
+   const std::vector< cl::Device >& devices,
+   const std::vector< Kind >& kinds,
+   double& time );
+// Return the compute units of devices, such as "4+4".
+std::string describe( const std::vector< cl::Device >& devices );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main( int argc, char** argv ) {
+
+   /**
+    * Parse the number of engines, which alternate between filters and
+    * matrix products.
+    * */
+
+   size_t engines = ENGINES;
+   bool valid = true;
+   for( int i = 1; i < argc && valid; i++ ) {
+      long count = 0;
+      if( strcmp( argv[i], "--engines" ) == 0 && i + 1 < argc ) {
+         try {
+            count = std::stol( argv[++i] );
+         } catch( const std::logic_error& ) {
+         }
+      }
+      valid = count > 0;
+      engines = static_cast< size_t >( count );
+   }
+   if( !valid ) {
+      std::cerr << "Usage: " << argv[0] << " [--engines n], n > 0"
+                << std::endl;
+      return 1;
+   }
+
+   device = getCpuDevice();
+   std::vector< Kind > kinds;
+   for( size_t i = 0; i < engines; i++ ) {
+      kinds.push_back( i % 2 == 0 ? Kind::Filter : Kind::Multiply );
+   }
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << ", "
+             << device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >()
+             << " compute units\n"
+             << engines << " engines of " << JOBS << " jobs" << std::endl;
+
+   /**
+    * Weigh every kind of engine by the time of its jobs on the whole
+    * device, to size the sub-devices of the partition by counts.
+    * */
+
+   std::vector< double > job_times;
+   for( Kind kind : { Kind::Filter, Kind::Multiply } ) {
+      Engine engine( device, kind );
+      engine.run( 1 );
+      auto start = std::chrono::steady_clock::now();
+      engine.run( CALIBRATION_JOBS );
+      job_times.push_back( getElapsedTime( start ) / CALIBRATION_JOBS );
+   }
+   std::vector< double > weights;
+   for( Kind kind : kinds ) {
+      weights.push_back( job_times[static_cast< int >( kind )] );
+   }
+
+   /**
+    * Run the engines sharing the whole device, then pinned to the
+    * sub-devices of every partition mode the device supports.
+    * */
+
+   double shared_time;
+   std::vector< std::vector< unsigned char > > expected = runEngines(
+      std::vector< cl::Device >( engines, device ), kinds, shared_time );
+
+   std::cout << std::fixed << std::setprecision( 2 ) << std::setw( 20 )
+             << "Execution" << std::setw( 16 ) << "Compute units"
+             << std::setw( 12 ) << "Time (ms)" << std::setw( 12 ) << "Jobs/s"
+             << "\n"
+             << std::setw( 20 ) << "shared" << std::setw( 16 )
+             << describe( std::vector< cl::Device >( engines, device ) )
+             << std::setw( 12 ) << shared_time << std::setw( 12 )
+             << engines * JOBS / shared_time * 1e3 << std::endl;
+
+   bool equal = true;
+   double best_time = shared_time;
+   for( DeviceFission::Mode mode : { DeviceFission::Mode::Equally,
+                                     DeviceFission::Mode::ByCounts,
+                                     DeviceFission::Mode::ByAffinityDomain } ) {
+      std::string name = DeviceFission::getName( mode );
+      std::vector< cl::Device > sub_devices
+         = DeviceFission::partition( device, mode, engines, weights );
+      if( sub_devices.empty() ) {
+         std::cout << std::setw( 20 ) << name << std::setw( 16 )
+                   << "not supported" << std::endl;
+         continue;
+      }
+
+      double time;
+      bool mode_equal = runEngines( sub_devices, kinds, time ) == expected;
+      equal = equal && mode_equal;
+      best_time = std::min( best_time, time );
+      std::cout << std::setw( 20 ) << name << std::setw( 16 )
+                << describe( sub_devices ) << std::setw( 12 ) << time
+                << std::setw( 12 ) << engines * JOBS / time * 1e3 << std::endl;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tShared: " << shared_time
+             << " ms;\n\tPartitioned: " << best_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( shared_time - best_time ) / best_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ----------------------------- Engine ----------------------------
+// =================================================================
+
+/**
+ * Create the context, program and thread pool of an engine of kind on
+ * engine_device.
+ * */
+
+Engine::Engine( const cl::Device& engine_device, const Kind kind )
+   : kind_( kind ) {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::string file_name
+      = kind == Kind::Filter
+           ? "../image_filtering/image_filtering.cl"
+           : "../matrix_multiplication/matrix_multiplication.cl";
+   std::ifstream kernel_file( file_name );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context_ = cl::Context( engine_device );
+   program_ = cl::Program( context_, sources );
+
+   auto err = program_.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program_.getBuildInfo< CL_PROGRAM_BUILD_STATUS >(
+                      engine_device )
+                << "\nBuild Log:\t "
+                << program_.getBuildInfo< CL_PROGRAM_BUILD_LOG >(
+                      engine_device )
+                << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Create the masks of the filter, shared by the workers, and the
+    * workers.
+    * */
+
+   std::vector< float > lp_mask( MASK_SIZE * MASK_SIZE, .04f );
+   std::vector< float > hp_mask( MASK_SIZE * MASK_SIZE, -1.0f );
+   hp_mask[MASK_SIZE * MASK_SIZE / 2] = MASK_SIZE * MASK_SIZE - 1.0f;
+   lp_mask_buf_ = cl::Buffer(
+      context_,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      lp_mask.size() * sizeof( float ),
+      lp_mask.data() );
+   hp_mask_buf_ = cl::Buffer(
+      context_,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      hp_mask.size() * sizeof( float ),
+      hp_mask.data() );
+
+   pool_.reset( new ThreadPool( context_, engine_device, ENGINE_WORKERS ) );
+}
+
+/**
+ * Run jobs jobs on the thread pool of the engine and return the output of
+ * the last one.
+ * */
+
+std::vector< unsigned char > Engine::run( const int jobs ) {
+   std::vector< std::future< std::vector< unsigned char > > > results;
+   for( int job = 0; job < jobs; job++ ) {
+      results.push_back( pool_->submit( [this, job]( Worker& worker ) {
+         return kind_ == Kind::Filter ? filter( worker, job )
+                                      : multiply( worker, job );
+      } ) );
+   }
+
+   std::vector< unsigned char > output;
+   for( auto& result : results ) {
+      output = result.get();
+   }
+   return output;
+}
+
+/**
+ * Filter frame job with the rgb2gray, low-pass and high-pass pipeline of
+ * image_filtering and return the output image.
+ * */
+
+std::vector< unsigned char > Engine::filter( Worker& worker, const int job ) {
+   constexpr size_t pixels = IMG_WIDTH * IMG_HEIGHT;
+   const cl::NDRange global( IMG_WIDTH, IMG_HEIGHT );
+
+   /**
+    * Create the channels of the frame and upload them.
+    * */
+
+   std::vector< unsigned char > channels( 3 * pixels );
+   for( size_t i = 0; i < channels.size(); i++ ) {
+      channels[i] = static_cast< unsigned char >( i * 7 + job );
+   }
+   std::vector< unsigned char > output( pixels );
+
+   cl::Buffer buffers[6];
+   for( int b = 0; b < 6; b++ ) {
+      buffers[b] = worker.pool.acquire( pixels );
+   }
+   for( int c = 0; c < 3; c++ ) {
+      worker.queue.enqueueWriteBuffer(
+         buffers[c], CL_FALSE, 0, pixels, &channels[c * pixels] );
+   }
+
+   /**
+    * Run the pipeline and read the output.
+    * */
+
+   cl::Kernel gray_kernel( program_, "rgb2gray" );
+   gray_kernel.setArg( 0, buffers[0] );
+   gray_kernel.setArg( 1, buffers[1] );
+   gray_kernel.setArg( 2, buffers[2] );
+   gray_kernel.setArg( 3, buffers[3] );
+   cl::Kernel lp_kernel( program_, "filterImage" );
+   lp_kernel.setArg( 0, MASK_SIZE );
+   lp_kernel.setArg( 1, buffers[3] );
+   lp_kernel.setArg( 2, lp_mask_buf_ );
+   lp_kernel.setArg( 3, buffers[4] );
+   cl::Kernel hp_kernel( program_, "filterImage" );
+   hp_kernel.setArg( 0, MASK_SIZE );
+   hp_kernel.setArg( 1, buffers[4] );
+   hp_kernel.setArg( 2, hp_mask_buf_ );
+   hp_kernel.setArg( 3, buffers[5] );
+   worker.queue.enqueueNDRangeKernel( gray_kernel, cl::NullRange, global );
+   worker.queue.enqueueNDRangeKernel( lp_kernel, cl::NullRange, global );
+   worker.queue.enqueueNDRangeKernel( hp_kernel, cl::NullRange, global );
+   worker.queue.enqueueReadBuffer(
+      buffers[5], CL_TRUE, 0, pixels, output.data() );
+
+   for( cl::Buffer& buffer : buffers ) {
+      worker.pool.release( buffer );
+   }
+   return output;
+}
+
+/**
+ * Multiply the matrices of job with multiplyMatrices and return their
+ * product, as bytes.
+ * */
+
+std::vector< unsigned char > Engine::multiply( Worker& worker,
+                                               const int job ) {
+   constexpr size_t bytes = MATRIX_SIZE * MATRIX_SIZE * sizeof( int );
+   std::vector< int > a( MATRIX_SIZE * MATRIX_SIZE );
+   std::vector< int > b( MATRIX_SIZE * MATRIX_SIZE );
+   for( int i = 0; i < MATRIX_SIZE * MATRIX_SIZE; i++ ) {
+      a[i] = ( i + job ) % 7;
+      b[i] = ( i * 3 + job ) % 5;
+   }
+   std::vector< unsigned char > c( bytes );
+
+   cl::Buffer a_buf = worker.pool.acquire( bytes, CL_MEM_READ_ONLY );
+   cl::Buffer b_buf = worker.pool.acquire( bytes, CL_MEM_READ_ONLY );
+   cl::Buffer c_buf = worker.pool.acquire( bytes, CL_MEM_WRITE_ONLY );
+   worker.queue.enqueueWriteBuffer( a_buf, CL_FALSE, 0, bytes, a.data() );
+   worker.queue.enqueueWriteBuffer( b_buf, CL_FALSE, 0, bytes, b.data() );
+
+   cl::Kernel kernel( program_, "multiplyMatrices" );
+   kernel.setArg( 0, a_buf );
+   kernel.setArg( 1, b_buf );
+   kernel.setArg( 2, c_buf );
+   kernel.setArg( 3, MATRIX_SIZE );
+   kernel.setArg( 4, MATRIX_SIZE );
+   kernel.setArg( 5, MATRIX_SIZE );
+   worker.queue.enqueueNDRangeKernel(
+      kernel, cl::NullRange, cl::NDRange( MATRIX_SIZE, MATRIX_SIZE ) );
+   worker.queue.enqueueReadBuffer( c_buf, CL_TRUE, 0, bytes, c.data() );
+
+   worker.pool.release( a_buf );
+   worker.pool.release( b_buf );
+   worker.pool.release( c_buf );
+   return c;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first CPU device found in any platform: fission is mostly
+ * supported by CPU devices. When there is none, return the first device
+ * of the first platform.
+ * */
+
+cl::Device getCpuDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for a CPU device on every platform.
+    * */
+
+   std::vector< cl::Device > devices;
+   for( const cl::Platform& platform : platforms ) {
+      platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+      for( const cl::Device& candidate : devices ) {
+         if( candidate.getInfo< CL_DEVICE_TYPE >() & CL_DEVICE_TYPE_CPU ) {
+            return candidate;
+         }
+      }
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   platforms.front().getDevices( CL_DEVICE_TYPE_ALL, &devices );
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+   std::cerr << "No CPU device found, using the first device." << std::endl;
+   return devices.front();
+}
+
+/**
+ * Run an engine of kinds[i] on devices[i] for every i, all at once from a
+ * host thread each, and return the outputs of their last jobs. The
+ * engines are created, and their programs compiled, before the clock
+ * starts; time is the time until all of them finished, in ms.
+ * */
+
+std::vector< std::vector< unsigned char > > runEngines(
+   const std::vector< cl::Device >& devices,
+   const std::vector< Kind >& kinds,
+   double& time ) {
+   std::vector< std::unique_ptr< Engine > > engines;
+   for( size_t i = 0; i < devices.size(); i++ ) {
+      engines.emplace_back( new Engine( devices[i], kinds[i] ) );
+   }
+
+   std::vector< std::vector< unsigned char > > outputs( engines.size() );
+   std::vector< std::thread > threads;
+   auto start = std::chrono::steady_clock::now();
+   for( size_t i = 0; i < engines.size(); i++ ) {
+      threads.emplace_back(
+         [&, i] { outputs[i] = engines[i]->run( JOBS ); } );
+   }
+   for( std::thread& thread : threads ) {
+      thread.join();
+   }
+   time = getElapsedTime( start );
+   return outputs;
+}
+
+/**
+ * Return the compute units of devices, such as "4+4".
+ * */
+
+std::string describe( const std::vector< cl::Device >& devices ) {
+   std::string description;
+   for( const cl::Device& sub_device : devices ) {
+      description += ( description.empty() ? "" : "+" )
+                   + std::to_string(
+                        sub_device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >() );
+   }
+   return description;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
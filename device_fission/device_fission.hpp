@@ -0,0 +1,196 @@
+#ifndef DEVICE_FISSION_HPP
+#define DEVICE_FISSION_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/**
+ * Partition a device into sub-devices with clCreateSubDevices, so that
+ * concurrent pipelines can each be pinned to their own compute units
+ * instead of contending for the whole device. A sub-device is used as any
+ * other device: a context and a queue created on it only run on its
+ * compute units.
+ *
+ *    std::vector< cl::Device > halves
+ *       = DeviceFission::partitionEqually( device, compute_units / 2 );
+ *    cl::Context context( halves[0] );
+ *
+ * The partition functions return no sub-devices when the device does not
+ * support the mode or the partition fails, so callers can fall back to the
+ * whole device.
+ * */
+
+class DeviceFission {
+ public:
+   // The partition modes of clCreateSubDevices.
+   enum class Mode { Equally, ByCounts, ByAffinityDomain };
+
+   // Check whether device can be partitioned with mode.
+   static bool isSupported( const cl::Device& device, const Mode mode ) {
+      if( device.getInfo< CL_DEVICE_PARTITION_MAX_SUB_DEVICES >() < 2 ) {
+         return false;
+      }
+      cl_device_partition_property property = getProperty( mode );
+      std::vector< cl_device_partition_property > properties
+         = device.getInfo< CL_DEVICE_PARTITION_PROPERTIES >();
+      return std::find( properties.begin(), properties.end(), property )
+          != properties.end();
+   }
+
+   // Return the name of mode.
+   static std::string getName( const Mode mode ) {
+      switch( mode ) {
+      case Mode::Equally:
+         return "equally";
+      case Mode::ByCounts:
+         return "by counts";
+      default:
+         return "by affinity domain";
+      }
+   }
+
+   // Split device into as many sub-devices of compute_units compute units
+   // as fit in it.
+   static std::vector< cl::Device > partitionEqually(
+      const cl::Device& device,
+      const cl_uint compute_units ) {
+      if( !isSupported( device, Mode::Equally ) || compute_units == 0 ) {
+         return {};
+      }
+      cl_device_partition_property properties[]
+         = { CL_DEVICE_PARTITION_EQUALLY,
+             static_cast< cl_device_partition_property >( compute_units ),
+             0 };
+      return createSubDevices( device, properties );
+   }
+
+   // Split device into a sub-device per element of counts, with that many
+   // compute units each.
+   static std::vector< cl::Device > partitionByCounts(
+      const cl::Device& device,
+      const std::vector< cl_uint >& counts ) {
+      if( !isSupported( device, Mode::ByCounts ) || counts.empty() ) {
+         return {};
+      }
+      std::vector< cl_device_partition_property > properties
+         = { CL_DEVICE_PARTITION_BY_COUNTS };
+      for( cl_uint count : counts ) {
+         properties.push_back(
+            static_cast< cl_device_partition_property >( count ) );
+      }
+      properties.push_back( CL_DEVICE_PARTITION_BY_COUNTS_LIST_END );
+      properties.push_back( 0 );
+      return createSubDevices( device, properties.data() );
+   }
+
+   // Split device into a sub-device per domain which shares a NUMA node or
+   // a cache level, e.g. CL_DEVICE_AFFINITY_DOMAIN_NUMA or
+   // CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE. The default splits along the
+   // first level the device supports, starting from NUMA nodes.
+   static std::vector< cl::Device > partitionByAffinityDomain(
+      const cl::Device& device,
+      const cl_device_affinity_domain domain
+      = CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE ) {
+      if( !isSupported( device, Mode::ByAffinityDomain )
+          || !( device.getInfo< CL_DEVICE_PARTITION_AFFINITY_DOMAIN >()
+                & domain ) ) {
+         return {};
+      }
+      cl_device_partition_property properties[]
+         = { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN,
+             static_cast< cl_device_partition_property >( domain ),
+             0 };
+      return createSubDevices( device, properties );
+   }
+
+   // Split device into count sub-devices with mode: equal shares for
+   // Equally, shares proportional to weights for ByCounts, and the
+   // affinity domains, reused in turn when there are fewer than count, for
+   // ByAffinityDomain. Return no sub-devices when it fails.
+   static std::vector< cl::Device > partition(
+      const cl::Device& device,
+      const Mode mode,
+      const size_t count,
+      const std::vector< double >& weights = {} ) {
+      cl_uint compute_units = device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >();
+      if( count == 0 || compute_units < count ) {
+         return {};
+      }
+
+      std::vector< cl::Device > sub_devices;
+      if( mode == Mode::Equally ) {
+         sub_devices = partitionEqually(
+            device, static_cast< cl_uint >( compute_units / count ) );
+         sub_devices.resize( std::min( sub_devices.size(), count ) );
+      } else if( mode == Mode::ByCounts ) {
+         sub_devices = partitionByCounts(
+            device, getCounts( compute_units, count, weights ) );
+      } else {
+         std::vector< cl::Device > domains
+            = partitionByAffinityDomain( device );
+         for( size_t i = 0; i < count && !domains.empty(); i++ ) {
+            sub_devices.push_back( domains[i % domains.size()] );
+         }
+      }
+      return sub_devices.size() == count ? sub_devices
+                                         : std::vector< cl::Device >();
+   }
+
+ private:
+   // Return the partition property of mode.
+   static cl_device_partition_property getProperty( const Mode mode ) {
+      switch( mode ) {
+      case Mode::Equally:
+         return CL_DEVICE_PARTITION_EQUALLY;
+      case Mode::ByCounts:
+         return CL_DEVICE_PARTITION_BY_COUNTS;
+      default:
+         return CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN;
+      }
+   }
+
+   // Split compute_units into count shares proportional to weights, or
+   // equal without weights, each of at least one compute unit.
+   static std::vector< cl_uint > getCounts(
+      const cl_uint compute_units,
+      const size_t count,
+      const std::vector< double >& weights ) {
+      double total = 0.0;
+      for( size_t i = 0; i < count; i++ ) {
+         total += i < weights.size() ? weights[i] : 1.0;
+      }
+
+      std::vector< cl_uint > counts( count );
+      cl_uint assigned = 0;
+      for( size_t i = 0; i < count; i++ ) {
+         double weight = i < weights.size() ? weights[i] : 1.0;
+         cl_uint left = static_cast< cl_uint >( count - i - 1 );
+         counts[i] = std::max< cl_uint >(
+            1, static_cast< cl_uint >( compute_units * weight / total ) );
+         counts[i] = std::min( counts[i], compute_units - assigned - left );
+         assigned += counts[i];
+      }
+      counts.back() += compute_units - assigned;
+      return counts;
+   }
+
+   // Create the sub-devices of properties.
+   static std::vector< cl::Device > createSubDevices(
+      const cl::Device& device,
+      const cl_device_partition_property* properties ) {
+      cl::Device parent = device;
+      std::vector< cl::Device > sub_devices;
+      if( parent.createSubDevices( properties, &sub_devices )
+          != CL_SUCCESS ) {
+         return {};
+      }
+      return sub_devices;
+   }
+};
+
+#endif
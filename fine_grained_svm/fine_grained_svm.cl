@@ -0,0 +1,136 @@
+/**
+ * Declare the rounds of the xorshift generator run by every task; the host
+ * code defines the same value.
+ */
+
+#ifndef TASK_ROUNDS
+   #define TASK_ROUNDS 256
+#endif
+
+/**
+ * Process the value of a task: a small, fixed amount of work whose result
+ * the host can check.
+ */
+
+int processTask( const int value ) {
+   uint x = (uint)value;
+   for( int i = 0; i < TASK_ROUNDS; i++ ) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+   }
+   return (int)x;
+}
+
+/**
+ * This kernel function processes a batch of tasks copied to the device,
+ * one per work-item: the coarse-grained path, which launches it for every
+ * batch.
+ */
+
+__kernel void processTasks( const __global int* values,
+                            __global int* results ) {
+   int index = (int)get_global_id( 0 );
+   results[index] = processTask( values[index] );
+}
+
+#ifdef FINE_GRAINED
+
+/**
+ * Declare the ring buffer shared with the host in fine-grained SVM, with
+ * the layout of its host counterpart. Every slot carries a sequence number,
+ * after Dmitry Vyukov's bounded queue: it equals the position of the push
+ * which may fill the slot, and that position plus one once the slot is
+ * full.
+ */
+
+typedef struct {
+   atomic_uint enqueue;     // Position of the next push.
+   atomic_uint dequeue;     // Position of the next pop.
+   atomic_uint completed;   // Tasks whose result is stored.
+   atomic_int stop;         // Set by the host once every task is pushed.
+} Ring;
+
+typedef struct {
+   atomic_uint sequence;
+   int id;
+   int value;
+   int padding;
+} Slot;
+
+/**
+ * Pop the oldest task of the ring into id and value and return true, or
+ * return false when the ring is empty. Every access is ordered at the
+ * scope of all the SVM devices, so the host threads see it.
+ */
+
+bool tryPop( __global Ring* ring,
+             __global Slot* slots,
+             const uint mask,
+             int* id,
+             int* value ) {
+   uint position = atomic_load_explicit( &ring->dequeue,
+                                         memory_order_relaxed,
+                                         memory_scope_all_svm_devices );
+   for( ;; ) {
+      __global Slot* slot = &slots[position & mask];
+      uint sequence = atomic_load_explicit( &slot->sequence,
+                                            memory_order_acquire,
+                                            memory_scope_all_svm_devices );
+      int difference = (int)( sequence - ( position + 1 ) );
+      if( difference == 0 ) {
+         if( atomic_compare_exchange_weak_explicit(
+                &ring->dequeue,
+                &position,
+                position + 1,
+                memory_order_relaxed,
+                memory_order_relaxed,
+                memory_scope_all_svm_devices ) ) {
+            *id = slot->id;
+            *value = slot->value;
+            atomic_store_explicit( &slot->sequence,
+                                   position + mask + 1,
+                                   memory_order_release,
+                                   memory_scope_all_svm_devices );
+            return true;
+         }
+      } else if( difference < 0 ) {
+         return false;
+      } else {
+         position = atomic_load_explicit( &ring->dequeue,
+                                          memory_order_relaxed,
+                                          memory_scope_all_svm_devices );
+      }
+   }
+}
+
+/**
+ * This persistent kernel function consumes the tasks the host threads push
+ * into the ring until the host sets the stop flag and the ring is empty.
+ * Every work-item is a consumer; they should be launched in work-groups of
+ * one, so no work-item waits for another of its group. The stop flag is
+ * set after the last push and read before the pop, so a pop which fails
+ * after seeing it means no task is left.
+ */
+
+__kernel void consumeTasks( __global Ring* ring,
+                            __global Slot* slots,
+                            const uint mask,
+                            __global int* results ) {
+   int id, value;
+   for( ;; ) {
+      int stop = atomic_load_explicit(
+         &ring->stop, memory_order_acquire, memory_scope_all_svm_devices );
+      if( tryPop( ring, slots, mask, &id, &value ) ) {
+         results[id] = processTask( value );
+         atomic_fetch_add_explicit( &ring->completed,
+                                    1,
+                                    memory_order_release,
+                                    memory_scope_all_svm_devices );
+      } else if( stop ) {
+         return;
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,467 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =================================================================
+// ---------------------------- Types -----------------------------
+// =================================================================
+
+/**
+ * The ring buffer shared with the consumeTasks kernel in fine-grained SVM,
+ * with the layout of its counterpart in fine_grained_svm.cl. The atomics
+ * are accessed by the host threads and the device at once, so they must be
+ * plain lock-free integers.
+ * */
+
+struct Ring {
+   std::atomic< cl_uint > enqueue;     // Position of the next push.
+   std::atomic< cl_uint > dequeue;     // Position of the next pop.
+   std::atomic< cl_uint > completed;   // Tasks whose result is stored.
+   std::atomic< cl_int > stop;         // Set once every task is pushed.
+};
+
+struct Slot {
+   std::atomic< cl_uint > sequence;
+   cl_int id;
+   cl_int value;
+   cl_int padding;
+};
+
+static_assert( sizeof( std::atomic< cl_uint > ) == sizeof( cl_uint )
+                  && std::atomic< cl_uint >::is_always_lock_free,
+               "The SVM atomics must be plain lock-free integers." );
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code, with the consumer kernel when
+// fine_grained is set.
+void initializeDevice( const bool fine_grained );
+// Check if the device supports fine-grained SVM buffers with atomics.
+bool isFineGrainedSupported();
+// Push the task id with value into ring; wait while the ring is full.
+void push( Ring* ring, Slot* slots, const cl_int id, const cl_int value );
+// Process the tasks with the persistent kernel, fed by host threads through
+// a ring in fine-grained SVM, and return the time taken in ms.
+double runFineGrained( std::vector< int >& results );
+// Process the tasks in batches, each copied to coarse-grained SVM with
+// map/unmap and processed by a launch, and return the time taken in ms.
+double runCoarseGrained( std::vector< int >& results );
+// Return the value of the task id.
+cl_int getTaskValue( const int id );
+// Sequentially process the value of a task.
+int seqProcessTask( const int value );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// Tasks of every run and rounds of work of every task.
+constexpr int TASKS = 1 << 16;
+constexpr int TASK_ROUNDS = 256;
+// Host threads pushing tasks into the ring, and slots of the ring, which
+// must be a power of two.
+constexpr int PRODUCERS = 4;
+constexpr cl_uint RING_CAPACITY = 1024;
+// Tasks of every launch of the coarse-grained path.
+constexpr int BATCH_SIZE = 64;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Initialize OpenCL device, with the consumer kernel when the device
+    * supports fine-grained SVM with atomics.
+    * */
+
+   device = getDefaultDevice();
+   if( !( device.getInfo< CL_DEVICE_SVM_CAPABILITIES >()
+          & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER ) ) {
+      std::cerr << "The device does not support SVM!" << std::endl;
+      return 1;
+   }
+   bool fine_grained = isFineGrainedSupported();
+   initializeDevice( fine_grained );
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << "\n"
+             << TASKS << " tasks of " << TASK_ROUNDS << " rounds"
+             << std::endl;
+
+   /**
+    * Process the tasks sequentially, to check both paths.
+    * */
+
+   std::vector< int > expected( TASKS );
+   for( int id = 0; id < TASKS; id++ ) {
+      expected[id] = seqProcessTask( getTaskValue( id ) );
+   }
+
+   /**
+    * Process the tasks with the coarse-grained path, then with the
+    * fine-grained one when it is supported. The first run of each path
+    * warms it up.
+    * */
+
+   std::vector< int > coarse_results( TASKS );
+   runCoarseGrained( coarse_results );
+   double coarse_time = runCoarseGrained( coarse_results );
+   bool equal = coarse_results == expected;
+
+   if( !fine_grained ) {
+      std::cout << "Fine-grained SVM with atomics is not supported, only the "
+                << "coarse-grained path runs." << std::endl;
+      std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" )
+                << std::endl;
+      std::cout << "Mean execution time: \n\tCoarse-grained: " << coarse_time
+                << " ms (" << TASKS / coarse_time * 1e3 << " tasks/s)."
+                << std::endl;
+      return 0;
+   }
+
+   std::vector< int > fine_results( TASKS );
+   runFineGrained( fine_results );
+   double fine_time = runFineGrained( fine_results );
+   equal = equal && fine_results == expected;
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tCoarse-grained, batches of "
+             << BATCH_SIZE << ": " << coarse_time << " ms ("
+             << TASKS / coarse_time * 1e3 << " tasks/s);\n\tFine-grained, "
+             << PRODUCERS << " producers: " << fine_time << " ms ("
+             << TASKS / fine_time * 1e3 << " tasks/s)." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( coarse_time - fine_time ) / fine_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code. The consumer kernel needs the
+ * atomics of OpenCL C 2.0, so it is only compiled when fine_grained is set.
+ * */
+
+void initializeDevice( const bool fine_grained ) {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "fine_grained_svm.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   std::string options = "-DTASK_ROUNDS=" + std::to_string( TASK_ROUNDS );
+   if( fine_grained ) {
+      options += " -cl-std=CL2.0 -DFINE_GRAINED";
+   }
+   auto err = program.build( options.c_str() );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Check if the device supports fine-grained SVM buffers with atomics,
+ * which the ring shared by the host threads and the device needs.
+ * */
+
+bool isFineGrainedSupported() {
+   cl_device_svm_capabilities capabilities
+      = device.getInfo< CL_DEVICE_SVM_CAPABILITIES >();
+   return ( capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER )
+       && ( capabilities & CL_DEVICE_SVM_ATOMICS );
+}
+
+/**
+ * Push the task id with value into ring, as the push of the MPMCQueue of
+ * thread_pool does; wait while the ring is full. The release store of the
+ * sequence publishes the task to the consumers on the device.
+ * */
+
+void push( Ring* ring, Slot* slots, const cl_int id, const cl_int value ) {
+   constexpr cl_uint mask = RING_CAPACITY - 1;
+   Slot* slot;
+   cl_uint position = ring->enqueue.load( std::memory_order_relaxed );
+   for( ;; ) {
+      slot = &slots[position & mask];
+      cl_uint sequence = slot->sequence.load( std::memory_order_acquire );
+      cl_int difference = static_cast< cl_int >( sequence - position );
+      if( difference == 0 ) {
+         if( ring->enqueue.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed ) ) {
+            break;
+         }
+      } else if( difference < 0 ) {
+         std::this_thread::yield();
+         position = ring->enqueue.load( std::memory_order_relaxed );
+      } else {
+         position = ring->enqueue.load( std::memory_order_relaxed );
+      }
+   }
+   slot->id = id;
+   slot->value = value;
+   slot->sequence.store( position + 1, std::memory_order_release );
+}
+
+/**
+ * Process the tasks with the persistent consumeTasks kernel: it is launched
+ * once, with a consumer per compute unit, then PRODUCERS host threads push
+ * the tasks into a ring in fine-grained SVM and the main thread waits for
+ * the completed counter. No map, unmap or launch happens per task.
+ * */
+
+double runFineGrained( std::vector< int >& results ) {
+
+   /**
+    * Allocate the ring and the results in fine-grained SVM, and initialize
+    * them in place.
+    * */
+
+   const cl_svm_mem_flags flags = CL_MEM_READ_WRITE
+                                | CL_MEM_SVM_FINE_GRAIN_BUFFER
+                                | CL_MEM_SVM_ATOMICS;
+   Ring* ring = static_cast< Ring* >(
+      clSVMAlloc( context(), flags, sizeof( Ring ), 0 ) );
+   Slot* slots = static_cast< Slot* >(
+      clSVMAlloc( context(), flags, RING_CAPACITY * sizeof( Slot ), 0 ) );
+   cl_int* svm_results = static_cast< cl_int* >(
+      clSVMAlloc( context(),
+                  CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER,
+                  TASKS * sizeof( cl_int ),
+                  0 ) );
+   if( !ring || !slots || !svm_results ) {
+      std::cerr << "Failed to allocate fine-grained SVM!" << std::endl;
+      exit( 1 );
+   }
+
+   new( ring ) Ring{ { 0 }, { 0 }, { 0 }, { 0 } };
+   for( cl_uint i = 0; i < RING_CAPACITY; i++ ) {
+      new( &slots[i] ) Slot{ { i }, 0, 0, 0 };
+   }
+
+   /**
+    * Launch the consumers, in work-groups of one.
+    * */
+
+   size_t consumers = device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >();
+   cl::Kernel kernel( program, "consumeTasks" );
+   kernel.setArg( 0, ring );
+   kernel.setArg( 1, slots );
+   kernel.setArg( 2, RING_CAPACITY - 1 );
+   kernel.setArg( 3, svm_results );
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel(
+      kernel, cl::NullRange, cl::NDRange( consumers ), cl::NDRange( 1 ) );
+   queue.flush();
+
+   /**
+    * Push the tasks from the producers and wait for their results.
+    * */
+
+   auto start = std::chrono::steady_clock::now();
+   std::vector< std::thread > producers;
+   for( int p = 0; p < PRODUCERS; p++ ) {
+      producers.emplace_back( [ring, slots, p] {
+         for( int id = p; id < TASKS; id += PRODUCERS ) {
+            push( ring, slots, id, getTaskValue( id ) );
+         }
+      } );
+   }
+   for( std::thread& producer : producers ) {
+      producer.join();
+   }
+   ring->stop.store( 1, std::memory_order_release );
+   while( ring->completed.load( std::memory_order_acquire ) < TASKS ) {
+      std::this_thread::yield();
+   }
+   double time = std::chrono::duration< double, std::milli >(
+                    std::chrono::steady_clock::now() - start )
+                    .count();
+
+   /**
+    * Wait for the consumers to stop, and collect the results.
+    * */
+
+   queue.finish();
+   std::copy( svm_results, svm_results + TASKS, results.begin() );
+   clSVMFree( context(), ring );
+   clSVMFree( context(), slots );
+   clSVMFree( context(), svm_results );
+   return time;
+}
+
+/**
+ * Process the tasks in batches of BATCH_SIZE, as coarse_grained_svm does:
+ * every batch is written to coarse-grained SVM between a map and an unmap,
+ * processed by a launch of processTasks, and its results are read between
+ * another map and unmap.
+ * */
+
+double runCoarseGrained( std::vector< int >& results ) {
+
+   /**
+    * Allocate the values of a batch and the results in coarse-grained SVM.
+    * */
+
+   cl_int* values = static_cast< cl_int* >( clSVMAlloc(
+      context(), CL_MEM_READ_WRITE, BATCH_SIZE * sizeof( cl_int ), 0 ) );
+   cl_int* svm_results = static_cast< cl_int* >( clSVMAlloc(
+      context(), CL_MEM_READ_WRITE, TASKS * sizeof( cl_int ), 0 ) );
+   if( !values || !svm_results ) {
+      std::cerr << "Failed to allocate coarse-grained SVM!" << std::endl;
+      exit( 1 );
+   }
+
+   cl::Kernel kernel( program, "processTasks" );
+   cl::CommandQueue queue( context, device );
+   auto start = std::chrono::steady_clock::now();
+   for( int first = 0; first < TASKS; first += BATCH_SIZE ) {
+      const int batch = std::min( BATCH_SIZE, TASKS - first );
+      const size_t bytes = batch * sizeof( cl_int );
+
+      /**
+       * Write the batch.
+       * */
+
+      clEnqueueSVMMap( queue(),
+                       CL_TRUE,
+                       CL_MAP_WRITE_INVALIDATE_REGION,
+                       values,
+                       bytes,
+                       0,
+                       nullptr,
+                       nullptr );
+      for( int i = 0; i < batch; i++ ) {
+         values[i] = getTaskValue( first + i );
+      }
+      clEnqueueSVMUnmap( queue(), values, 0, nullptr, nullptr );
+
+      /**
+       * Process it and read its results.
+       * */
+
+      kernel.setArg( 0, values );
+      kernel.setArg( 1, svm_results + first );
+      queue.enqueueNDRangeKernel( kernel, cl::NullRange, cl::NDRange( batch ) );
+      clEnqueueSVMMap( queue(),
+                       CL_TRUE,
+                       CL_MAP_READ,
+                       svm_results + first,
+                       bytes,
+                       0,
+                       nullptr,
+                       nullptr );
+      std::copy(
+         svm_results + first, svm_results + first + batch, &results[first] );
+      clEnqueueSVMUnmap( queue(), svm_results + first, 0, nullptr, nullptr );
+   }
+   queue.finish();
+   double time = std::chrono::duration< double, std::milli >(
+                    std::chrono::steady_clock::now() - start )
+                    .count();
+
+   clSVMFree( context(), values );
+   clSVMFree( context(), svm_results );
+   return time;
+}
+
+/**
+ * Return the value of the task id, spread over the 32 bits.
+ * */
+
+cl_int getTaskValue( const int id ) {
+   return static_cast< cl_int >( static_cast< cl_uint >( id ) * 2654435761u
+                                 + 1u );
+}
+
+/**
+ * Sequentially process the value of a task, as processTask does.
+ * */
+
+int seqProcessTask( const int value ) {
+   cl_uint x = static_cast< cl_uint >( value );
+   for( int i = 0; i < TASK_ROUNDS; i++ ) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+   }
+   return static_cast< int >( x );
+}
@@ -0,0 +1,292 @@
+/**
+ * Declare the histograms computed by this program. The host code defines
+ * VALUE_TYPE, the type of the values counted by histogramBins (e.g. int,
+ * uint, float). The 8-bit kernels always count unsigned chars.
+ *
+ * Every work-group counts into copies private histograms in local memory,
+ * interleaved so that the copies of a bin are consecutive and work-items
+ * with different copies hit different banks: copy c of bin b is
+ * local_bins[b * copies + c]. Neighbouring work-items use different copies,
+ * so equal values, common in images, contend less on the same counter. The
+ * work-group then adds its copies into the global histogram with one atomic
+ * per bin.
+ */
+
+#ifndef VALUE_TYPE
+   #define VALUE_TYPE int
+#endif
+
+#define BINS_8BIT 256
+
+/**
+ * Clear the local histograms of the work-group.
+ */
+
+void clearLocalBins( __local uint* local_bins, const uint size ) {
+   for( uint i = get_local_id( 0 ); i < size; i += get_local_size( 0 ) ) {
+      local_bins[i] = 0;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+}
+
+/**
+ * Add the local histograms of the work-group into histogram[bins].
+ */
+
+void mergeLocalBins( const __local uint* local_bins,
+                     __global uint* histogram,
+                     const uint bins,
+                     const uint copies ) {
+   barrier( CLK_LOCAL_MEM_FENCE );
+   for( uint bin = get_local_id( 0 ); bin < bins; bin += get_local_size( 0 ) ) {
+      uint sum = 0;
+      for( uint copy = 0; copy < copies; copy++ ) {
+         sum += local_bins[bin * copies + copy];
+      }
+      if( sum > 0 ) {
+         atomic_add( &histogram[bin], sum );
+      }
+   }
+}
+
+/**
+ * This kernel function adds the histogram of the 8-bit values input[n] to
+ * histogram[256]. Each work-item counts a strided range of four values at
+ * a time; local_bins must hold 256 * copies counters.
+ */
+
+__kernel void histogram256( const __global uchar* input,
+                            __global uint* histogram,
+                            const unsigned int n,
+                            const unsigned int copies,
+                            __local uint* local_bins ) {
+   clearLocalBins( local_bins, BINS_8BIT * copies );
+
+   /**
+    * Count the values into the copy of this work-item.
+    */
+
+   __local uint* bins = local_bins + get_local_id( 0 ) % copies;
+   uint quads = n / 4;
+   for( uint i = get_global_id( 0 ); i < quads; i += get_global_size( 0 ) ) {
+      uchar4 values = vload4( i, input );
+      atomic_inc( &bins[values.x * copies] );
+      atomic_inc( &bins[values.y * copies] );
+      atomic_inc( &bins[values.z * copies] );
+      atomic_inc( &bins[values.w * copies] );
+   }
+   for( uint i = 4 * quads + get_global_id( 0 ); i < n;
+        i += get_global_size( 0 ) ) {
+      atomic_inc( &bins[input[i] * copies] );
+   }
+
+   mergeLocalBins( local_bins, histogram, BINS_8BIT, copies );
+}
+
+/**
+ * This kernel function adds the histogram of input[n] to histogram[bins]:
+ * the bins split [min_value, max_value] evenly, scale is bins / (max_value -
+ * min_value), max_value falls in the last bin and values out of the range
+ * are not counted. When copies is 0 the bins do not fit in local memory and
+ * are counted directly in global memory.
+ */
+
+__kernel void histogramBins( const __global VALUE_TYPE* input,
+                             __global uint* histogram,
+                             const unsigned int n,
+                             const unsigned int bins,
+                             const VALUE_TYPE min_value,
+                             const VALUE_TYPE max_value,
+                             const float scale,
+                             const unsigned int copies,
+                             __local uint* local_bins ) {
+   if( copies > 0 ) {
+      clearLocalBins( local_bins, bins * copies );
+   }
+
+   /**
+    * Count the values into the copy of this work-item.
+    */
+
+   __local uint* local_copy
+      = local_bins + ( copies > 0 ? get_local_id( 0 ) % copies : 0 );
+   for( uint i = get_global_id( 0 ); i < n; i += get_global_size( 0 ) ) {
+      VALUE_TYPE value = input[i];
+      if( value < min_value || value > max_value ) {
+         continue;
+      }
+      uint bin = min( (uint)( ( (float)value - (float)min_value ) * scale ),
+                      bins - 1 );
+      if( copies > 0 ) {
+         atomic_inc( &local_copy[bin * copies] );
+      } else {
+         atomic_inc( &histogram[bin] );
+      }
+   }
+
+   if( copies > 0 ) {
+      mergeLocalBins( local_bins, histogram, bins, copies );
+   }
+}
+
+/**
+ * This kernel function, run by a single work-item, turns the histogram of n
+ * 8-bit values into the lookup table of their equalization: every value is
+ * mapped to its rounded share of the cumulative histogram above the first
+ * value present. 256 bins are too few to spread over a work-group.
+ */
+
+__kernel void equalizationLut( const __global uint* histogram,
+                               __global uchar* lut,
+                               const unsigned int n ) {
+
+   /**
+    * Find the count of the smallest value present.
+    */
+
+   uint cdf_min = 0;
+   for( uint i = 0; i < BINS_8BIT && cdf_min == 0; i++ ) {
+      cdf_min = histogram[i];
+   }
+
+   /**
+    * Map every value; an image of a single value is left unchanged.
+    */
+
+   uint cdf = 0;
+   for( uint i = 0; i < BINS_8BIT; i++ ) {
+      cdf += histogram[i];
+      if( cdf_min == n ) {
+         lut[i] = i;
+      } else if( cdf < cdf_min ) {
+         lut[i] = 0;
+      } else {
+         ulong range = n - cdf_min;
+         lut[i] = ( (ulong)( cdf - cdf_min ) * 255 + range / 2 ) / range;
+      }
+   }
+}
+
+/**
+ * This kernel function maps every 8-bit value of input through lut into
+ * output; input and output may be the same buffer.
+ */
+
+__kernel void applyLut( const __global uchar* input,
+                        const __constant uchar* lut,
+                        __global uchar* output,
+                        const unsigned int n ) {
+   uint index = get_global_id( 0 );
+   if( index < n ) {
+      output[index] = lut[input[index]];
+   }
+}
+
+/**
+ * Multiply the square of d by p into the 192-bit integer r, from its least
+ * significant word, with mul_hi for the high words of the 64-bit products.
+ */
+
+void multiplySquare( const ulong d, const ulong p, ulong* r ) {
+   ulong low = d * d;
+   ulong high = mul_hi( d, d );
+   ulong middle = mul_hi( low, p );
+   r[0] = low * p;
+   r[1] = middle + high * p;
+   r[2] = mul_hi( high, p ) + ( r[1] < middle );
+}
+
+/**
+ * Compare the between-class variances of two thresholds exactly, in
+ * integers. The variance of a threshold is proportional to d * d / p,
+ * where d is the difference n * sum - total_sum * weight and p is
+ * weight * ( n - weight ), so the first one is larger when
+ * d_a^2 * p_b > d_b^2 * p_a. Both products fit in 192 bits, and d in 64
+ * bits for images of fewer than 2^28 pixels. Histogram::isLargerVariance
+ * computes the same on the host.
+ */
+
+bool isLargerVariance( const ulong d_a,
+                       const ulong p_a,
+                       const ulong d_b,
+                       const ulong p_b ) {
+   ulong a[3], b[3];
+   multiplySquare( d_a, p_b, a );
+   multiplySquare( d_b, p_a, b );
+   for( int i = 2; i >= 0; i-- ) {
+      if( a[i] != b[i] ) {
+         return a[i] > b[i];
+      }
+   }
+   return false;
+}
+
+/**
+ * This kernel function, run by a single work-item, finds Otsu's threshold
+ * of the histogram of n 8-bit values: the value t which maximizes the
+ * variance between the values up to t and the values above it. The first
+ * such value is stored in threshold[0]. The variances are compared in
+ * integers, so the host finds the same threshold whatever the precision
+ * of the device's float division.
+ */
+
+__kernel void otsuThreshold( const __global uint* histogram,
+                             __global uchar* threshold,
+                             const unsigned int n ) {
+
+   /**
+    * Compute the sum of all values.
+    */
+
+   ulong total_sum = 0;
+   for( uint i = 0; i < BINS_8BIT; i++ ) {
+      total_sum += (ulong)i * histogram[i];
+   }
+
+   /**
+    * Try every threshold, growing the lower class one value at a time.
+    */
+
+   uint best = 0;
+   bool found = false;
+   ulong best_difference = 0;
+   ulong best_weights = 1;
+   uint weight = 0;
+   ulong sum = 0;
+   for( uint t = 0; t < BINS_8BIT; t++ ) {
+      weight += histogram[t];
+      sum += (ulong)t * histogram[t];
+      if( weight == 0 || weight == n ) {
+         continue;
+      }
+      ulong lower = (ulong)n * sum;
+      ulong upper = total_sum * weight;
+      ulong difference = lower > upper ? lower - upper : upper - lower;
+      ulong weights = (ulong)weight * ( n - weight );
+      if( !found
+          || isLargerVariance(
+             difference, weights, best_difference, best_weights ) ) {
+         found = true;
+         best_difference = difference;
+         best_weights = weights;
+         best = t;
+      }
+   }
+   threshold[0] = best;
+}
+
+/**
+ * This kernel function sets every 8-bit value of input above threshold[0]
+ * to 255 and the others to 0 in output; input and output may be the same
+ * buffer.
+ */
+
+__kernel void binarize( const __global uchar* input,
+                        const __global uchar* threshold,
+                        __global uchar* output,
+                        const unsigned int n ) {
+   uint index = get_global_id( 0 );
+   if( index < n ) {
+      output[index] = input[index] > threshold[0] ? 255 : 0;
+   }
+}
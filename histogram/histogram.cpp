@@ -0,0 +1,393 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "histogram.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Sequentially count a[n] into histogram[bins] over [min_value, max_value].
+template< typename T >
+void seqHistogram( const T* a,
+                   const size_t n,
+                   const size_t bins,
+                   const T min_value,
+                   const T max_value,
+                   unsigned int* histogram );
+// Sequentially equalize the histogram of the 8-bit image img[n] in place.
+void seqEqualize( unsigned char* img, const size_t n );
+// Sequentially binarize the 8-bit image img[n] in place with Otsu's
+// threshold and return the threshold.
+unsigned char seqOtsu( unsigned char* img, const size_t n );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 10;
+   bool equal = true;
+
+   /**
+    * Prepare the inputs: an 8-bit image where half of the pixels share the
+    * background value, the worst case for a single local histogram, and
+    * floats and ints spread over their ranges.
+    * */
+
+   constexpr size_t n = 1 << 26;
+   constexpr size_t float_bins = 1000;
+   constexpr size_t int_bins = 1 << 16;
+   constexpr int int_max = 1 << 20;
+   std::vector< unsigned char > img( n );
+   std::vector< float > f( n / 4 );
+   std::vector< int > a( n / 4 );
+   unsigned int state = 2463534242u;
+   for( size_t i = 0; i < n; i++ ) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      img[i] = i % 2 == 0 ? 128 : static_cast< unsigned char >( state >> 24 );
+      if( i < n / 4 ) {
+         f[i] = static_cast< float >( state >> 8 ) / ( 1 << 23 ) - 1.0f;
+         a[i] = static_cast< int >( state % ( int_max + 1 ) );
+      }
+   }
+
+   /**
+    * Sequentially count the histograms.
+    * */
+
+   std::vector< unsigned int > seq_img_bins( Histogram::BINS_8BIT );
+   std::vector< unsigned int > seq_float_bins( float_bins );
+   std::vector< unsigned int > seq_int_bins( int_bins );
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      seqHistogram< unsigned char >( img.data(),
+                                     n,
+                                     Histogram::BINS_8BIT,
+                                     0,
+                                     255,
+                                     seq_img_bins.data() );
+   }
+   double seq_time = getElapsedTime( start ) / executions;
+   seqHistogram( f.data(),
+                 f.size(),
+                 float_bins,
+                 -1.0f,
+                 1.0f,
+                 seq_float_bins.data() );
+   seqHistogram( a.data(),
+                 a.size(),
+                 int_bins,
+                 0,
+                 int_max,
+                 seq_int_bins.data() );
+
+   /**
+    * Initialize OpenCL device and upload the inputs.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   cl::CommandQueue queue( context, device );
+   cl::Buffer img_buf(
+      context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, n, img.data() );
+   cl::Buffer f_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      f.size() * sizeof( float ),
+      f.data() );
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.size() * sizeof( int ),
+      a.data() );
+   cl::Buffer bins_buf( context,
+                        CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY,
+                        int_bins * sizeof( cl_uint ) );
+   std::vector< unsigned int > par_bins( int_bins );
+
+   /**
+    * Parallelly count the 8-bit histogram with one local histogram per
+    * work-group and with several copies.
+    * */
+
+   double par_time = 0.0;
+   std::cout << std::fixed << std::setprecision( 3 )
+             << "Mean execution time of the histogram of " << n
+             << " 8-bit pixels:" << std::endl;
+   for( size_t copies : { size_t( 1 ), Histogram::MAX_COPIES } ) {
+      Histogram histogram( context, device, copies );
+      histogram.count256( queue, img_buf, n, bins_buf );
+      queue.finish();
+      start = std::chrono::steady_clock::now();
+      for( int i = 0; i < executions; i++ ) {
+         histogram.count256( queue, img_buf, n, bins_buf );
+      }
+      queue.finish();
+      par_time = getElapsedTime( start ) / executions;
+
+      queue.enqueueReadBuffer( bins_buf,
+                               CL_TRUE,
+                               0,
+                               Histogram::BINS_8BIT * sizeof( cl_uint ),
+                               par_bins.data() );
+      bool copies_equal = std::equal(
+         seq_img_bins.begin(), seq_img_bins.end(), par_bins.begin() );
+      equal = equal && copies_equal;
+      std::cout << "\tUp to " << std::setw( 2 ) << copies
+                << " local copies: " << par_time << " ms; "
+                << n / ( par_time * 1e6 ) << " GB/s"
+                << ( copies_equal ? "" : " (FAILED)" ) << std::endl;
+   }
+
+   /**
+    * Parallelly count the float and int histograms, the second one too
+    * large for local memory on most devices.
+    * */
+
+   Histogram histogram( context, device );
+   histogram.count< float >(
+      queue, f_buf, f.size(), float_bins, -1.0f, 1.0f, bins_buf );
+   queue.enqueueReadBuffer( bins_buf,
+                            CL_TRUE,
+                            0,
+                            float_bins * sizeof( cl_uint ),
+                            par_bins.data() );
+   bool float_equal = std::equal(
+      seq_float_bins.begin(), seq_float_bins.end(), par_bins.begin() );
+
+   histogram.count< int >(
+      queue, a_buf, a.size(), int_bins, 0, int_max, bins_buf );
+   queue.enqueueReadBuffer( bins_buf,
+                            CL_TRUE,
+                            0,
+                            int_bins * sizeof( cl_uint ),
+                            par_bins.data() );
+   bool int_equal = std::equal(
+      seq_int_bins.begin(), seq_int_bins.end(), par_bins.begin() );
+   equal = equal && float_equal && int_equal;
+
+   /**
+    * Equalize and binarize the image on both sides.
+    * */
+
+   std::vector< unsigned char > seq_img = img;
+   std::vector< unsigned char > par_img( n );
+   seqEqualize( seq_img.data(), n );
+   histogram.equalize( queue, img_buf, img_buf, n );
+   queue.enqueueReadBuffer( img_buf, CL_TRUE, 0, n, par_img.data() );
+   bool equalize_equal = seq_img == par_img;
+
+   unsigned char seq_threshold = seqOtsu( seq_img.data(), n );
+   histogram.otsu( queue, img_buf, img_buf, n );
+   queue.enqueueReadBuffer( img_buf, CL_TRUE, 0, n, par_img.data() );
+   bool otsu_equal = seq_img == par_img;
+   equal = equal && equalize_equal && otsu_equal;
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Histogram of " << f.size() << " floats in " << float_bins
+             << " bins: " << ( float_equal ? "SUCCESS!" : "FAILED!" )
+             << "\nHistogram of " << a.size() << " ints in " << int_bins
+             << " bins: " << ( int_equal ? "SUCCESS!" : "FAILED!" )
+             << "\nEqualization: "
+             << ( equalize_equal ? "SUCCESS!" : "FAILED!" )
+             << "\nOtsu's threshold " << static_cast< int >( seq_threshold )
+             << ": " << ( otsu_equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << seq_time
+             << " ms;\n\tParallel: " << par_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Sequentially count a[n] into histogram[bins], which split [min_value,
+ * max_value] evenly, with the same float arithmetic as histogramBins.
+ * */
+
+template< typename T >
+void seqHistogram( const T* a,
+                   const size_t n,
+                   const size_t bins,
+                   const T min_value,
+                   const T max_value,
+                   unsigned int* histogram ) {
+   float scale = Histogram::getScale( bins, min_value, max_value );
+   std::fill( histogram, histogram + bins, 0 );
+   for( size_t i = 0; i < n; i++ ) {
+      if( a[i] < min_value || a[i] > max_value ) {
+         continue;
+      }
+      size_t bin = static_cast< size_t >(
+         ( static_cast< float >( a[i] ) - static_cast< float >( min_value ) )
+         * scale );
+      histogram[std::min( bin, bins - 1 )]++;
+   }
+}
+
+/**
+ * Sequentially equalize the histogram of the 8-bit image img[n] in place,
+ * with the same rounding as equalizationLut.
+ * */
+
+void seqEqualize( unsigned char* img, const size_t n ) {
+   unsigned int histogram[Histogram::BINS_8BIT] = {};
+   for( size_t i = 0; i < n; i++ ) {
+      histogram[img[i]]++;
+   }
+
+   unsigned long long cdf_min = 0;
+   for( size_t i = 0; i < Histogram::BINS_8BIT && cdf_min == 0; i++ ) {
+      cdf_min = histogram[i];
+   }
+
+   unsigned char lut[Histogram::BINS_8BIT];
+   unsigned long long cdf = 0;
+   for( size_t i = 0; i < Histogram::BINS_8BIT; i++ ) {
+      cdf += histogram[i];
+      if( cdf_min == n ) {
+         lut[i] = static_cast< unsigned char >( i );
+      } else if( cdf < cdf_min ) {
+         lut[i] = 0;
+      } else {
+         unsigned long long range = n - cdf_min;
+         lut[i] = static_cast< unsigned char >(
+            ( ( cdf - cdf_min ) * 255 + range / 2 ) / range );
+      }
+   }
+
+   for( size_t i = 0; i < n; i++ ) {
+      img[i] = lut[img[i]];
+   }
+}
+
+/**
+ * Sequentially binarize the 8-bit image img[n] in place with Otsu's
+ * threshold and return the threshold. The variances are compared exactly in
+ * integers, as otsuThreshold does, so both find the same threshold.
+ * */
+
+unsigned char seqOtsu( unsigned char* img, const size_t n ) {
+   unsigned int histogram[Histogram::BINS_8BIT] = {};
+   for( size_t i = 0; i < n; i++ ) {
+      histogram[img[i]]++;
+   }
+
+   unsigned long long total_sum = 0;
+   for( size_t i = 0; i < Histogram::BINS_8BIT; i++ ) {
+      total_sum += i * histogram[i];
+   }
+
+   unsigned int best = 0;
+   bool found = false;
+   cl_ulong best_difference = 0;
+   cl_ulong best_weights = 1;
+   unsigned int weight = 0;
+   unsigned long long sum = 0;
+   for( unsigned int t = 0; t < Histogram::BINS_8BIT; t++ ) {
+      weight += histogram[t];
+      sum += static_cast< unsigned long long >( t ) * histogram[t];
+      if( weight == 0 || weight == n ) {
+         continue;
+      }
+      cl_ulong lower = static_cast< cl_ulong >( n ) * sum;
+      cl_ulong upper = total_sum * weight;
+      cl_ulong difference = lower > upper ? lower - upper : upper - lower;
+      cl_ulong weights = static_cast< cl_ulong >( weight ) * ( n - weight );
+      if( !found
+          || Histogram::isLargerVariance(
+             difference, weights, best_difference, best_weights ) ) {
+         found = true;
+         best_difference = difference;
+         best_weights = weights;
+         best = t;
+      }
+   }
+
+   for( size_t i = 0; i < n; i++ ) {
+      img[i] = img[i] > best ? 255 : 0;
+   }
+   return static_cast< unsigned char >( best );
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,370 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+/**
+ * Compute histograms of device buffers with the kernels of histogram.cl,
+ * and the image stages built on them. Every work-group counts into several
+ * copies of its histogram in local memory, as many as fit up to
+ * MAX_COPIES, which spreads the atomics of equal values, and then adds them
+ * to the global histogram:
+ *    - count256 counts 8-bit values into 256 bins;
+ *    - count counts values of any type into bins over a range;
+ *    - equalize equalizes the histogram of an 8-bit image;
+ *    - otsu binarizes an 8-bit image with Otsu's threshold.
+ * The image stages keep their histogram, lookup table and threshold on the
+ * device, so they can run between other kernels without any read back.
+ *
+ *    Histogram histogram( context, device );
+ *    histogram.count256( queue, image, n, bins );
+ * */
+
+// =================================================================
+// ---------------------------- Traits -----------------------------
+// =================================================================
+
+// The OpenCL C name of the counted types.
+template< typename T >
+struct HistogramType;
+
+template<>
+struct HistogramType< int > {
+   static constexpr const char* name = "int";
+};
+
+template<>
+struct HistogramType< unsigned int > {
+   static constexpr const char* name = "uint";
+};
+
+template<>
+struct HistogramType< float > {
+   static constexpr const char* name = "float";
+};
+
+template<>
+struct HistogramType< unsigned char > {
+   static constexpr const char* name = "uchar";
+};
+
+// =================================================================
+// --------------------------- Histogram ---------------------------
+// =================================================================
+
+class Histogram {
+ public:
+   // Number of bins of 8-bit values.
+   static constexpr size_t BINS_8BIT = 256;
+   // Maximum number of local histograms of every work-group.
+   static constexpr size_t MAX_COPIES = 16;
+   // Work-groups launched per compute unit; each one counts a strided
+   // range, so the global merge happens a few times per compute unit.
+   static constexpr size_t GROUPS_PER_COMPUTE_UNIT = 4;
+
+   // max_copies limits the local histograms of every work-group.
+   Histogram( const cl::Context& context,
+              const cl::Device& device,
+              const size_t max_copies = MAX_COPIES,
+              const std::string& file_name = "../histogram/histogram.cl" )
+      : context_( context ), device_( device ), max_copies_( max_copies ) {
+
+      /**
+       * Read the kernel file and compile the 8-bit kernels now, so the
+       * first image stage does not pay for it.
+       * */
+
+      std::ifstream kernel_file( file_name );
+      if( !kernel_file.is_open() ) {
+         std::cerr << "Fail to open " << file_name << "." << std::endl;
+         exit( 1 );
+      }
+      source_ = std::string( std::istreambuf_iterator< char >( kernel_file ),
+                             ( std::istreambuf_iterator< char >() ) );
+      getProgram( getOptions< unsigned char >() );
+
+      /**
+       * Size the launches from the device and allocate the buffers of the
+       * image stages.
+       * */
+
+      size_t limit = std::min< size_t >(
+         256, device.getInfo< CL_DEVICE_MAX_WORK_GROUP_SIZE >() );
+      local_size_ = 1;
+      while( 2 * local_size_ <= limit ) {
+         local_size_ *= 2;
+      }
+      max_groups_ = GROUPS_PER_COMPUTE_UNIT
+                  * device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >();
+      local_mem_size_ = device.getInfo< CL_DEVICE_LOCAL_MEM_SIZE >();
+
+      bins_ = cl::Buffer( context,
+                          CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                          BINS_8BIT * sizeof( cl_uint ) );
+      lut_ = cl::Buffer( context,
+                         CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                         BINS_8BIT * sizeof( cl_uchar ) );
+      threshold_ = cl::Buffer( context, CL_MEM_READ_WRITE, sizeof( cl_uchar ) );
+   }
+
+   // Count the 8-bit values of input[n] into histogram[256].
+   void count256( const cl::CommandQueue& queue,
+                  const cl::Buffer& input,
+                  const size_t n,
+                  const cl::Buffer& histogram ) {
+      clear( queue, histogram, BINS_8BIT );
+      if( n == 0 ) {
+         return;
+      }
+
+      cl_uint copies = getCopies( BINS_8BIT );
+      cl::Kernel kernel( getProgram( getOptions< unsigned char >() ),
+                         "histogram256" );
+      kernel.setArg( 0, input );
+      kernel.setArg( 1, histogram );
+      kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      kernel.setArg( 3, copies );
+      kernel.setArg( 4, cl::Local( BINS_8BIT * copies * sizeof( cl_uint ) ) );
+      enqueueGroups( queue, kernel, ( n + 3 ) / 4 );
+   }
+
+   // Count the values of input[n] into histogram[bins], which split
+   // [min_value, max_value] evenly; values out of the range are not
+   // counted.
+   template< typename T >
+   void count( const cl::CommandQueue& queue,
+               const cl::Buffer& input,
+               const size_t n,
+               const size_t bins,
+               const T min_value,
+               const T max_value,
+               const cl::Buffer& histogram ) {
+      clear( queue, histogram, bins );
+      if( n == 0 ) {
+         return;
+      }
+
+      cl_uint copies = getCopies( bins );
+      cl::Kernel kernel( getProgram( getOptions< T >() ), "histogramBins" );
+      kernel.setArg( 0, input );
+      kernel.setArg( 1, histogram );
+      kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      kernel.setArg( 3, static_cast< cl_uint >( bins ) );
+      kernel.setArg( 4, min_value );
+      kernel.setArg( 5, max_value );
+      kernel.setArg( 6, getScale( bins, min_value, max_value ) );
+      kernel.setArg( 7, copies );
+      kernel.setArg( 8,
+                     cl::Local( std::max< size_t >( bins * copies, 1 )
+                                * sizeof( cl_uint ) ) );
+      enqueueGroups( queue, kernel, n );
+   }
+
+   // Return the factor which turns the distance of a value to min_value
+   // into its bin; it matches histogramBins, so host code can compute the
+   // same bins.
+   template< typename T >
+   static float getScale( const size_t bins,
+                          const T min_value,
+                          const T max_value ) {
+      return static_cast< float >( bins )
+           / ( static_cast< float >( max_value )
+               - static_cast< float >( min_value ) );
+   }
+
+   // Equalize the histogram of the 8-bit image input[n] into output[n];
+   // they may be the same buffer.
+   void equalize( const cl::CommandQueue& queue,
+                  const cl::Buffer& input,
+                  const cl::Buffer& output,
+                  const size_t n ) {
+      count256( queue, input, n, bins_ );
+
+      cl::Program& program = getProgram( getOptions< unsigned char >() );
+      cl::Kernel lut_kernel( program, "equalizationLut" );
+      lut_kernel.setArg( 0, bins_ );
+      lut_kernel.setArg( 1, lut_ );
+      lut_kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      queue.enqueueNDRangeKernel(
+         lut_kernel, cl::NullRange, cl::NDRange( 1 ), cl::NDRange( 1 ) );
+
+      cl::Kernel apply_kernel( program, "applyLut" );
+      apply_kernel.setArg( 0, input );
+      apply_kernel.setArg( 1, lut_ );
+      apply_kernel.setArg( 2, output );
+      apply_kernel.setArg( 3, static_cast< cl_uint >( n ) );
+      enqueuePixels( queue, apply_kernel, n );
+   }
+
+   // Binarize the 8-bit image input[n] into output[n] with Otsu's
+   // threshold: values above it become 255 and the others 0. They may be
+   // the same buffer.
+   void otsu( const cl::CommandQueue& queue,
+              const cl::Buffer& input,
+              const cl::Buffer& output,
+              const size_t n ) {
+      count256( queue, input, n, bins_ );
+
+      cl::Program& program = getProgram( getOptions< unsigned char >() );
+      cl::Kernel threshold_kernel( program, "otsuThreshold" );
+      threshold_kernel.setArg( 0, bins_ );
+      threshold_kernel.setArg( 1, threshold_ );
+      threshold_kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      queue.enqueueNDRangeKernel(
+         threshold_kernel, cl::NullRange, cl::NDRange( 1 ), cl::NDRange( 1 ) );
+
+      cl::Kernel binarize_kernel( program, "binarize" );
+      binarize_kernel.setArg( 0, input );
+      binarize_kernel.setArg( 1, threshold_ );
+      binarize_kernel.setArg( 2, output );
+      binarize_kernel.setArg( 3, static_cast< cl_uint >( n ) );
+      enqueuePixels( queue, binarize_kernel, n );
+   }
+
+   // Compare the between-class variances of two thresholds of Otsu's
+   // method exactly, as isLargerVariance of histogram.cl does: each is
+   // proportional to d * d / p, with d = n * sum - total_sum * weight and
+   // p = weight * ( n - weight ), compared as d_a^2 * p_b > d_b^2 * p_a
+   // in 192 bits.
+   static bool isLargerVariance( const cl_ulong d_a,
+                                 const cl_ulong p_a,
+                                 const cl_ulong d_b,
+                                 const cl_ulong p_b ) {
+      cl_ulong a[3], b[3];
+      multiplySquare( d_a, p_b, a );
+      multiplySquare( d_b, p_a, b );
+      for( int i = 2; i >= 0; i-- ) {
+         if( a[i] != b[i] ) {
+            return a[i] > b[i];
+         }
+      }
+      return false;
+   }
+
+   // Return the threshold of the last otsu call.
+   cl_uchar lastThreshold( const cl::CommandQueue& queue ) const {
+      cl_uchar threshold;
+      queue.enqueueReadBuffer(
+         threshold_, CL_TRUE, 0, sizeof( cl_uchar ), &threshold );
+      return threshold;
+   }
+
+ private:
+   // Return the options which select the type counted by histogramBins.
+   template< typename T >
+   static std::string getOptions() {
+      return std::string( "-DVALUE_TYPE=" ) + HistogramType< T >::name;
+   }
+
+   // Return the number of local histograms of bins counters per
+   // work-group: a power of two up to max_copies_ and the work-group size,
+   // using at most half of the local memory, or 0 when a single one does
+   // not fit.
+   cl_uint getCopies( const size_t bins ) const {
+      size_t budget = local_mem_size_ / 2;
+      if( bins * sizeof( cl_uint ) > budget ) {
+         return 0;
+      }
+      size_t copies = 1;
+      while( 2 * copies <= std::min( max_copies_, local_size_ )
+             && 2 * copies * bins * sizeof( cl_uint ) <= budget ) {
+         copies *= 2;
+      }
+      return static_cast< cl_uint >( copies );
+   }
+
+   // Return the high word of the 128-bit product of a and b, as mul_hi.
+   static cl_ulong mulHi( const cl_ulong a, const cl_ulong b ) {
+      return static_cast< cl_ulong >(
+         ( static_cast< unsigned __int128 >( a ) * b ) >> 64 );
+   }
+
+   // Multiply the square of d by p into the 192-bit integer r, from its
+   // least significant word.
+   static void multiplySquare( const cl_ulong d,
+                               const cl_ulong p,
+                               cl_ulong* r ) {
+      cl_ulong low = d * d;
+      cl_ulong high = mulHi( d, d );
+      cl_ulong middle = mulHi( low, p );
+      r[0] = low * p;
+      r[1] = middle + high * p;
+      r[2] = mulHi( high, p ) + ( r[1] < middle );
+   }
+
+   // Zero histogram[bins].
+   static void clear( const cl::CommandQueue& queue,
+                      const cl::Buffer& histogram,
+                      const size_t bins ) {
+      queue.enqueueFillBuffer(
+         histogram, cl_uint( 0 ), 0, bins * sizeof( cl_uint ) );
+   }
+
+   // Launch kernel with enough work-groups for items, up to max_groups_;
+   // the kernel strides over the rest.
+   void enqueueGroups( const cl::CommandQueue& queue,
+                       const cl::Kernel& kernel,
+                       const size_t items ) const {
+      size_t groups = std::min( ( items + local_size_ - 1 ) / local_size_,
+                                max_groups_ );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( groups * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+   }
+
+   // Launch kernel with one work-item per pixel of an image of n pixels.
+   void enqueuePixels( const cl::CommandQueue& queue,
+                       const cl::Kernel& kernel,
+                       const size_t n ) const {
+      size_t groups = ( n + local_size_ - 1 ) / local_size_;
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( groups * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+   }
+
+   // Return the program built with options, compiling it on first use.
+   cl::Program& getProgram( const std::string& options ) {
+      auto found = programs_.find( options );
+      if( found != programs_.end() ) {
+         return found->second;
+      }
+
+      cl::Program::Sources sources{ source_ };
+      cl::Program program( context_, sources );
+      auto err = program.build( device_, options.c_str() );
+      if( err != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Status: "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device_ )
+                   << "\nBuild Options: " << options << "\nBuild Log:\t "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device_ )
+                   << std::endl;
+         exit( 1 );
+      }
+      return programs_.emplace( options, program ).first->second;
+   }
+
+   cl::Context context_;
+   cl::Device device_;
+   size_t max_copies_;
+   std::string source_;
+   std::map< std::string, cl::Program > programs_;
+   size_t local_size_;
+   size_t max_groups_;
+   size_t local_mem_size_;
+   cl::Buffer bins_;
+   cl::Buffer lut_;
+   cl::Buffer threshold_;
+};
+
+#endif
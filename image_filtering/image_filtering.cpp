@@ -13,10 +13,21 @@
 // Revert back to the previous state
 #pragma GCC diagnostic pop
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string.h>
+#include <thread>
 #include <time.h>
+#include <vector>
+
+#include "../compaction/compaction.hpp"
+#include "../device_fission/device_fission.hpp"
+#include "../histogram/histogram.hpp"
+#include "../reduction/reduction.hpp"
 
 #ifdef DBG
    #define IF_MES( tof, mes )      \
@@ -63,12 +74,26 @@ void seqFilter( unsigned int img_width,
                 float* hp_mask,
                 unsigned char* output_img );
 
-// Check if the images img1 and img2 are equal.
-bool checkEquality( const unsigned char* img1,
-                    const unsigned char* img2,
+// Sequentially equalize the histogram of an 8-bit image in place.
+void seqEqualize( unsigned char* img, const size_t n );
+
+// Sequentially binarize an 8-bit image in place with Otsu's threshold.
+void seqOtsu( unsigned char* img, const size_t n );
+
+// Check on the device if the images img1 and img2 are equal.
+bool checkEquality( const cl::Buffer& img1_buf,
+                    const cl::Buffer& img2_buf,
                     const unsigned int m,
                     const unsigned int n );
 
+// Sequentially extract the pixels of an image above a threshold.
+size_t seqExtractEdges( unsigned int img_width,
+                        unsigned int img_height,
+                        const unsigned char* img,
+                        unsigned char threshold,
+                        unsigned int* edge_indices,
+                        unsigned char* edge_values );
+
 // =================================================================
 // ------------------------ OpenCL Functions -----------------------
 // =================================================================
@@ -89,7 +114,72 @@ void parFilter( unsigned int img_width,
                 unsigned char* input_bchannel,
                 float* lp_mask,
                 float* hp_mask,
-                unsigned char* output_img );
+                unsigned char* output_img,
+                cl::Buffer* hp_output = nullptr );
+
+// A device of the multi-device filter, with its own context and program.
+struct FilterDevice {
+   cl::Device device;
+   cl::Context context;
+   cl::Program program;
+   double rows_per_ms = 0.0;   // Measured throughput of the device.
+};
+
+// Return every device of every platform, or the sub-devices of the default
+// device when sub_devices is set.
+std::vector< cl::Device > getAllDevices();
+
+// Inicialize every device of the multi-device filter and compile its code.
+void initializeFilterDevices();
+
+// Parallelly filter the rows [begin, end) of an image on a single device.
+void parFilterBand( const FilterDevice& filter_device,
+                    unsigned int img_width,
+                    unsigned int img_height,
+                    unsigned int begin,
+                    unsigned int end,
+                    unsigned int lp_mask_size,
+                    unsigned int hp_mask_size,
+                    unsigned char* input_rchannel,
+                    unsigned char* input_gchannel,
+                    unsigned char* input_bchannel,
+                    float* lp_mask,
+                    float* hp_mask,
+                    unsigned char* output_img );
+
+// Measure the rows filtered per millisecond by every filter device.
+void calibrateFilterDevices( unsigned int img_width,
+                             unsigned int img_height,
+                             unsigned int lp_mask_size,
+                             unsigned int hp_mask_size,
+                             unsigned char* input_rchannel,
+                             unsigned char* input_gchannel,
+                             unsigned char* input_bchannel,
+                             float* lp_mask,
+                             float* hp_mask,
+                             unsigned char* output_img );
+
+// Parallelly filter an image on every filter device at once.
+void parFilter( unsigned int img_width,
+                unsigned int img_height,
+                unsigned int lp_mask_size,
+                unsigned int hp_mask_size,
+                unsigned char* input_rchannel,
+                unsigned char* input_gchannel,
+                unsigned char* input_bchannel,
+                float* lp_mask,
+                float* hp_mask,
+                unsigned char* output_img,
+                std::vector< FilterDevice >& devices );
+
+// Parallelly extract the pixels of an image buffer above a threshold.
+size_t parExtractEdges( Compaction& compaction,
+                        unsigned int img_width,
+                        unsigned int img_height,
+                        const cl::Buffer& img_buf,
+                        unsigned char threshold,
+                        unsigned int* edge_indices,
+                        unsigned char* edge_values );
 
 // =================================================================
 // ------------------------ Global Variables ------------------------
@@ -99,11 +189,23 @@ cl::Program program;   // The program that will run on the device.
 cl::Context context;   // The context which holds the device.
 cl::Device device;     // The device where the kernel will run.
 
+bool equalize_stage = false;   // Equalize the grayscale image.
+bool otsu_stage = false;       // Binarize the high-pass output.
+std::unique_ptr< Histogram > histogram;   // The kernels of both stages.
+std::unique_ptr< Reduction > reduction;   // Compares the outputs.
+
+constexpr unsigned char EDGE_THRESHOLD = 128;   // Edge pixels are above it.
+
+bool multi_device = false;        // Also filter on every device at once.
+unsigned int sub_devices = 0;     // Split the default device in as many.
+std::vector< FilterDevice > filter_devices;   // The multi-device filter.
+constexpr unsigned int CALIBRATION_ROWS = 64;  // Rows of the calibration.
+
 // =================================================================
 // ------------------------- Main Function -------------------------
 // =================================================================
 
-int main() {
+int main( int argc, char** argv ) {
 
    /**
     * Create auxiliary variables.
@@ -111,6 +213,53 @@ int main() {
 
    clock_t start, end;
 
+   /**
+    * Enable the optional stages: --equalize equalizes the histogram of the
+    * grayscale image before the low-pass filter and --otsu binarizes the
+    * high-pass output with Otsu's threshold.
+    * */
+
+   bool valid = true;
+   for( int i = 1; i < argc && valid; i++ ) {
+      if( strcmp( argv[i], "--equalize" ) == 0 ) {
+         equalize_stage = true;
+      } else if( strcmp( argv[i], "--otsu" ) == 0 ) {
+         otsu_stage = true;
+      } else if( strcmp( argv[i], "--multi-device" ) == 0 ) {
+         multi_device = true;
+      } else if( strcmp( argv[i], "--sub-devices" ) == 0 && i + 1 < argc ) {
+         multi_device = true;
+         long count = 0;
+         try {
+            count = std::stol( argv[++i] );
+         } catch( const std::logic_error& ) {
+         }
+         valid = count >= 2;
+         sub_devices = static_cast< unsigned int >( count );
+      } else {
+         valid = false;
+      }
+   }
+   if( !valid ) {
+      std::cerr << "Usage: " << argv[0] << " [--equalize] [--otsu]"
+                << " [--multi-device] [--sub-devices n], n >= 2"
+                << std::endl;
+      return 1;
+   }
+
+   /**
+    * --multi-device also filters the image on every device at once, in row
+    * bands; --sub-devices n does it on n sub-devices of the default device
+    * instead, so it can be tried on a single CPU. The histogram of the
+    * optional stages spans the whole image, so they cannot be split.
+    * */
+
+   if( multi_device && ( equalize_stage || otsu_stage ) ) {
+      std::cerr << "The multi-device filter does not support --equalize and "
+                << "--otsu." << std::endl;
+      return 1;
+   }
+
    /**
     * Load input image.
     * */
@@ -207,9 +356,11 @@ int main() {
    initializeDevice();
 
    /**
-    * Parallelly convolve filter over image.
+    * Parallelly convolve filter over image, keeping the high-pass output
+    * on the device.
     * */
 
+   cl::Buffer hp_output_buf;
    start = clock();
    parFilter( img_width,
               img_height,
@@ -220,19 +371,79 @@ int main() {
               input_bchannel,
               lp_mask_data,
               hp_mask_data,
-              par_filtered_img );
+              par_filtered_img,
+              &hp_output_buf );
    end = clock();
    double par_time
       = ( 10e3 * static_cast< double >( end - start ) ) / CLOCKS_PER_SEC;
 
    /**
-    * Check if outputs are equal.
+    * Check if outputs are equal on the device, uploading only the
+    * sequential output.
     * */
 
-   bool equal = checkEquality( seq_filtered_img,
-                               par_filtered_img,
-                               img_width,
-                               img_height );
+   cl::Buffer seq_filtered_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+      img_width * img_height * sizeof( unsigned char ),
+      seq_filtered_img );
+   bool equal = checkEquality(
+      seq_filtered_buf, hp_output_buf, img_width, img_height );
+
+   /**
+    * Extract the edge pixels of the filtered image: sequentially from the
+    * image read back, and parallelly from the high-pass output still on
+    * the device, reading back only the edge pixels. The first parallel
+    * extraction compiles the programs, so it is not measured.
+    * */
+
+   unsigned int* seq_edge_indices = static_cast< unsigned int* >(
+      malloc( img_width * img_height * sizeof( unsigned int ) ) );
+   unsigned char* seq_edge_values = static_cast< unsigned char* >(
+      malloc( img_width * img_height * sizeof( unsigned char ) ) );
+   unsigned int* par_edge_indices = static_cast< unsigned int* >(
+      malloc( img_width * img_height * sizeof( unsigned int ) ) );
+   unsigned char* par_edge_values = static_cast< unsigned char* >(
+      malloc( img_width * img_height * sizeof( unsigned char ) ) );
+
+   start = clock();
+   size_t seq_edges = seqExtractEdges( img_width,
+                                       img_height,
+                                       par_filtered_img,
+                                       EDGE_THRESHOLD,
+                                       seq_edge_indices,
+                                       seq_edge_values );
+   end = clock();
+   double seq_edges_time
+      = ( 1e3 * static_cast< double >( end - start ) ) / CLOCKS_PER_SEC;
+
+   Compaction compaction( context, device );
+   parExtractEdges( compaction,
+                    img_width,
+                    img_height,
+                    hp_output_buf,
+                    EDGE_THRESHOLD,
+                    par_edge_indices,
+                    par_edge_values );
+   start = clock();
+   size_t par_edges = parExtractEdges( compaction,
+                                       img_width,
+                                       img_height,
+                                       hp_output_buf,
+                                       EDGE_THRESHOLD,
+                                       par_edge_indices,
+                                       par_edge_values );
+   end = clock();
+   double par_edges_time
+      = ( 1e3 * static_cast< double >( end - start ) ) / CLOCKS_PER_SEC;
+
+   bool edges_equal
+      = seq_edges == par_edges
+     && memcmp( seq_edge_indices,
+                par_edge_indices,
+                seq_edges * sizeof( unsigned int ) )
+           == 0
+     && memcmp( seq_edge_values, par_edge_values, seq_edges ) == 0;
 
    /**
     * Print results.
@@ -243,6 +454,85 @@ int main() {
              << " ms;\n\tParallel: " << par_time << " ms." << std::endl;
    std::cout << "Performance gain: "
              << ( 100 * ( seq_time - par_time ) / par_time ) << "\n";
+   std::cout << "Edge pixels above " << static_cast< int >( EDGE_THRESHOLD )
+             << ": " << par_edges
+             << "\n\tStatus: " << ( edges_equal ? "SUCCESS!" : "FAILED!" )
+             << "\n\tSequential, from the image read back: " << seq_edges_time
+             << " ms;\n\tParallel, on the device: " << par_edges_time
+             << " ms." << std::endl;
+
+   /**
+    * Filter the image on every device at once, and compare it with the
+    * filter on the default device. Both are timed with the wall clock,
+    * since clock() adds up the time of the threads of every device.
+    * */
+
+   if( multi_device ) {
+      initializeFilterDevices();
+      calibrateFilterDevices( img_width,
+                              img_height,
+                              lp_mask_size,
+                              hp_mask_size,
+                              input_rchannel,
+                              input_gchannel,
+                              input_bchannel,
+                              lp_mask_data,
+                              hp_mask_data,
+                              par_filtered_img );
+
+      auto wall_start = std::chrono::steady_clock::now();
+      parFilter( img_width,
+                 img_height,
+                 lp_mask_size,
+                 hp_mask_size,
+                 input_rchannel,
+                 input_gchannel,
+                 input_bchannel,
+                 lp_mask_data,
+                 hp_mask_data,
+                 par_filtered_img );
+      double single_time = std::chrono::duration< double, std::milli >(
+                              std::chrono::steady_clock::now() - wall_start )
+                              .count();
+
+      memset( par_filtered_img, 0, img_width * img_height );
+      wall_start = std::chrono::steady_clock::now();
+      parFilter( img_width,
+                 img_height,
+                 lp_mask_size,
+                 hp_mask_size,
+                 input_rchannel,
+                 input_gchannel,
+                 input_bchannel,
+                 lp_mask_data,
+                 hp_mask_data,
+                 par_filtered_img,
+                 filter_devices );
+      double multi_time = std::chrono::duration< double, std::milli >(
+                             std::chrono::steady_clock::now() - wall_start )
+                             .count();
+      cl::Buffer multi_filtered_buf(
+         context,
+         CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         img_width * img_height * sizeof( unsigned char ),
+         par_filtered_img );
+      bool multi_equal = checkEquality(
+         seq_filtered_buf, multi_filtered_buf, img_width, img_height );
+
+      std::cout << "Multi-device filter on " << filter_devices.size()
+                << " devices:";
+      for( const FilterDevice& filter_device : filter_devices ) {
+         std::cout << "\n\t"
+                   << filter_device.device.getInfo< CL_DEVICE_NAME >()
+                   << ": " << filter_device.rows_per_ms << " rows/ms";
+      }
+      std::cout << "\n\tStatus: " << ( multi_equal ? "SUCCESS!" : "FAILED!" )
+                << "\n\tSingle device: " << single_time
+                << " ms;\n\tMulti-device: " << multi_time << " ms."
+                << "\n\tPerformance gain: "
+                << ( 100 * ( single_time - multi_time ) / multi_time ) << "%"
+                << std::endl;
+   }
 
    /**
     * Display filtered image.
@@ -254,6 +544,10 @@ int main() {
 #endif
    free( seq_filtered_img );
    free( par_filtered_img );
+   free( seq_edge_indices );
+   free( seq_edge_values );
+   free( par_edge_indices );
+   free( par_edge_values );
    return 0;
 }
 
@@ -338,10 +632,22 @@ void initializeDevice() {
                 << std::endl;
       exit( 1 );
    }
+
+   /**
+    * Compile the histogram kernels of the optional stages, and the
+    * reduction which compares the outputs.
+    * */
+
+   if( equalize_stage || otsu_stage ) {
+      histogram = std::make_unique< Histogram >( context, device );
+   }
+   reduction = std::make_unique< Reduction >( context, device );
 }
 
 /**
- * Parallelly filter an image.
+ * Parallelly filter an image. When hp_output is not NULL, it receives the
+ * device buffer of the high-pass output, so further stages can use it
+ * without uploading the image again.
  */
 
 void parFilter( unsigned int img_width,
@@ -353,7 +659,8 @@ void parFilter( unsigned int img_width,
                 unsigned char* input_bchannel,
                 float* lp_mask,
                 float* hp_mask,
-                unsigned char* output_img ) {
+                unsigned char* output_img,
+                cl::Buffer* hp_output ) {
 
    /**
     * Create buffers and allocate memory on the device.
@@ -391,7 +698,7 @@ void parFilter( unsigned int img_width,
                              CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
                              img_width * img_height * sizeof( unsigned char ) );
    cl::Buffer hp_output_buf( context,
-                             CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                             CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY,
                              img_width * img_height * sizeof( unsigned char ) );
 
    /**
@@ -444,6 +751,12 @@ void parFilter( unsigned int img_width,
                                        cl::NullRange,
                                        cl::NDRange( img_width, img_height ) ),
            "gray_kernel not works." );
+   if( equalize_stage ) {
+      histogram->equalize( queue,
+                           gray_output_buf,
+                           gray_output_buf,
+                           img_width * img_height );
+   }
    IF_MES( queue.enqueueNDRangeKernel( lp_kernel,
                                        cl::NullRange,
                                        cl::NDRange( img_width, img_height ) ),
@@ -452,11 +765,390 @@ void parFilter( unsigned int img_width,
                                        cl::NullRange,
                                        cl::NDRange( img_width, img_height ) ),
            "hp_kernel not works" );
+   if( otsu_stage ) {
+      histogram->otsu(
+         queue, hp_output_buf, hp_output_buf, img_width * img_height );
+   }
    queue.enqueueReadBuffer( hp_output_buf,
                             CL_TRUE,
                             0,
                             img_width * img_height * sizeof( unsigned char ),
                             output_img );
+   if( hp_output ) {
+      *hp_output = hp_output_buf;
+   }
+}
+
+/**
+ * Return every device of every platform, so the multi-device filter uses
+ * all of them, e.g. PoCL's CPU device alongside another CPU driver. When
+ * sub_devices is set, return that many sub-devices of the default device
+ * instead.
+ * */
+
+std::vector< cl::Device > getAllDevices() {
+
+   /**
+    * Split the default device equally.
+    * */
+
+   if( sub_devices > 0 ) {
+      std::vector< cl::Device > devices = DeviceFission::partition(
+         getDefaultDevice(), DeviceFission::Mode::Equally, sub_devices );
+      if( devices.empty() ) {
+         std::cerr << "The default device cannot be split in " << sub_devices
+                   << " sub-devices!" << std::endl;
+         exit( 1 );
+      }
+      return devices;
+   }
+
+   /**
+    * Search for all the OpenCL platforms available and collect the devices
+    * of every one of them.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   std::vector< cl::Device > all_devices;
+   for( const cl::Platform& platform : platforms ) {
+      std::vector< cl::Device > devices;
+      platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+      all_devices.insert( all_devices.end(), devices.begin(), devices.end() );
+   }
+
+   if( all_devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+   return all_devices;
+}
+
+/**
+ * Inicialize every device of the multi-device filter: each one gets a
+ * context and a program of its own, since the devices may belong to
+ * different platforms.
+ * */
+
+void initializeFilterDevices() {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "image_filtering.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+   cl::Program::Sources sources{ src };
+
+   /**
+    * Compile kernel program for every device.
+    * */
+
+   for( const cl::Device& filter_device : getAllDevices() ) {
+      FilterDevice entry;
+      entry.device = filter_device;
+      entry.context = cl::Context( filter_device );
+      entry.program = cl::Program( entry.context, sources );
+
+      auto err = entry.program.build();
+      if( err != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Status: "
+                   << entry.program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >(
+                         filter_device )
+                   << "\nBuild Log:\t "
+                   << entry.program.getBuildInfo< CL_PROGRAM_BUILD_LOG >(
+                         filter_device )
+                   << std::endl;
+         exit( 1 );
+      }
+      filter_devices.push_back( entry );
+   }
+}
+
+/**
+ * Parallelly filter the rows [begin, end) of an image on filter_device.
+ * The band is extended by the halo rows both filters need, lp_mask_size / 2
+ * and hp_mask_size / 2, and filtered as an image of its own: the kernels
+ * blank the border rows of the band, which are real borders only at the
+ * top and the bottom of the image, so only the rows [begin, end) are read
+ * back into output_img.
+ * */
+
+void parFilterBand( const FilterDevice& filter_device,
+                    unsigned int img_width,
+                    unsigned int img_height,
+                    unsigned int begin,
+                    unsigned int end,
+                    unsigned int lp_mask_size,
+                    unsigned int hp_mask_size,
+                    unsigned char* input_rchannel,
+                    unsigned char* input_gchannel,
+                    unsigned char* input_bchannel,
+                    float* lp_mask,
+                    float* hp_mask,
+                    unsigned char* output_img ) {
+
+   /**
+    * Find the band with its halo rows.
+    * */
+
+   unsigned int halo = lp_mask_size / 2 + hp_mask_size / 2;
+   unsigned int band_begin = begin < halo ? 0 : begin - halo;
+   unsigned int band_end = std::min( img_height, end + halo );
+   size_t band_offset = static_cast< size_t >( band_begin ) * img_width;
+   size_t band_size
+      = static_cast< size_t >( band_end - band_begin ) * img_width;
+   const cl::Context& band_context = filter_device.context;
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer input_rchannel_buf(
+      band_context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      band_size * sizeof( unsigned char ),
+      &input_rchannel[band_offset] );
+   cl::Buffer input_gchannel_buf(
+      band_context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      band_size * sizeof( unsigned char ),
+      &input_gchannel[band_offset] );
+   cl::Buffer input_bchannel_buf(
+      band_context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      band_size * sizeof( unsigned char ),
+      &input_bchannel[band_offset] );
+   cl::Buffer gray_output_buf( band_context,
+                               CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                               band_size * sizeof( unsigned char ) );
+   cl::Buffer lp_mask_buf(
+      band_context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      lp_mask_size * lp_mask_size * sizeof( float ),
+      lp_mask );
+   cl::Buffer hp_mask_buf(
+      band_context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      hp_mask_size * hp_mask_size * sizeof( float ),
+      hp_mask );
+   cl::Buffer lp_output_buf( band_context,
+                             CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                             band_size * sizeof( unsigned char ) );
+   cl::Buffer hp_output_buf( band_context,
+                             CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY,
+                             band_size * sizeof( unsigned char ) );
+
+   /**
+    * Initialize the kernels of the three stages.
+    * */
+
+   cl::Kernel gray_kernel( filter_device.program, "rgb2gray" );
+   gray_kernel.setArg( 0, input_rchannel_buf );
+   gray_kernel.setArg( 1, input_gchannel_buf );
+   gray_kernel.setArg( 2, input_bchannel_buf );
+   gray_kernel.setArg( 3, gray_output_buf );
+
+   cl::Kernel lp_kernel( filter_device.program, "filterImage" );
+   lp_kernel.setArg( 0, sizeof( unsigned int ), &lp_mask_size );
+   lp_kernel.setArg( 1, gray_output_buf );
+   lp_kernel.setArg( 2, lp_mask_buf );
+   lp_kernel.setArg( 3, lp_output_buf );
+
+   cl::Kernel hp_kernel( filter_device.program, "filterImage" );
+   hp_kernel.setArg( 0, sizeof( unsigned int ), &hp_mask_size );
+   hp_kernel.setArg( 1, lp_output_buf );
+   hp_kernel.setArg( 2, hp_mask_buf );
+   hp_kernel.setArg( 3, hp_output_buf );
+
+   /**
+    * Execute kernel functions and collect the rows of the band.
+    * */
+
+   cl::NDRange global( img_width, band_end - band_begin );
+   cl::CommandQueue queue( band_context, filter_device.device );
+   queue.enqueueNDRangeKernel( gray_kernel, cl::NullRange, global );
+   queue.enqueueNDRangeKernel( lp_kernel, cl::NullRange, global );
+   queue.enqueueNDRangeKernel( hp_kernel, cl::NullRange, global );
+   queue.enqueueReadBuffer(
+      hp_output_buf,
+      CL_TRUE,
+      static_cast< size_t >( begin - band_begin ) * img_width,
+      static_cast< size_t >( end - begin ) * img_width,
+      &output_img[static_cast< size_t >( begin ) * img_width] );
+}
+
+/**
+ * Measure the rows filtered per millisecond by every filter device: each
+ * one filters the first CALIBRATION_ROWS rows alone, once to warm it up and
+ * once measured.
+ * */
+
+void calibrateFilterDevices( unsigned int img_width,
+                             unsigned int img_height,
+                             unsigned int lp_mask_size,
+                             unsigned int hp_mask_size,
+                             unsigned char* input_rchannel,
+                             unsigned char* input_gchannel,
+                             unsigned char* input_bchannel,
+                             float* lp_mask,
+                             float* hp_mask,
+                             unsigned char* output_img ) {
+   unsigned int rows = std::min( CALIBRATION_ROWS, img_height );
+   for( FilterDevice& filter_device : filter_devices ) {
+      double time = 0.0;
+      for( int run = 0; run < 2; run++ ) {
+         auto start = std::chrono::steady_clock::now();
+         parFilterBand( filter_device,
+                        img_width,
+                        img_height,
+                        0,
+                        rows,
+                        lp_mask_size,
+                        hp_mask_size,
+                        input_rchannel,
+                        input_gchannel,
+                        input_bchannel,
+                        lp_mask,
+                        hp_mask,
+                        output_img );
+         time = std::chrono::duration< double, std::milli >(
+                   std::chrono::steady_clock::now() - start )
+                   .count();
+      }
+      filter_device.rows_per_ms = rows / std::max( time, 1e-3 );
+   }
+}
+
+/**
+ * Parallelly filter an image on every device of devices at once. The image
+ * is split in row bands sized by the measured throughput of every device,
+ * each band is filtered by parFilterBand from a host thread of its own, and
+ * the rows of every band are read straight into output_img.
+ * */
+
+void parFilter( unsigned int img_width,
+                unsigned int img_height,
+                unsigned int lp_mask_size,
+                unsigned int hp_mask_size,
+                unsigned char* input_rchannel,
+                unsigned char* input_gchannel,
+                unsigned char* input_bchannel,
+                float* lp_mask,
+                float* hp_mask,
+                unsigned char* output_img,
+                std::vector< FilterDevice >& devices ) {
+
+   /**
+    * Size the bands by throughput; the last one takes the rows left.
+    * */
+
+   double total = 0.0;
+   for( const FilterDevice& filter_device : devices ) {
+      total += filter_device.rows_per_ms > 0.0 ? filter_device.rows_per_ms
+                                               : 1.0;
+   }
+
+   std::vector< std::thread > threads;
+   unsigned int begin = 0;
+   for( size_t d = 0; d < devices.size() && begin < img_height; d++ ) {
+      double rate = devices[d].rows_per_ms > 0.0 ? devices[d].rows_per_ms
+                                                 : 1.0;
+      unsigned int end
+         = d + 1 == devices.size()
+              ? img_height
+              : std::min( img_height,
+                          begin
+                             + static_cast< unsigned int >(
+                                img_height * rate / total + 0.5 ) );
+      if( end == begin ) {
+         continue;
+      }
+
+      /**
+       * Filter the band on its device.
+       * */
+
+      threads.emplace_back( parFilterBand,
+                            std::cref( devices[d] ),
+                            img_width,
+                            img_height,
+                            begin,
+                            end,
+                            lp_mask_size,
+                            hp_mask_size,
+                            input_rchannel,
+                            input_gchannel,
+                            input_bchannel,
+                            lp_mask,
+                            hp_mask,
+                            output_img );
+      begin = end;
+   }
+
+   /**
+    * Gather the bands.
+    * */
+
+   for( std::thread& thread : threads ) {
+      thread.join();
+   }
+}
+
+/**
+ * Parallelly extract the pixels of an image buffer above threshold: their
+ * positions and values are packed on the device and only they are read
+ * back. Return the number of edge pixels.
+ */
+
+size_t parExtractEdges( Compaction& compaction,
+                        unsigned int img_width,
+                        unsigned int img_height,
+                        const cl::Buffer& img_buf,
+                        unsigned char threshold,
+                        unsigned int* edge_indices,
+                        unsigned char* edge_values ) {
+
+   /**
+    * Create the packed buffers, large enough for every pixel.
+    * */
+
+   size_t n = img_width * img_height;
+   cl::Buffer indices_buf( context,
+                           CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                           n * sizeof( unsigned int ) );
+   cl::Buffer values_buf( context,
+                          CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                          n * sizeof( unsigned char ) );
+
+   /**
+    * Pack the edge pixels and read back only them.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   size_t count = compaction.copyIf< unsigned char >(
+      queue,
+      img_buf,
+      n,
+      Compaction::Predicate::Greater,
+      threshold,
+      values_buf,
+      indices_buf );
+   if( count > 0 ) {
+      queue.enqueueReadBuffer( indices_buf,
+                               CL_FALSE,
+                               0,
+                               count * sizeof( unsigned int ),
+                               edge_indices );
+      queue.enqueueReadBuffer( values_buf,
+                               CL_TRUE,
+                               0,
+                               count * sizeof( unsigned char ),
+                               edge_values );
+   }
+   return count;
 }
 
 // =================================================================
@@ -588,6 +1280,9 @@ void seqFilter( unsigned int img_width,
                 input_gchannel,
                 input_bchannel,
                 gray_out );
+   if( equalize_stage ) {
+      seqEqualize( gray_out, img_width * img_height );
+   }
 
    /**
     * Apply the low-pass filter.
@@ -612,18 +1307,127 @@ void seqFilter( unsigned int img_width,
                 lp_out,
                 hp_mask,
                 output_img );
+   if( otsu_stage ) {
+      seqOtsu( output_img, img_width * img_height );
+   }
+}
+
+/**
+ * Sequentially equalize the histogram of an 8-bit image in place, with the
+ * same rounding as the equalizationLut kernel.
+ */
+
+void seqEqualize( unsigned char* img, const size_t n ) {
+
+   /**
+    * Count the pixels and find the count of the smallest value present.
+    */
+
+   unsigned int bins[Histogram::BINS_8BIT] = {};
+   for( size_t i = 0; i < n; i++ ) {
+      bins[img[i]]++;
+   }
+   unsigned long long cdf_min = 0;
+   for( size_t i = 0; i < Histogram::BINS_8BIT && cdf_min == 0; i++ ) {
+      cdf_min = bins[i];
+   }
+
+   /**
+    * Map every pixel through the cumulative histogram.
+    */
+
+   unsigned char lut[Histogram::BINS_8BIT];
+   unsigned long long cdf = 0;
+   for( size_t i = 0; i < Histogram::BINS_8BIT; i++ ) {
+      cdf += bins[i];
+      if( cdf_min == n ) {
+         lut[i] = static_cast< unsigned char >( i );
+      } else if( cdf < cdf_min ) {
+         lut[i] = 0;
+      } else {
+         unsigned long long range = n - cdf_min;
+         lut[i] = static_cast< unsigned char >(
+            ( ( cdf - cdf_min ) * 255 + range / 2 ) / range );
+      }
+   }
+   for( size_t i = 0; i < n; i++ ) {
+      img[i] = lut[img[i]];
+   }
 }
 
 /**
- * Check if the images img1 and img2 are equal.
+ * Sequentially binarize an 8-bit image in place with Otsu's threshold. The
+ * variances are compared exactly in integers, as the otsuThreshold kernel
+ * does, so both find the same threshold.
+ */
+
+void seqOtsu( unsigned char* img, const size_t n ) {
+
+   /**
+    * Count the pixels and sum their values.
+    */
+
+   unsigned int bins[Histogram::BINS_8BIT] = {};
+   for( size_t i = 0; i < n; i++ ) {
+      bins[img[i]]++;
+   }
+   unsigned long long total_sum = 0;
+   for( size_t i = 0; i < Histogram::BINS_8BIT; i++ ) {
+      total_sum += i * bins[i];
+   }
+
+   /**
+    * Find the threshold of largest variance between both classes.
+    */
+
+   unsigned int best = 0;
+   bool found = false;
+   cl_ulong best_difference = 0;
+   cl_ulong best_weights = 1;
+   unsigned int weight = 0;
+   unsigned long long sum = 0;
+   for( unsigned int t = 0; t < Histogram::BINS_8BIT; t++ ) {
+      weight += bins[t];
+      sum += static_cast< unsigned long long >( t ) * bins[t];
+      if( weight == 0 || weight == n ) {
+         continue;
+      }
+      cl_ulong lower = static_cast< cl_ulong >( n ) * sum;
+      cl_ulong upper = total_sum * weight;
+      cl_ulong difference = lower > upper ? lower - upper : upper - lower;
+      cl_ulong weights = static_cast< cl_ulong >( weight ) * ( n - weight );
+      if( !found
+          || Histogram::isLargerVariance(
+             difference, weights, best_difference, best_weights ) ) {
+         found = true;
+         best_difference = difference;
+         best_weights = weights;
+         best = t;
+      }
+   }
+
+   for( size_t i = 0; i < n; i++ ) {
+      img[i] = img[i] > best ? 255 : 0;
+   }
+}
+
+/**
+ * Check on the device if the images img1 and img2 are equal, by counting
+ * their different pixels with a parallel reduction.
  * */
 
-bool checkEquality( const unsigned char* img1,
-                    const unsigned char* img2,
+bool checkEquality( const cl::Buffer& img1_buf,
+                    const cl::Buffer& img2_buf,
                     const unsigned int m,
                     const unsigned int n ) {
+   cl::CommandQueue queue( context, device );
 
 #ifdef DBG
+   std::vector< unsigned char > img1( m * n );
+   std::vector< unsigned char > img2( m * n );
+   queue.enqueueReadBuffer( img1_buf, CL_TRUE, 0, m * n, img1.data() );
+   queue.enqueueReadBuffer( img2_buf, CL_TRUE, 0, m * n, img2.data() );
+
    std::ofstream file1( "res_img1.txt" );
    if( file1.is_open() ) {
       for( unsigned int i = 0; i < m; i++ ) {
@@ -649,12 +1453,37 @@ bool checkEquality( const unsigned char* img1,
    };
 #endif
 
-   for( unsigned int i = 0; i < m * n; i++ ) {
-      if( img1[i] != img2[i] ) {
-         return false;
+   /**
+    * Count the different pixels.
+    * */
+
+   return reduction->countDifferences< unsigned char >( queue,
+                                                        img1_buf,
+                                                        img2_buf,
+                                                        m * n )
+       == 0;
+}
+
+/**
+ * Sequentially extract the pixels of an image above threshold, storing
+ * their positions in edge_indices and their values in edge_values. Return
+ * the number of edge pixels.
+ */
+
+size_t seqExtractEdges( unsigned int img_width,
+                        unsigned int img_height,
+                        const unsigned char* img,
+                        unsigned char threshold,
+                        unsigned int* edge_indices,
+                        unsigned char* edge_values ) {
+   size_t count = 0;
+   for( unsigned int i = 0; i < img_width * img_height; i++ ) {
+      if( img[i] > threshold ) {
+         edge_indices[count] = i;
+         edge_values[count++] = img[i];
       }
    }
-   return true;
+   return count;
 }
 
 void convertInterleavedToPlanar( const unsigned char* inter_img,
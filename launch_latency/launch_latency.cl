@@ -0,0 +1,35 @@
+/**
+ * This kernel function does nothing; it measures the fixed cost of a
+ * launch.
+ */
+
+__kernel void empty() {}
+
+/**
+ * This kernel function only fills a buffer with the sentence 'Hello World!'.
+ */
+
+__kernel void helloWorld( __global char* data ) {
+   data[0] = 'H';
+   data[1] = 'e';
+   data[2] = 'l';
+   data[3] = 'l';
+   data[4] = 'o';
+   data[5] = ' ';
+   data[6] = 'W';
+   data[7] = 'o';
+   data[8] = 'r';
+   data[9] = 'l';
+   data[10] = 'd';
+   data[11] = '!';
+   data[12] = '\n';
+}
+
+/**
+ * This kernel function adds one to every element of data.
+ */
+
+__kernel void add_one( __global int* data ) {
+   int i = get_global_id( 0 );
+   data[i] += 1;
+}
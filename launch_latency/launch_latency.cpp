@@ -0,0 +1,614 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Initialize device, queue, kernels and their buffers.
+void initializeDevice();
+// Enqueue add_one over the data buffer and count the launch.
+void enqueueAddOne( cl::Event* event = nullptr );
+// Write the round-trip latency of the trivial kernels as JSON.
+void measureRoundTrip( std::ostream& json );
+// Write the sustained enqueue rates as JSON.
+void measureEnqueueRate( std::ostream& json );
+// Write the cost of clFinish and clWaitForEvents as JSON.
+void measureSyncCost( std::ostream& json );
+// Write the latency of completion callbacks as JSON.
+void measureCallbackLatency( std::ostream& json );
+// Write the cost of mapping and unmapping buffers of every size as JSON.
+void measureMapUnmap( std::ostream& json );
+// Run function once to warm up, then samples times, and return the
+// microseconds taken by each run.
+template< typename Function >
+std::vector< double > sampleTimes( const int samples, Function function );
+// Return the mean, median, minimum and 99th percentile of samples as a JSON
+// object.
+std::string jsonStats( std::vector< double > samples );
+// Return text as a JSON string.
+std::string jsonString( const std::string& text );
+// Record the completion time of a command.
+void CL_CALLBACK onComplete( cl_event event, cl_int status, void* user_data );
+// Return the microseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;        // The program that will run on the device.
+cl::Context context;        // The context which holds the device.
+cl::Device device;          // The device where the kernel will run.
+cl::CommandQueue queue;     // The in-order queue of every measure.
+cl::Kernel empty_kernel;    // The kernel which does nothing.
+cl::Kernel hello_kernel;    // The kernel which writes 'Hello World!'.
+cl::Kernel add_one_kernel;  // The kernel which adds one to data_buf.
+cl::Buffer hello_buf;       // The output of hello_kernel.
+cl::Buffer data_buf;        // The data of add_one_kernel.
+int add_one_launches = 0;   // The number of add_one launches enqueued.
+
+// Runs of every latency measure.
+constexpr int SAMPLES = 1000;
+// Commands of every enqueue rate measure.
+constexpr int ENQUEUES = 10000;
+// Elements of data_buf: trivial, but more than a single work-group.
+constexpr size_t ADD_ONE_SIZE = 1024;
+// Mapped sizes go from MIN_MAP_SIZE to MAX_MAP_SIZE bytes, multiplied by 4.
+constexpr size_t MIN_MAP_SIZE = 4 << 10;
+constexpr size_t MAX_MAP_SIZE = 64 << 20;
+// Runs of every map measure; sizes above MAP_SAMPLES_LIMIT use fewer.
+constexpr int MAP_SAMPLES = 100;
+constexpr size_t MAP_SAMPLES_LIMIT = 1 << 20;
+
+// The completion time of a command, set by onComplete.
+struct CallbackState {
+   std::atomic< bool > done{ false };
+   std::chrono::steady_clock::time_point time;
+};
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Initialize the device and describe it; the results are only
+    * meaningful next to the device and driver they were measured on.
+    * */
+
+   initializeDevice();
+   cl::Platform platform( device.getInfo< CL_DEVICE_PLATFORM >() );
+
+   std::ostringstream json;
+   json << std::fixed << std::setprecision( 3 ) << "{\n";
+   json << "   \"platform\": "
+        << jsonString( platform.getInfo< CL_PLATFORM_NAME >() ) << ",\n";
+   json << "   \"device\": "
+        << jsonString( device.getInfo< CL_DEVICE_NAME >() ) << ",\n";
+   json << "   \"driver\": "
+        << jsonString( device.getInfo< CL_DRIVER_VERSION >() ) << ",\n";
+
+   /**
+    * Measure the fixed costs.
+    * */
+
+   measureRoundTrip( json );
+   measureEnqueueRate( json );
+   measureSyncCost( json );
+   measureCallbackLatency( json );
+   measureMapUnmap( json );
+
+   /**
+    * Check that every add_one launch ran exactly once.
+    * */
+
+   std::vector< int > data( ADD_ONE_SIZE );
+   queue.enqueueReadBuffer(
+      data_buf, CL_TRUE, 0, ADD_ONE_SIZE * sizeof( int ), data.data() );
+   bool equal = std::all_of( data.begin(), data.end(), []( const int value ) {
+      return value == add_one_launches;
+   } );
+
+   /**
+    * Print results.
+    * */
+
+   json << "   \"status\": " << jsonString( equal ? "SUCCESS" : "FAILED" )
+        << "\n}\n";
+   std::cout << json.str();
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Initialize device, queue, kernels and their buffers.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device.
+    * */
+
+   device = getDefaultDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "launch_latency.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Create the queue, the kernels and their buffers once, so that the
+    * measures only see the launches.
+    * */
+
+   queue = cl::CommandQueue( context, device );
+   hello_buf = cl::Buffer( context, CL_MEM_WRITE_ONLY, 16 * sizeof( char ) );
+   data_buf
+      = cl::Buffer( context, CL_MEM_READ_WRITE, ADD_ONE_SIZE * sizeof( int ) );
+   queue.enqueueFillBuffer( data_buf, 0, 0, ADD_ONE_SIZE * sizeof( int ) );
+   queue.finish();
+
+   empty_kernel = cl::Kernel( program, "empty" );
+   hello_kernel = cl::Kernel( program, "helloWorld" );
+   hello_kernel.setArg( 0, hello_buf );
+   add_one_kernel = cl::Kernel( program, "add_one" );
+   add_one_kernel.setArg( 0, data_buf );
+}
+
+/**
+ * Enqueue add_one over the data buffer and count the launch, so that main
+ * can check how many times every element was incremented.
+ * */
+
+void enqueueAddOne( cl::Event* event ) {
+   queue.enqueueNDRangeKernel( add_one_kernel,
+                               cl::NullRange,
+                               cl::NDRange( ADD_ONE_SIZE ),
+                               cl::NullRange,
+                               nullptr,
+                               event );
+   add_one_launches++;
+}
+
+/**
+ * Write the round-trip latency of the trivial kernels as JSON: the time
+ * from enqueueing a single kernel on an idle queue until clFinish returns.
+ * It is the least time any launch which the host waits for can take.
+ * */
+
+void measureRoundTrip( std::ostream& json ) {
+   json << "   \"round_trip_us\": {\n";
+
+   json << "      \"empty\": " << jsonStats( sampleTimes( SAMPLES, [] {
+              queue.enqueueNDRangeKernel(
+                 empty_kernel, cl::NullRange, cl::NDRange( 1 ) );
+              queue.finish();
+           } ) )
+        << ",\n";
+
+   json << "      \"hello_world\": " << jsonStats( sampleTimes( SAMPLES, [] {
+              queue.enqueueNDRangeKernel(
+                 hello_kernel, cl::NullRange, cl::NDRange( 1 ) );
+              queue.finish();
+           } ) )
+        << ",\n";
+
+   json << "      \"add_one\": " << jsonStats( sampleTimes( SAMPLES, [] {
+              enqueueAddOne();
+              queue.finish();
+           } ) )
+        << "\n";
+
+   json << "   },\n";
+}
+
+/**
+ * Write the sustained enqueue rates as JSON, in commands per second:
+ *    - non-blocking: ENQUEUES commands are enqueued back to back and then
+ *      waited for at once; "enqueue" counts only the time spent in the
+ *      enqueue calls and "complete" the time until all of them finish;
+ *    - blocking: every command is waited for before enqueueing the next
+ *      one, a kernel through its event and a write through a blocking
+ *      call.
+ * The writes copy a single int, so they measure the transfer overhead.
+ * */
+
+void measureEnqueueRate( std::ostream& json ) {
+   int value = 0;
+   queue.finish();
+
+   /**
+    * Enqueue kernels without waiting.
+    * */
+
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < ENQUEUES; i++ ) {
+      enqueueAddOne();
+   }
+   double kernel_enqueue_time = getElapsedTime( start );
+   queue.finish();
+   double kernel_complete_time = getElapsedTime( start );
+
+   /**
+    * Enqueue kernels waiting for each one.
+    * */
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < ENQUEUES; i++ ) {
+      cl::Event event;
+      enqueueAddOne( &event );
+      event.wait();
+   }
+   double kernel_blocking_time = getElapsedTime( start );
+
+   /**
+    * Enqueue writes without waiting, then waiting for each one.
+    * */
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < ENQUEUES; i++ ) {
+      queue.enqueueWriteBuffer( hello_buf, CL_FALSE, 0, sizeof( int ), &value );
+   }
+   double write_enqueue_time = getElapsedTime( start );
+   queue.finish();
+   double write_complete_time = getElapsedTime( start );
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < ENQUEUES; i++ ) {
+      queue.enqueueWriteBuffer( hello_buf, CL_TRUE, 0, sizeof( int ), &value );
+   }
+   double write_blocking_time = getElapsedTime( start );
+
+   /**
+    * Convert the times to rates.
+    * */
+
+   auto rate = []( const double time ) { return ENQUEUES / time * 1e6; };
+   json << "   \"enqueue_rate_per_s\": {\n"
+        << "      \"kernel_non_blocking_enqueue\": "
+        << rate( kernel_enqueue_time ) << ",\n"
+        << "      \"kernel_non_blocking_complete\": "
+        << rate( kernel_complete_time ) << ",\n"
+        << "      \"kernel_blocking\": " << rate( kernel_blocking_time )
+        << ",\n"
+        << "      \"write_non_blocking_enqueue\": "
+        << rate( write_enqueue_time ) << ",\n"
+        << "      \"write_non_blocking_complete\": "
+        << rate( write_complete_time ) << ",\n"
+        << "      \"write_blocking\": " << rate( write_blocking_time ) << "\n"
+        << "   },\n";
+}
+
+/**
+ * Write the cost of clFinish and clWaitForEvents as JSON:
+ *    - on an idle queue and on an event already complete, which is the
+ *      price of a synchronization that turns out to be unnecessary;
+ *    - right after enqueueing the empty kernel, which compares waiting for
+ *      the whole queue with waiting for a single event.
+ * */
+
+void measureSyncCost( std::ostream& json ) {
+   json << "   \"sync_cost_us\": {\n";
+
+   queue.finish();
+   json << "      \"finish_idle\": "
+        << jsonStats( sampleTimes( SAMPLES, [] { queue.finish(); } ) )
+        << ",\n";
+
+   cl::Event complete;
+   queue.enqueueNDRangeKernel( empty_kernel,
+                               cl::NullRange,
+                               cl::NDRange( 1 ),
+                               cl::NullRange,
+                               nullptr,
+                               &complete );
+   complete.wait();
+   json << "      \"wait_complete_event\": "
+        << jsonStats( sampleTimes(
+              SAMPLES, [&] { cl::Event::waitForEvents( { complete } ); } ) )
+        << ",\n";
+
+   json << "      \"finish_after_kernel\": "
+        << jsonStats( sampleTimes( SAMPLES, [] {
+              queue.enqueueNDRangeKernel(
+                 empty_kernel, cl::NullRange, cl::NDRange( 1 ) );
+              queue.finish();
+           } ) )
+        << ",\n";
+
+   json << "      \"wait_after_kernel\": "
+        << jsonStats( sampleTimes( SAMPLES, [] {
+              cl::Event event;
+              queue.enqueueNDRangeKernel( empty_kernel,
+                                          cl::NullRange,
+                                          cl::NDRange( 1 ),
+                                          cl::NullRange,
+                                          nullptr,
+                                          &event );
+              cl::Event::waitForEvents( { event } );
+           } ) )
+        << "\n";
+
+   json << "   },\n";
+}
+
+/**
+ * Write the latency of completion callbacks as JSON:
+ *    - user_event: from setting a user event complete until its callback
+ *      runs, which is the dispatch cost of the runtime alone;
+ *    - kernel: from enqueueing the empty kernel until its callback runs,
+ *      to compare with its round trip through clFinish.
+ * The host spins on the flag set by the callback, so it sees it as soon
+ * as possible.
+ * */
+
+void measureCallbackLatency( std::ostream& json ) {
+   std::vector< double > user_event_times;
+   std::vector< double > kernel_times;
+   for( int i = 0; i <= SAMPLES; i++ ) {
+
+      /**
+       * Complete a user event.
+       * */
+
+      CallbackState user_state;
+      cl::UserEvent user_event( context );
+      user_event.setCallback( CL_COMPLETE, onComplete, &user_state );
+      auto start = std::chrono::steady_clock::now();
+      user_event.setStatus( CL_COMPLETE );
+      while( !user_state.done.load( std::memory_order_acquire ) ) {
+      }
+      double user_event_time = std::chrono::duration< double, std::micro >(
+                                  user_state.time - start )
+                                  .count();
+
+      /**
+       * Complete a kernel; the queue must be flushed, or the kernel may
+       * never be submitted.
+       * */
+
+      CallbackState kernel_state;
+      cl::Event event;
+      start = std::chrono::steady_clock::now();
+      queue.enqueueNDRangeKernel( empty_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( 1 ),
+                                  cl::NullRange,
+                                  nullptr,
+                                  &event );
+      event.setCallback( CL_COMPLETE, onComplete, &kernel_state );
+      queue.flush();
+      while( !kernel_state.done.load( std::memory_order_acquire ) ) {
+      }
+      double kernel_time = std::chrono::duration< double, std::micro >(
+                              kernel_state.time - start )
+                              .count();
+
+      // The first run warms up the callback thread of the runtime.
+      if( i > 0 ) {
+         user_event_times.push_back( user_event_time );
+         kernel_times.push_back( kernel_time );
+      }
+   }
+
+   json << "   \"callback_latency_us\": {\n"
+        << "      \"user_event\": " << jsonStats( user_event_times ) << ",\n"
+        << "      \"kernel\": " << jsonStats( kernel_times ) << "\n"
+        << "   },\n";
+}
+
+/**
+ * Write the cost of mapping and unmapping buffers from MIN_MAP_SIZE to
+ * MAX_MAP_SIZE bytes as JSON. Every size is mapped for reading, which must
+ * make the device data visible to the host, and for writing with
+ * CL_MAP_WRITE_INVALIDATE_REGION, which need not; the blocking map and the
+ * unmap until it completes are measured separately, since either may carry
+ * the copy.
+ * */
+
+void measureMapUnmap( std::ostream& json ) {
+   json << "   \"map_unmap_us\": [\n";
+   for( size_t size = MIN_MAP_SIZE; size <= MAX_MAP_SIZE; size *= 4 ) {
+      cl::Buffer buffer( context, CL_MEM_READ_WRITE, size );
+      queue.enqueueFillBuffer( buffer, cl_uchar( 1 ), 0, size );
+      queue.finish();
+      int samples
+         = size <= MAP_SAMPLES_LIMIT ? MAP_SAMPLES : MAP_SAMPLES / 10;
+
+      std::vector< double > times[4];
+      cl_map_flags flags[2] = { CL_MAP_READ, CL_MAP_WRITE_INVALIDATE_REGION };
+      for( int i = 0; i <= samples; i++ ) {
+         for( int f = 0; f < 2; f++ ) {
+            auto start = std::chrono::steady_clock::now();
+            void* ptr
+               = queue.enqueueMapBuffer( buffer, CL_TRUE, flags[f], 0, size );
+            double map_time = getElapsedTime( start );
+
+            // Touch the memory, so that lazy mappings are resolved.
+            static_cast< volatile cl_uchar* >( ptr )[size - 1]
+               = static_cast< volatile cl_uchar* >( ptr )[0];
+
+            start = std::chrono::steady_clock::now();
+            queue.enqueueUnmapMemObject( buffer, ptr );
+            queue.finish();
+            double unmap_time = getElapsedTime( start );
+
+            // The first run maps the buffer for the first time.
+            if( i > 0 ) {
+               times[2 * f].push_back( map_time );
+               times[2 * f + 1].push_back( unmap_time );
+            }
+         }
+      }
+
+      json << "      {\n"
+           << "         \"bytes\": " << size << ",\n"
+           << "         \"map_read\": " << jsonStats( times[0] ) << ",\n"
+           << "         \"unmap_read\": " << jsonStats( times[1] ) << ",\n"
+           << "         \"map_write\": " << jsonStats( times[2] ) << ",\n"
+           << "         \"unmap_write\": " << jsonStats( times[3] ) << "\n"
+           << "      }" << ( size * 4 <= MAX_MAP_SIZE ? "," : "" ) << "\n";
+   }
+   json << "   ],\n";
+}
+
+/**
+ * Run function once to warm up, then samples times, and return the
+ * microseconds taken by each run.
+ * */
+
+template< typename Function >
+std::vector< double > sampleTimes( const int samples, Function function ) {
+   function();
+   std::vector< double > times( samples );
+   for( int i = 0; i < samples; i++ ) {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      times[i] = getElapsedTime( start );
+   }
+   return times;
+}
+
+/**
+ * Return the mean, median, minimum and 99th percentile of samples as a JSON
+ * object. The median and the minimum are steadier than the mean, which
+ * suffers from the occasional preemption of the host thread.
+ * */
+
+std::string jsonStats( std::vector< double > samples ) {
+   std::sort( samples.begin(), samples.end() );
+   size_t n = samples.size();
+   double mean = std::accumulate( samples.begin(), samples.end(), 0.0 ) / n;
+
+   std::ostringstream json;
+   json << std::fixed << std::setprecision( 3 ) << "{ \"mean\": " << mean
+        << ", \"median\": " << samples[n / 2] << ", \"min\": " << samples[0]
+        << ", \"p99\": " << samples[( n - 1 ) * 99 / 100] << " }";
+   return json.str();
+}
+
+/**
+ * Return text as a JSON string, escaping quotes, backslashes and control
+ * characters. Some platforms end their info strings with a null character,
+ * which is dropped.
+ * */
+
+std::string jsonString( const std::string& text ) {
+   std::ostringstream json;
+   json << '"';
+   for( char c : text ) {
+      if( c == '\0' ) {
+         continue;
+      } else if( c == '"' || c == '\\' ) {
+         json << '\\' << c;
+      } else if( static_cast< unsigned char >( c ) < 0x20 ) {
+         json << "\\u" << std::hex << std::setw( 4 ) << std::setfill( '0' )
+              << static_cast< int >( c ) << std::dec;
+      } else {
+         json << c;
+      }
+   }
+   json << '"';
+   return json.str();
+}
+
+/**
+ * Record the completion time of a command in the CallbackState pointed to
+ * by user_data.
+ * */
+
+void CL_CALLBACK onComplete( cl_event, cl_int, void* user_data ) {
+   auto time = std::chrono::steady_clock::now();
+   CallbackState* state = static_cast< CallbackState* >( user_data );
+   state->time = time;
+   state->done.store( true, std::memory_order_release );
+}
+
+/**
+ * Return the microseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::micro >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
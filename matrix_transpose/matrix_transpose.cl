@@ -0,0 +1,151 @@
+/**
+ * Declare the size of each tile (it must be the same work-group size
+ * declared in the host code).
+ */
+
+#define TILE_SIZE 16
+
+/**
+ * This kernel function copies a matrix a[rows,cols] into b[rows,cols]. It
+ * moves the same amount of data as a transpose, so its bandwidth is the
+ * reference the transpose kernels are compared against.
+ */
+
+__kernel void copyMatrix( const __global float* a,
+                          __global float* b,
+                          const unsigned int rows,
+                          const unsigned int cols ) {
+   int col = (int)get_global_id( 0 );
+   int row = (int)get_global_id( 1 );
+   b[row * (int)cols + col] = a[row * (int)cols + col];
+}
+
+/**
+ * This kernel function stores the transpose of a[rows,cols] in b[cols,rows]
+ * directly. Reads are coalesced, but consecutive work-items write elements
+ * which are rows apart.
+ */
+
+__kernel void transposeNaive( const __global float* a,
+                              __global float* b,
+                              const unsigned int rows,
+                              const unsigned int cols ) {
+   int col = (int)get_global_id( 0 );
+   int row = (int)get_global_id( 1 );
+   b[col * (int)rows + row] = a[row * (int)cols + col];
+}
+
+/**
+ * This kernel function stores the transpose of a[rows,cols] in b[cols,rows]
+ * through a tile cached in the device local memory, so both the reads and
+ * the writes are coalesced. The tile is padded by one column, so reading it
+ * along a column hits a different bank for every work-item.
+ */
+
+__kernel void transposeTiled( const __global float* a,
+                              __global float* b,
+                              const unsigned int rows,
+                              const unsigned int cols ) {
+
+   /**
+    * Create the tile that caches a block of the matrix A.
+    */
+
+   __local float tile[TILE_SIZE][TILE_SIZE + 1];
+
+   /**
+    * Get work-item identifiers.
+    */
+
+   int local_col = (int)get_local_id( 0 );
+   int local_row = (int)get_local_id( 1 );
+   int group_col = (int)get_group_id( 0 ) * TILE_SIZE;
+   int group_row = (int)get_group_id( 1 ) * TILE_SIZE;
+
+   /**
+    * Load a block of rows of A into the tile.
+    */
+
+   tile[local_row][local_col]
+      = a[( group_row + local_row ) * (int)cols + group_col + local_col];
+
+   /**
+    * Synchronize all work-items in this work-group.
+    */
+
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Store the columns of the tile as rows of B.
+    */
+
+   b[( group_col + local_row ) * (int)rows + group_row + local_col]
+      = tile[local_col][local_row];
+}
+
+/**
+ * This kernel function packs a[m,k] into panels of TILE_SIZE rows: panel p
+ * holds rows [p * TILE_SIZE, (p + 1) * TILE_SIZE) stored column by column,
+ * so packed[(p * k + z) * TILE_SIZE + r] = a[p * TILE_SIZE + r, z]. Every
+ * panel is the transpose of a block of rows, so it is built through a
+ * padded tile.
+ */
+
+__kernel void packPanelsA( const __global float* a,
+                           __global float* packed,
+                           const unsigned int m,
+                           const unsigned int k ) {
+
+   /**
+    * Create the tile that caches a block of the matrix A.
+    */
+
+   __local float tile[TILE_SIZE][TILE_SIZE + 1];
+
+   /**
+    * Get work-item identifiers.
+    */
+
+   int local_col = (int)get_local_id( 0 );
+   int local_row = (int)get_local_id( 1 );
+   int group_col = (int)get_group_id( 0 ) * TILE_SIZE;
+   int panel = (int)get_group_id( 1 );
+
+   /**
+    * Load a block of the panel into the tile.
+    */
+
+   tile[local_row][local_col]
+      = a[( panel * TILE_SIZE + local_row ) * (int)k + group_col + local_col];
+
+   /**
+    * Synchronize all work-items in this work-group.
+    */
+
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Store the block column by column.
+    */
+
+   packed[( panel * (int)k + group_col + local_row ) * TILE_SIZE + local_col]
+      = tile[local_col][local_row];
+}
+
+/**
+ * This kernel function packs b[k,n] into panels of TILE_SIZE columns: panel
+ * p holds columns [p * TILE_SIZE, (p + 1) * TILE_SIZE) stored row by row, so
+ * packed[(p * k + z) * TILE_SIZE + c] = b[z, p * TILE_SIZE + c]. Rows of a
+ * panel are contiguous in both layouts, so no tile is needed.
+ */
+
+__kernel void packPanelsB( const __global float* b,
+                           __global float* packed,
+                           const unsigned int k,
+                           const unsigned int n ) {
+   int col = (int)get_global_id( 0 );
+   int z = (int)get_global_id( 1 );
+   int panel = col / TILE_SIZE;
+   packed[( panel * (int)k + z ) * TILE_SIZE + col % TILE_SIZE]
+      = b[z * (int)n + col];
+}
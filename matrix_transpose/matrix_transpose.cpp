@@ -0,0 +1,367 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code.
+void initializeDevice();
+// Sequentially stores the transpose of a[rows,cols] in b[cols,rows].
+void seqTranspose( const float* a,
+                   float* b,
+                   const size_t rows,
+                   const size_t cols );
+// Sequentially packs a[m,k] into panels of TILE_SIZE rows.
+void seqPackPanelsA( const float* a,
+                     float* packed,
+                     const size_t m,
+                     const size_t k );
+// Sequentially packs b[k,n] into panels of TILE_SIZE columns.
+void seqPackPanelsB( const float* b,
+                     float* packed,
+                     const size_t k,
+                     const size_t n );
+// Parallelly runs a kernel from a[rows,cols] into b, returning its mean time.
+double parRunKernel( const std::string& name,
+                     const float* a,
+                     float* b,
+                     const size_t rows,
+                     const size_t cols,
+                     const int executions );
+// Check if the matrices c1 and c2 are equal.
+bool checkEquality( const float* c1,
+                    const float* c2,
+                    const size_t rows,
+                    const size_t cols );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+const size_t WG_SIZE[2] = { 16, 16 };   // The size of work-groups.
+constexpr size_t TILE_SIZE = 16;        // The size of tiles and panels.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 20;
+
+   /**
+    * Prepare input constants related to the dimensions of the matrix. Both
+    * must be multiples of TILE_SIZE.
+    * */
+
+   constexpr size_t rows = 1 << 12;
+   constexpr size_t cols = 1 << 11;
+   static_assert( rows % TILE_SIZE == 0 && cols % TILE_SIZE == 0,
+                  "Unsupported matrix dimensions." );
+   constexpr double bytes = 2.0 * rows * cols * sizeof( float );
+
+   /**
+    * Prepare the input matrix and the expected outputs.
+    * */
+
+   std::vector< float > a( rows * cols );
+   for( size_t i = 0; i < rows * cols; i++ ) {
+      a[i] = static_cast< float >( i );
+   }
+
+   std::vector< float > transposed( rows * cols );
+   std::vector< float > packed_a( rows * cols );
+   std::vector< float > packed_b( rows * cols );
+   seqTranspose( a.data(), transposed.data(), rows, cols );
+   seqPackPanelsA( a.data(), packed_a.data(), rows, cols );
+   seqPackPanelsB( a.data(), packed_b.data(), rows, cols );
+
+   /**
+    * Initialize OpenCL device.
+    * */
+
+   initializeDevice();
+
+   /**
+    * Run every kernel, checking its output against the expected one.
+    * */
+
+   struct Result {
+      std::string name;
+      const std::vector< float >* expected;
+      double time;
+      bool equal;
+   };
+   std::vector< Result > results
+      = { { "copyMatrix", &a, 0.0, false },
+          { "transposeNaive", &transposed, 0.0, false },
+          { "transposeTiled", &transposed, 0.0, false },
+          { "packPanelsA", &packed_a, 0.0, false },
+          { "packPanelsB", &packed_b, 0.0, false } };
+
+   bool equal = true;
+   std::vector< float > b( rows * cols );
+   for( auto& result : results ) {
+      result.time = parRunKernel(
+         result.name, a.data(), b.data(), rows, cols, executions );
+      result.equal
+         = checkEquality( result.expected->data(), b.data(), rows, cols );
+      equal = equal && result.equal;
+   }
+
+   /**
+    * Print results. Bandwidth counts one read and one write of the matrix.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Matrix: " << rows << " x " << cols << " floats" << std::endl;
+   std::cout << "Mean kernel time and bandwidth:" << std::fixed
+             << std::setprecision( 3 ) << std::endl;
+   double copy_bandwidth = bytes / results.front().time / 1e6;
+   for( const auto& result : results ) {
+      double bandwidth = bytes / result.time / 1e6;
+      std::cout << "\t" << std::left << std::setw( 16 ) << result.name
+                << std::right << result.time << " ms; " << bandwidth
+                << " GB/s; " << 100 * bandwidth / copy_bandwidth
+                << "% of copy" << ( result.equal ? "" : " (FAILED)" )
+                << std::endl;
+   }
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device.
+    * */
+
+   device = getDefaultDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "matrix_transpose.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Sequentially stores the transpose of a[rows,cols] in b[cols,rows].
+ * */
+
+void seqTranspose( const float* a,
+                   float* b,
+                   const size_t rows,
+                   const size_t cols ) {
+   for( size_t i = 0; i < rows; i++ ) {
+      for( size_t j = 0; j < cols; j++ ) {
+         b[j * rows + i] = a[i * cols + j];
+      }
+   }
+}
+
+/**
+ * Sequentially packs a[m,k] into panels of TILE_SIZE rows, each one stored
+ * column by column.
+ * */
+
+void seqPackPanelsA( const float* a,
+                     float* packed,
+                     const size_t m,
+                     const size_t k ) {
+   for( size_t i = 0; i < m; i++ ) {
+      size_t panel = i / TILE_SIZE;
+      for( size_t z = 0; z < k; z++ ) {
+         packed[( panel * k + z ) * TILE_SIZE + i % TILE_SIZE] = a[i * k + z];
+      }
+   }
+}
+
+/**
+ * Sequentially packs b[k,n] into panels of TILE_SIZE columns, each one stored
+ * row by row.
+ * */
+
+void seqPackPanelsB( const float* b,
+                     float* packed,
+                     const size_t k,
+                     const size_t n ) {
+   for( size_t z = 0; z < k; z++ ) {
+      for( size_t j = 0; j < n; j++ ) {
+         size_t panel = j / TILE_SIZE;
+         packed[( panel * k + z ) * TILE_SIZE + j % TILE_SIZE] = b[z * n + j];
+      }
+   }
+}
+
+/**
+ * Parallelly runs one of the kernels, which all read a matrix a[rows,cols]
+ * and write the same number of elements to b, and returns its mean
+ * execution time in milliseconds, measured with profiling events.
+ * */
+
+double parRunKernel( const std::string& name,
+                     const float* a,
+                     float* b,
+                     const size_t rows,
+                     const size_t cols,
+                     const int executions ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      rows * cols * sizeof( float ),
+      const_cast< float* >( a ) );
+   cl::Buffer b_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     rows * cols * sizeof( float ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, name.c_str() );
+   kernel.setArg( 0, a_buf );
+   kernel.setArg( 1, b_buf );
+   kernel.setArg( 2, static_cast< cl_uint >( rows ) );
+   kernel.setArg( 3, static_cast< cl_uint >( cols ) );
+
+   /**
+    * Execute the kernel function once to warm up, then measure it.
+    * */
+
+   cl::CommandQueue queue( context, device, CL_QUEUE_PROFILING_ENABLE );
+   cl::NDRange global( cols, rows );
+   cl::NDRange local( WG_SIZE[0], WG_SIZE[1] );
+   queue.enqueueNDRangeKernel( kernel, cl::NullRange, global, local );
+   queue.finish();
+
+   double time = 0.0;
+   for( int i = 0; i < executions; i++ ) {
+      cl::Event event;
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  global,
+                                  local,
+                                  nullptr,
+                                  &event );
+      event.wait();
+      time += 1e-6
+            * static_cast< double >(
+                 event.getProfilingInfo< CL_PROFILING_COMMAND_END >()
+                 - event.getProfilingInfo< CL_PROFILING_COMMAND_START >() );
+   }
+
+   /**
+    * Collect the result.
+    * */
+
+   queue.enqueueReadBuffer( b_buf,
+                            CL_TRUE,
+                            0,
+                            rows * cols * sizeof( float ),
+                            b );
+   return time / executions;
+}
+
+/**
+ * Check if the matrices C1 and C2 are equal.
+ * */
+
+bool checkEquality( const float* c1,
+                    const float* c2,
+                    const size_t rows,
+                    const size_t cols ) {
+   for( size_t i = 0; i < rows * cols; i++ ) {
+      if( c1[i] != c2[i] ) {
+         return false;
+      }
+   }
+   return true;
+}
@@ -0,0 +1,10 @@
+/**
+ * This kernel function fills an allocation of the arena: every work-item
+ * stores value plus its index, so the host can tell the allocations apart
+ * and check that they do not overlap.
+ */
+
+__kernel void fillValues( __global int* data, const int value ) {
+   int index = (int)get_global_id( 0 );
+   data[index] = value + index;
+}
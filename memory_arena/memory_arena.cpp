@@ -0,0 +1,367 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "memory_arena.hpp"
+
+// =================================================================
+// ---------------------------- Types -----------------------------
+// =================================================================
+
+/**
+ * Allocate a new buffer from the driver for every request, as the other
+ * examples do, behind the interface of the arenas.
+ * */
+
+struct DirectAllocator {
+   using Handle = cl::Buffer;
+
+   cl::Context context;
+   size_t allocations = 0;
+
+   cl::Buffer allocate( const size_t size ) {
+      allocations++;
+      return cl::Buffer( context, CL_MEM_READ_WRITE, size );
+   }
+
+   // The buffer is freed with its last reference, once its commands end.
+   void release( const cl::Buffer& ) {}
+
+   void reset() {}
+};
+
+// An allocation of a frame which is kept until the frame ends, with the
+// values filled into it.
+template< typename Handle >
+struct Allocation {
+   Handle handle;
+   int ints;
+   int value;
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code.
+void initializeDevice();
+// Return the ints of allocation j of frame.
+int getAllocationInts( const int frame, const int j );
+// Run FRAMES frames of allocations from allocator, plus a checked one, and
+// return the mean time of a frame in ms.
+template< typename Allocator >
+double runFrames( Allocator& allocator, bool& equal );
+// Allocate, fill and release the allocations of frame, and return those
+// kept until the frame ends.
+template< typename Allocator >
+std::vector< Allocation< typename Allocator::Handle > > runFrame(
+   Allocator& allocator,
+   cl::Kernel& kernel,
+   cl::CommandQueue& queue,
+   const int frame );
+// Check the first and last values filled into a buffer allocation.
+bool checkValues( cl::CommandQueue& queue,
+                  const Allocation< cl::Buffer >& allocation );
+// Check the first and last values filled into an SVM allocation.
+bool checkValues( cl::CommandQueue& queue,
+                  const Allocation< void* >& allocation );
+// Print the usage statistics of arena.
+template< typename Arena >
+void printStats( const std::string& name, const Arena& arena );
+// Return the time elapsed since start, in ms.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// Frames timed for every allocator and allocations of every frame; one
+// allocation in four is released before the frame ends.
+constexpr int FRAMES = 100;
+constexpr int ALLOCATIONS = 64;
+constexpr int RELEASE_EVERY = 4;
+// Unit of the allocation sizes, in ints; the largest is 1024 times this.
+constexpr int MIN_INTS = 256;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Initialize OpenCL device.
+    * */
+
+   device = getDefaultDevice();
+   initializeDevice();
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << "\n"
+             << FRAMES << " frames of " << ALLOCATIONS
+             << " allocations of up to " << MIN_INTS * sizeof( cl_int )
+             << " KiB" << std::endl;
+
+   /**
+    * Run the frames with a buffer per allocation, then with the arenas of
+    * sub-buffers and, when the device supports SVM, of SVM regions.
+    * */
+
+   DirectAllocator direct{ context };
+   bool equal = true;
+   double direct_time = runFrames( direct, equal );
+
+   BufferArena buffer_arena( SubBufferBackend( context ), device );
+   double buffer_time = runFrames( buffer_arena, equal );
+
+   bool svm = device.getInfo< CL_DEVICE_SVM_CAPABILITIES >()
+            & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER;
+   SvmArena svm_arena( SvmBackend( context ), device );
+   double svm_time = svm ? runFrames( svm_arena, equal ) : 0;
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time of a frame: \n\tBuffer per allocation: "
+             << direct_time << " ms;\n\tSub-buffer arena: " << buffer_time
+             << " ms";
+   if( svm ) {
+      std::cout << ";\n\tSVM arena: " << svm_time << " ms";
+   }
+   std::cout << "." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( direct_time - buffer_time ) / buffer_time )
+             << "%\n";
+
+   std::cout << "Driver allocations:\n\tBuffer per allocation: "
+             << direct.allocations << std::endl;
+   printStats( "Sub-buffer arena", buffer_arena );
+   if( svm ) {
+      printStats( "SVM arena", svm_arena );
+   }
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "memory_arena.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Return the ints of allocation j of frame: a power of two from MIN_INTS
+ * to 1024 times it, plus a remainder, so that every size class is used and
+ * most requests are not a size class themselves. Every frame differs, and
+ * every allocator gets the same sizes.
+ * */
+
+int getAllocationInts( const int frame, const int j ) {
+   cl_uint hash = static_cast< cl_uint >( frame * ALLOCATIONS + j )
+                * 2654435761u;
+   hash ^= hash >> 16;
+   return ( MIN_INTS << ( hash % 11 ) ) - ( hash >> 8 ) % MIN_INTS;
+}
+
+/**
+ * Run FRAMES frames of allocations from allocator, each ended by a reset,
+ * and return the mean time of a frame in ms. A last frame, which is not
+ * timed, checks the values of its allocations, so overlapping allocations
+ * set equal to false.
+ * */
+
+template< typename Allocator >
+double runFrames( Allocator& allocator, bool& equal ) {
+   cl::Kernel kernel( program, "fillValues" );
+   cl::CommandQueue queue( context, device );
+
+   auto start = std::chrono::steady_clock::now();
+   for( int frame = 0; frame < FRAMES; frame++ ) {
+      runFrame( allocator, kernel, queue, frame );
+      queue.finish();
+      allocator.reset();
+   }
+   double time = getElapsedTime( start ) / FRAMES;
+
+   auto allocations = runFrame( allocator, kernel, queue, FRAMES );
+   queue.finish();
+   for( const auto& allocation : allocations ) {
+      equal = equal && checkValues( queue, allocation );
+   }
+   allocator.reset();
+   return time;
+}
+
+/**
+ * Allocate the allocations of frame, filling each with a launch. Every
+ * RELEASE_EVERY allocations the previous one is released, so the arenas
+ * hand it out again: the commands of the in-order queue which used it end
+ * before those of its next owner start. Return the allocations which are
+ * kept until the frame ends.
+ * */
+
+template< typename Allocator >
+std::vector< Allocation< typename Allocator::Handle > > runFrame(
+   Allocator& allocator,
+   cl::Kernel& kernel,
+   cl::CommandQueue& queue,
+   const int frame ) {
+   std::vector< Allocation< typename Allocator::Handle > > allocations;
+   for( int j = 0; j < ALLOCATIONS; j++ ) {
+      const int ints = getAllocationInts( frame, j );
+      const int value = j << 20;
+      auto handle = allocator.allocate( ints * sizeof( cl_int ) );
+      kernel.setArg( 0, handle );
+      kernel.setArg( 1, value );
+      queue.enqueueNDRangeKernel( kernel, cl::NullRange, cl::NDRange( ints ) );
+
+      if( j % RELEASE_EVERY == RELEASE_EVERY - 1 ) {
+         allocator.release( allocations.back().handle );
+         allocations.pop_back();
+      }
+      allocations.push_back( { handle, ints, value } );
+   }
+   return allocations;
+}
+
+/**
+ * Check the first and last values filled into a buffer allocation.
+ * */
+
+bool checkValues( cl::CommandQueue& queue,
+                  const Allocation< cl::Buffer >& allocation ) {
+   cl_int first, last;
+   queue.enqueueReadBuffer( allocation.handle, CL_TRUE, 0, sizeof( cl_int ),
+                            &first );
+   queue.enqueueReadBuffer( allocation.handle,
+                            CL_TRUE,
+                            ( allocation.ints - 1 ) * sizeof( cl_int ),
+                            sizeof( cl_int ),
+                            &last );
+   return first == allocation.value
+       && last == allocation.value + allocation.ints - 1;
+}
+
+/**
+ * Check the first and last values filled into an SVM allocation, between a
+ * map and an unmap.
+ * */
+
+bool checkValues( cl::CommandQueue& queue,
+                  const Allocation< void* >& allocation ) {
+   cl_int* data = static_cast< cl_int* >( allocation.handle );
+   const size_t bytes = allocation.ints * sizeof( cl_int );
+   clEnqueueSVMMap( queue(), CL_TRUE, CL_MAP_READ, data, bytes, 0, nullptr,
+                    nullptr );
+   bool equal = data[0] == allocation.value
+             && data[allocation.ints - 1]
+                   == allocation.value + allocation.ints - 1;
+   clEnqueueSVMUnmap( queue(), data, 0, nullptr, nullptr );
+   queue.finish();
+   return equal;
+}
+
+/**
+ * Print the usage statistics of arena: the driver allocations are its
+ * blocks, and reuses are allocations served by a free list.
+ * */
+
+template< typename Arena >
+void printStats( const std::string& name, const Arena& arena ) {
+   const auto& stats = arena.stats();
+   std::cout << name << ":\n\tBlocks: " << stats.blocks << " ("
+             << ( stats.reserved >> 20 ) << " MiB);\n\tPeak in use: "
+             << ( stats.peak >> 20 ) << " MiB;\n\tAllocations: "
+             << stats.allocations << ", " << stats.reuses << " reused, "
+             << stats.carved << " carved;\n\tResets: " << stats.resets
+             << "." << std::endl;
+}
+
+/**
+ * Return the time elapsed since start, in ms.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,279 @@
+#ifndef MEMORY_ARENA_HPP
+#define MEMORY_ARENA_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * Suballocate device memory from a few large blocks instead of asking the
+ * driver for every buffer. Requests are rounded up to a power-of-two size
+ * class, at least the base address alignment of the device, and carved
+ * from the current block with a bump pointer; released allocations go to
+ * the free list of their class and are handed out again. reset() releases
+ * every allocation at once, e.g. at the end of a frame, and keeps the
+ * blocks for the next one:
+ *
+ *    BufferArena arena( SubBufferBackend( context ), device );
+ *    cl::Buffer a = arena.allocate( 1000 );    // A sub-buffer of a block.
+ *    cl::Buffer b = arena.allocate( 5000 );
+ *    arena.release( a );                       // Reused up to 1024 bytes.
+ *    ...
+ *    arena.reset();                            // a and b are invalid.
+ *
+ * BufferArena hands out sub-buffers of parent buffers, as sub_buffer does,
+ * and SvmArena pointers into coarse-grained SVM regions. Allocations must
+ * not be used by pending commands of another queue when they are released
+ * or reset; the commands of a single in-order queue are safe.
+ * */
+
+// =================================================================
+// ---------------------------- Backends ---------------------------
+// =================================================================
+
+/**
+ * Blocks are buffers and allocations are sub-buffers of them. A released
+ * sub-buffer is kept in its free list, so reusing it creates no object.
+ * */
+
+struct SubBufferBackend {
+   using Handle = cl::Buffer;
+
+   explicit SubBufferBackend( const cl::Context& context,
+                              const cl_mem_flags flags = CL_MEM_READ_WRITE )
+      : context_( context ), flags_( flags ) {}
+
+   // Return a block of size bytes, or a null buffer when it fails.
+   Handle createBlock( const size_t size ) {
+      cl_int err;
+      cl::Buffer block( context_, flags_, size, nullptr, &err );
+      return err == CL_SUCCESS ? block : cl::Buffer();
+   }
+
+   // Return the allocation of size bytes at offset of block.
+   Handle carve( const Handle& block, const size_t offset, const size_t size ) {
+      cl_buffer_region region = { offset, size };
+      cl::Buffer parent = block;
+      return parent.createSubBuffer(
+         flags_, CL_BUFFER_CREATE_TYPE_REGION, &region );
+   }
+
+   // Free block; the buffer is freed with its last reference.
+   void destroyBlock( Handle& block ) { block = cl::Buffer(); }
+
+   // Return the key of an allocation.
+   static const void* getKey( const Handle& handle ) { return handle(); }
+
+ private:
+   cl::Context context_;
+   cl_mem_flags flags_;
+};
+
+/**
+ * Blocks are coarse-grained SVM regions and allocations are pointers at an
+ * offset of them, so carving is free.
+ * */
+
+struct SvmBackend {
+   using Handle = void*;
+
+   explicit SvmBackend( const cl::Context& context,
+                        const cl_svm_mem_flags flags = CL_MEM_READ_WRITE )
+      : context_( context ), flags_( flags ) {}
+
+   // Return a block of size bytes, or nullptr when it fails.
+   Handle createBlock( const size_t size ) {
+      return clSVMAlloc( context_(), flags_, size, 0 );
+   }
+
+   // Return the allocation at offset of block.
+   Handle carve( const Handle& block, const size_t offset, const size_t ) {
+      return static_cast< char* >( block ) + offset;
+   }
+
+   // Free block.
+   void destroyBlock( Handle& block ) {
+      clSVMFree( context_(), block );
+      block = nullptr;
+   }
+
+   // Return the key of an allocation.
+   static const void* getKey( const Handle& handle ) { return handle; }
+
+ private:
+   cl::Context context_;
+   cl_svm_mem_flags flags_;
+};
+
+// =================================================================
+// ----------------------------- Arena -----------------------------
+// =================================================================
+
+template< typename Backend >
+class Arena {
+ public:
+   using Handle = typename Backend::Handle;
+
+   // Default size of the blocks; larger requests get a block of their own.
+   static constexpr size_t BLOCK_SIZE = 64 << 20;
+   // Smallest size class, in bytes.
+   static constexpr size_t MIN_SIZE = 256;
+
+   // Usage of the arena.
+   struct Stats {
+      size_t blocks = 0;        // Blocks reserved from the driver.
+      size_t reserved = 0;      // Bytes of the blocks.
+      size_t in_use = 0;        // Bytes of the live allocations' classes.
+      size_t requested = 0;     // Bytes requested by the live allocations.
+      size_t peak = 0;          // Largest in_use.
+      size_t allocations = 0;   // Calls to allocate.
+      size_t reuses = 0;        // Allocations served by a free list.
+      size_t carved = 0;        // Allocations carved from a block.
+      size_t resets = 0;        // Calls to reset.
+   };
+
+   // Create an arena whose allocations are aligned to the base address
+   // alignment of device, as sub-buffers require.
+   Arena( const Backend& backend,
+          const cl::Device& device,
+          const size_t block_size = BLOCK_SIZE )
+      : backend_( backend ), block_size_( block_size ) {
+      alignment_ = std::max< size_t >(
+         MIN_SIZE, device.getInfo< CL_DEVICE_MEM_BASE_ADDR_ALIGN >() / 8 );
+   }
+
+   ~Arena() {
+      for( Block& block : blocks_ ) {
+         backend_.destroyBlock( block.handle );
+      }
+   }
+
+   Arena( const Arena& ) = delete;
+   Arena& operator=( const Arena& ) = delete;
+
+   // Return an allocation of at least size bytes; exit when the driver
+   // cannot reserve a block for it.
+   Handle allocate( const size_t size ) {
+      const size_t size_class = getSizeClass( size );
+      stats_.allocations++;
+
+      /**
+       * Reuse a released allocation of the class, or carve one from the
+       * first block with room, starting from the current one.
+       * */
+
+      Handle handle;
+      std::vector< Handle >& free_handles = free_[size_class];
+      if( !free_handles.empty() ) {
+         handle = free_handles.back();
+         free_handles.pop_back();
+         stats_.reuses++;
+      } else {
+         while( current_ < blocks_.size()
+                && blocks_[current_].used + size_class
+                      > blocks_[current_].size ) {
+            current_++;
+         }
+         if( current_ == blocks_.size() ) {
+            addBlock( std::max( block_size_, size_class ) );
+         }
+         Block& block = blocks_[current_];
+         handle = backend_.carve( block.handle, block.used, size_class );
+         block.used += size_class;
+         stats_.carved++;
+      }
+
+      live_[Backend::getKey( handle )] = { size_class, size };
+      stats_.in_use += size_class;
+      stats_.requested += size;
+      stats_.peak = std::max( stats_.peak, stats_.in_use );
+      return handle;
+   }
+
+   // Return handle, which came from allocate, to the free list of its
+   // class; exit when it is not live, e.g. released twice. A handle from
+   // before a reset must not be released: its region may be live again.
+   void release( const Handle& handle ) {
+      auto live = live_.find( Backend::getKey( handle ) );
+      if( live == live_.end() ) {
+         std::cerr << "Failed to release an allocation which is not live "
+                   << "in the arena!" << std::endl;
+         exit( 1 );
+      }
+      stats_.in_use -= live->second.first;
+      stats_.requested -= live->second.second;
+      free_[live->second.first].push_back( handle );
+      live_.erase( live );
+   }
+
+   // Release every allocation at once and start carving from the first
+   // block again. The blocks are kept.
+   void reset() {
+      for( Block& block : blocks_ ) {
+         block.used = 0;
+      }
+      free_.clear();
+      live_.clear();
+      current_ = 0;
+      stats_.in_use = 0;
+      stats_.requested = 0;
+      stats_.resets++;
+   }
+
+   // Usage of the arena.
+   const Stats& stats() const { return stats_; }
+
+   // Alignment of every allocation, in bytes.
+   size_t alignment() const { return alignment_; }
+
+ private:
+   struct Block {
+      Handle handle;
+      size_t size;
+      size_t used;
+   };
+
+   // Reserve a block of size bytes after the others and make it current.
+   void addBlock( const size_t size ) {
+      Handle handle = backend_.createBlock( size );
+      if( Backend::getKey( handle ) == nullptr ) {
+         std::cerr << "Failed to reserve an arena block of " << size
+                   << " bytes!" << std::endl;
+         exit( 1 );
+      }
+      blocks_.push_back( { handle, size, 0 } );
+      current_ = blocks_.size() - 1;
+      stats_.blocks++;
+      stats_.reserved += size;
+   }
+
+   // Return the power of two, at least the alignment, which holds size
+   // bytes.
+   size_t getSizeClass( const size_t size ) const {
+      size_t size_class = alignment_;
+      while( size_class < size ) {
+         size_class *= 2;
+      }
+      return size_class;
+   }
+
+   Backend backend_;
+   size_t block_size_;
+   size_t alignment_;
+   std::vector< Block > blocks_;
+   size_t current_ = 0;
+   std::map< size_t, std::vector< Handle > > free_;
+   std::map< const void*, std::pair< size_t, size_t > > live_;
+   Stats stats_;
+};
+
+using BufferArena = Arena< SubBufferBackend >;
+using SvmArena = Arena< SvmBackend >;
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * Declare the descriptor of a task, with the layout of its host
+ * counterpart: the add_one of map over count elements from offset, with
+ * the increment of the task.
+ */
+
+typedef struct {
+   uint offset;
+   uint count;
+   int increment;
+   uint padding;
+} Task;
+
+/**
+ * This kernel function runs a single task, launched over its elements with
+ * the offset of the task as global offset: the path with a launch per task.
+ */
+
+__kernel void addOne( __global int* data, const int increment ) {
+   int index = (int)get_global_id( 0 );
+   data[index] += increment;
+}
+
+/**
+ * Declare the queue of tasks shared with the host, with the layout of its
+ * host counterpart. Work-groups claim the task at head; the tasks before
+ * tail are appended, and stop is set once the host appends no more.
+ * Without FINE_GRAINED, the host appends every task through a mapped
+ * buffer and sets stop before the launch, so the fields only change by the
+ * claims of the work-groups.
+ */
+
+#ifdef FINE_GRAINED
+
+typedef struct {
+   atomic_uint head;
+   atomic_uint tail;
+   atomic_int stop;
+   uint padding;
+} TaskQueue;
+
+// Claim the next task of queue and return its index.
+uint claimTask( __global TaskQueue* queue ) {
+   return atomic_fetch_add_explicit( &queue->head,
+                                     1,
+                                     memory_order_relaxed,
+                                     memory_scope_all_svm_devices );
+}
+
+// Wait until the task index is appended and return true, or return false
+// when the host stopped before appending it. The stop flag is read before
+// the tail, so a tail read after seeing it is final.
+bool waitForTask( __global TaskQueue* queue, const uint index ) {
+   for( ;; ) {
+      int stop = atomic_load_explicit(
+         &queue->stop, memory_order_acquire, memory_scope_all_svm_devices );
+      uint tail = atomic_load_explicit(
+         &queue->tail, memory_order_acquire, memory_scope_all_svm_devices );
+      if( index < tail ) {
+         return true;
+      }
+      if( stop ) {
+         return false;
+      }
+   }
+}
+
+#else
+
+typedef struct {
+   uint head;
+   uint tail;
+   int stop;
+   uint padding;
+} TaskQueue;
+
+// Claim the next task of queue and return its index.
+uint claimTask( __global TaskQueue* queue ) {
+   return atomic_inc( &queue->head );
+}
+
+// Wait until the task index is appended and return true, or return false
+// when the host stopped before appending it.
+bool waitForTask( __global TaskQueue* queue, const uint index ) {
+   volatile __global TaskQueue* shared = queue;
+   for( ;; ) {
+      if( index < shared->tail ) {
+         return true;
+      }
+      if( shared->stop ) {
+         return false;
+      }
+   }
+}
+
+#endif
+
+/**
+ * This persistent kernel function runs the tasks of queue until the host
+ * stops it. It is launched once, with as many work-groups as the device
+ * holds at once: each work-group claims a task, runs it with all its
+ * work-items, and claims the next, so no launch happens per task. The
+ * first work-item claims and waits for the task; the barriers share the
+ * task with the others and keep the loop uniform across the work-group.
+ */
+
+__kernel void consumeTasks( __global TaskQueue* queue,
+                            const __global Task* tasks,
+                            __global int* data ) {
+   __local uint index;
+   __local int found;
+   for( ;; ) {
+      if( get_local_id( 0 ) == 0 ) {
+         index = claimTask( queue );
+         found = waitForTask( queue, index );
+      }
+      barrier( CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE );
+      if( !found ) {
+         return;
+      }
+
+      Task task = tasks[index];
+      for( uint i = get_local_id( 0 ); i < task.count;
+           i += get_local_size( 0 ) ) {
+         data[task.offset + i] += task.increment;
+      }
+      barrier( CLK_LOCAL_MEM_FENCE );
+   }
+}
@@ -0,0 +1,476 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ---------------------------- Types -----------------------------
+// =================================================================
+
+/**
+ * The descriptor of a task and the queue of tasks, with the layout of
+ * their counterparts in persistent_threads.cl. The queue is accessed by
+ * the host and the device at once in fine-grained SVM, so its atomics must
+ * be plain lock-free integers.
+ * */
+
+struct Task {
+   cl_uint offset;      // First element of the task.
+   cl_uint count;       // Elements of the task.
+   cl_int increment;    // Value added to every element.
+   cl_uint padding;
+};
+
+struct TaskQueue {
+   std::atomic< cl_uint > head;   // Index of the next task claimed.
+   std::atomic< cl_uint > tail;   // Tasks appended.
+   std::atomic< cl_int > stop;    // Set once no more tasks are appended.
+   cl_uint padding;
+};
+
+static_assert( sizeof( std::atomic< cl_uint > ) == sizeof( cl_uint )
+                  && std::atomic< cl_uint >::is_always_lock_free,
+               "The SVM atomics must be plain lock-free integers." );
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Compile kernel code, with the fine-grained queue when fine_grained is
+// set.
+cl::Program buildProgram( const bool fine_grained );
+// Check if the device supports fine-grained SVM buffers with atomics.
+bool isFineGrainedSupported();
+// Return the work-groups of kernel which the device holds at once, and
+// their size in local_size.
+size_t getOccupancy( const cl::Kernel& kernel, size_t& local_size );
+// Run every task with a launch of addOne and return the time taken in ms.
+double runLaunchPerTask( std::vector< int >& result );
+// Append every task to a queue through mapped memory, run them with a
+// single launch of the persistent kernel and return the time taken in ms.
+double runPersistentMapped( std::vector< int >& result );
+// Append the tasks to a queue in fine-grained SVM while the persistent
+// kernel runs them, and return the time taken in ms.
+double runPersistentSvm( std::vector< int >& result );
+// Return the descriptor of the task id.
+Task getTask( const int id );
+// Return the time elapsed since start, in ms.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;       // The program that will run on the device.
+cl::Program svm_program;   // The program with the fine-grained queue.
+cl::Context context;       // The context which holds the device.
+cl::Device device;         // The device where the kernel will run.
+
+// Tasks of every run, each the add_one of map over TASK_SIZE elements of
+// its own.
+constexpr int TASKS = 1 << 14;
+constexpr int TASK_SIZE = 1024;
+// Largest work-group of the persistent kernel.
+constexpr size_t MAX_LOCAL_SIZE = 256;
+// Work-items a compute unit of a GPU holds at once. OpenCL does not report
+// it, so this is a conservative estimate; extra work-groups only wait for
+// the first ones to exit.
+constexpr size_t RESIDENT_WORK_ITEMS = 1024;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Initialize OpenCL device, with the fine-grained queue when the
+    * device supports fine-grained SVM with atomics.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   program = buildProgram( false );
+   bool fine_grained = isFineGrainedSupported();
+   if( fine_grained ) {
+      svm_program = buildProgram( true );
+   }
+
+   size_t local_size;
+   size_t groups
+      = getOccupancy( cl::Kernel( program, "consumeTasks" ), local_size );
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << "\n"
+             << TASKS << " tasks of " << TASK_SIZE << " elements, "
+             << groups << " persistent work-groups of " << local_size
+             << " work-items" << std::endl;
+
+   /**
+    * Run the tasks with a launch per task, then with the persistent
+    * kernel fed through mapped memory and, when it is supported, through
+    * fine-grained SVM. The first run of each path warms it up.
+    * */
+
+   std::vector< int > expected( TASKS * TASK_SIZE );
+   for( int id = 0; id < TASKS; id++ ) {
+      Task task = getTask( id );
+      std::fill_n( expected.begin() + task.offset, task.count,
+                   task.increment );
+   }
+
+   std::vector< int > result;
+   runLaunchPerTask( result );
+   double launch_time = runLaunchPerTask( result );
+   bool equal = result == expected;
+
+   runPersistentMapped( result );
+   double mapped_time = runPersistentMapped( result );
+   equal = equal && result == expected;
+
+   double svm_time = 0;
+   if( fine_grained ) {
+      runPersistentSvm( result );
+      svm_time = runPersistentSvm( result );
+      equal = equal && result == expected;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tLaunch per task: " << launch_time
+             << " ms (" << TASKS / launch_time * 1e3
+             << " tasks/s);\n\tPersistent, mapped queue: " << mapped_time
+             << " ms (" << TASKS / mapped_time * 1e3 << " tasks/s)";
+   if( fine_grained ) {
+      std::cout << ";\n\tPersistent, SVM queue: " << svm_time << " ms ("
+                << TASKS / svm_time * 1e3 << " tasks/s)";
+   }
+   std::cout << "." << std::endl;
+   std::cout << "Performance gain: \n\tMapped queue: "
+             << ( 100 * ( launch_time - mapped_time ) / mapped_time ) << "%";
+   if( fine_grained ) {
+      std::cout << ";\n\tSVM queue: "
+                << ( 100 * ( launch_time - svm_time ) / svm_time ) << "%";
+   } else {
+      std::cout << ".\nFine-grained SVM with atomics is not supported, the "
+                << "SVM queue does not run";
+   }
+   std::cout << "." << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Compile kernel code. The fine-grained queue needs the atomics of OpenCL
+ * C 2.0, so it is only compiled when fine_grained is set.
+ * */
+
+cl::Program buildProgram( const bool fine_grained ) {
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "persistent_threads.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   cl::Program built( context, sources );
+
+   auto err = built.build( fine_grained ? "-cl-std=CL2.0 -DFINE_GRAINED"
+                                        : "" );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << built.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << built.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+   return built;
+}
+
+/**
+ * Check if the device supports fine-grained SVM buffers with atomics,
+ * which the queue shared by the host and the running kernel needs.
+ * */
+
+bool isFineGrainedSupported() {
+   cl_device_svm_capabilities capabilities
+      = device.getInfo< CL_DEVICE_SVM_CAPABILITIES >();
+   return ( capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER )
+       && ( capabilities & CL_DEVICE_SVM_ATOMICS );
+}
+
+/**
+ * Return the work-groups of kernel which the device holds at once, and
+ * their size in local_size: the largest multiple of the preferred size,
+ * up to MAX_LOCAL_SIZE, which the kernel supports. A compute unit of a CPU
+ * runs a single work-group at a time; one of a GPU holds as many as fit in
+ * RESIDENT_WORK_ITEMS and in its local memory.
+ * */
+
+size_t getOccupancy( const cl::Kernel& kernel, size_t& local_size ) {
+   size_t limit = std::min(
+      MAX_LOCAL_SIZE,
+      kernel.getWorkGroupInfo< CL_KERNEL_WORK_GROUP_SIZE >( device ) );
+   size_t multiple = kernel.getWorkGroupInfo<
+      CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE >( device );
+   local_size = multiple <= limit ? limit / multiple * multiple : limit;
+
+   size_t groups_per_unit = 1;
+   if( !( device.getInfo< CL_DEVICE_TYPE >() & CL_DEVICE_TYPE_CPU ) ) {
+      cl_ulong local_memory
+         = kernel.getWorkGroupInfo< CL_KERNEL_LOCAL_MEM_SIZE >( device );
+      groups_per_unit = std::max< size_t >(
+         1, RESIDENT_WORK_ITEMS / local_size );
+      if( local_memory > 0 ) {
+         groups_per_unit = std::min< size_t >(
+            groups_per_unit,
+            std::max< cl_ulong >(
+               1,
+               device.getInfo< CL_DEVICE_LOCAL_MEM_SIZE >() / local_memory ) );
+      }
+   }
+   return device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >() * groups_per_unit;
+}
+
+/**
+ * Run every task with a launch of addOne over its elements, with the
+ * offset of the task as global offset, as map launches add_one.
+ * */
+
+double runLaunchPerTask( std::vector< int >& result ) {
+   const size_t bytes = TASKS * TASK_SIZE * sizeof( int );
+   cl::Buffer data( context, CL_MEM_READ_WRITE, bytes );
+   cl::CommandQueue queue( context, device );
+   queue.enqueueFillBuffer( data, 0, 0, bytes );
+   cl::Kernel kernel( program, "addOne" );
+   kernel.setArg( 0, data );
+   queue.finish();
+
+   auto start = std::chrono::steady_clock::now();
+   for( int id = 0; id < TASKS; id++ ) {
+      Task task = getTask( id );
+      kernel.setArg( 1, task.increment );
+      queue.enqueueNDRangeKernel(
+         kernel, cl::NDRange( task.offset ), cl::NDRange( task.count ) );
+   }
+   queue.finish();
+   double time = getElapsedTime( start );
+
+   result.resize( TASKS * TASK_SIZE );
+   queue.enqueueReadBuffer( data, CL_TRUE, 0, bytes, result.data() );
+   return time;
+}
+
+/**
+ * Append every task to a queue through mapped memory, then run them with a
+ * single launch of the persistent consumeTasks kernel. A mapped buffer
+ * cannot be written while a kernel uses it, so the host sets the stop flag
+ * before the launch and the kernel exits once the queue is empty.
+ * */
+
+double runPersistentMapped( std::vector< int >& result ) {
+   const size_t bytes = TASKS * TASK_SIZE * sizeof( int );
+   cl::Buffer data( context, CL_MEM_READ_WRITE, bytes );
+   cl::Buffer queue_buffer(
+      context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, sizeof( TaskQueue ) );
+   cl::Buffer tasks( context,
+                     CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR,
+                     TASKS * sizeof( Task ) );
+   cl::CommandQueue queue( context, device );
+   queue.enqueueFillBuffer( data, 0, 0, bytes );
+
+   cl::Kernel kernel( program, "consumeTasks" );
+   kernel.setArg( 0, queue_buffer );
+   kernel.setArg( 1, tasks );
+   kernel.setArg( 2, data );
+   size_t local_size;
+   size_t groups = getOccupancy( kernel, local_size );
+   queue.finish();
+
+   /**
+    * Append the tasks and close the queue, then launch the kernel.
+    * */
+
+   auto start = std::chrono::steady_clock::now();
+   Task* mapped_tasks = static_cast< Task* >( queue.enqueueMapBuffer(
+      tasks, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0,
+      TASKS * sizeof( Task ) ) );
+   for( int id = 0; id < TASKS; id++ ) {
+      mapped_tasks[id] = getTask( id );
+   }
+   queue.enqueueUnmapMemObject( tasks, mapped_tasks );
+
+   TaskQueue* mapped_queue = static_cast< TaskQueue* >( queue.enqueueMapBuffer(
+      queue_buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0,
+      sizeof( TaskQueue ) ) );
+   new( mapped_queue ) TaskQueue{ { 0 }, { TASKS }, { 1 }, 0 };
+   queue.enqueueUnmapMemObject( queue_buffer, mapped_queue );
+
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( groups * local_size ),
+                               cl::NDRange( local_size ) );
+   queue.finish();
+   double time = getElapsedTime( start );
+
+   result.resize( TASKS * TASK_SIZE );
+   queue.enqueueReadBuffer( data, CL_TRUE, 0, bytes, result.data() );
+   return time;
+}
+
+/**
+ * Run the persistent consumeTasks kernel on a queue in fine-grained SVM:
+ * it is launched first, then the host appends every task, publishing each
+ * with a release store of the tail, and sets the stop flag after the last
+ * one. The tasks are allocated with SVM atomics, as the slots of
+ * fine_grained_svm are, so that release store orders the write of the
+ * descriptor before it for the device; without that flag the device could
+ * read a stale descriptor. The work-groups run the tasks while they are
+ * appended.
+ * */
+
+double runPersistentSvm( std::vector< int >& result ) {
+
+   /**
+    * Allocate the queue and the tasks in fine-grained SVM, and initialize
+    * the queue in place.
+    * */
+
+   TaskQueue* task_queue = static_cast< TaskQueue* >(
+      clSVMAlloc( context(),
+                  CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER
+                     | CL_MEM_SVM_ATOMICS,
+                  sizeof( TaskQueue ),
+                  0 ) );
+   Task* tasks = static_cast< Task* >(
+      clSVMAlloc( context(),
+                  CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER
+                     | CL_MEM_SVM_ATOMICS,
+                  TASKS * sizeof( Task ),
+                  0 ) );
+   if( !task_queue || !tasks ) {
+      std::cerr << "Failed to allocate fine-grained SVM!" << std::endl;
+      exit( 1 );
+   }
+   new( task_queue ) TaskQueue{ { 0 }, { 0 }, { 0 }, 0 };
+
+   const size_t bytes = TASKS * TASK_SIZE * sizeof( int );
+   cl::Buffer data( context, CL_MEM_READ_WRITE, bytes );
+   cl::CommandQueue queue( context, device );
+   queue.enqueueFillBuffer( data, 0, 0, bytes );
+
+   cl::Kernel kernel( svm_program, "consumeTasks" );
+   kernel.setArg( 0, task_queue );
+   kernel.setArg( 1, tasks );
+   kernel.setArg( 2, data );
+   size_t local_size;
+   size_t groups = getOccupancy( kernel, local_size );
+   queue.finish();
+
+   /**
+    * Launch the kernel, then append the tasks and stop it.
+    * */
+
+   auto start = std::chrono::steady_clock::now();
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( groups * local_size ),
+                               cl::NDRange( local_size ) );
+   queue.flush();
+
+   for( int id = 0; id < TASKS; id++ ) {
+      tasks[id] = getTask( id );
+      task_queue->tail.store( id + 1, std::memory_order_release );
+   }
+   task_queue->stop.store( 1, std::memory_order_release );
+   queue.finish();
+   double time = getElapsedTime( start );
+
+   result.resize( TASKS * TASK_SIZE );
+   queue.enqueueReadBuffer( data, CL_TRUE, 0, bytes, result.data() );
+   clSVMFree( context(), task_queue );
+   clSVMFree( context(), tasks );
+   return time;
+}
+
+/**
+ * Return the descriptor of the task id: its own elements, and an
+ * increment from 1 to 7, so that a task run twice or never is found.
+ * */
+
+Task getTask( const int id ) {
+   return { static_cast< cl_uint >( id * TASK_SIZE ),
+            static_cast< cl_uint >( TASK_SIZE ),
+            id % 7 + 1,
+            0 };
+}
+
+/**
+ * Return the time elapsed since start, in ms.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,170 @@
+/**
+ * Declare the size of each submatrix (it must be the same work-group size
+ * declared in the host code). Every element of a submatrix packs four
+ * consecutive 8-bit values along the k dimension, so a submatrix covers
+ * 4 * SUB_SIZE values of k.
+ */
+
+#define SUB_SIZE 16
+
+/**
+ * Return the dot product of two vectors of four signed 8-bit integers,
+ * accumulated in 32 bits. The integer dot product built-in is used when the
+ * device supports cl_khr_integer_dot_product.
+ */
+
+int dot4( const char4 a, const char4 b ) {
+#ifdef __opencl_c_integer_dot_product_input_4x8bit
+   return dot( a, b );
+#else
+   int4 product = convert_int4( a ) * convert_int4( b );
+   return product.x + product.y + product.z + product.w;
+#endif
+}
+
+/**
+ * Accumulate the product of the row row_index of a[m,k] by the column
+ * col_index of b[k,n], caching submatrices in the device local memory. The
+ * matrix b is stored transposed, as b_t[n,k], so that every char4 holds four
+ * consecutive values of k. The sums of the row of a and of the column of b
+ * are accumulated as well, since they are needed to remove zero points.
+ * The local submatrices must be declared by the calling kernel; the extra
+ * column of b_sub avoids bank conflicts when it is read along its first
+ * dimension.
+ */
+
+int3 accumulateInt8( const __global char4* a,
+                     const __global char4* b_t,
+                     const unsigned int k,
+                     __local char4 ( *a_sub )[SUB_SIZE],
+                     __local char4 ( *b_sub )[SUB_SIZE + 1] ) {
+
+   /**
+    * Get work-item identifiers.
+    */
+
+   int col_index = (int)get_local_id( 0 );
+   int row_index = (int)get_local_id( 1 );
+   int global_row_index = (int)get_global_id( 1 );
+   int group_col_index = (int)get_group_id( 0 ) * SUB_SIZE;
+   int k4 = (int)k / 4;
+
+   /**
+    * Initialize accumulator registers: the product, the row sum of a and
+    * the column sum of b.
+    */
+
+   const char4 ones = (char4)( 1 );
+   int3 sum = (int3)( 0 );
+
+   /**
+    * Loop over all submatrices.
+    */
+
+   const int n_sub = k4 / SUB_SIZE;
+   for( int i = 0; i < n_sub; i++ ) {
+
+      /**
+       * Load submatrices into local memory. Work-item (row, col) loads the
+       * col-th packed element of the row-th row of the b_t tile.
+       */
+
+      const int s_col = SUB_SIZE * i + col_index;
+      a_sub[row_index][col_index] = a[global_row_index * k4 + s_col];
+      b_sub[row_index][col_index]
+         = b_t[( group_col_index + row_index ) * k4 + s_col];
+
+      /**
+       * Synchronize all work-items in this work-group.
+       */
+
+      barrier( CLK_LOCAL_MEM_FENCE );
+
+      /**
+       * Perform the computation for a single submatrix.
+       */
+
+      for( int j = 0; j < SUB_SIZE; j++ ) {
+         const char4 a4 = a_sub[row_index][j];
+         const char4 b4 = b_sub[col_index][j];
+         sum.x += dot4( a4, b4 );
+         sum.y += dot4( a4, ones );
+         sum.z += dot4( b4, ones );
+      }
+
+      /**
+       * Synchronize all work-items in this work-group.
+       */
+
+      barrier( CLK_LOCAL_MEM_FENCE );
+   }
+
+   return sum;
+}
+
+/**
+ * This kernel function multiplies two 8-bit matrices a[m,k] and b[k,n] with
+ * 32-bit accumulation. The matrix b is stored transposed, as b_t[n,k].
+ */
+
+__kernel void multiplyMatricesInt8( const __global char4* a,
+                                    const __global char4* b_t,
+                                    __global int* c,
+                                    const unsigned int m,
+                                    const unsigned int n,
+                                    const unsigned int k ) {
+
+   /**
+    * Create submatrices that will cache the matrices a and b_t in local
+    * memory.
+    */
+
+   __local char4 a_sub[SUB_SIZE][SUB_SIZE];
+   __local char4 b_sub[SUB_SIZE][SUB_SIZE + 1];
+
+   int index = (int)get_global_id( 1 ) * (int)n + (int)get_global_id( 0 );
+   c[index] = accumulateInt8( a, b_t, k, a_sub, b_sub ).x;
+}
+
+/**
+ * This kernel function multiplies two quantized matrices a[m,k] and b[k,n]
+ * and dequantizes the result before storing it. Row i of a uses the scale
+ * a_scale[i] and the zero point a_zero[i]; column j of b uses the scale
+ * b_scale[j] and the zero point b_zero[j], so:
+ *
+ *    c[i,j] = a_scale[i] * b_scale[j] * sum_z (a[i,z] - a_zero[i])
+ *                                           * (b[z,j] - b_zero[j]).
+ */
+
+__kernel void multiplyMatricesInt8Dequantize( const __global char4* a,
+                                              const __global char4* b_t,
+                                              const __global float* a_scale,
+                                              const __global int* a_zero,
+                                              const __global float* b_scale,
+                                              const __global int* b_zero,
+                                              __global float* c,
+                                              const unsigned int m,
+                                              const unsigned int n,
+                                              const unsigned int k ) {
+
+   /**
+    * Create submatrices that will cache the matrices a and b_t in local
+    * memory.
+    */
+
+   __local char4 a_sub[SUB_SIZE][SUB_SIZE];
+   __local char4 b_sub[SUB_SIZE][SUB_SIZE + 1];
+
+   int col = (int)get_global_id( 0 );
+   int row = (int)get_global_id( 1 );
+   int3 sum = accumulateInt8( a, b_t, k, a_sub, b_sub );
+
+   /**
+    * Expand the product of the zero-point corrected values in registers.
+    */
+
+   int za = a_zero[row];
+   int zb = b_zero[col];
+   int acc = sum.x - zb * sum.y - za * sum.z + (int)k * za * zb;
+   c[row * (int)n + col] = a_scale[row] * b_scale[col] * (float)acc;
+}
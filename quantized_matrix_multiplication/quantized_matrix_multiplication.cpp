@@ -0,0 +1,561 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code.
+void initializeDevice();
+// Store b[k,n] transposed, as b_t[n,k].
+void transposeMatrix( const int8_t* b,
+                      int8_t* b_t,
+                      const size_t k,
+                      const size_t n );
+// Sequentially performs the operation c[m,n] = a[m,k] * b[k,n].
+void seqMultiplyMatrices( const int8_t* a,
+                          const int8_t* b,
+                          int* c,
+                          const size_t m,
+                          const size_t n,
+                          const size_t k );
+// Sequentially multiplies and dequantizes two quantized matrices.
+void seqMultiplyDequantize( const int8_t* a,
+                            const int8_t* b,
+                            const float* a_scale,
+                            const int* a_zero,
+                            const float* b_scale,
+                            const int* b_zero,
+                            float* c,
+                            const size_t m,
+                            const size_t n,
+                            const size_t k );
+// Parallelly performs the operation c[m,n] = a[m,k] * b[k,n].
+void parMultiplyMatrices( int8_t* a,
+                          int8_t* b_t,
+                          int* c,
+                          const size_t m,
+                          const size_t n,
+                          const size_t k );
+// Parallelly multiplies and dequantizes two quantized matrices.
+void parMultiplyDequantize( int8_t* a,
+                            int8_t* b_t,
+                            float* a_scale,
+                            int* a_zero,
+                            float* b_scale,
+                            int* b_zero,
+                            float* c,
+                            const size_t m,
+                            const size_t n,
+                            const size_t k );
+// Check if the matrices c1 and c2 are equal.
+bool checkEquality( const int* c1,
+                    const int* c2,
+                    const size_t m,
+                    const size_t n );
+// Check if the matrices c1 and c2 are equal up to rounding errors.
+bool checkEquality( const float* c1,
+                    const float* c2,
+                    const size_t m,
+                    const size_t n );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+const size_t WG_SIZE[2] = { 16, 16 };   // The size of work-groups.
+constexpr size_t K_STEP = 4 * 16;       // The values of k per submatrix.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 10;
+
+   /**
+    * Prepare input constants related to the dimensions of the matrices.
+    * m and n must be multiples of the work-group size and k a multiple of
+    * K_STEP.
+    * */
+
+   constexpr size_t m = 1 << 8;
+   constexpr size_t k = 1 << 12;
+   constexpr size_t n = 1 << 8;
+   static_assert( m % 16 == 0 && n % 16 == 0 && k % K_STEP == 0,
+                  "Unsupported matrix dimensions." );
+
+   /**
+    * Prepare quantized input matrices a and b, with a scale and a zero
+    * point per row of a and per column of b.
+    * */
+
+   std::vector< int8_t > a( m * k );
+   for( size_t i = 0; i < m * k; i++ ) {
+      a[i] = static_cast< int8_t >( ( i * 7 ) % 255 - 127 );
+   }
+   std::vector< int8_t > b( k * n );
+   for( size_t i = 0; i < k * n; i++ ) {
+      b[i] = static_cast< int8_t >( ( i * 13 ) % 255 - 127 );
+   }
+   std::vector< int8_t > b_t( n * k );
+   transposeMatrix( b.data(), b_t.data(), k, n );
+
+   std::vector< float > a_scale( m );
+   std::vector< int > a_zero( m );
+   for( size_t i = 0; i < m; i++ ) {
+      a_scale[i] = 0.01f + 0.001f * static_cast< float >( i % 10 );
+      a_zero[i] = static_cast< int >( i % 7 ) - 3;
+   }
+   std::vector< float > b_scale( n );
+   std::vector< int > b_zero( n );
+   for( size_t i = 0; i < n; i++ ) {
+      b_scale[i] = 0.02f + 0.001f * static_cast< float >( i % 5 );
+      b_zero[i] = static_cast< int >( i % 5 ) - 2;
+   }
+
+   /**
+    * Prepare sequential and parallel output matrices.
+    * */
+
+   std::vector< int > cs( m * n );
+   std::vector< int > cp( m * n );
+   std::vector< float > ds( m * n );
+   std::vector< float > dp( m * n );
+
+   /**
+    * Sequentially multiply matrices.
+    * */
+
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      seqMultiplyMatrices( a.data(), b.data(), cs.data(), m, n, k );
+   }
+   double seq_time = getElapsedTime( start ) / executions;
+   seqMultiplyDequantize( a.data(),
+                          b.data(),
+                          a_scale.data(),
+                          a_zero.data(),
+                          b_scale.data(),
+                          b_zero.data(),
+                          ds.data(),
+                          m,
+                          n,
+                          k );
+
+   /**
+    * Initialize OpenCL device.
+    * */
+
+   initializeDevice();
+
+   /**
+    * Parallelly multiply matrices, with and without dequantization.
+    * */
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      parMultiplyMatrices( a.data(), b_t.data(), cp.data(), m, n, k );
+   }
+   double par_time = getElapsedTime( start ) / executions;
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      parMultiplyDequantize( a.data(),
+                             b_t.data(),
+                             a_scale.data(),
+                             a_zero.data(),
+                             b_scale.data(),
+                             b_zero.data(),
+                             dp.data(),
+                             m,
+                             n,
+                             k );
+   }
+   double dequant_time = getElapsedTime( start ) / executions;
+
+   /**
+    * Check if outputs are equal.
+    * */
+
+   bool equal = checkEquality( cs.data(), cp.data(), m, n );
+   bool dequant_equal = checkEquality( ds.data(), dp.data(), m, n );
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: "
+             << ( equal && dequant_equal ? "SUCCESS!" : "FAILED!" )
+             << "\n\tint32 accumulation: " << ( equal ? "SUCCESS" : "FAILED" )
+             << "\n\tDequantized: " << ( dequant_equal ? "SUCCESS" : "FAILED" )
+             << std::endl;
+   std::cout << "Results: \n\tA[0] = " << static_cast< int >( a[0] )
+             << "\n\tB[0] = " << static_cast< int >( b[0] )
+             << "\n\tC[0] = " << cp[0] << "\n\tD[0] = " << dp[0] << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << seq_time
+             << " ms;\n\tParallel: " << par_time
+             << " ms;\n\tParallel with dequantization: " << dequant_time
+             << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device and report whether it has integer
+    * dot product instructions.
+    * */
+
+   device = getDefaultDevice();
+   auto extensions = device.getInfo< CL_DEVICE_EXTENSIONS >();
+   std::cout << "cl_khr_integer_dot_product: "
+             << ( extensions.find( "cl_khr_integer_dot_product" )
+                        != std::string::npos
+                     ? "available"
+                     : "not available" )
+             << std::endl;
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "quantized_matrix_multiplication.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build( "-cl-std=CL3.0" );
+   if( err != CL_BUILD_SUCCESS ) {
+      err = program.build();
+   }
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Store b[k,n] transposed, as b_t[n,k], so that consecutive values of k can
+ * be packed four by four.
+ * */
+
+void transposeMatrix( const int8_t* b,
+                      int8_t* b_t,
+                      const size_t k,
+                      const size_t n ) {
+   for( size_t z = 0; z < k; z++ ) {
+      for( size_t j = 0; j < n; j++ ) {
+         b_t[j * k + z] = b[z * n + j];
+      }
+   }
+}
+
+/**
+ * Sequentially performs the operation c[m,n] = a[m,k] * b[k,n].
+ * */
+
+void seqMultiplyMatrices( const int8_t* a,
+                          const int8_t* b,
+                          int* c,
+                          const size_t m,
+                          const size_t n,
+                          const size_t k ) {
+   for( size_t i = 0; i < m; i++ ) {
+      for( size_t j = 0; j < n; j++ ) {
+         int sum = 0;
+         for( size_t z = 0; z < k; z++ ) {
+            sum += a[i * k + z] * b[j + z * n];
+         }
+         c[i * n + j] = sum;
+      }
+   }
+}
+
+/**
+ * Sequentially multiplies two quantized matrices a[m,k] and b[k,n] and
+ * dequantizes the result:
+ *    c[i,j] = a_scale[i] * b_scale[j]
+ *           * sum_z (a[i,z] - a_zero[i]) * (b[z,j] - b_zero[j]).
+ * */
+
+void seqMultiplyDequantize( const int8_t* a,
+                            const int8_t* b,
+                            const float* a_scale,
+                            const int* a_zero,
+                            const float* b_scale,
+                            const int* b_zero,
+                            float* c,
+                            const size_t m,
+                            const size_t n,
+                            const size_t k ) {
+   for( size_t i = 0; i < m; i++ ) {
+      for( size_t j = 0; j < n; j++ ) {
+         int sum = 0;
+         for( size_t z = 0; z < k; z++ ) {
+            sum += ( a[i * k + z] - a_zero[i] ) * ( b[j + z * n] - b_zero[j] );
+         }
+         c[i * n + j] = a_scale[i] * b_scale[j] * static_cast< float >( sum );
+      }
+   }
+}
+
+/**
+ * Parallelly performs the operation c[m,n] = a[m,k] * b[k,n], where b is
+ * given transposed as b_t[n,k].
+ * */
+
+void parMultiplyMatrices( int8_t* a,
+                          int8_t* b_t,
+                          int* c,
+                          const size_t m,
+                          const size_t n,
+                          const size_t k ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      m * k * sizeof( int8_t ),
+      a );
+   cl::Buffer b_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      k * n * sizeof( int8_t ),
+      b_t );
+   cl::Buffer c_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     m * n * sizeof( int ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, "multiplyMatricesInt8" );
+   kernel.setArg( 0, a_buf );
+   kernel.setArg( 1, b_buf );
+   kernel.setArg( 2, c_buf );
+   kernel.setArg( 3, static_cast< cl_uint >( m ) );
+   kernel.setArg( 4, static_cast< cl_uint >( n ) );
+   kernel.setArg( 5, static_cast< cl_uint >( k ) );
+
+   /**
+    * Execute the kernel function and collect its result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( n, m ),
+                               cl::NDRange( WG_SIZE[0], WG_SIZE[1] ) );
+   queue.enqueueReadBuffer( c_buf, CL_TRUE, 0, m * n * sizeof( int ), c );
+}
+
+/**
+ * Parallelly multiplies two quantized matrices a[m,k] and b[k,n], where b is
+ * given transposed as b_t[n,k], and dequantizes the result in the kernel
+ * epilogue.
+ * */
+
+void parMultiplyDequantize( int8_t* a,
+                            int8_t* b_t,
+                            float* a_scale,
+                            int* a_zero,
+                            float* b_scale,
+                            int* b_zero,
+                            float* c,
+                            const size_t m,
+                            const size_t n,
+                            const size_t k ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      m * k * sizeof( int8_t ),
+      a );
+   cl::Buffer b_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      k * n * sizeof( int8_t ),
+      b_t );
+   cl::Buffer a_scale_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      m * sizeof( float ),
+      a_scale );
+   cl::Buffer a_zero_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      m * sizeof( int ),
+      a_zero );
+   cl::Buffer b_scale_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      n * sizeof( float ),
+      b_scale );
+   cl::Buffer b_zero_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      n * sizeof( int ),
+      b_zero );
+   cl::Buffer c_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     m * n * sizeof( float ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, "multiplyMatricesInt8Dequantize" );
+   kernel.setArg( 0, a_buf );
+   kernel.setArg( 1, b_buf );
+   kernel.setArg( 2, a_scale_buf );
+   kernel.setArg( 3, a_zero_buf );
+   kernel.setArg( 4, b_scale_buf );
+   kernel.setArg( 5, b_zero_buf );
+   kernel.setArg( 6, c_buf );
+   kernel.setArg( 7, static_cast< cl_uint >( m ) );
+   kernel.setArg( 8, static_cast< cl_uint >( n ) );
+   kernel.setArg( 9, static_cast< cl_uint >( k ) );
+
+   /**
+    * Execute the kernel function and collect its result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( n, m ),
+                               cl::NDRange( WG_SIZE[0], WG_SIZE[1] ) );
+   queue.enqueueReadBuffer( c_buf, CL_TRUE, 0, m * n * sizeof( float ), c );
+}
+
+/**
+ * Check if the matrices C1 and C2 are equal.
+ * */
+
+bool checkEquality( const int* c1,
+                    const int* c2,
+                    const size_t m,
+                    const size_t n ) {
+   for( size_t i = 0; i < m * n; i++ ) {
+      if( c1[i] != c2[i] ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Check if the matrices C1 and C2 are equal up to rounding errors.
+ * */
+
+bool checkEquality( const float* c1,
+                    const float* c2,
+                    const size_t m,
+                    const size_t n ) {
+   for( size_t i = 0; i < m * n; i++ ) {
+      if( std::fabs( c1[i] - c2[i] )
+          > 1e-4f * std::max( 1.0f, std::fabs( c1[i] ) ) ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
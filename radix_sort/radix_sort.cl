@@ -0,0 +1,224 @@
+/**
+ * Declare the sort performed by this program. The host code defines:
+ *    - KEY_TYPE: the type of the keys, uint or ulong;
+ *    - VALUE_TYPE: the type of the values, when WITH_VALUES is defined;
+ *    - WG_SIZE: the work-group size, a power of two.
+ * Each pass sorts the keys by the RADIX_BITS bits starting at shift. Every
+ * work-group handles a tile of TILE_SIZE keys, ITEMS_PER_WORK_ITEM
+ * consecutive keys per work-item.
+ */
+
+#ifndef KEY_TYPE
+   #define KEY_TYPE uint
+#endif
+
+#ifndef VALUE_TYPE
+   #define VALUE_TYPE uint
+#endif
+
+#ifndef WG_SIZE
+   #define WG_SIZE 256
+#endif
+
+#define RADIX_BITS 4
+#define RADIX ( 1 << RADIX_BITS )
+#define ITEMS_PER_WORK_ITEM 4
+#define TILE_SIZE ( WG_SIZE * ITEMS_PER_WORK_ITEM )
+
+#define DIGIT( key, shift ) ( (uint)( ( key ) >> ( shift ) ) & ( RADIX - 1 ) )
+
+/**
+ * This kernel function counts the digits of every tile of keys[n], storing
+ * them digit-major in counts[digit * groups + group], so that the exclusive
+ * scan of counts gives the first output position of every digit of every
+ * tile.
+ */
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+countDigits( const __global KEY_TYPE* keys,
+             __global uint* counts,
+             const unsigned int n,
+             const unsigned int shift ) {
+
+   /**
+    * Create the local histogram.
+    */
+
+   __local uint histogram[RADIX];
+
+   uint local_index = get_local_id( 0 );
+   if( local_index < RADIX ) {
+      histogram[local_index] = 0;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Count the digits of the tile, reading the keys coalesced.
+    */
+
+   uint tile_start = get_group_id( 0 ) * TILE_SIZE;
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint index = tile_start + i * WG_SIZE + local_index;
+      if( index < n ) {
+         atomic_inc( &histogram[DIGIT( keys[index], shift )] );
+      }
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   if( local_index < RADIX ) {
+      counts[local_index * get_num_groups( 0 ) + get_group_id( 0 )]
+         = histogram[local_index];
+   }
+}
+
+/**
+ * Return the exclusive prefix sum of value over the work-group and store
+ * the total in total. scratch must hold WG_SIZE elements.
+ */
+
+uint scanWorkGroup( uint value, __local uint* scratch, uint* total ) {
+   uint local_index = get_local_id( 0 );
+   scratch[local_index] = value;
+   for( uint offset = 1; offset < WG_SIZE; offset *= 2 ) {
+      barrier( CLK_LOCAL_MEM_FENCE );
+      uint prev = local_index >= offset ? scratch[local_index - offset] : 0;
+      barrier( CLK_LOCAL_MEM_FENCE );
+      scratch[local_index] += prev;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+   *total = scratch[WG_SIZE - 1];
+   uint prefix = scratch[local_index] - value;
+   barrier( CLK_LOCAL_MEM_FENCE );
+   return prefix;
+}
+
+/**
+ * This kernel function moves every key of keys_in[n] (and its value) to its
+ * position in keys_out[n] for the digit at shift. offsets is the exclusive
+ * scan of the counts of countDigits. The tile is first sorted by digit in
+ * local memory with RADIX_BITS stable one-bit splits, so the keys of a
+ * digit leave the work-group as one contiguous run and the order of equal
+ * digits is kept.
+ */
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+scatterDigits( const __global KEY_TYPE* keys_in,
+               __global KEY_TYPE* keys_out,
+#ifdef WITH_VALUES
+               const __global VALUE_TYPE* values_in,
+               __global VALUE_TYPE* values_out,
+#endif
+               const __global uint* offsets,
+               const unsigned int n,
+               const unsigned int shift ) {
+
+   /**
+    * Create the local tile, the work-group scan array and the first
+    * position of every digit in the sorted tile and in the output.
+    */
+
+   __local KEY_TYPE tile_keys[TILE_SIZE];
+#ifdef WITH_VALUES
+   __local VALUE_TYPE tile_values[TILE_SIZE];
+#endif
+   __local uint scratch[WG_SIZE];
+   __local uint tile_starts[RADIX];
+   __local uint output_starts[RADIX];
+
+   uint local_index = get_local_id( 0 );
+   uint tile_start = get_group_id( 0 ) * TILE_SIZE;
+   uint tile_count = min( (uint)TILE_SIZE, n - tile_start );
+
+   /**
+    * Load the tile; missing keys have every bit set, so they are sorted
+    * after the others.
+    */
+
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint tile_index = i * WG_SIZE + local_index;
+      uint index = tile_start + tile_index;
+      tile_keys[tile_index] = index < n ? keys_in[index] : (KEY_TYPE)( -1 );
+#ifdef WITH_VALUES
+      tile_values[tile_index] = index < n ? values_in[index] : 0;
+#endif
+   }
+   if( local_index < RADIX ) {
+      tile_starts[local_index] = 0;
+      output_starts[local_index]
+         = offsets[local_index * get_num_groups( 0 ) + get_group_id( 0 )];
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Sort the tile by digit, one bit at a time: keys whose bit is clear
+    * keep their order at the front and the others follow.
+    */
+
+   uint first = local_index * ITEMS_PER_WORK_ITEM;
+   for( uint bit = shift; bit < shift + RADIX_BITS; bit++ ) {
+      KEY_TYPE keys[ITEMS_PER_WORK_ITEM];
+#ifdef WITH_VALUES
+      VALUE_TYPE values[ITEMS_PER_WORK_ITEM];
+#endif
+      uint zeros = 0;
+      for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+         keys[i] = tile_keys[first + i];
+#ifdef WITH_VALUES
+         values[i] = tile_values[first + i];
+#endif
+         zeros += ( ( keys[i] >> bit ) & 1 ) == 0;
+      }
+
+      uint total_zeros;
+      uint zeros_before = scanWorkGroup( zeros, scratch, &total_zeros );
+
+      for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+         uint position;
+         if( ( ( keys[i] >> bit ) & 1 ) == 0 ) {
+            position = zeros_before++;
+         } else {
+            position = total_zeros + first + i - zeros_before;
+         }
+         tile_keys[position] = keys[i];
+#ifdef WITH_VALUES
+         tile_values[position] = values[i];
+#endif
+      }
+      barrier( CLK_LOCAL_MEM_FENCE );
+   }
+
+   /**
+    * Find the first position of every digit in the sorted tile: a digit
+    * starts where it differs from the previous key.
+    */
+
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint tile_index = i * WG_SIZE + local_index;
+      if( tile_index < tile_count ) {
+         uint digit = DIGIT( tile_keys[tile_index], shift );
+         if( tile_index == 0
+             || digit != DIGIT( tile_keys[tile_index - 1], shift ) ) {
+            tile_starts[digit] = tile_index;
+         }
+      }
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Store the tile: consecutive work-items write consecutive positions of
+    * each digit run.
+    */
+
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint tile_index = i * WG_SIZE + local_index;
+      if( tile_index < tile_count ) {
+         KEY_TYPE key = tile_keys[tile_index];
+         uint digit = DIGIT( key, shift );
+         uint index = output_starts[digit] + tile_index - tile_starts[digit];
+         keys_out[index] = key;
+#ifdef WITH_VALUES
+         values_out[index] = tile_values[tile_index];
+#endif
+      }
+   }
+}
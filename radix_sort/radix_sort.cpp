@@ -0,0 +1,267 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "radix_sort.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Sequentially sort keys[n], moving values[n] with them when it is not NULL.
+template< typename K >
+void seqSort( K* keys, cl_uint* values, const size_t n );
+// Parallelly sort keys[n], moving values[n] with them when it is not NULL.
+template< typename K >
+void parSort( K* keys, cl_uint* values, const size_t n );
+// Compare the sequential and parallel sorts of n random keys.
+template< typename K >
+bool compareSorts( const std::string& name,
+                   const bool with_values,
+                   const size_t n );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+std::unique_ptr< RadixSort > radix_sort;   // The sort and its programs.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Initialize OpenCL device.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   radix_sort = std::make_unique< RadixSort >( context, device );
+
+   /**
+    * Compare the sorts of 32-bit and 64-bit keys, with and without values.
+    * */
+
+   constexpr size_t n = 1 << 24;
+   bool equal = compareSorts< cl_uint >( "32-bit keys", false, n );
+   equal = compareSorts< cl_uint >( "32-bit keys and values", true, n )
+        && equal;
+   equal = compareSorts< cl_ulong >( "64-bit keys", false, n ) && equal;
+   equal = compareSorts< cl_ulong >( "64-bit keys and values", true, n )
+        && equal;
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Sequentially sort keys[n], moving values[n] with them when it is not
+ * NULL: keys alone go through std::sort, key-value pairs through
+ * std::stable_sort, which keeps the order of the values of equal keys like
+ * the radix sort.
+ * */
+
+template< typename K >
+void seqSort( K* keys, cl_uint* values, const size_t n ) {
+   if( !values ) {
+      std::sort( keys, keys + n );
+      return;
+   }
+
+   std::vector< std::pair< K, cl_uint > > pairs( n );
+   for( size_t i = 0; i < n; i++ ) {
+      pairs[i] = { keys[i], values[i] };
+   }
+   std::stable_sort( pairs.begin(),
+                     pairs.end(),
+                     []( const auto& a, const auto& b ) {
+                        return a.first < b.first;
+                     } );
+   for( size_t i = 0; i < n; i++ ) {
+      keys[i] = pairs[i].first;
+      values[i] = pairs[i].second;
+   }
+}
+
+/**
+ * Parallelly sort keys[n], moving values[n] with them when it is not NULL.
+ * */
+
+template< typename K >
+void parSort( K* keys, cl_uint* values, const size_t n ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer keys_buf( context,
+                        CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                        n * sizeof( K ),
+                        keys );
+   cl::Buffer values_buf;
+   if( values ) {
+      values_buf = cl::Buffer( context,
+                               CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                               n * sizeof( cl_uint ),
+                               values );
+   }
+
+   /**
+    * Sort and collect the result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   if( values ) {
+      radix_sort->sortByKey< K >( queue, keys_buf, values_buf, n );
+      queue.enqueueReadBuffer( values_buf,
+                               CL_FALSE,
+                               0,
+                               n * sizeof( cl_uint ),
+                               values );
+   } else {
+      radix_sort->sort< K >( queue, keys_buf, n );
+   }
+   queue.enqueueReadBuffer( keys_buf, CL_TRUE, 0, n * sizeof( K ), keys );
+}
+
+/**
+ * Compare the sequential and parallel sorts of n random keys. Values are
+ * the original positions of the keys, so they also check stability.
+ * */
+
+template< typename K >
+bool compareSorts( const std::string& name,
+                   const bool with_values,
+                   const size_t n ) {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 5;
+
+   /**
+    * Prepare input keys, with many duplicates, and values.
+    * */
+
+   std::vector< K > keys( n );
+   std::vector< cl_uint > values( n );
+   K state = 88172645463325252ull & static_cast< K >( -1 );
+   for( size_t i = 0; i < n; i++ ) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      keys[i] = i % 4 == 0 ? state % 1024 : state;
+      values[i] = static_cast< cl_uint >( i );
+   }
+
+   /**
+    * Sequentially sort copies of the input.
+    * */
+
+   std::vector< K > ks;
+   std::vector< cl_uint > vs;
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      ks = keys;
+      vs = values;
+      seqSort( ks.data(), with_values ? vs.data() : nullptr, n );
+   }
+   double seq_time = getElapsedTime( start ) / executions;
+
+   /**
+    * Parallelly sort copies of the input; the first sort compiles the
+    * programs, so it is not measured.
+    * */
+
+   std::vector< K > kp = keys;
+   std::vector< cl_uint > vp = values;
+   parSort( kp.data(), with_values ? vp.data() : nullptr, n );
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      kp = keys;
+      vp = values;
+      parSort( kp.data(), with_values ? vp.data() : nullptr, n );
+   }
+   double par_time = getElapsedTime( start ) / executions;
+
+   /**
+    * Check if outputs are equal and print results.
+    * */
+
+   bool equal = ks == kp && ( !with_values || vs == vp );
+   std::cout << name << " (" << n << " elements):\n\tStatus: "
+             << ( equal ? "SUCCESS!" : "FAILED!" )
+             << "\n\tMean execution time: \n\t\tSequential: " << seq_time
+             << " ms;\n\t\tParallel: " << par_time << " ms."
+             << "\n\tPerformance gain: "
+             << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+   return equal;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
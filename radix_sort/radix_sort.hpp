@@ -0,0 +1,232 @@
+#ifndef RADIX_SORT_HPP
+#define RADIX_SORT_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "../scan/scan.hpp"
+
+/**
+ * Sort device buffers of 32-bit or 64-bit unsigned keys, optionally with a
+ * buffer of 32-bit values, with the kernels of radix_sort.cl. Every pass
+ * sorts the keys by 4 bits, from the least significant ones:
+ *    1. countDigits counts the digits of every tile in local memory;
+ *    2. Scan turns the counts into the output position of every digit of
+ *       every tile;
+ *    3. scatterDigits sorts every tile by digit in local memory and writes
+ *       the digit runs to their positions, keeping the order of equal keys.
+ * The keys are sorted in place; a temporary buffer of the same size holds
+ * the odd passes.
+ *
+ *    RadixSort radix_sort( context, device );
+ *    radix_sort.sortByKey< cl_uint >( queue, keys, values, n );
+ * */
+
+// =================================================================
+// ---------------------------- Traits -----------------------------
+// =================================================================
+
+// The OpenCL C name of the sorted key types.
+template< typename K >
+struct RadixKeyType;
+
+template<>
+struct RadixKeyType< cl_uint > {
+   static constexpr const char* name = "uint";
+};
+
+template<>
+struct RadixKeyType< cl_ulong > {
+   static constexpr const char* name = "ulong";
+};
+
+// =================================================================
+// --------------------------- RadixSort ---------------------------
+// =================================================================
+
+class RadixSort {
+ public:
+   // Bits sorted by every pass and elements per work-item; they must match
+   // radix_sort.cl.
+   static constexpr size_t RADIX_BITS = 4;
+   static constexpr size_t RADIX = 1 << RADIX_BITS;
+   static constexpr size_t ITEMS_PER_WORK_ITEM = 4;
+
+   RadixSort( const cl::Context& context,
+              const cl::Device& device,
+              const std::string& file_name = "../radix_sort/radix_sort.cl" )
+      : context_( context ), device_( device ), scan_( context, device ) {
+
+      /**
+       * Read the kernel file.
+       * */
+
+      std::ifstream kernel_file( file_name );
+      if( !kernel_file.is_open() ) {
+         std::cerr << "Fail to open " << file_name << "." << std::endl;
+         exit( 1 );
+      }
+      source_ = std::string( std::istreambuf_iterator< char >( kernel_file ),
+                             ( std::istreambuf_iterator< char >() ) );
+
+      /**
+       * Select the largest power-of-two work-group size up to 256.
+       * */
+
+      size_t limit = std::min< size_t >(
+         256, device.getInfo< CL_DEVICE_MAX_WORK_GROUP_SIZE >() );
+      local_size_ = 1;
+      while( 2 * local_size_ <= limit ) {
+         local_size_ *= 2;
+      }
+      tile_size_ = local_size_ * ITEMS_PER_WORK_ITEM;
+   }
+
+   // Sort keys[n].
+   template< typename K >
+   void sort( const cl::CommandQueue& queue,
+              const cl::Buffer& keys,
+              const size_t n ) {
+      run< K >( queue, keys, nullptr, n );
+   }
+
+   // Sort keys[n] and move values[n] with them; equal keys keep the order
+   // of their values.
+   template< typename K >
+   void sortByKey( const cl::CommandQueue& queue,
+                   const cl::Buffer& keys,
+                   const cl::Buffer& values,
+                   const size_t n ) {
+      run< K >( queue, keys, &values, n );
+   }
+
+ private:
+   // Sort keys[n], and values[n] when it is not NULL.
+   template< typename K >
+   void run( const cl::CommandQueue& queue,
+             const cl::Buffer& keys,
+             const cl::Buffer* values,
+             const size_t n ) {
+      if( n < 2 ) {
+         return;
+      }
+
+      /**
+       * Get the program and grow the temporary buffers when needed.
+       * */
+
+      std::string options = std::string( "-DKEY_TYPE=" )
+                          + RadixKeyType< K >::name
+                          + " -DWG_SIZE=" + std::to_string( local_size_ )
+                          + ( values ? " -DWITH_VALUES" : "" );
+      cl::Program& program = getProgram( options );
+      size_t tiles = ( n + tile_size_ - 1 ) / tile_size_;
+      reserve( temp_keys_, temp_keys_size_, n * sizeof( K ) );
+      if( values ) {
+         reserve( temp_values_, temp_values_size_, n * sizeof( cl_uint ) );
+      }
+      reserve( counts_, counts_size_, RADIX * tiles * sizeof( cl_uint ) );
+      reserve( offsets_, offsets_size_, RADIX * tiles * sizeof( cl_uint ) );
+
+      /**
+       * Sort by every digit, swapping the input and output buffers; the
+       * number of passes is even, so the result ends in keys.
+       * */
+
+      cl::Kernel count_kernel( program, "countDigits" );
+      cl::Kernel scatter_kernel( program, "scatterDigits" );
+      cl::Buffer keys_in = keys;
+      cl::Buffer keys_out = temp_keys_;
+      cl::Buffer values_in = values ? *values : cl::Buffer();
+      cl::Buffer values_out = temp_values_;
+      for( cl_uint shift = 0; shift < 8 * sizeof( K ); shift += RADIX_BITS ) {
+         count_kernel.setArg( 0, keys_in );
+         count_kernel.setArg( 1, counts_ );
+         count_kernel.setArg( 2, static_cast< cl_uint >( n ) );
+         count_kernel.setArg( 3, shift );
+         queue.enqueueNDRangeKernel( count_kernel,
+                                     cl::NullRange,
+                                     cl::NDRange( tiles * local_size_ ),
+                                     cl::NDRange( local_size_ ) );
+
+         scan_.exclusiveScan< cl_uint >(
+            queue, counts_, offsets_, RADIX * tiles );
+
+         cl_uint arg = 0;
+         scatter_kernel.setArg( arg++, keys_in );
+         scatter_kernel.setArg( arg++, keys_out );
+         if( values ) {
+            scatter_kernel.setArg( arg++, values_in );
+            scatter_kernel.setArg( arg++, values_out );
+         }
+         scatter_kernel.setArg( arg++, offsets_ );
+         scatter_kernel.setArg( arg++, static_cast< cl_uint >( n ) );
+         scatter_kernel.setArg( arg++, shift );
+         queue.enqueueNDRangeKernel( scatter_kernel,
+                                     cl::NullRange,
+                                     cl::NDRange( tiles * local_size_ ),
+                                     cl::NDRange( local_size_ ) );
+
+         std::swap( keys_in, keys_out );
+         std::swap( values_in, values_out );
+      }
+   }
+
+   // Reallocate buffer when it holds less than size bytes.
+   void reserve( cl::Buffer& buffer, size_t& capacity, const size_t size ) {
+      if( size > capacity ) {
+         buffer = cl::Buffer( context_,
+                              CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                              size );
+         capacity = size;
+      }
+   }
+
+   // Return the program built with options, compiling it on first use.
+   cl::Program& getProgram( const std::string& options ) {
+      auto found = programs_.find( options );
+      if( found != programs_.end() ) {
+         return found->second;
+      }
+
+      cl::Program::Sources sources{ source_ };
+      cl::Program program( context_, sources );
+      auto err = program.build( device_, options.c_str() );
+      if( err != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Status: "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device_ )
+                   << "\nBuild Options: " << options << "\nBuild Log:\t "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device_ )
+                   << std::endl;
+         exit( 1 );
+      }
+      return programs_.emplace( options, program ).first->second;
+   }
+
+   cl::Context context_;
+   cl::Device device_;
+   Scan scan_;
+   std::string source_;
+   std::map< std::string, cl::Program > programs_;
+   size_t local_size_;
+   size_t tile_size_;
+   cl::Buffer temp_keys_;
+   size_t temp_keys_size_ = 0;
+   cl::Buffer temp_values_;
+   size_t temp_values_size_ = 0;
+   cl::Buffer counts_;
+   size_t counts_size_ = 0;
+   cl::Buffer offsets_;
+   size_t offsets_size_ = 0;
+};
+
+#endif
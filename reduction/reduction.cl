@@ -0,0 +1,272 @@
+/**
+ * Declare the reduction performed by this program. The host code defines:
+ *    - REDUCE_TYPE: the type of the reduced values (e.g. int, uint, float);
+ *    - REDUCE_OP: add, min or max, named after the built-in reductions;
+ *    - REDUCE_IDENTITY: the identity of REDUCE_OP for REDUCE_TYPE;
+ *    - COMPARE_TYPE: the type of the arrays compared by countDifferences.
+ */
+
+#ifndef REDUCE_TYPE
+   #define REDUCE_TYPE int
+#endif
+
+#ifndef REDUCE_OP
+   #define REDUCE_OP add
+#endif
+
+#ifndef REDUCE_IDENTITY
+   #define REDUCE_IDENTITY 0
+#endif
+
+#ifndef COMPARE_TYPE
+   #define COMPARE_TYPE REDUCE_TYPE
+#endif
+
+/**
+ * Select how work-groups are reduced, unless the host code forces one path
+ * with REDUCE_WORK_GROUP, REDUCE_SUB_GROUP or REDUCE_TREE:
+ *    - work_group_reduce_* when work-group collective functions are
+ *      supported (OpenCL C 2.0, or the OpenCL C 3.0 optional feature);
+ *    - sub_group_reduce_* and a small local array of sub-group results when
+ *      sub-groups are supported (OpenCL C 3.0 feature or cl_khr_subgroups);
+ *    - a tree in local memory otherwise, which needs a power-of-two
+ *      work-group size.
+ */
+
+#if !defined( REDUCE_WORK_GROUP ) && !defined( REDUCE_SUB_GROUP ) \
+   && !defined( REDUCE_TREE )
+   #if defined( __opencl_c_work_group_collective_functions ) \
+      || __OPENCL_C_VERSION__ == 200
+      #define REDUCE_WORK_GROUP
+   #elif defined( __opencl_c_subgroups ) || defined( cl_khr_subgroups )
+      #define REDUCE_SUB_GROUP
+   #else
+      #define REDUCE_TREE
+   #endif
+#endif
+
+#if defined( REDUCE_SUB_GROUP ) && !defined( __opencl_c_subgroups )
+   #pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+/**
+ * Combine two values with one of the reduction operations.
+ */
+
+#define COMBINE_add( a, b ) ( ( a ) + ( b ) )
+#define COMBINE_min( a, b ) min( a, b )
+#define COMBINE_max( a, b ) max( a, b )
+#define COMBINE_IMPL( OP, a, b ) COMBINE_##OP( a, b )
+#define COMBINE( OP, a, b ) COMBINE_IMPL( OP, a, b )
+
+/**
+ * Define a function NAME which reduces the value of every work-item of the
+ * work-group with the operation OP and returns the result to all of them.
+ * scratch must hold one value per work-item.
+ */
+
+#if defined( REDUCE_WORK_GROUP )
+
+   #define DEFINE_WORK_GROUP_REDUCE_IMPL( NAME, TYPE, OP, IDENTITY ) \
+      TYPE NAME( TYPE value, __local TYPE* scratch ) {              \
+         return work_group_reduce_##OP( value );                    \
+      }
+
+#elif defined( REDUCE_SUB_GROUP )
+
+   #define DEFINE_WORK_GROUP_REDUCE_IMPL( NAME, TYPE, OP, IDENTITY )      \
+      TYPE NAME( TYPE value, __local TYPE* scratch ) {                   \
+         value = sub_group_reduce_##OP( value );                         \
+         if( get_sub_group_local_id() == 0 ) {                           \
+            scratch[get_sub_group_id()] = value;                         \
+         }                                                               \
+         barrier( CLK_LOCAL_MEM_FENCE );                                 \
+         value = IDENTITY;                                               \
+         for( uint i = get_sub_group_local_id(); i < get_num_sub_groups(); \
+              i += get_sub_group_size() ) {                              \
+            value = COMBINE_##OP( value, scratch[i] );                   \
+         }                                                               \
+         value = sub_group_reduce_##OP( value );                         \
+         barrier( CLK_LOCAL_MEM_FENCE );                                 \
+         return value;                                                   \
+      }
+
+#else
+
+   #define DEFINE_WORK_GROUP_REDUCE_IMPL( NAME, TYPE, OP, IDENTITY )         \
+      TYPE NAME( TYPE value, __local TYPE* scratch ) {                      \
+         uint local_index = get_local_id( 0 );                              \
+         scratch[local_index] = value;                                      \
+         for( uint offset = get_local_size( 0 ) / 2; offset > 0;            \
+              offset /= 2 ) {                                               \
+            barrier( CLK_LOCAL_MEM_FENCE );                                 \
+            if( local_index < offset ) {                                    \
+               scratch[local_index] = COMBINE_##OP( scratch[local_index],   \
+                                                    scratch[local_index     \
+                                                            + offset] );    \
+            }                                                               \
+         }                                                                  \
+         barrier( CLK_LOCAL_MEM_FENCE );                                    \
+         value = scratch[0];                                                \
+         barrier( CLK_LOCAL_MEM_FENCE );                                    \
+         return value;                                                      \
+      }
+
+#endif
+
+#define DEFINE_WORK_GROUP_REDUCE( NAME, TYPE, OP, IDENTITY ) \
+   DEFINE_WORK_GROUP_REDUCE_IMPL( NAME, TYPE, OP, IDENTITY )
+
+DEFINE_WORK_GROUP_REDUCE( reduceWorkGroup,
+                          REDUCE_TYPE,
+                          REDUCE_OP,
+                          REDUCE_IDENTITY )
+DEFINE_WORK_GROUP_REDUCE( reduceIndices, uint, min, UINT_MAX )
+
+/**
+ * This kernel function reduces input[n] to one value per work-group, stored
+ * in partial[group]. Each work-item first reduces a strided range of
+ * elements in registers, so the host can launch far fewer work-items than
+ * elements. Running it again on the partial results, with a single
+ * work-group, completes a two-pass reduction.
+ */
+
+__kernel void reduce( const __global REDUCE_TYPE* input,
+                      __global REDUCE_TYPE* partial,
+                      const unsigned int n,
+                      __local REDUCE_TYPE* scratch ) {
+
+   /**
+    * Reduce the elements of this work-item.
+    */
+
+   REDUCE_TYPE value = REDUCE_IDENTITY;
+   for( uint i = get_global_id( 0 ); i < n; i += get_global_size( 0 ) ) {
+      value = COMBINE( REDUCE_OP, value, input[i] );
+   }
+
+   /**
+    * Reduce the work-group and store its result.
+    */
+
+   value = reduceWorkGroup( value, scratch );
+   if( get_local_id( 0 ) == 0 ) {
+      partial[get_group_id( 0 )] = value;
+   }
+}
+
+/**
+ * This kernel function reduces input[n] to result[0] in a single pass: every
+ * work-group combines its result atomically, so result[0] must be
+ * initialized with REDUCE_IDENTITY. It is only available for 32-bit integer
+ * types, the ones supported by the atomic built-ins, for which the host
+ * defines REDUCE_ATOMIC.
+ */
+
+#ifdef REDUCE_ATOMIC
+
+#define ATOMIC_IMPL( OP, pointer, value ) atomic_##OP( pointer, value )
+#define ATOMIC( OP, pointer, value ) ATOMIC_IMPL( OP, pointer, value )
+
+__kernel void reduceAtomic( const __global REDUCE_TYPE* input,
+                            volatile __global REDUCE_TYPE* result,
+                            const unsigned int n,
+                            __local REDUCE_TYPE* scratch ) {
+
+   /**
+    * Reduce the elements of this work-item.
+    */
+
+   REDUCE_TYPE value = REDUCE_IDENTITY;
+   for( uint i = get_global_id( 0 ); i < n; i += get_global_size( 0 ) ) {
+      value = COMBINE( REDUCE_OP, value, input[i] );
+   }
+
+   /**
+    * Reduce the work-group and combine its result with the others.
+    */
+
+   value = reduceWorkGroup( value, scratch );
+   if( get_local_id( 0 ) == 0 ) {
+      ATOMIC( REDUCE_OP, result, value );
+   }
+}
+
+#endif
+
+/**
+ * This kernel function counts the elements which differ between a[n] and
+ * b[n], storing one count per work-group in partial[group]. The counts are
+ * completed by reduce, so REDUCE_TYPE must be uint and REDUCE_OP add.
+ */
+
+__kernel void countDifferences( const __global COMPARE_TYPE* a,
+                                const __global COMPARE_TYPE* b,
+                                __global REDUCE_TYPE* partial,
+                                const unsigned int n,
+                                __local REDUCE_TYPE* scratch ) {
+
+   /**
+    * Count the differences of this work-item.
+    */
+
+   REDUCE_TYPE count = 0;
+   for( uint i = get_global_id( 0 ); i < n; i += get_global_size( 0 ) ) {
+      count += a[i] != b[i] ? 1 : 0;
+   }
+
+   /**
+    * Reduce the work-group and store its result.
+    */
+
+   count = reduceWorkGroup( count, scratch );
+   if( get_local_id( 0 ) == 0 ) {
+      partial[get_group_id( 0 )] = count;
+   }
+}
+
+/**
+ * This kernel function finds the greatest element of input[n] and its index,
+ * storing one pair per work-group in partial[group] and
+ * partial_indices[group]; ties are resolved to the smallest index. In the
+ * first pass input_indices must be NULL, so the position of each element is
+ * its index; the second pass reads the indices of the partial results.
+ * REDUCE_OP must be max.
+ */
+
+__kernel void argmax( const __global REDUCE_TYPE* input,
+                      const __global uint* input_indices,
+                      __global REDUCE_TYPE* partial,
+                      __global uint* partial_indices,
+                      const unsigned int n,
+                      __local REDUCE_TYPE* scratch,
+                      __local uint* index_scratch ) {
+
+   /**
+    * Find the greatest element of this work-item.
+    */
+
+   REDUCE_TYPE best = REDUCE_IDENTITY;
+   uint best_index = UINT_MAX;
+   for( uint i = get_global_id( 0 ); i < n; i += get_global_size( 0 ) ) {
+      REDUCE_TYPE value = input[i];
+      uint index = input_indices ? input_indices[i] : i;
+      if( value > best || ( value == best && index < best_index ) ) {
+         best = value;
+         best_index = index;
+      }
+   }
+
+   /**
+    * Reduce the greatest value of the work-group, then the smallest index
+    * holding it.
+    */
+
+   REDUCE_TYPE group_best = reduceWorkGroup( best, scratch );
+   best_index = reduceIndices( best == group_best ? best_index : UINT_MAX,
+                               index_scratch );
+   if( get_local_id( 0 ) == 0 ) {
+      partial[get_group_id( 0 )] = group_best;
+      partial_indices[get_group_id( 0 )] = best_index;
+   }
+}
@@ -0,0 +1,341 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "reduction.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Sequentially find the sum, min, max and argmax of a[n].
+template< typename T >
+void seqReduce( const T* a,
+                const size_t n,
+                double& sum,
+                T& min,
+                T& max,
+                size_t& argmax );
+// Parallelly find the sum, min, max and argmax of a buffer of n elements.
+template< typename T >
+void parReduce( Reduction& reduction,
+                const cl::CommandQueue& queue,
+                const cl::Buffer& a_buf,
+                const size_t n,
+                T& sum,
+                T& min,
+                T& max,
+                std::pair< T, unsigned int >& argmax );
+// Check if the sums s1 and s2 are equal, up to rounding errors for floats.
+bool checkSum( const double s1, const double s2, const size_t n );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 10;
+   bool equal = true;
+
+   /**
+    * Prepare input arrays: the greatest value appears twice, so argmax
+    * must return the first one.
+    * */
+
+   constexpr size_t n = 1 << 26;
+   std::vector< int > a( n );
+   std::vector< float > f( n );
+   for( size_t i = 0; i < n; i++ ) {
+      a[i] = static_cast< int >( ( i * 7919 ) % 2001 ) - 1000;
+      f[i] = static_cast< float >( ( i * 104729 ) % 1000 ) / 1000.0f - 0.5f;
+   }
+   a[n / 3] = a[2 * n / 3] = 1 << 20;
+   f[n / 5] = f[4 * n / 5] = 2.0f;
+
+   /**
+    * Sequentially reduce arrays.
+    * */
+
+   double seq_int_sum, seq_float_sum;
+   int seq_int_min, seq_int_max;
+   float seq_float_min, seq_float_max;
+   size_t seq_int_argmax, seq_float_argmax;
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      seqReduce( a.data(),
+                 n,
+                 seq_int_sum,
+                 seq_int_min,
+                 seq_int_max,
+                 seq_int_argmax );
+      seqReduce( f.data(),
+                 n,
+                 seq_float_sum,
+                 seq_float_min,
+                 seq_float_max,
+                 seq_float_argmax );
+   }
+   double seq_time = getElapsedTime( start ) / executions;
+
+   /**
+    * Initialize OpenCL device and upload the arrays.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   cl::CommandQueue queue( context, device );
+   cl::Buffer a_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      n * sizeof( int ),
+      a.data() );
+   cl::Buffer f_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      n * sizeof( float ),
+      f.data() );
+
+   /**
+    * Parallelly reduce arrays with every work-group path the device
+    * supports.
+    * */
+
+   const std::vector< std::pair< Reduction::Path, std::string > > paths = {
+      { Reduction::Path::Auto, "Auto" },
+      { Reduction::Path::WorkGroup, "Work-group" },
+      { Reduction::Path::SubGroup, "Sub-group" },
+      { Reduction::Path::Tree, "Local tree" },
+   };
+   double par_time = 0.0;
+   std::cout << std::fixed << std::setprecision( 3 )
+             << "Mean execution time of sum, min, max and argmax of "
+             << n << " ints and floats:" << std::endl;
+   for( const auto& path : paths ) {
+      if( !Reduction::isSupported( device, path.first ) ) {
+         std::cout << "\t" << std::setw( 10 ) << path.second
+                   << ": not supported." << std::endl;
+         continue;
+      }
+      Reduction reduction( context, device, path.first );
+
+      int int_sum, int_min, int_max;
+      float float_sum, float_min, float_max;
+      std::pair< int, unsigned int > int_argmax;
+      std::pair< float, unsigned int > float_argmax;
+
+      // The first run compiles the programs, so it is not measured.
+      for( int i = 0; i <= executions; i++ ) {
+         if( i == 1 ) {
+            start = std::chrono::steady_clock::now();
+         }
+         parReduce( reduction,
+                    queue,
+                    a_buf,
+                    n,
+                    int_sum,
+                    int_min,
+                    int_max,
+                    int_argmax );
+         parReduce( reduction,
+                    queue,
+                    f_buf,
+                    n,
+                    float_sum,
+                    float_min,
+                    float_max,
+                    float_argmax );
+      }
+      double path_time = getElapsedTime( start ) / executions;
+      if( path.first == Reduction::Path::Auto ) {
+         par_time = path_time;
+      }
+
+      // Integer sums wrap around like the sequential sum converted to int.
+      bool path_equal
+         = int_sum == static_cast< int >( static_cast< long long >(
+              seq_int_sum ) )
+        && int_min == seq_int_min && int_max == seq_int_max
+        && int_argmax.first == seq_int_max
+        && int_argmax.second == seq_int_argmax
+        && checkSum( seq_float_sum, float_sum, n )
+        && float_min == seq_float_min && float_max == seq_float_max
+        && float_argmax.first == seq_float_max
+        && float_argmax.second == seq_float_argmax;
+      equal = equal && path_equal;
+
+      // Each operation reads both arrays once.
+      double gb = 4.0 * 2.0 * n * sizeof( int ) / 1e9;
+      std::cout << "\t" << std::setw( 10 ) << path.second << ": "
+                << path_time << " ms; " << gb / ( path_time * 1e-3 )
+                << " GB/s" << ( path_equal ? "" : " (FAILED)" ) << std::endl;
+   }
+
+   /**
+    * Compare the two-pass sum with the single-pass atomic sum.
+    * */
+
+   Reduction reduction( context, device );
+   int two_pass_sum = reduction.sum< int >( queue, a_buf, n );
+   int atomic_sum = reduction.reduceAtomic< int >(
+      queue, Reduction::Operation::Add, a_buf, n );
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      two_pass_sum = reduction.sum< int >( queue, a_buf, n );
+   }
+   double two_pass_time = getElapsedTime( start ) / executions;
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      atomic_sum = reduction.reduceAtomic< int >(
+         queue, Reduction::Operation::Add, a_buf, n );
+   }
+   double atomic_time = getElapsedTime( start ) / executions;
+   equal = equal && two_pass_sum == atomic_sum;
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Integer sum: \n\tTwo passes: " << two_pass_time
+             << " ms;\n\tAtomic: " << atomic_time << " ms." << std::endl;
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Results: \n\tsum(a) = " << two_pass_sum
+             << "\n\tmax(a) = a[" << seq_int_argmax << "] = " << seq_int_max
+             << "\n\tmax(f) = f[" << seq_float_argmax << "] = " << seq_float_max
+             << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << seq_time
+             << " ms;\n\tParallel: " << par_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Sequentially find the sum, min, max and argmax of a[n]. The sum is
+ * accumulated in double, which is exact for the int inputs.
+ * */
+
+template< typename T >
+void seqReduce( const T* a,
+                const size_t n,
+                double& sum,
+                T& min,
+                T& max,
+                size_t& argmax ) {
+   sum = 0.0;
+   min = a[0];
+   max = a[0];
+   argmax = 0;
+   for( size_t i = 0; i < n; i++ ) {
+      sum += static_cast< double >( a[i] );
+      if( a[i] < min ) {
+         min = a[i];
+      }
+      if( a[i] > max ) {
+         max = a[i];
+         argmax = i;
+      }
+   }
+}
+
+/**
+ * Parallelly find the sum, min, max and argmax of a buffer of n elements.
+ * */
+
+template< typename T >
+void parReduce( Reduction& reduction,
+                const cl::CommandQueue& queue,
+                const cl::Buffer& a_buf,
+                const size_t n,
+                T& sum,
+                T& min,
+                T& max,
+                std::pair< T, unsigned int >& argmax ) {
+   sum = reduction.sum< T >( queue, a_buf, n );
+   min = reduction.min< T >( queue, a_buf, n );
+   max = reduction.max< T >( queue, a_buf, n );
+   argmax = reduction.argmax< T >( queue, a_buf, n );
+}
+
+/**
+ * Check if the sums s1 and s2 are equal, up to rounding errors for floats,
+ * which grow with the number n of summed values.
+ * */
+
+bool checkSum( const double s1, const double s2, const size_t n ) {
+   return std::fabs( s1 - s2 ) <= 1e-6 * static_cast< double >( n );
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
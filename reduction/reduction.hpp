@@ -0,0 +1,452 @@
+#ifndef REDUCTION_HPP
+#define REDUCTION_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Reduce device buffers with the kernels of reduction.cl: sum, min, max,
+ * argmax and the number of differences between two buffers. Each work-item
+ * reduces a strided range of elements in registers, each work-group reduces
+ * its work-items with the fastest path the device supports and a second
+ * pass (or an atomic, for integer sums, mins and maxs) reduces the
+ * work-groups. Programs are compiled on first use and cached by their
+ * options:
+ *
+ *    Reduction reduction( context, device );
+ *    int sum = reduction.sum< int >( queue, buffer, n );
+ * */
+
+// =================================================================
+// ---------------------------- Traits -----------------------------
+// =================================================================
+
+// The OpenCL C name of the reduced types.
+template< typename T >
+struct ReductionType;
+
+template<>
+struct ReductionType< int > {
+   static constexpr const char* name = "int";
+   static constexpr const char* lowest = "INT_MIN";
+   static constexpr const char* highest = "INT_MAX";
+};
+
+template<>
+struct ReductionType< unsigned int > {
+   static constexpr const char* name = "uint";
+   static constexpr const char* lowest = "0";
+   static constexpr const char* highest = "UINT_MAX";
+};
+
+template<>
+struct ReductionType< float > {
+   static constexpr const char* name = "float";
+   static constexpr const char* lowest = "-INFINITY";
+   static constexpr const char* highest = "INFINITY";
+};
+
+template<>
+struct ReductionType< unsigned char > {
+   static constexpr const char* name = "uchar";
+   static constexpr const char* lowest = "0";
+   static constexpr const char* highest = "UCHAR_MAX";
+};
+
+// =================================================================
+// --------------------------- Reduction ---------------------------
+// =================================================================
+
+class Reduction {
+ public:
+   // The operations reduce and reduceAtomic can perform.
+   enum class Operation { Add, Min, Max };
+
+   // How work-groups are reduced: Auto lets the kernel pick the fastest
+   // path the device compiler supports; the others force one path.
+   enum class Path { Auto, WorkGroup, SubGroup, Tree };
+
+   // Maximum number of work-groups of the first pass, which is the number
+   // of partial results reduced by the second pass.
+   static constexpr size_t MAX_GROUPS = 1024;
+   // Number of elements each work-item reduces before the work-group does.
+   static constexpr size_t ITEMS_PER_WORK_ITEM = 8;
+
+   Reduction( const cl::Context& context,
+              const cl::Device& device,
+              const Path path = Path::Auto,
+              const std::string& file_name = "../reduction/reduction.cl" )
+      : context_( context ), device_( device ) {
+
+      /**
+       * Read the kernel file and select the language version, which makes
+       * the work-group and sub-group features visible to the compiler.
+       * */
+
+      std::ifstream kernel_file( file_name );
+      if( !kernel_file.is_open() ) {
+         std::cerr << "Fail to open " << file_name << "." << std::endl;
+         exit( 1 );
+      }
+      source_ = std::string( std::istreambuf_iterator< char >( kernel_file ),
+                             ( std::istreambuf_iterator< char >() ) );
+
+      std::string version = device.getInfo< CL_DEVICE_VERSION >();
+      if( version.compare( 0, 8, "OpenCL 3" ) == 0 ) {
+         base_options_ = "-cl-std=CL3.0";
+      } else if( version.compare( 0, 8, "OpenCL 2" ) == 0 ) {
+         base_options_ = "-cl-std=CL2.0";
+      }
+      if( path == Path::WorkGroup ) {
+         base_options_ += " -DREDUCE_WORK_GROUP";
+      } else if( path == Path::SubGroup ) {
+         base_options_ += " -DREDUCE_SUB_GROUP";
+      } else if( path == Path::Tree ) {
+         base_options_ += " -DREDUCE_TREE";
+      }
+
+      /**
+       * Allocate the partial results and the final result, large enough
+       * for any reduced type and its index.
+       * */
+
+      partial_ = cl::Buffer( context,
+                             CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                             MAX_GROUPS * sizeof( cl_ulong ) );
+      partial_indices_ = cl::Buffer( context,
+                                     CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                     MAX_GROUPS * sizeof( cl_uint ) );
+      result_ = cl::Buffer( context, CL_MEM_READ_WRITE, sizeof( cl_ulong ) );
+      result_index_
+         = cl::Buffer( context, CL_MEM_READ_WRITE, sizeof( cl_uint ) );
+   }
+
+   // Check whether device can compile a path forced by the constructor.
+   static bool isSupported( const cl::Device& device, const Path path ) {
+      std::string version = device.getInfo< CL_DEVICE_VERSION >();
+      bool is_2x = version.compare( 0, 8, "OpenCL 2" ) == 0;
+      bool is_3x = version.compare( 0, 8, "OpenCL 3" ) == 0;
+      std::string extensions = device.getInfo< CL_DEVICE_EXTENSIONS >();
+      switch( path ) {
+         case Path::WorkGroup:
+            return is_2x
+                || ( is_3x
+                     && device.getInfo<
+                        CL_DEVICE_WORK_GROUP_COLLECTIVE_FUNCTIONS_SUPPORT >() );
+         case Path::SubGroup:
+            return extensions.find( "cl_khr_subgroups" ) != std::string::npos
+                || ( is_3x
+                     && device.getInfo< CL_DEVICE_MAX_NUM_SUB_GROUPS >() > 0 );
+         default:
+            return true;
+      }
+   }
+
+   // Reduce input[n] with operation in two passes.
+   template< typename T >
+   T reduce( const cl::CommandQueue& queue,
+             const Operation operation,
+             const cl::Buffer& input,
+             const size_t n ) {
+      cl::Program& program = getProgram( getOptions< T >( operation ) );
+      cl::Kernel kernel( program, "reduce" );
+      size_t local_size = getLocalSize( kernel );
+      size_t groups = getGroups( n, local_size );
+
+      /**
+       * Reduce the input to one value per work-group; a single work-group
+       * writes the result directly.
+       * */
+
+      const cl::Buffer& first_output = groups == 1 ? result_ : partial_;
+      kernel.setArg( 0, input );
+      kernel.setArg( 1, first_output );
+      kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      kernel.setArg( 3, cl::Local( local_size * sizeof( T ) ) );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( groups * local_size ),
+                                  cl::NDRange( local_size ) );
+
+      /**
+       * Reduce the partial results with a single work-group.
+       * */
+
+      if( groups > 1 ) {
+         cl::Kernel final_kernel( program, "reduce" );
+         final_kernel.setArg( 0, partial_ );
+         final_kernel.setArg( 1, result_ );
+         final_kernel.setArg( 2, static_cast< cl_uint >( groups ) );
+         final_kernel.setArg( 3, cl::Local( local_size * sizeof( T ) ) );
+         queue.enqueueNDRangeKernel( final_kernel,
+                                     cl::NullRange,
+                                     cl::NDRange( local_size ),
+                                     cl::NDRange( local_size ) );
+      }
+
+      T result;
+      queue.enqueueReadBuffer( result_, CL_TRUE, 0, sizeof( T ), &result );
+      return result;
+   }
+
+   // Reduce input[n] with operation in a single pass, combining the
+   // work-groups with atomics. Only int and unsigned int are supported.
+   template< typename T >
+   T reduceAtomic( const cl::CommandQueue& queue,
+                   const Operation operation,
+                   const cl::Buffer& input,
+                   const size_t n ) {
+      static_assert( std::is_same_v< T, int >
+                        || std::is_same_v< T, unsigned int >,
+                     "Atomic reductions need 32-bit integers." );
+      cl::Program& program = getProgram( getOptions< T >( operation ) );
+      cl::Kernel kernel( program, "reduceAtomic" );
+      size_t local_size = getLocalSize( kernel );
+      size_t groups = getGroups( n, local_size );
+
+      /**
+       * Initialize the result with the identity and reduce the input.
+       * */
+
+      T identity = getIdentity< T >( operation );
+      queue.enqueueFillBuffer( result_, identity, 0, sizeof( T ) );
+      kernel.setArg( 0, input );
+      kernel.setArg( 1, result_ );
+      kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      kernel.setArg( 3, cl::Local( local_size * sizeof( T ) ) );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( groups * local_size ),
+                                  cl::NDRange( local_size ) );
+
+      T result;
+      queue.enqueueReadBuffer( result_, CL_TRUE, 0, sizeof( T ), &result );
+      return result;
+   }
+
+   template< typename T >
+   T sum( const cl::CommandQueue& queue, const cl::Buffer& input, size_t n ) {
+      return reduce< T >( queue, Operation::Add, input, n );
+   }
+
+   template< typename T >
+   T min( const cl::CommandQueue& queue, const cl::Buffer& input, size_t n ) {
+      return reduce< T >( queue, Operation::Min, input, n );
+   }
+
+   template< typename T >
+   T max( const cl::CommandQueue& queue, const cl::Buffer& input, size_t n ) {
+      return reduce< T >( queue, Operation::Max, input, n );
+   }
+
+   // Return the greatest element of input[n] and its smallest index.
+   template< typename T >
+   std::pair< T, unsigned int > argmax( const cl::CommandQueue& queue,
+                                        const cl::Buffer& input,
+                                        const size_t n ) {
+      cl::Program& program = getProgram( getOptions< T >( Operation::Max ) );
+      cl::Kernel kernel( program, "argmax" );
+      size_t local_size = getLocalSize( kernel );
+      size_t groups = getGroups( n, local_size );
+
+      /**
+       * Find the greatest element of every work-group; the indices of the
+       * first pass are the positions of the elements.
+       * */
+
+      kernel.setArg( 0, input );
+      kernel.setArg( 1, sizeof( cl_mem ), nullptr );
+      kernel.setArg( 2, groups == 1 ? result_ : partial_ );
+      kernel.setArg( 3, groups == 1 ? result_index_ : partial_indices_ );
+      kernel.setArg( 4, static_cast< cl_uint >( n ) );
+      kernel.setArg( 5, cl::Local( local_size * sizeof( T ) ) );
+      kernel.setArg( 6, cl::Local( local_size * sizeof( cl_uint ) ) );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( groups * local_size ),
+                                  cl::NDRange( local_size ) );
+
+      /**
+       * Find the greatest partial result with a single work-group.
+       * */
+
+      if( groups > 1 ) {
+         cl::Kernel final_kernel( program, "argmax" );
+         final_kernel.setArg( 0, partial_ );
+         final_kernel.setArg( 1, partial_indices_ );
+         final_kernel.setArg( 2, result_ );
+         final_kernel.setArg( 3, result_index_ );
+         final_kernel.setArg( 4, static_cast< cl_uint >( groups ) );
+         final_kernel.setArg( 5, cl::Local( local_size * sizeof( T ) ) );
+         final_kernel.setArg( 6, cl::Local( local_size * sizeof( cl_uint ) ) );
+         queue.enqueueNDRangeKernel( final_kernel,
+                                     cl::NullRange,
+                                     cl::NDRange( local_size ),
+                                     cl::NDRange( local_size ) );
+      }
+
+      std::pair< T, unsigned int > result;
+      queue.enqueueReadBuffer( result_,
+                               CL_FALSE,
+                               0,
+                               sizeof( T ),
+                               &result.first );
+      queue.enqueueReadBuffer( result_index_,
+                               CL_TRUE,
+                               0,
+                               sizeof( cl_uint ),
+                               &result.second );
+      return result;
+   }
+
+   // Count the elements which differ between a[n] and b[n].
+   template< typename T >
+   size_t countDifferences( const cl::CommandQueue& queue,
+                            const cl::Buffer& a,
+                            const cl::Buffer& b,
+                            const size_t n ) {
+      cl::Program& program
+         = getProgram( getOptions< unsigned int >( Operation::Add )
+                       + " -DCOMPARE_TYPE=" + ReductionType< T >::name );
+      cl::Kernel kernel( program, "countDifferences" );
+      size_t local_size = getLocalSize( kernel );
+      size_t groups = getGroups( n, local_size );
+
+      /**
+       * Count the differences of every work-group.
+       * */
+
+      kernel.setArg( 0, a );
+      kernel.setArg( 1, b );
+      kernel.setArg( 2, groups == 1 ? result_ : partial_ );
+      kernel.setArg( 3, static_cast< cl_uint >( n ) );
+      kernel.setArg( 4, cl::Local( local_size * sizeof( cl_uint ) ) );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( groups * local_size ),
+                                  cl::NDRange( local_size ) );
+
+      /**
+       * Sum the counts with a single work-group.
+       * */
+
+      if( groups > 1 ) {
+         cl::Kernel final_kernel( program, "reduce" );
+         final_kernel.setArg( 0, partial_ );
+         final_kernel.setArg( 1, result_ );
+         final_kernel.setArg( 2, static_cast< cl_uint >( groups ) );
+         final_kernel.setArg( 3, cl::Local( local_size * sizeof( cl_uint ) ) );
+         queue.enqueueNDRangeKernel( final_kernel,
+                                     cl::NullRange,
+                                     cl::NDRange( local_size ),
+                                     cl::NDRange( local_size ) );
+      }
+
+      cl_uint count;
+      queue.enqueueReadBuffer( result_, CL_TRUE, 0, sizeof( cl_uint ), &count );
+      return count;
+   }
+
+ private:
+   // Return the build options which instantiate operation for T; they
+   // enable reduceAtomic only for the 32-bit integers the atomic built-ins
+   // support.
+   template< typename T >
+   static std::string getOptions( const Operation operation ) {
+      std::string options = std::string( " -DREDUCE_TYPE=" )
+                          + ReductionType< T >::name;
+      if constexpr( std::is_same_v< T, int >
+                    || std::is_same_v< T, unsigned int > ) {
+         options += " -DREDUCE_ATOMIC";
+      }
+      options += " -DREDUCE_OP=";
+      switch( operation ) {
+         case Operation::Add:
+            return options + "add -DREDUCE_IDENTITY=0";
+         case Operation::Min:
+            return options + "min -DREDUCE_IDENTITY="
+                 + ReductionType< T >::highest;
+         default:
+            return options + "max -DREDUCE_IDENTITY="
+                 + ReductionType< T >::lowest;
+      }
+   }
+
+   // Return the host value of the identity of operation for T.
+   template< typename T >
+   static T getIdentity( const Operation operation ) {
+      switch( operation ) {
+         case Operation::Add:
+            return T( 0 );
+         case Operation::Min:
+            return std::numeric_limits< T >::max();
+         default:
+            return std::numeric_limits< T >::lowest();
+      }
+   }
+
+   // Return the program built with options, compiling it on first use.
+   cl::Program& getProgram( const std::string& options ) {
+      auto found = programs_.find( options );
+      if( found != programs_.end() ) {
+         return found->second;
+      }
+
+      cl::Program::Sources sources{ source_ };
+      cl::Program program( context_, sources );
+      std::string all_options = base_options_ + options;
+      auto err = program.build( device_, all_options.c_str() );
+      if( err != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Status: "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device_ )
+                   << "\nBuild Options: " << all_options << "\nBuild Log:\t "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device_ )
+                   << std::endl;
+         exit( 1 );
+      }
+      return programs_.emplace( options, program ).first->second;
+   }
+
+   // Return the largest power-of-two work-group size, up to 256, that the
+   // kernel supports; the local tree needs a power of two.
+   size_t getLocalSize( const cl::Kernel& kernel ) const {
+      size_t limit = std::min< size_t >(
+         256,
+         kernel.getWorkGroupInfo< CL_KERNEL_WORK_GROUP_SIZE >( device_ ) );
+      size_t local_size = 1;
+      while( 2 * local_size <= limit ) {
+         local_size *= 2;
+      }
+      return local_size;
+   }
+
+   // Return the number of work-groups of the first pass over n elements.
+   static size_t getGroups( const size_t n, const size_t local_size ) {
+      size_t items = local_size * ITEMS_PER_WORK_ITEM;
+      return std::max< size_t >(
+         1, std::min( ( n + items - 1 ) / items, MAX_GROUPS ) );
+   }
+
+   cl::Context context_;
+   cl::Device device_;
+   std::string source_;
+   std::string base_options_;
+   std::map< std::string, cl::Program > programs_;
+   cl::Buffer partial_;
+   cl::Buffer partial_indices_;
+   cl::Buffer result_;
+   cl::Buffer result_index_;
+};
+
+#endif
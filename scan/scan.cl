@@ -0,0 +1,483 @@
+#include "utility.cl"
+
+/**
+ * Declare the scan performed by this program. The host code defines:
+ *    - SCAN_TYPE: the type of the scanned values (e.g. int, uint, float);
+ *    - WG_SIZE: the work-group size, a power of two;
+ *    - SEGMENTED: to restart the sums at every element whose head flag is
+ *      set, heads being a uchar array as long as the input;
+ *    - SCAN_LOOKBACK: to compile the single-pass kernel, which needs the
+ *      acquire/release device-scope atomics of OpenCL C 2.0.
+ * Each work-group scans tiles of TILE_SIZE elements: every work-item scans
+ * ITEMS_PER_WORK_ITEM consecutive elements in registers and the work-group
+ * scans the work-item sums.
+ */
+
+#ifndef SCAN_TYPE
+   #define SCAN_TYPE int
+#endif
+
+#ifndef WG_SIZE
+   #define WG_SIZE 256
+#endif
+
+#define ITEMS_PER_WORK_ITEM 16
+#define TILE_SIZE ( WG_SIZE * ITEMS_PER_WORK_ITEM )
+
+/**
+ * Every work-item reads ITEMS_PER_WORK_ITEM consecutive elements of a tile
+ * from local memory, so one padding element per 32 avoids bank conflicts.
+ */
+
+#define PADDED( i ) ( ( i ) + ( i ) / 32 )
+#define PADDED_TILE_SIZE PADDED( TILE_SIZE )
+
+/**
+ * Combine the sum prev of the elements before a value with that value; a
+ * head flag restarts the sum.
+ */
+
+#ifdef SEGMENTED
+   #define COMBINE( prev, value, head ) \
+      ( ( head ) ? ( value ) : ( prev ) + ( value ) )
+#else
+   #define COMBINE( prev, value, head ) ( ( prev ) + ( value ) )
+#endif
+
+/**
+ * Copy input[n] to output[n], the reference the scan bandwidth is compared
+ * with.
+ */
+
+__kernel void copyBuffer( const __global SCAN_TYPE* input,
+                          __global SCAN_TYPE* output,
+                          const unsigned int n ) {
+   unsigned int index = compute_flattened_global_id();
+   if( index < n ) {
+      output[index] = input[index];
+   }
+}
+
+/**
+ * Scan the pairs ( value, head ) of the work-group: return the sum of the
+ * values of the previous work-items, restarted by their heads, store in
+ * prefix_head whether any of them has a head and in aggregate and
+ * aggregate_head the pair of the whole work-group. The local arrays must
+ * hold WG_SIZE elements.
+ */
+
+SCAN_TYPE scanWorkGroup( SCAN_TYPE value,
+                         uint head,
+                         __local SCAN_TYPE* values,
+                         __local uint* heads,
+                         uint* prefix_head,
+                         SCAN_TYPE* aggregate,
+                         uint* aggregate_head ) {
+   uint local_index = get_local_id( 0 );
+   values[local_index] = value;
+   heads[local_index] = head;
+
+   /**
+    * Scan the pairs with log2(WG_SIZE) steps of a Hillis-Steele scan.
+    */
+
+   for( uint offset = 1; offset < WG_SIZE; offset *= 2 ) {
+      barrier( CLK_LOCAL_MEM_FENCE );
+      SCAN_TYPE prev = 0;
+      uint prev_head = 0;
+      if( local_index >= offset ) {
+         prev = values[local_index - offset];
+         prev_head = heads[local_index - offset];
+      }
+      barrier( CLK_LOCAL_MEM_FENCE );
+      if( local_index >= offset ) {
+         value = COMBINE( prev, value, head );
+         head |= prev_head;
+         values[local_index] = value;
+         heads[local_index] = head;
+      }
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   *aggregate = values[WG_SIZE - 1];
+   *aggregate_head = heads[WG_SIZE - 1];
+   SCAN_TYPE prefix = local_index > 0 ? values[local_index - 1] : 0;
+   *prefix_head = local_index > 0 ? heads[local_index - 1] : 0;
+   barrier( CLK_LOCAL_MEM_FENCE );
+   return prefix;
+}
+
+/**
+ * Load the tile starting at tile_start into local memory, coalescing the
+ * global reads, and scan it locally: afterwards tile holds the inclusive or
+ * exclusive scan of the tile alone and, for segmented scans, tile_heads
+ * flags the elements preceded by a head of the tile, which must not receive
+ * the carry of the previous tiles. Return the pair of the whole tile in
+ * aggregate and aggregate_head.
+ */
+
+void scanTile( const __global SCAN_TYPE* input,
+               const __global uchar* heads,
+               const unsigned int n,
+               const unsigned int tile_start,
+               const unsigned int inclusive,
+               __local SCAN_TYPE* tile,
+               __local uchar* tile_heads,
+               __local SCAN_TYPE* values,
+               __local uint* value_heads,
+               SCAN_TYPE* aggregate,
+               uint* aggregate_head ) {
+   uint local_index = get_local_id( 0 );
+
+   /**
+    * Load the tile, padding the input with zeros.
+    */
+
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint tile_index = i * WG_SIZE + local_index;
+      uint index = tile_start + tile_index;
+      tile[PADDED( tile_index )] = index < n ? input[index] : 0;
+#ifdef SEGMENTED
+      tile_heads[PADDED( tile_index )] = index < n ? heads[index] : 0;
+#endif
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   /**
+    * Reduce the consecutive elements of this work-item.
+    */
+
+   uint first = local_index * ITEMS_PER_WORK_ITEM;
+   SCAN_TYPE sum = 0;
+   uint head = 0;
+   for( uint i = first; i < first + ITEMS_PER_WORK_ITEM; i++ ) {
+#ifdef SEGMENTED
+      uint element_head = tile_heads[PADDED( i )];
+#else
+      uint element_head = 0;
+#endif
+      sum = COMBINE( sum, tile[PADDED( i )], element_head );
+      head |= element_head;
+   }
+
+   /**
+    * Scan the sums of the work-items.
+    */
+
+   uint prefix_head;
+   SCAN_TYPE prefix = scanWorkGroup( sum,
+                                     head,
+                                     values,
+                                     value_heads,
+                                     &prefix_head,
+                                     aggregate,
+                                     aggregate_head );
+
+   /**
+    * Scan the consecutive elements of this work-item from its prefix.
+    */
+
+   SCAN_TYPE running = prefix;
+   for( uint i = first; i < first + ITEMS_PER_WORK_ITEM; i++ ) {
+      SCAN_TYPE value = tile[PADDED( i )];
+#ifdef SEGMENTED
+      uint element_head = tile_heads[PADDED( i )];
+      prefix_head |= element_head;
+      tile_heads[PADDED( i )] = prefix_head;
+      SCAN_TYPE exclusive = element_head ? 0 : running;
+#else
+      uint element_head = 0;
+      SCAN_TYPE exclusive = running;
+#endif
+      running = COMBINE( running, value, element_head );
+      tile[PADDED( i )] = inclusive ? running : exclusive;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+}
+
+/**
+ * Store the scanned tile starting at tile_start, adding the carry of the
+ * previous tiles to the elements not preceded by a head of the tile.
+ */
+
+void storeTile( __global SCAN_TYPE* output,
+                const unsigned int n,
+                const unsigned int tile_start,
+                const SCAN_TYPE carry,
+                __local SCAN_TYPE* tile,
+                __local uchar* tile_heads ) {
+   for( uint i = 0; i < ITEMS_PER_WORK_ITEM; i++ ) {
+      uint tile_index = i * WG_SIZE + get_local_id( 0 );
+      uint index = tile_start + tile_index;
+      if( index < n ) {
+#ifdef SEGMENTED
+         output[index] = tile[PADDED( tile_index )]
+                       + ( tile_heads[PADDED( tile_index )] ? 0 : carry );
+#else
+         output[index] = tile[PADDED( tile_index )] + carry;
+#endif
+      }
+   }
+}
+
+/**
+ * The reduce-then-scan kernels split the input into one chunk of
+ * consecutive tiles per work-group: reduceChunks computes the pair of every
+ * chunk, scanChunkSums scans those pairs with a single work-group and
+ * scanChunks scans every chunk from the sum of the previous ones. The input
+ * is read twice, so this path reaches at most two thirds of the copy
+ * bandwidth; it only needs OpenCL C 1.2.
+ */
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+reduceChunks( const __global SCAN_TYPE* input,
+              const __global uchar* heads,
+              __global SCAN_TYPE* chunk_sums,
+              __global uint* chunk_heads,
+              const unsigned int n,
+              const unsigned int tiles_per_chunk ) {
+
+   /**
+    * Create the local tile and the arrays of the work-group scan.
+    */
+
+   __local SCAN_TYPE tile[PADDED_TILE_SIZE];
+   __local uchar tile_heads[PADDED_TILE_SIZE];
+   __local SCAN_TYPE values[WG_SIZE];
+   __local uint value_heads[WG_SIZE];
+
+   /**
+    * Combine the pairs of the tiles of this chunk.
+    */
+
+   SCAN_TYPE sum = 0;
+   uint head = 0;
+   uint first_tile = get_group_id( 0 ) * tiles_per_chunk;
+   for( uint t = first_tile; t < first_tile + tiles_per_chunk; t++ ) {
+      SCAN_TYPE tile_sum;
+      uint tile_head;
+      scanTile( input,
+                heads,
+                n,
+                t * TILE_SIZE,
+                1,
+                tile,
+                tile_heads,
+                values,
+                value_heads,
+                &tile_sum,
+                &tile_head );
+      sum = COMBINE( sum, tile_sum, tile_head );
+      head |= tile_head;
+   }
+
+   if( get_local_id( 0 ) == 0 ) {
+      chunk_sums[get_group_id( 0 )] = sum;
+      chunk_heads[get_group_id( 0 )] = head;
+   }
+}
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+scanChunkSums( __global SCAN_TYPE* chunk_sums,
+               const __global uint* chunk_heads,
+               const unsigned int chunks ) {
+
+   /**
+    * Create the arrays of the work-group scan.
+    */
+
+   __local SCAN_TYPE values[WG_SIZE];
+   __local uint value_heads[WG_SIZE];
+
+   /**
+    * Replace every chunk pair by the sum of the previous chunks, there
+    * being at most WG_SIZE chunks.
+    */
+
+   uint index = get_local_id( 0 );
+   SCAN_TYPE sum = index < chunks ? chunk_sums[index] : 0;
+   uint head = index < chunks ? chunk_heads[index] : 0;
+   uint prefix_head;
+   SCAN_TYPE aggregate;
+   uint aggregate_head;
+   SCAN_TYPE prefix = scanWorkGroup( sum,
+                                     head,
+                                     values,
+                                     value_heads,
+                                     &prefix_head,
+                                     &aggregate,
+                                     &aggregate_head );
+   if( index < chunks ) {
+      chunk_sums[index] = prefix;
+   }
+}
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+scanChunks( const __global SCAN_TYPE* input,
+            const __global uchar* heads,
+            __global SCAN_TYPE* output,
+            const __global SCAN_TYPE* chunk_prefixes,
+            const unsigned int n,
+            const unsigned int tiles_per_chunk,
+            const unsigned int inclusive ) {
+
+   /**
+    * Create the local tile and the arrays of the work-group scan.
+    */
+
+   __local SCAN_TYPE tile[PADDED_TILE_SIZE];
+   __local uchar tile_heads[PADDED_TILE_SIZE];
+   __local SCAN_TYPE values[WG_SIZE];
+   __local uint value_heads[WG_SIZE];
+
+   /**
+    * Scan the tiles of this chunk, carrying the sum of the previous ones.
+    */
+
+   SCAN_TYPE carry = chunk_prefixes[get_group_id( 0 )];
+   uint first_tile = get_group_id( 0 ) * tiles_per_chunk;
+   for( uint t = first_tile; t < first_tile + tiles_per_chunk; t++ ) {
+      SCAN_TYPE tile_sum;
+      uint tile_head;
+      scanTile( input,
+                heads,
+                n,
+                t * TILE_SIZE,
+                inclusive,
+                tile,
+                tile_heads,
+                values,
+                value_heads,
+                &tile_sum,
+                &tile_head );
+      storeTile( output, n, t * TILE_SIZE, carry, tile, tile_heads );
+      carry = COMBINE( carry, tile_sum, tile_head );
+      barrier( CLK_LOCAL_MEM_FENCE );
+   }
+}
+
+#ifdef SCAN_LOOKBACK
+
+/**
+ * Declare the status of a tile of the single-pass scan: its aggregate
+ * (and whether it has a head) or its inclusive prefix are available.
+ */
+
+   #define STATUS_NONE 0
+   #define STATUS_AGGREGATE 1
+   #define STATUS_PREFIX 2
+   #define STATUS_HEAD 4
+
+/**
+ * This kernel function scans input[n] in a single pass with decoupled
+ * look-back: work-groups take tiles in order from tile_counter, publish
+ * the aggregate of their tile as soon as it is scanned locally, then look
+ * back at the previous tiles, combining their aggregates until one of them
+ * has published its inclusive prefix (or has a head), and publish their own
+ * inclusive prefix. Taking tiles in order guarantees that every awaited
+ * tile belongs to a running work-group. tile_counter and tile_status must
+ * be zeroed before each launch.
+ */
+
+__kernel __attribute__( ( reqd_work_group_size( WG_SIZE, 1, 1 ) ) ) void
+scanLookback( const __global SCAN_TYPE* input,
+              const __global uchar* heads,
+              __global SCAN_TYPE* output,
+              const unsigned int n,
+              const unsigned int inclusive,
+              volatile __global atomic_uint* tile_counter,
+              volatile __global atomic_uint* tile_status,
+              __global SCAN_TYPE* tile_aggregates,
+              __global SCAN_TYPE* tile_prefixes ) {
+
+   /**
+    * Create the local tile, the arrays of the work-group scan and the
+    * values broadcast by the first work-item.
+    */
+
+   __local SCAN_TYPE tile[PADDED_TILE_SIZE];
+   __local uchar tile_heads[PADDED_TILE_SIZE];
+   __local SCAN_TYPE values[WG_SIZE];
+   __local uint value_heads[WG_SIZE];
+   __local uint tile_index;
+   __local SCAN_TYPE carry;
+
+   /**
+    * Take the next tile and scan it locally.
+    */
+
+   if( get_local_id( 0 ) == 0 ) {
+      tile_index = atomic_fetch_add_explicit( tile_counter,
+                                              1,
+                                              memory_order_relaxed,
+                                              memory_scope_device );
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+   uint t = tile_index;
+
+   SCAN_TYPE aggregate;
+   uint aggregate_head;
+   scanTile( input,
+             heads,
+             n,
+             t * TILE_SIZE,
+             inclusive,
+             tile,
+             tile_heads,
+             values,
+             value_heads,
+             &aggregate,
+             &aggregate_head );
+
+   /**
+    * Publish the aggregate, look back and publish the inclusive prefix.
+    */
+
+   if( get_local_id( 0 ) == 0 ) {
+      SCAN_TYPE exclusive = 0;
+      if( t == 0 ) {
+         tile_prefixes[0] = aggregate;
+         atomic_store_explicit( &tile_status[0],
+                                STATUS_PREFIX,
+                                memory_order_release,
+                                memory_scope_device );
+      } else {
+         tile_aggregates[t] = aggregate;
+         atomic_store_explicit( &tile_status[t],
+                                STATUS_AGGREGATE
+                                   | ( aggregate_head ? STATUS_HEAD : 0 ),
+                                memory_order_release,
+                                memory_scope_device );
+
+         // Walk back until the previous sums are complete: a prefix, or a
+         // head which restarts the sum.
+         uint exclusive_head = 0;
+         for( int j = (int)t - 1; j >= 0 && !exclusive_head; j-- ) {
+            uint status;
+            do {
+               status = atomic_load_explicit( &tile_status[j],
+                                              memory_order_acquire,
+                                              memory_scope_device );
+            } while( status == STATUS_NONE );
+            if( status & STATUS_PREFIX ) {
+               exclusive = tile_prefixes[j] + exclusive;
+               break;
+            }
+            exclusive = tile_aggregates[j] + exclusive;
+            exclusive_head = status & STATUS_HEAD;
+         }
+
+         tile_prefixes[t] = COMBINE( exclusive, aggregate, aggregate_head );
+         atomic_store_explicit( &tile_status[t],
+                                STATUS_PREFIX,
+                                memory_order_release,
+                                memory_scope_device );
+      }
+      carry = exclusive;
+   }
+   barrier( CLK_LOCAL_MEM_FENCE );
+
+   storeTile( output, n, t * TILE_SIZE, carry, tile, tile_heads );
+}
+
+#endif
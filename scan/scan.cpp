@@ -0,0 +1,330 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "scan.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Sequentially scan input[n] into output[n]; heads is NULL for unsegmented
+// scans.
+template< typename T >
+void seqScan( const T* input,
+              const unsigned char* heads,
+              T* output,
+              const size_t n,
+              const bool inclusive );
+// Check if the arrays c1 and c2 are equal, up to rounding errors for floats.
+template< typename T >
+bool checkEquality( const T* c1, const T* c2, const size_t n );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 10;
+   bool equal = true;
+
+   /**
+    * Initialize OpenCL device and the scans of both paths.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   cl::CommandQueue queue( context, device );
+   cl_ulong max_alloc_size = device.getInfo< CL_DEVICE_MAX_MEM_ALLOC_SIZE >();
+   cl_ulong global_mem_size = device.getInfo< CL_DEVICE_GLOBAL_MEM_SIZE >();
+
+   Scan scan( context, device );
+   Scan reduce_then_scan( context, device, Scan::Path::ReduceThenScan );
+   std::cout << "Scan path: "
+             << ( scan.usesLookback() ? "decoupled look-back"
+                                      : "reduce then scan" )
+             << std::endl;
+
+   /**
+    * Scan from 1K to 1G elements.
+    * */
+
+   std::cout << std::fixed << std::setprecision( 3 );
+   for( size_t n = size_t( 1 ) << 10; n <= size_t( 1 ) << 30; n <<= 2 ) {
+
+      // Skip the sizes which do not fit in the device: an input, an output
+      // and the heads.
+      const size_t bytes = n * sizeof( int );
+      if( bytes > max_alloc_size || 2 * bytes + n > global_mem_size ) {
+         std::cout << std::setw( 10 ) << n
+                   << " elements: skipped, not enough device memory."
+                   << std::endl;
+         continue;
+      }
+
+      /**
+       * Prepare the inputs: segments start every 1000 elements and at
+       * every multiple of 7919.
+       * */
+
+      std::vector< int > input( n );
+      std::vector< float > float_input( n );
+      std::vector< unsigned char > heads( n );
+      for( size_t i = 0; i < n; i++ ) {
+         input[i] = static_cast< int >( i % 7 ) - 3;
+         float_input[i] = 0.25f * static_cast< float >( i % 4 );
+         heads[i] = i % 1000 == 0 || i % 7919 == 0;
+      }
+      std::vector< int > expected( n );
+      std::vector< int > output( n );
+
+      cl::Buffer input_buf( context, CL_MEM_READ_WRITE, bytes );
+      cl::Buffer output_buf( context, CL_MEM_READ_WRITE, bytes );
+      cl::Buffer heads_buf(
+         context,
+         CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+         n,
+         heads.data() );
+      queue.enqueueWriteBuffer( input_buf, CL_TRUE, 0, bytes, input.data() );
+
+      /**
+       * Measure the kernel copy of the input, the reference bandwidth.
+       * */
+
+      scan.copy< int >( queue, input_buf, output_buf, n );
+      queue.finish();
+      auto start = std::chrono::steady_clock::now();
+      for( int i = 0; i < executions; i++ ) {
+         scan.copy< int >( queue, input_buf, output_buf, n );
+      }
+      queue.finish();
+      double copy_time = getElapsedTime( start ) / executions;
+      double copy_bandwidth = 2.0 * bytes / ( copy_time * 1e6 );
+      std::cout << std::setw( 10 ) << n << " elements: copy " << copy_time
+                << " ms, " << copy_bandwidth << " GB/s" << std::endl;
+
+      /**
+       * Run every int scan, validate it and measure it. The first run of
+       * each scan compiles its program, so it is not measured.
+       * */
+
+      auto measure = [&]( const std::string& name,
+                          auto&& run,
+                          const bool result_equal ) {
+         start = std::chrono::steady_clock::now();
+         for( int i = 0; i < executions; i++ ) {
+            run();
+         }
+         queue.finish();
+         double time = getElapsedTime( start ) / executions;
+         double bandwidth = 2.0 * bytes / ( time * 1e6 );
+         std::cout << "\t" << std::setw( 28 ) << std::left << name
+                   << std::right << time << " ms, " << bandwidth << " GB/s, "
+                   << 100.0 * bandwidth / copy_bandwidth << "% of copy"
+                   << ( result_equal ? "" : " (FAILED)" ) << std::endl;
+         equal = equal && result_equal;
+      };
+
+      const std::vector< std::pair< std::string, Scan* > > scans
+         = { { "", &scan }, { " (reduce then scan)", &reduce_then_scan } };
+      for( const auto& named_scan : scans ) {
+         Scan& s = *named_scan.second;
+         if( &s == &reduce_then_scan && !scan.usesLookback() ) {
+            continue;
+         }
+
+         auto inclusive = [&]() {
+            s.inclusiveScan< int >( queue, input_buf, output_buf, n );
+         };
+         inclusive();
+         queue.enqueueReadBuffer(
+            output_buf, CL_TRUE, 0, bytes, output.data() );
+         seqScan( input.data(), nullptr, expected.data(), n, true );
+         measure( "inclusive int" + named_scan.first,
+                  inclusive,
+                  checkEquality( expected.data(), output.data(), n ) );
+
+         auto exclusive = [&]() {
+            s.exclusiveScan< int >( queue, input_buf, output_buf, n );
+         };
+         exclusive();
+         queue.enqueueReadBuffer(
+            output_buf, CL_TRUE, 0, bytes, output.data() );
+         seqScan( input.data(), nullptr, expected.data(), n, false );
+         measure( "exclusive int" + named_scan.first,
+                  exclusive,
+                  checkEquality( expected.data(), output.data(), n ) );
+
+         auto segmented = [&]() {
+            s.segmentedInclusiveScan< int >(
+               queue, input_buf, heads_buf, output_buf, n );
+         };
+         segmented();
+         queue.enqueueReadBuffer(
+            output_buf, CL_TRUE, 0, bytes, output.data() );
+         seqScan( input.data(), heads.data(), expected.data(), n, true );
+         measure( "segmented inclusive int" + named_scan.first,
+                  segmented,
+                  checkEquality( expected.data(), output.data(), n ) );
+      }
+
+      /**
+       * Run the segmented float exclusive scan with the default path.
+       * */
+
+      queue.enqueueWriteBuffer( input_buf,
+                                CL_TRUE,
+                                0,
+                                bytes,
+                                float_input.data() );
+      std::vector< float > float_expected( n );
+      std::vector< float > float_output( n );
+      auto float_exclusive = [&]() {
+         scan.segmentedExclusiveScan< float >(
+            queue, input_buf, heads_buf, output_buf, n );
+      };
+      float_exclusive();
+      queue.enqueueReadBuffer( output_buf,
+                               CL_TRUE,
+                               0,
+                               bytes,
+                               float_output.data() );
+      seqScan( float_input.data(),
+               heads.data(),
+               float_expected.data(),
+               n,
+               false );
+      measure( "segmented exclusive float",
+               float_exclusive,
+               checkEquality( float_expected.data(), float_output.data(), n ) );
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Sequentially scan input[n] into output[n]; heads is NULL for unsegmented
+ * scans. Float sums are accumulated in double.
+ * */
+
+template< typename T >
+void seqScan( const T* input,
+              const unsigned char* heads,
+              T* output,
+              const size_t n,
+              const bool inclusive ) {
+   using Sum = std::conditional_t< std::is_floating_point_v< T >, double, T >;
+   Sum sum = 0;
+   for( size_t i = 0; i < n; i++ ) {
+      if( heads && heads[i] ) {
+         sum = 0;
+      }
+      if( !inclusive ) {
+         output[i] = static_cast< T >( sum );
+      }
+      sum += input[i];
+      if( inclusive ) {
+         output[i] = static_cast< T >( sum );
+      }
+   }
+}
+
+/**
+ * Check if the arrays c1 and c2 are equal, up to rounding errors for floats.
+ * */
+
+template< typename T >
+bool checkEquality( const T* c1, const T* c2, const size_t n ) {
+   for( size_t i = 0; i < n; i++ ) {
+      if constexpr( std::is_floating_point_v< T > ) {
+         if( std::fabs( c1[i] - c2[i] )
+             > 1e-4f * std::fmax( 1.0f, std::fabs( c1[i] ) ) ) {
+            return false;
+         }
+      } else if( c1[i] != c2[i] ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,407 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+/**
+ * Scan device buffers with the kernels of scan.cl: inclusive and exclusive
+ * prefix sums of int, uint and float buffers, optionally segmented by a
+ * buffer of uchar head flags. Devices with acquire/release device-scope
+ * atomics run a single pass with decoupled look-back, reading and writing
+ * every element once; the others reduce then scan fixed chunks of the
+ * input. Programs are compiled on first use and cached by their options:
+ *
+ *    Scan scan( context, device );
+ *    scan.exclusiveScan< int >( queue, input, output, n );
+ * */
+
+// =================================================================
+// ---------------------------- Traits -----------------------------
+// =================================================================
+
+// The OpenCL C name of the scanned types.
+template< typename T >
+struct ScanType;
+
+template<>
+struct ScanType< int > {
+   static constexpr const char* name = "int";
+};
+
+template<>
+struct ScanType< unsigned int > {
+   static constexpr const char* name = "uint";
+};
+
+template<>
+struct ScanType< float > {
+   static constexpr const char* name = "float";
+};
+
+// =================================================================
+// ------------------------------ Scan -----------------------------
+// =================================================================
+
+class Scan {
+ public:
+   // How the tiles are chained: Auto uses Lookback when the device
+   // supports it and ReduceThenScan otherwise.
+   enum class Path { Auto, Lookback, ReduceThenScan };
+
+   // Number of elements each work-item scans; it must match scan.cl.
+   static constexpr size_t ITEMS_PER_WORK_ITEM = 16;
+
+   Scan( const cl::Context& context,
+         const cl::Device& device,
+         const Path path = Path::Auto,
+         const std::string& file_name = "../scan/scan.cl",
+         const std::string& include_path = "../test" )
+      : context_( context ), device_( device ) {
+
+      /**
+       * Read the kernel file, which includes utility.cl.
+       * */
+
+      std::ifstream kernel_file( file_name );
+      if( !kernel_file.is_open() ) {
+         std::cerr << "Fail to open " << file_name << "." << std::endl;
+         exit( 1 );
+      }
+      source_ = std::string( std::istreambuf_iterator< char >( kernel_file ),
+                             ( std::istreambuf_iterator< char >() ) );
+
+      /**
+       * Select the largest power-of-two work-group size, up to 256, whose
+       * tile fits in local memory.
+       * */
+
+      size_t limit = std::min< size_t >(
+         256, device.getInfo< CL_DEVICE_MAX_WORK_GROUP_SIZE >() );
+      local_size_ = 1;
+      while( 2 * local_size_ <= limit
+             && getLocalMemSize( 2 * local_size_ )
+                   <= device.getInfo< CL_DEVICE_LOCAL_MEM_SIZE >() ) {
+         local_size_ *= 2;
+      }
+      tile_size_ = local_size_ * ITEMS_PER_WORK_ITEM;
+
+      /**
+       * Select the path and the language version it needs.
+       * */
+
+      lookback_ = path == Path::Lookback
+               || ( path == Path::Auto
+                    && isSupported( device, Path::Lookback ) );
+      std::string version = device.getInfo< CL_DEVICE_VERSION >();
+      if( version.compare( 0, 8, "OpenCL 3" ) == 0 ) {
+         base_options_ = "-cl-std=CL3.0";
+      } else if( version.compare( 0, 8, "OpenCL 2" ) == 0 ) {
+         base_options_ = "-cl-std=CL2.0";
+      }
+      base_options_ += " -I" + include_path
+                     + " -DWG_SIZE=" + std::to_string( local_size_ );
+      if( lookback_ ) {
+         base_options_ += " -DSCAN_LOOKBACK";
+      }
+
+      /**
+       * Allocate the chunk sums of the reduce-then-scan path, one per
+       * work-item of the single work-group which scans them, and the tile
+       * counter of the look-back path.
+       * */
+
+      chunk_sums_ = cl::Buffer( context,
+                                CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                local_size_ * sizeof( cl_ulong ) );
+      chunk_heads_ = cl::Buffer( context,
+                                 CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                 local_size_ * sizeof( cl_uint ) );
+      tile_counter_ = cl::Buffer( context,
+                                  CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                  sizeof( cl_uint ) );
+   }
+
+   // Check whether device supports a path.
+   static bool isSupported( const cl::Device& device, const Path path ) {
+      if( path != Path::Lookback ) {
+         return true;
+      }
+      std::string version = device.getInfo< CL_DEVICE_VERSION >();
+      if( version.compare( 0, 8, "OpenCL 2" ) == 0 ) {
+         return true;
+      }
+      if( version.compare( 0, 8, "OpenCL 3" ) != 0 ) {
+         return false;
+      }
+      cl_device_atomic_capabilities capabilities
+         = device.getInfo< CL_DEVICE_ATOMIC_MEMORY_CAPABILITIES >();
+      return ( capabilities & CL_DEVICE_ATOMIC_ORDER_ACQ_REL )
+          && ( capabilities & CL_DEVICE_ATOMIC_SCOPE_DEVICE );
+   }
+
+   bool usesLookback() const { return lookback_; }
+
+   // output[i] = input[0] + ... + input[i].
+   template< typename T >
+   void inclusiveScan( const cl::CommandQueue& queue,
+                       const cl::Buffer& input,
+                       const cl::Buffer& output,
+                       const size_t n ) {
+      run< T >( queue, input, nullptr, output, n, true );
+   }
+
+   // output[i] = input[0] + ... + input[i - 1], and output[0] = 0.
+   template< typename T >
+   void exclusiveScan( const cl::CommandQueue& queue,
+                       const cl::Buffer& input,
+                       const cl::Buffer& output,
+                       const size_t n ) {
+      run< T >( queue, input, nullptr, output, n, false );
+   }
+
+   // Inclusive scan restarted at every element whose head flag is set.
+   template< typename T >
+   void segmentedInclusiveScan( const cl::CommandQueue& queue,
+                                const cl::Buffer& input,
+                                const cl::Buffer& heads,
+                                const cl::Buffer& output,
+                                const size_t n ) {
+      run< T >( queue, input, &heads, output, n, true );
+   }
+
+   // Exclusive scan restarted at every element whose head flag is set.
+   template< typename T >
+   void segmentedExclusiveScan( const cl::CommandQueue& queue,
+                                const cl::Buffer& input,
+                                const cl::Buffer& heads,
+                                const cl::Buffer& output,
+                                const size_t n ) {
+      run< T >( queue, input, &heads, output, n, false );
+   }
+
+   // Copy input[n] to output[n] with a kernel, the reference of the scan
+   // bandwidth.
+   template< typename T >
+   void copy( const cl::CommandQueue& queue,
+              const cl::Buffer& input,
+              const cl::Buffer& output,
+              const size_t n ) {
+      cl::Kernel kernel( getProgram( getOptions< T >( false ) ), "copyBuffer" );
+      kernel.setArg( 0, input );
+      kernel.setArg( 1, output );
+      kernel.setArg( 2, static_cast< cl_uint >( n ) );
+      size_t global_size
+         = ( n + local_size_ - 1 ) / local_size_ * local_size_;
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( global_size ),
+                                  cl::NDRange( local_size_ ) );
+   }
+
+ private:
+   // Enqueue the scan of input[n] into output[n]; heads is NULL for
+   // unsegmented scans.
+   template< typename T >
+   void run( const cl::CommandQueue& queue,
+             const cl::Buffer& input,
+             const cl::Buffer* heads,
+             const cl::Buffer& output,
+             const size_t n,
+             const bool inclusive ) {
+      if( n == 0 ) {
+         return;
+      }
+      cl::Program& program = getProgram( getOptions< T >( heads != nullptr ) );
+      size_t tiles = ( n + tile_size_ - 1 ) / tile_size_;
+      if( lookback_ ) {
+         runLookback(
+            queue, program, input, heads, output, n, tiles, inclusive );
+      } else {
+         runReduceThenScan(
+            queue, program, input, heads, output, n, tiles, inclusive );
+      }
+   }
+
+   // Scan in a single pass, every tile looking back at the previous ones.
+   void runLookback( const cl::CommandQueue& queue,
+                     cl::Program& program,
+                     const cl::Buffer& input,
+                     const cl::Buffer* heads,
+                     const cl::Buffer& output,
+                     const size_t n,
+                     const size_t tiles,
+                     const bool inclusive ) {
+
+      /**
+       * Grow the tile statuses when needed and reset them with the tile
+       * counter.
+       * */
+
+      if( tiles > lookback_tiles_ ) {
+         lookback_tiles_ = tiles;
+         tile_status_ = cl::Buffer( context_,
+                                    CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                    tiles * sizeof( cl_uint ) );
+         tile_aggregates_ = cl::Buffer( context_,
+                                        CL_MEM_READ_WRITE
+                                           | CL_MEM_HOST_NO_ACCESS,
+                                        tiles * sizeof( cl_ulong ) );
+         tile_prefixes_ = cl::Buffer( context_,
+                                      CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                      tiles * sizeof( cl_ulong ) );
+      }
+
+      queue.enqueueFillBuffer( tile_status_,
+                               cl_uint( 0 ),
+                               0,
+                               tiles * sizeof( cl_uint ) );
+      queue.enqueueFillBuffer( tile_counter_,
+                               cl_uint( 0 ),
+                               0,
+                               sizeof( cl_uint ) );
+
+      /**
+       * Scan every tile.
+       * */
+
+      cl::Kernel kernel( program, "scanLookback" );
+      kernel.setArg( 0, input );
+      setHeadsArg( kernel, 1, heads );
+      kernel.setArg( 2, output );
+      kernel.setArg( 3, static_cast< cl_uint >( n ) );
+      kernel.setArg( 4, static_cast< cl_uint >( inclusive ) );
+      kernel.setArg( 5, tile_counter_ );
+      kernel.setArg( 6, tile_status_ );
+      kernel.setArg( 7, tile_aggregates_ );
+      kernel.setArg( 8, tile_prefixes_ );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( tiles * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+   }
+
+   // Reduce fixed chunks of tiles, scan the chunk sums, then scan every
+   // chunk from its prefix.
+   void runReduceThenScan( const cl::CommandQueue& queue,
+                           cl::Program& program,
+                           const cl::Buffer& input,
+                           const cl::Buffer* heads,
+                           const cl::Buffer& output,
+                           const size_t n,
+                           const size_t tiles,
+                           const bool inclusive ) {
+      size_t chunks = std::min( tiles, local_size_ );
+      cl_uint tiles_per_chunk
+         = static_cast< cl_uint >( ( tiles + chunks - 1 ) / chunks );
+
+      cl::Kernel reduce_kernel( program, "reduceChunks" );
+      reduce_kernel.setArg( 0, input );
+      setHeadsArg( reduce_kernel, 1, heads );
+      reduce_kernel.setArg( 2, chunk_sums_ );
+      reduce_kernel.setArg( 3, chunk_heads_ );
+      reduce_kernel.setArg( 4, static_cast< cl_uint >( n ) );
+      reduce_kernel.setArg( 5, tiles_per_chunk );
+      queue.enqueueNDRangeKernel( reduce_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( chunks * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+
+      cl::Kernel sums_kernel( program, "scanChunkSums" );
+      sums_kernel.setArg( 0, chunk_sums_ );
+      sums_kernel.setArg( 1, chunk_heads_ );
+      sums_kernel.setArg( 2, static_cast< cl_uint >( chunks ) );
+      queue.enqueueNDRangeKernel( sums_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+
+      cl::Kernel scan_kernel( program, "scanChunks" );
+      scan_kernel.setArg( 0, input );
+      setHeadsArg( scan_kernel, 1, heads );
+      scan_kernel.setArg( 2, output );
+      scan_kernel.setArg( 3, chunk_sums_ );
+      scan_kernel.setArg( 4, static_cast< cl_uint >( n ) );
+      scan_kernel.setArg( 5, tiles_per_chunk );
+      scan_kernel.setArg( 6, static_cast< cl_uint >( inclusive ) );
+      queue.enqueueNDRangeKernel( scan_kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( chunks * local_size_ ),
+                                  cl::NDRange( local_size_ ) );
+   }
+
+   // Set the heads argument, NULL for unsegmented scans.
+   static void setHeadsArg( cl::Kernel& kernel,
+                            const cl_uint index,
+                            const cl::Buffer* heads ) {
+      if( heads ) {
+         kernel.setArg( index, *heads );
+      } else {
+         kernel.setArg( index, sizeof( cl_mem ), nullptr );
+      }
+   }
+
+   // Return the build options which instantiate the scan of T.
+   template< typename T >
+   static std::string getOptions( const bool segmented ) {
+      return std::string( " -DSCAN_TYPE=" ) + ScanType< T >::name
+           + ( segmented ? " -DSEGMENTED" : "" );
+   }
+
+   // Return the local memory used by a work-group of local_size
+   // work-items: the padded tile, its heads and the work-group scan.
+   static size_t getLocalMemSize( const size_t local_size ) {
+      size_t tile_size = local_size * ITEMS_PER_WORK_ITEM;
+      size_t padded_tile_size = tile_size + tile_size / 32;
+      return padded_tile_size * ( sizeof( cl_ulong ) + sizeof( cl_uchar ) )
+           + local_size * ( sizeof( cl_ulong ) + sizeof( cl_uint ) );
+   }
+
+   // Return the program built with options, compiling it on first use.
+   cl::Program& getProgram( const std::string& options ) {
+      auto found = programs_.find( options );
+      if( found != programs_.end() ) {
+         return found->second;
+      }
+
+      cl::Program::Sources sources{ source_ };
+      cl::Program program( context_, sources );
+      std::string all_options = base_options_ + options;
+      auto err = program.build( device_, all_options.c_str() );
+      if( err != CL_BUILD_SUCCESS ) {
+         std::cerr << "Error!\nBuild Status: "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device_ )
+                   << "\nBuild Options: " << all_options << "\nBuild Log:\t "
+                   << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device_ )
+                   << std::endl;
+         exit( 1 );
+      }
+      return programs_.emplace( options, program ).first->second;
+   }
+
+   cl::Context context_;
+   cl::Device device_;
+   std::string source_;
+   std::string base_options_;
+   std::map< std::string, cl::Program > programs_;
+   size_t local_size_;
+   size_t tile_size_;
+   bool lookback_;
+   size_t lookback_tiles_ = 0;
+   cl::Buffer tile_counter_;
+   cl::Buffer tile_status_;
+   cl::Buffer tile_aggregates_;
+   cl::Buffer tile_prefixes_;
+   cl::Buffer chunk_sums_;
+   cl::Buffer chunk_heads_;
+};
+
+#endif
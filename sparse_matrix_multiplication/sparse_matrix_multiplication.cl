@@ -0,0 +1,314 @@
+/**
+ * Number of work-items cooperating on a single row in the vector CSR kernel.
+ * It must be a power of two not greater than the work-group size declared in
+ * the host code.
+ **/
+
+#ifndef VECTOR_SIZE
+   #define VECTOR_SIZE 32
+#endif
+
+/**
+ * This kernel function multiplies a sparse matrix a[rows,cols] stored in the
+ * CSR format by a dense vector x[cols]. Each work-item computes one row.
+ **/
+
+__kernel void spmvCsrScalar( const __global int* row_ptr,
+                             const __global int* col_idx,
+                             const __global float* values,
+                             const __global float* x,
+                             __global float* y,
+                             const int rows ) {
+
+   /**
+    * Get work-item identifiers.
+    **/
+
+   int row = (int)get_global_id( 0 );
+   if( row >= rows ) {
+      return;
+   }
+
+   /**
+    * Compute element y[row].
+    **/
+
+   float sum = 0.0f;
+   for( int i = row_ptr[row]; i < row_ptr[row + 1]; i++ ) {
+      sum += values[i] * x[col_idx[i]];
+   }
+   y[row] = sum;
+}
+
+/**
+ * This kernel function multiplies a sparse matrix a[rows,cols] stored in the
+ * CSR format by a dense vector x[cols]. Each row is computed by VECTOR_SIZE
+ * work-items, so consecutive work-items read consecutive non-zeros.
+ **/
+
+__kernel void spmvCsrVector( const __global int* row_ptr,
+                             const __global int* col_idx,
+                             const __global float* values,
+                             const __global float* x,
+                             __global float* y,
+                             const int rows,
+                             __local float* partial ) {
+
+   /**
+    * Get work-item identifiers.
+    **/
+
+   int local_index = (int)get_local_id( 0 );
+   int lane = (int)get_global_id( 0 ) & ( VECTOR_SIZE - 1 );
+   int row = (int)get_global_id( 0 ) / VECTOR_SIZE;
+
+   /**
+    * Accumulate a strided slice of the row.
+    **/
+
+   float sum = 0.0f;
+   if( row < rows ) {
+      for( int i = row_ptr[row] + lane; i < row_ptr[row + 1];
+           i += VECTOR_SIZE ) {
+         sum += values[i] * x[col_idx[i]];
+      }
+   }
+   partial[local_index] = sum;
+
+   /**
+    * Reduce the partial sums of the lanes which share this row.
+    **/
+
+   for( int offset = VECTOR_SIZE / 2; offset > 0; offset /= 2 ) {
+      barrier( CLK_LOCAL_MEM_FENCE );
+      if( lane < offset ) {
+         partial[local_index] += partial[local_index + offset];
+      }
+   }
+
+   /**
+    * Store the final result in the vector y.
+    **/
+
+   if( lane == 0 && row < rows ) {
+      y[row] = partial[local_index];
+   }
+}
+
+/**
+ * Find where the diagonal crosses the merge path of the row end offsets and
+ * the indices of the non-zeros. The returned coordinate holds the number of
+ * rows (x) and non-zeros (y) consumed before the diagonal.
+ **/
+
+int2 mergePathSearch( const int diagonal,
+                      const __global int* row_end_offsets,
+                      const int rows,
+                      const int nnz ) {
+   int x_min = max( diagonal - nnz, 0 );
+   int x_max = min( diagonal, rows );
+   while( x_min < x_max ) {
+      int pivot = ( x_min + x_max ) >> 1;
+      if( row_end_offsets[pivot] <= diagonal - pivot - 1 ) {
+         x_min = pivot + 1;
+      } else {
+         x_max = pivot;
+      }
+   }
+   return (int2)( min( x_min, rows ), diagonal - x_min );
+}
+
+/**
+ * This kernel function multiplies a sparse matrix a[rows,cols] stored in the
+ * CSR format by a dense vector x[cols] using merge-path partitioning. Every
+ * work-item consumes the same number of rows plus non-zeros, so a few very
+ * long rows no longer serialize on a single work-item. Partial sums of rows
+ * crossing a partition boundary are written to carry_rows and carry_values
+ * and must be added by spmvCsrMergePathFixup.
+ **/
+
+__kernel void spmvCsrMergePath( const __global int* row_ptr,
+                                const __global int* col_idx,
+                                const __global float* values,
+                                const __global float* x,
+                                __global float* y,
+                                const int rows,
+                                const int nnz,
+                                const int items_per_work_item,
+                                __global int* carry_rows,
+                                __global float* carry_values ) {
+
+   /**
+    * Get work-item identifiers.
+    **/
+
+   int index = (int)get_global_id( 0 );
+
+   /**
+    * Locate the start and end of this work-item on the merge path.
+    **/
+
+   const __global int* row_end_offsets = row_ptr + 1;
+   int merge_items = rows + nnz;
+   int start_diagonal = min( items_per_work_item * index, merge_items );
+   int end_diagonal = min( start_diagonal + items_per_work_item, merge_items );
+   int2 coord = mergePathSearch( start_diagonal, row_end_offsets, rows, nnz );
+   int2 end_coord = mergePathSearch( end_diagonal, row_end_offsets, rows, nnz );
+
+   /**
+    * Consume the rows which end inside this partition.
+    **/
+
+   float sum = 0.0f;
+   for( ; coord.x < end_coord.x; coord.x++ ) {
+      for( ; coord.y < row_end_offsets[coord.x]; coord.y++ ) {
+         sum += values[coord.y] * x[col_idx[coord.y]];
+      }
+      y[coord.x] = sum;
+      sum = 0.0f;
+   }
+
+   /**
+    * Consume the head of the row which continues in the next partition.
+    **/
+
+   for( ; coord.y < end_coord.y; coord.y++ ) {
+      sum += values[coord.y] * x[col_idx[coord.y]];
+   }
+
+   carry_rows[index] = end_coord.x;
+   carry_values[index] = sum;
+}
+
+/**
+ * This kernel function adds the partial sums carried out of every merge-path
+ * partition. It runs on a single work-item, since there is only one carry per
+ * partition of spmvCsrMergePath.
+ **/
+
+__kernel void spmvCsrMergePathFixup( const __global int* carry_rows,
+                                     const __global float* carry_values,
+                                     __global float* y,
+                                     const int rows,
+                                     const int num_carries ) {
+   for( int i = 0; i < num_carries; i++ ) {
+      if( carry_rows[i] < rows ) {
+         y[carry_rows[i]] += carry_values[i];
+      }
+   }
+}
+
+/**
+ * This kernel function multiplies a sparse matrix a[rows,cols] stored in the
+ * column-major ELL format by a dense vector x[cols]. Padded entries hold a
+ * zero value, so they do not need to be skipped.
+ **/
+
+__kernel void spmvEll( const __global int* ell_cols,
+                       const __global float* ell_values,
+                       const __global float* x,
+                       __global float* y,
+                       const int rows,
+                       const int width ) {
+
+   /**
+    * Get work-item identifiers.
+    **/
+
+   int row = (int)get_global_id( 0 );
+   if( row >= rows ) {
+      return;
+   }
+
+   /**
+    * Compute element y[row].
+    **/
+
+   float sum = 0.0f;
+   for( int j = 0; j < width; j++ ) {
+      int i = j * rows + row;
+      sum += ell_values[i] * x[ell_cols[i]];
+   }
+   y[row] = sum;
+}
+
+/**
+ * This kernel function multiplies a sparse matrix a[rows,cols] stored in the
+ * SELL-C-sigma format by a dense vector x[cols]. Rows are grouped in slices
+ * of slice_height rows, each one padded to its own width and stored
+ * column-major, and row_perm maps a slice row back to the original row.
+ **/
+
+__kernel void spmvSell( const __global int* slice_ptr,
+                        const __global int* slice_width,
+                        const __global int* sell_cols,
+                        const __global float* sell_values,
+                        const __global int* row_perm,
+                        const __global float* x,
+                        __global float* y,
+                        const int slice_height,
+                        const int padded_rows ) {
+
+   /**
+    * Get work-item identifiers.
+    **/
+
+   int index = (int)get_global_id( 0 );
+   if( index >= padded_rows ) {
+      return;
+   }
+   int slice = index / slice_height;
+   int lane = index % slice_height;
+   int row = row_perm[index];
+
+   /**
+    * Compute element y[row], skipping the rows added to fill the last slice.
+    **/
+
+   if( row < 0 ) {
+      return;
+   }
+   float sum = 0.0f;
+   int offset = slice_ptr[slice] + lane;
+   for( int j = 0; j < slice_width[slice]; j++ ) {
+      int i = offset + j * slice_height;
+      sum += sell_values[i] * x[sell_cols[i]];
+   }
+   y[row] = sum;
+}
+
+/**
+ * This kernel function multiplies a sparse matrix a[rows,k] stored in the CSR
+ * format by a dense row-major matrix b[k,n]. Each work-item computes one
+ * element of c[rows,n], so neighbouring work-items read neighbouring
+ * elements of b.
+ **/
+
+__kernel void spmmCsr( const __global int* row_ptr,
+                       const __global int* col_idx,
+                       const __global float* values,
+                       const __global float* b,
+                       __global float* c,
+                       const int rows,
+                       const int n ) {
+
+   /**
+    * Get work-item identifiers.
+    **/
+
+   int col_index = (int)get_global_id( 0 );
+   int row_index = (int)get_global_id( 1 );
+   if( col_index >= n || row_index >= rows ) {
+      return;
+   }
+
+   /**
+    * Compute element c[row_index, col_index].
+    **/
+
+   float sum = 0.0f;
+   for( int i = row_ptr[row_index]; i < row_ptr[row_index + 1]; i++ ) {
+      sum += values[i] * b[col_idx[i] * n + col_index];
+   }
+   c[row_index * n + col_index] = sum;
+}
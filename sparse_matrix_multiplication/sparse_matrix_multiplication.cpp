@@ -0,0 +1,1053 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ------------------------- Sparse Formats -------------------------
+// =================================================================
+
+// A single non-zero element of a sparse matrix.
+struct Triplet {
+   int row;
+   int col;
+   float value;
+};
+
+// Sparse matrix stored in the compressed sparse row (CSR) format.
+struct CsrMatrix {
+   size_t rows = 0;
+   size_t cols = 0;
+   std::vector< int > row_ptr;    // rows + 1 offsets into col_idx/values.
+   std::vector< int > col_idx;    // Column of every non-zero.
+   std::vector< float > values;   // Value of every non-zero.
+};
+
+// Sparse matrix stored in the column-major ELL format.
+struct EllMatrix {
+   size_t rows = 0;
+   size_t cols = 0;
+   size_t width = 0;              // Length of the longest row.
+   std::vector< int > col_idx;    // col_idx[j * rows + row], padded with 0.
+   std::vector< float > values;   // values[j * rows + row], padded with 0.
+};
+
+// Sparse matrix stored in the SELL-C-sigma format.
+struct SellMatrix {
+   size_t rows = 0;
+   size_t cols = 0;
+   size_t slice_height = 0;           // C: rows per slice.
+   size_t sigma = 0;                  // Rows sorted by length per window.
+   size_t padded_rows = 0;            // rows rounded up to slice_height.
+   std::vector< int > slice_ptr;      // Offset of every slice.
+   std::vector< int > slice_width;    // Longest row of every slice.
+   std::vector< int > col_idx;        // Column-major inside each slice.
+   std::vector< float > values;       // Column-major inside each slice.
+   std::vector< int > row_perm;       // Original row or -1 for padding.
+};
+
+// SpMV kernels provided by sparse_matrix_multiplication.cl.
+enum class SpmvKernel { CsrScalar, CsrVector, CsrMergePath, Ell, Sell };
+
+// Row-length statistics used to select an SpMV kernel.
+struct RowStatistics {
+   double mean = 0;       // Mean non-zeros per row.
+   double stddev = 0;     // Standard deviation of the non-zeros per row.
+   size_t max = 0;        // Non-zeros of the longest row.
+   double ell_fill = 0;   // Fraction of useful entries in the ELL format.
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code.
+void initializeDevice();
+// Read a coordinate matrix from a Matrix Market file.
+bool loadMatrixMarket( const std::string& path, CsrMatrix& a );
+// Generate a matrix whose row lengths are heavily skewed.
+CsrMatrix generateSkewedMatrix( const size_t rows, const size_t cols );
+// Sort and merge triplets into a CSR matrix.
+void buildCsr( std::vector< Triplet >& entries, CsrMatrix& a );
+// Convert a CSR matrix to the ELL format.
+EllMatrix convertCsrToEll( const CsrMatrix& a );
+// Convert a CSR matrix to the SELL-C-sigma format.
+SellMatrix convertCsrToSell( const CsrMatrix& a,
+                             const size_t slice_height,
+                             const size_t sigma );
+// Compute the row-length statistics of a CSR matrix.
+RowStatistics computeRowStatistics( const CsrMatrix& a );
+// Select the SpMV kernel which best fits the row-length statistics.
+SpmvKernel selectSpmvKernel( const RowStatistics& stats );
+// Return the name of an SpMV kernel.
+const char* getKernelName( const SpmvKernel kernel_type );
+// Sequentially performs the operation y[rows] = a[rows,cols] * x[cols].
+void seqSpmv( const CsrMatrix& a, const float* x, float* y );
+// Sequentially performs the operation c[rows,n] = a[rows,k] * b[k,n].
+void seqSpmm( const CsrMatrix& a, const float* b, float* c, const size_t n );
+// Parallelly performs y = a * x with one of the CSR kernels.
+void parSpmvCsr( const CsrMatrix& a,
+                 const float* x,
+                 float* y,
+                 const SpmvKernel kernel_type );
+// Parallelly performs y = a * x with a matrix stored in the ELL format.
+void parSpmvEll( const EllMatrix& a, const float* x, float* y );
+// Parallelly performs y = a * x with a matrix stored in the SELL format.
+void parSpmvSell( const SellMatrix& a, const float* x, float* y );
+// Parallelly performs the operation c[rows,n] = a[rows,k] * b[k,n].
+void parSpmm( const CsrMatrix& a, const float* b, float* c, const size_t n );
+// Check if the arrays c1 and c2 are equal up to rounding errors.
+bool checkEquality( const float* c1, const float* c2, const size_t n );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+constexpr size_t WG_SIZE = 128;        // The size of work-groups.
+constexpr size_t VECTOR_SIZE = 32;     // Work-items per row in CSR vector.
+constexpr int MERGE_PATH_ITEMS = 32;   // Merge items per work-item.
+constexpr size_t SELL_C = 32;          // Rows per SELL slice.
+constexpr size_t SELL_SIGMA = 1024;    // Rows sorted together in SELL.
+constexpr size_t MAX_ELL_PADDING = 8;  // Max ELL entries per non-zero.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main( int argc, char** argv ) {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   constexpr int executions = 20;
+
+   /**
+    * Load the sparse matrix A from a Matrix Market file, or generate one
+    * with a skewed row-length distribution.
+    * */
+
+   CsrMatrix a;
+   if( argc > 1 ) {
+      if( !loadMatrixMarket( argv[1], a ) ) {
+         return 1;
+      }
+   } else {
+      a = generateSkewedMatrix( 1 << 16, 1 << 16 );
+   }
+   const size_t nnz = a.values.size();
+
+   /**
+    * Prepare the dense input vector x and the dense input matrix B.
+    * */
+
+   constexpr size_t n = 16;
+   std::vector< float > x( a.cols );
+   for( size_t i = 0; i < a.cols; i++ ) {
+      x[i] = static_cast< float >( i % 7 ) * 0.5f;
+   }
+   std::vector< float > b( a.cols * n );
+   for( size_t i = 0; i < a.cols * n; i++ ) {
+      b[i] = static_cast< float >( i % 5 ) * 0.25f;
+   }
+
+   /**
+    * Convert A to the other formats and select an SpMV kernel.
+    * */
+
+   RowStatistics stats = computeRowStatistics( a );
+   SpmvKernel selected = selectSpmvKernel( stats );
+   bool use_ell = a.rows * stats.max <= MAX_ELL_PADDING * nnz;
+   EllMatrix ell = use_ell ? convertCsrToEll( a ) : EllMatrix();
+   SellMatrix sell = convertCsrToSell( a, SELL_C, SELL_SIGMA );
+
+   /**
+    * Prepare sequential and parallel outputs.
+    * */
+
+   std::vector< float > ys( a.rows );
+   std::vector< float > yp( a.rows );
+   std::vector< float > cs( a.rows * n );
+   std::vector< float > cp( a.rows * n );
+
+   /**
+    * Sequentially multiply A by x and by B.
+    * */
+
+   auto start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      seqSpmv( a, x.data(), ys.data() );
+   }
+   double seq_spmv_time = getElapsedTime( start ) / executions;
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      seqSpmm( a, b.data(), cs.data(), n );
+   }
+   double seq_spmm_time = getElapsedTime( start ) / executions;
+
+   /**
+    * Initialize OpenCL device.
+    * */
+
+   initializeDevice();
+
+   /**
+    * Print the properties of the matrix.
+    * */
+
+   std::cout << "Matrix: " << a.rows << " x " << a.cols << ", " << nnz
+             << " non-zeros;\n\tRow length: mean " << stats.mean << ", stddev "
+             << stats.stddev << ", max " << stats.max << ";\n\tELL fill: "
+             << 100 * stats.ell_fill << "%;\n\tSelected kernel: "
+             << getKernelName( selected ) << std::endl;
+
+   /**
+    * Parallelly multiply A by x with every kernel and check the outputs.
+    * */
+
+   const SpmvKernel kernels[] = { SpmvKernel::CsrScalar,
+                                  SpmvKernel::CsrVector,
+                                  SpmvKernel::CsrMergePath,
+                                  SpmvKernel::Ell,
+                                  SpmvKernel::Sell };
+   bool equal = true;
+   std::cout << "Mean SpMV execution time: \n\tSequential: " << seq_spmv_time
+             << " ms;" << std::endl;
+   for( SpmvKernel kernel_type : kernels ) {
+      if( kernel_type == SpmvKernel::Ell && !use_ell ) {
+         std::cout << "\t" << getKernelName( kernel_type )
+                   << ": skipped, too much padding;" << std::endl;
+         continue;
+      }
+      std::fill( yp.begin(), yp.end(), 0.0f );
+      start = std::chrono::steady_clock::now();
+      for( int i = 0; i < executions; i++ ) {
+         if( kernel_type == SpmvKernel::Ell ) {
+            parSpmvEll( ell, x.data(), yp.data() );
+         } else if( kernel_type == SpmvKernel::Sell ) {
+            parSpmvSell( sell, x.data(), yp.data() );
+         } else {
+            parSpmvCsr( a, x.data(), yp.data(), kernel_type );
+         }
+      }
+      double par_time = getElapsedTime( start ) / executions;
+      bool kernel_equal = checkEquality( ys.data(), yp.data(), a.rows );
+      equal = equal && kernel_equal;
+      std::cout << "\t" << getKernelName( kernel_type ) << ": " << par_time
+                << " ms (" << ( kernel_equal ? "SUCCESS" : "FAILED" )
+                << ", gain " << ( 100 * ( seq_spmv_time - par_time ) / par_time )
+                << "%);" << std::endl;
+   }
+
+   /**
+    * Parallelly multiply A by B.
+    * */
+
+   start = std::chrono::steady_clock::now();
+   for( int i = 0; i < executions; i++ ) {
+      parSpmm( a, b.data(), cp.data(), n );
+   }
+   double par_spmm_time = getElapsedTime( start ) / executions;
+   bool spmm_equal = checkEquality( cs.data(), cp.data(), a.rows * n );
+   equal = equal && spmm_equal;
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Mean SpMM execution time (n = " << n
+             << "): \n\tSequential: " << seq_spmm_time
+             << " ms;\n\tParallel: " << par_spmm_time << " ms ("
+             << ( spmm_equal ? "SUCCESS" : "FAILED" ) << ")." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( seq_spmm_time - par_spmm_time ) / par_spmm_time )
+             << "%\n";
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return equal ? 0 : 1;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device.
+    * */
+
+   device = getDefaultDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "sparse_matrix_multiplication.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   std::string options = "-DVECTOR_SIZE=" + std::to_string( VECTOR_SIZE );
+   auto err = program.build( options.c_str() );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Read a coordinate matrix from a Matrix Market file. Real, integer and
+ * pattern fields are supported, as well as general, symmetric and
+ * skew-symmetric matrices.
+ * */
+
+bool loadMatrixMarket( const std::string& path, CsrMatrix& a ) {
+
+   /**
+    * Open the file and parse its banner.
+    * */
+
+   std::ifstream file( path );
+   if( !file.is_open() ) {
+      std::cerr << "Cannot open " << path << "!" << std::endl;
+      return false;
+   }
+
+   std::string line;
+   std::getline( file, line );
+   std::istringstream banner( line );
+   std::string tag, object, format, field, symmetry;
+   banner >> tag >> object >> format >> field >> symmetry;
+   for( std::string* word : { &object, &format, &field, &symmetry } ) {
+      std::transform( word->begin(), word->end(), word->begin(), ::tolower );
+   }
+
+   if( tag != "%%MatrixMarket" || object != "matrix"
+       || format != "coordinate" ) {
+      std::cerr << "Only Matrix Market coordinate matrices are supported!"
+                << std::endl;
+      return false;
+   }
+   if( field != "real" && field != "integer" && field != "pattern" ) {
+      std::cerr << "Unsupported Matrix Market field: " << field << std::endl;
+      return false;
+   }
+   bool symmetric = symmetry == "symmetric";
+   bool skew = symmetry == "skew-symmetric";
+   if( !symmetric && !skew && symmetry != "general" ) {
+      std::cerr << "Unsupported Matrix Market symmetry: " << symmetry
+                << std::endl;
+      return false;
+   }
+
+   /**
+    * Skip comments and read the dimensions of the matrix.
+    * */
+
+   while( std::getline( file, line ) ) {
+      if( !line.empty() && line[0] != '%' ) {
+         break;
+      }
+   }
+   size_t rows = 0, cols = 0, entries = 0;
+   std::istringstream size_line( line );
+   if( !( size_line >> rows >> cols >> entries ) ) {
+      std::cerr << "Invalid Matrix Market size line!" << std::endl;
+      return false;
+   }
+
+   /**
+    * Read the non-zeros, converting 1-based indices to 0-based ones and
+    * mirroring the lower triangle of symmetric matrices.
+    * */
+
+   std::vector< Triplet > triplets;
+   triplets.reserve( symmetric || skew ? 2 * entries : entries );
+   for( size_t i = 0; i < entries; i++ ) {
+      long row, col;
+      double value = 1.0;
+      file >> row >> col;
+      if( field != "pattern" ) {
+         file >> value;
+      }
+      if( !file || row < 1 || col < 1 || static_cast< size_t >( row ) > rows
+          || static_cast< size_t >( col ) > cols ) {
+         std::cerr << "Invalid Matrix Market entry " << i << "!" << std::endl;
+         return false;
+      }
+      Triplet t{ static_cast< int >( row - 1 ),
+                 static_cast< int >( col - 1 ),
+                 static_cast< float >( value ) };
+      triplets.push_back( t );
+      if( ( symmetric || skew ) && t.row != t.col ) {
+         triplets.push_back( { t.col, t.row, skew ? -t.value : t.value } );
+      }
+   }
+
+   a.rows = rows;
+   a.cols = cols;
+   buildCsr( triplets, a );
+   if( a.values.empty() ) {
+      std::cerr << "The matrix has no non-zeros!" << std::endl;
+      return false;
+   }
+   return true;
+}
+
+/**
+ * Generate a matrix whose row lengths are heavily skewed: most rows hold a
+ * few non-zeros, while one row out of 1024 is much longer.
+ * */
+
+CsrMatrix generateSkewedMatrix( const size_t rows, const size_t cols ) {
+   std::mt19937 generator( 42 );
+   std::uniform_int_distribution< int > short_length( 2, 14 );
+   std::uniform_int_distribution< int > col_dist(
+      0,
+      static_cast< int >( cols ) - 1 );
+   std::uniform_real_distribution< float > value_dist( -1.0f, 1.0f );
+
+   std::vector< Triplet > triplets;
+   for( size_t i = 0; i < rows; i++ ) {
+      size_t length = ( i % 1024 == 0 ) ? cols / 16
+                                        : static_cast< size_t >(
+                                             short_length( generator ) );
+      for( size_t j = 0; j < length; j++ ) {
+         triplets.push_back( { static_cast< int >( i ),
+                               col_dist( generator ),
+                               value_dist( generator ) } );
+      }
+   }
+
+   CsrMatrix a;
+   a.rows = rows;
+   a.cols = cols;
+   buildCsr( triplets, a );
+   return a;
+}
+
+/**
+ * Sort and merge triplets into a CSR matrix whose dimensions are already set.
+ * Duplicated entries are summed.
+ * */
+
+void buildCsr( std::vector< Triplet >& entries, CsrMatrix& a ) {
+   std::sort( entries.begin(),
+              entries.end(),
+              []( const Triplet& l, const Triplet& r ) {
+                 return l.row < r.row || ( l.row == r.row && l.col < r.col );
+              } );
+
+   a.row_ptr.assign( a.rows + 1, 0 );
+   a.col_idx.clear();
+   a.values.clear();
+   for( size_t i = 0; i < entries.size(); i++ ) {
+      if( i > 0 && entries[i].row == entries[i - 1].row
+          && entries[i].col == entries[i - 1].col ) {
+         a.values.back() += entries[i].value;
+         continue;
+      }
+      a.col_idx.push_back( entries[i].col );
+      a.values.push_back( entries[i].value );
+      a.row_ptr[entries[i].row + 1]++;
+   }
+   std::partial_sum( a.row_ptr.begin(), a.row_ptr.end(), a.row_ptr.begin() );
+}
+
+/**
+ * Convert a CSR matrix to the ELL format, padding every row to the length of
+ * the longest one.
+ * */
+
+EllMatrix convertCsrToEll( const CsrMatrix& a ) {
+   EllMatrix ell;
+   ell.rows = a.rows;
+   ell.cols = a.cols;
+   for( size_t i = 0; i < a.rows; i++ ) {
+      ell.width = std::max( ell.width,
+                            static_cast< size_t >( a.row_ptr[i + 1]
+                                                   - a.row_ptr[i] ) );
+   }
+
+   ell.col_idx.assign( ell.rows * ell.width, 0 );
+   ell.values.assign( ell.rows * ell.width, 0.0f );
+   for( size_t i = 0; i < a.rows; i++ ) {
+      for( int j = a.row_ptr[i]; j < a.row_ptr[i + 1]; j++ ) {
+         size_t index = static_cast< size_t >( j - a.row_ptr[i] ) * ell.rows + i;
+         ell.col_idx[index] = a.col_idx[j];
+         ell.values[index] = a.values[j];
+      }
+   }
+   return ell;
+}
+
+/**
+ * Convert a CSR matrix to the SELL-C-sigma format. Rows are sorted by length
+ * inside windows of sigma rows, so rows of similar lengths share a slice and
+ * little padding is needed.
+ * */
+
+SellMatrix convertCsrToSell( const CsrMatrix& a,
+                             const size_t slice_height,
+                             const size_t sigma ) {
+   SellMatrix sell;
+   sell.rows = a.rows;
+   sell.cols = a.cols;
+   sell.slice_height = slice_height;
+   sell.sigma = sigma;
+   sell.padded_rows = ( a.rows + slice_height - 1 ) / slice_height
+                    * slice_height;
+
+   /**
+    * Sort the rows of every sigma window by decreasing length.
+    * */
+
+   auto row_length = [&a]( int row ) {
+      return a.row_ptr[row + 1] - a.row_ptr[row];
+   };
+   sell.row_perm.assign( sell.padded_rows, -1 );
+   std::iota( sell.row_perm.begin(), sell.row_perm.begin() + a.rows, 0 );
+   for( size_t w = 0; w < a.rows; w += sigma ) {
+      std::stable_sort( sell.row_perm.begin() + w,
+                        sell.row_perm.begin() + std::min( w + sigma, a.rows ),
+                        [&]( int l, int r ) {
+                           return row_length( l ) > row_length( r );
+                        } );
+   }
+
+   /**
+    * Compute the width and offset of every slice.
+    * */
+
+   size_t slices = sell.padded_rows / slice_height;
+   sell.slice_ptr.assign( slices + 1, 0 );
+   sell.slice_width.assign( slices, 0 );
+   for( size_t s = 0; s < slices; s++ ) {
+      for( size_t lane = 0; lane < slice_height; lane++ ) {
+         int row = sell.row_perm[s * slice_height + lane];
+         if( row >= 0 ) {
+            sell.slice_width[s] = std::max( sell.slice_width[s],
+                                            row_length( row ) );
+         }
+      }
+      sell.slice_ptr[s + 1] = sell.slice_ptr[s]
+                            + sell.slice_width[s]
+                                 * static_cast< int >( slice_height );
+   }
+
+   /**
+    * Store every slice column-major.
+    * */
+
+   sell.col_idx.assign( sell.slice_ptr[slices], 0 );
+   sell.values.assign( sell.slice_ptr[slices], 0.0f );
+   for( size_t s = 0; s < slices; s++ ) {
+      for( size_t lane = 0; lane < slice_height; lane++ ) {
+         int row = sell.row_perm[s * slice_height + lane];
+         if( row < 0 ) {
+            continue;
+         }
+         for( int j = a.row_ptr[row]; j < a.row_ptr[row + 1]; j++ ) {
+            size_t index = sell.slice_ptr[s] + lane
+                         + static_cast< size_t >( j - a.row_ptr[row] )
+                              * slice_height;
+            sell.col_idx[index] = a.col_idx[j];
+            sell.values[index] = a.values[j];
+         }
+      }
+   }
+   return sell;
+}
+
+/**
+ * Compute the row-length statistics of a CSR matrix.
+ * */
+
+RowStatistics computeRowStatistics( const CsrMatrix& a ) {
+   RowStatistics stats;
+   if( a.rows == 0 ) {
+      return stats;
+   }
+
+   double sum_squares = 0;
+   for( size_t i = 0; i < a.rows; i++ ) {
+      size_t length = static_cast< size_t >( a.row_ptr[i + 1] - a.row_ptr[i] );
+      stats.max = std::max( stats.max, length );
+      sum_squares += static_cast< double >( length * length );
+   }
+   stats.mean = static_cast< double >( a.values.size() ) / a.rows;
+   stats.stddev = std::sqrt(
+      std::max( 0.0, sum_squares / a.rows - stats.mean * stats.mean ) );
+   stats.ell_fill = stats.max == 0 ? 1.0 : stats.mean / stats.max;
+   return stats;
+}
+
+/**
+ * Select the SpMV kernel which best fits the row-length statistics:
+ *  - ELL when rows have almost the same length;
+ *  - CSR merge-path when a few rows are much longer than the others;
+ *  - CSR vector when rows are long enough to feed VECTOR_SIZE work-items;
+ *  - SELL-C-sigma for the remaining short and irregular rows.
+ * */
+
+SpmvKernel selectSpmvKernel( const RowStatistics& stats ) {
+   if( stats.ell_fill >= 0.75 ) {
+      return SpmvKernel::Ell;
+   }
+   if( stats.stddev >= stats.mean
+       && static_cast< double >( stats.max ) >= 16 * stats.mean ) {
+      return SpmvKernel::CsrMergePath;
+   }
+   if( stats.mean >= VECTOR_SIZE / 2 ) {
+      return SpmvKernel::CsrVector;
+   }
+   return SpmvKernel::Sell;
+}
+
+/**
+ * Return the name of an SpMV kernel.
+ * */
+
+const char* getKernelName( const SpmvKernel kernel_type ) {
+   switch( kernel_type ) {
+      case SpmvKernel::CsrScalar: return "CSR scalar";
+      case SpmvKernel::CsrVector: return "CSR vector";
+      case SpmvKernel::CsrMergePath: return "CSR merge-path";
+      case SpmvKernel::Ell: return "ELL";
+      case SpmvKernel::Sell: return "SELL-C-sigma";
+   }
+   return "unknown";
+}
+
+/**
+ * Sequentially performs the operation y[rows] = a[rows,cols] * x[cols].
+ * */
+
+void seqSpmv( const CsrMatrix& a, const float* x, float* y ) {
+   for( size_t i = 0; i < a.rows; i++ ) {
+      float sum = 0.0f;
+      for( int j = a.row_ptr[i]; j < a.row_ptr[i + 1]; j++ ) {
+         sum += a.values[j] * x[a.col_idx[j]];
+      }
+      y[i] = sum;
+   }
+}
+
+/**
+ * Sequentially performs the operation c[rows,n] = a[rows,k] * b[k,n].
+ * */
+
+void seqSpmm( const CsrMatrix& a, const float* b, float* c, const size_t n ) {
+   for( size_t i = 0; i < a.rows; i++ ) {
+      for( size_t j = 0; j < n; j++ ) {
+         float sum = 0.0f;
+         for( int z = a.row_ptr[i]; z < a.row_ptr[i + 1]; z++ ) {
+            sum += a.values[z] * b[a.col_idx[z] * n + j];
+         }
+         c[i * n + j] = sum;
+      }
+   }
+}
+
+/**
+ * Parallelly performs the operation y[rows] = a[rows,cols] * x[cols] with one
+ * of the CSR kernels.
+ * */
+
+void parSpmvCsr( const CsrMatrix& a,
+                 const float* x,
+                 float* y,
+                 const SpmvKernel kernel_type ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   const cl_int rows = static_cast< cl_int >( a.rows );
+   const cl_int nnz = static_cast< cl_int >( a.values.size() );
+   cl::Buffer row_ptr_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.row_ptr.size() * sizeof( int ),
+      const_cast< int* >( a.row_ptr.data() ) );
+   cl::Buffer col_idx_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.col_idx.size() * sizeof( int ),
+      const_cast< int* >( a.col_idx.data() ) );
+   cl::Buffer values_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.values.size() * sizeof( float ),
+      const_cast< float* >( a.values.data() ) );
+   cl::Buffer x_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.cols * sizeof( float ),
+      const_cast< float* >( x ) );
+   cl::Buffer y_buf( context,
+                     CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY,
+                     a.rows * sizeof( float ) );
+
+   cl::CommandQueue queue( context, device );
+
+   /**
+    * Set kernel arguments and execute the selected kernel.
+    * */
+
+   if( kernel_type == SpmvKernel::CsrMergePath ) {
+
+      /**
+       * Every work-item consumes MERGE_PATH_ITEMS rows plus non-zeros and
+       * carries out the partial sum of its last row.
+       * */
+
+      size_t num_work_items = ( a.rows + a.values.size() + MERGE_PATH_ITEMS
+                                - 1 )
+                            / MERGE_PATH_ITEMS;
+      cl::Buffer carry_rows_buf( context,
+                                 CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                 num_work_items * sizeof( int ) );
+      cl::Buffer carry_values_buf( context,
+                                   CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS,
+                                   num_work_items * sizeof( float ) );
+
+      cl::Kernel kernel( program, "spmvCsrMergePath" );
+      kernel.setArg( 0, row_ptr_buf );
+      kernel.setArg( 1, col_idx_buf );
+      kernel.setArg( 2, values_buf );
+      kernel.setArg( 3, x_buf );
+      kernel.setArg( 4, y_buf );
+      kernel.setArg( 5, rows );
+      kernel.setArg( 6, nnz );
+      kernel.setArg( 7, MERGE_PATH_ITEMS );
+      kernel.setArg( 8, carry_rows_buf );
+      kernel.setArg( 9, carry_values_buf );
+
+      cl::Kernel fixup( program, "spmvCsrMergePathFixup" );
+      fixup.setArg( 0, carry_rows_buf );
+      fixup.setArg( 1, carry_values_buf );
+      fixup.setArg( 2, y_buf );
+      fixup.setArg( 3, rows );
+      fixup.setArg( 4, static_cast< cl_int >( num_work_items ) );
+
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( num_work_items ) );
+      queue.enqueueNDRangeKernel( fixup, cl::NullRange, cl::NDRange( 1 ) );
+   } else if( kernel_type == SpmvKernel::CsrVector ) {
+      cl::Kernel kernel( program, "spmvCsrVector" );
+      kernel.setArg( 0, row_ptr_buf );
+      kernel.setArg( 1, col_idx_buf );
+      kernel.setArg( 2, values_buf );
+      kernel.setArg( 3, x_buf );
+      kernel.setArg( 4, y_buf );
+      kernel.setArg( 5, rows );
+      kernel.setArg( 6, cl::Local( WG_SIZE * sizeof( float ) ) );
+
+      size_t global_size = ( a.rows * VECTOR_SIZE + WG_SIZE - 1 ) / WG_SIZE
+                         * WG_SIZE;
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( global_size ),
+                                  cl::NDRange( WG_SIZE ) );
+   } else {
+      cl::Kernel kernel( program, "spmvCsrScalar" );
+      kernel.setArg( 0, row_ptr_buf );
+      kernel.setArg( 1, col_idx_buf );
+      kernel.setArg( 2, values_buf );
+      kernel.setArg( 3, x_buf );
+      kernel.setArg( 4, y_buf );
+      kernel.setArg( 5, rows );
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( a.rows ) );
+   }
+
+   /**
+    * Collect the result.
+    * */
+
+   queue.enqueueReadBuffer( y_buf, CL_TRUE, 0, a.rows * sizeof( float ), y );
+}
+
+/**
+ * Parallelly performs the operation y[rows] = a[rows,cols] * x[cols] with a
+ * matrix stored in the ELL format.
+ * */
+
+void parSpmvEll( const EllMatrix& a, const float* x, float* y ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer cols_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.col_idx.size() * sizeof( int ),
+      const_cast< int* >( a.col_idx.data() ) );
+   cl::Buffer values_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.values.size() * sizeof( float ),
+      const_cast< float* >( a.values.data() ) );
+   cl::Buffer x_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.cols * sizeof( float ),
+      const_cast< float* >( x ) );
+   cl::Buffer y_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     a.rows * sizeof( float ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, "spmvEll" );
+   kernel.setArg( 0, cols_buf );
+   kernel.setArg( 1, values_buf );
+   kernel.setArg( 2, x_buf );
+   kernel.setArg( 3, y_buf );
+   kernel.setArg( 4, static_cast< cl_int >( a.rows ) );
+   kernel.setArg( 5, static_cast< cl_int >( a.width ) );
+
+   /**
+    * Execute the kernel function and collect its result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel( kernel, cl::NullRange, cl::NDRange( a.rows ) );
+   queue.enqueueReadBuffer( y_buf, CL_TRUE, 0, a.rows * sizeof( float ), y );
+}
+
+/**
+ * Parallelly performs the operation y[rows] = a[rows,cols] * x[cols] with a
+ * matrix stored in the SELL-C-sigma format.
+ * */
+
+void parSpmvSell( const SellMatrix& a, const float* x, float* y ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer slice_ptr_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.slice_ptr.size() * sizeof( int ),
+      const_cast< int* >( a.slice_ptr.data() ) );
+   cl::Buffer slice_width_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.slice_width.size() * sizeof( int ),
+      const_cast< int* >( a.slice_width.data() ) );
+   cl::Buffer cols_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.col_idx.size() * sizeof( int ),
+      const_cast< int* >( a.col_idx.data() ) );
+   cl::Buffer values_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.values.size() * sizeof( float ),
+      const_cast< float* >( a.values.data() ) );
+   cl::Buffer row_perm_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.row_perm.size() * sizeof( int ),
+      const_cast< int* >( a.row_perm.data() ) );
+   cl::Buffer x_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.cols * sizeof( float ),
+      const_cast< float* >( x ) );
+   cl::Buffer y_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     a.rows * sizeof( float ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, "spmvSell" );
+   kernel.setArg( 0, slice_ptr_buf );
+   kernel.setArg( 1, slice_width_buf );
+   kernel.setArg( 2, cols_buf );
+   kernel.setArg( 3, values_buf );
+   kernel.setArg( 4, row_perm_buf );
+   kernel.setArg( 5, x_buf );
+   kernel.setArg( 6, y_buf );
+   kernel.setArg( 7, static_cast< cl_int >( a.slice_height ) );
+   kernel.setArg( 8, static_cast< cl_int >( a.padded_rows ) );
+
+   /**
+    * Execute the kernel function and collect its result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( a.padded_rows ),
+                               cl::NDRange( a.slice_height ) );
+   queue.enqueueReadBuffer( y_buf, CL_TRUE, 0, a.rows * sizeof( float ), y );
+}
+
+/**
+ * Parallelly performs the operation c[rows,n] = a[rows,k] * b[k,n].
+ * */
+
+void parSpmm( const CsrMatrix& a, const float* b, float* c, const size_t n ) {
+
+   /**
+    * Create buffers and allocate memory on the device.
+    * */
+
+   cl::Buffer row_ptr_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.row_ptr.size() * sizeof( int ),
+      const_cast< int* >( a.row_ptr.data() ) );
+   cl::Buffer col_idx_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.col_idx.size() * sizeof( int ),
+      const_cast< int* >( a.col_idx.data() ) );
+   cl::Buffer values_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.values.size() * sizeof( float ),
+      const_cast< float* >( a.values.data() ) );
+   cl::Buffer b_buf(
+      context,
+      CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
+      a.cols * n * sizeof( float ),
+      const_cast< float* >( b ) );
+   cl::Buffer c_buf( context,
+                     CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
+                     a.rows * n * sizeof( float ) );
+
+   /**
+    * Set kernel arguments.
+    * */
+
+   cl::Kernel kernel( program, "spmmCsr" );
+   kernel.setArg( 0, row_ptr_buf );
+   kernel.setArg( 1, col_idx_buf );
+   kernel.setArg( 2, values_buf );
+   kernel.setArg( 3, b_buf );
+   kernel.setArg( 4, c_buf );
+   kernel.setArg( 5, static_cast< cl_int >( a.rows ) );
+   kernel.setArg( 6, static_cast< cl_int >( n ) );
+
+   /**
+    * Execute the kernel function and collect its result.
+    * */
+
+   cl::CommandQueue queue( context, device );
+   queue.enqueueNDRangeKernel( kernel,
+                               cl::NullRange,
+                               cl::NDRange( n, a.rows ) );
+   queue.enqueueReadBuffer( c_buf,
+                            CL_TRUE,
+                            0,
+                            a.rows * n * sizeof( float ),
+                            c );
+}
+
+/**
+ * Check if the arrays c1 and c2 are equal up to rounding errors, since the
+ * parallel kernels sum the non-zeros of a row in a different order.
+ * */
+
+bool checkEquality( const float* c1, const float* c2, const size_t n ) {
+   for( size_t i = 0; i < n; i++ ) {
+      float tolerance = 1e-3f * std::max( 1.0f, std::fabs( c1[i] ) );
+      if( std::fabs( c1[i] - c2[i] ) > tolerance ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////////////
+///                         File Name: elementwise.hpp                       ///
+///                                                                          ///
+///   Expression templates which fuse chains of elementwise operations on    ///
+///   device vectors into one OpenCL kernel generated at runtime:            ///
+///                                                                          ///
+///      elementwise::Engine engine( context, device, queue );               ///
+///      elementwise::Vector x( engine, size ), y( ... ), z( ... );          ///
+///      out = ( x + y ) * z;                                                ///
+///                                                                          ///
+///   Every distinct expression is compiled once and cached by its           ///
+///   signature; intermediate values live in registers.                     ///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ELEMENTWISE_HPP
+#define ELEMENTWISE_HPP
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#ifndef CL_TARGET_OPENCL_VERSION
+   #define CL_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/cl.h>
+
+namespace elementwise {
+
+class Vector;
+
+// Base class of every expression, used to constrain the operators.
+struct Expression {};
+
+// Print an error message and exit when an OpenCL call failed.
+inline void checkError( const cl_int err, const std::string& what ) {
+   if( err != CL_SUCCESS ) {
+      std::cout << "Fail to " << what << " (error " << err << ").\n";
+      std::exit( 1 );
+   }
+}
+
+// =================================================================
+// ---------------------------- Engine -----------------------------
+// =================================================================
+
+// Generates, compiles, caches and launches the fused kernels.
+class Engine {
+ public:
+   Engine( cl_context context, cl_device_id device, cl_command_queue queue )
+      : context_( context ), device_( device ), queue_( queue ) {}
+
+   Engine( const Engine& ) = delete;
+   Engine& operator=( const Engine& ) = delete;
+
+   ~Engine() {
+      for( auto& entry : kernels_ ) {
+         clReleaseKernel( entry.second );
+      }
+   }
+
+   cl_context context() const { return context_; }
+   cl_command_queue queue() const { return queue_; }
+
+   // Number of fused kernels compiled so far.
+   size_t cachedKernels() const { return kernels_.size(); }
+
+   // Evaluate expr into output with a single kernel launch.
+   template< typename Expr >
+   void evaluate( const Expr& expr, Vector& output );
+
+ private:
+   // Return the kernel for a signature, generating it on a cache miss.
+   template< typename Expr >
+   cl_kernel getKernel( const Expr& expr,
+                        const std::string& signature,
+                        const size_t num_inputs );
+
+   cl_context context_;
+   cl_device_id device_;
+   cl_command_queue queue_;
+   std::unordered_map< std::string, cl_kernel > kernels_;
+};
+
+// =================================================================
+// ---------------------------- Vector -----------------------------
+// =================================================================
+
+// A vector of ints stored in a device buffer; the leaves of expressions.
+class Vector : public Expression {
+ public:
+   Vector( Engine& engine, const size_t size )
+      : engine_( engine ), size_( size ) {
+      cl_int err = CL_SUCCESS;
+      buffer_ = clCreateBuffer( engine.context(),
+                                CL_MEM_READ_WRITE,
+                                size * sizeof( int ),
+                                nullptr,
+                                &err );
+      checkError( err, "create buffer for an elementwise vector" );
+   }
+
+   Vector( const Vector& ) = delete;
+
+   ~Vector() { clReleaseMemObject( buffer_ ); }
+
+   // Evaluate expr into this vector with one fused kernel.
+   template< typename Expr,
+             typename = std::enable_if_t<
+                std::is_base_of_v< Expression, Expr > > >
+   Vector& operator=( const Expr& expr ) {
+      engine_.evaluate( expr, *this );
+      return *this;
+   }
+
+   // Copy the vector into this one.
+   Vector& operator=( const Vector& other ) {
+      engine_.evaluate( other, *this );
+      return *this;
+   }
+
+   // Upload size() values from data.
+   void write( const int* data, const cl_bool blocking = CL_FALSE ) {
+      checkError( clEnqueueWriteBuffer( engine_.queue(),
+                                        buffer_,
+                                        blocking,
+                                        0,
+                                        size_ * sizeof( int ),
+                                        data,
+                                        0,
+                                        nullptr,
+                                        nullptr ),
+                  "write an elementwise vector" );
+   }
+
+   // Download size() values to data.
+   void read( int* data ) const {
+      checkError( clEnqueueReadBuffer( engine_.queue(),
+                                       buffer_,
+                                       CL_TRUE,
+                                       0,
+                                       size_ * sizeof( int ),
+                                       data,
+                                       0,
+                                       nullptr,
+                                       nullptr ),
+                  "read an elementwise vector" );
+   }
+
+   cl_mem buffer() const { return buffer_; }
+   size_t size() const { return size_; }
+
+   // Leaves are numbered by their first appearance, so repeated vectors are
+   // loaded once and the signature captures the sharing.
+   void collect( std::vector< cl_mem >& inputs ) const {
+      for( cl_mem input : inputs ) {
+         if( input == buffer_ ) {
+            return;
+         }
+      }
+      inputs.push_back( buffer_ );
+   }
+
+   std::string signature( const std::vector< cl_mem >& inputs ) const {
+      return "v" + std::to_string( index( inputs ) );
+   }
+
+   std::string code( const std::vector< cl_mem >& inputs ) const {
+      return signature( inputs );
+   }
+
+ private:
+   size_t index( const std::vector< cl_mem >& inputs ) const {
+      size_t i = 0;
+      while( inputs[i] != buffer_ ) {
+         i++;
+      }
+      return i;
+   }
+
+   Engine& engine_;
+   size_t size_;
+   cl_mem buffer_;
+};
+
+// =================================================================
+// -------------------------- Operations ---------------------------
+// =================================================================
+
+// An elementwise binary operation between two expressions.
+template< char Op, typename L, typename R >
+class Binary : public Expression {
+ public:
+   Binary( const L& left, const R& right ) : left_( left ), right_( right ) {
+      if( left_.size() != right_.size() ) {
+         std::cout << "Fail to combine an expression of size "
+                   << left_.size() << " with one of size " << right_.size()
+                   << ".\n";
+         std::exit( 1 );
+      }
+   }
+
+   size_t size() const { return left_.size(); }
+
+   void collect( std::vector< cl_mem >& inputs ) const {
+      left_.collect( inputs );
+      right_.collect( inputs );
+   }
+
+   std::string signature( const std::vector< cl_mem >& inputs ) const {
+      return std::string( "(" ) + left_.signature( inputs ) + Op
+           + right_.signature( inputs ) + ")";
+   }
+
+   std::string code( const std::vector< cl_mem >& inputs ) const {
+      return std::string( "( " ) + left_.code( inputs ) + " " + Op + " "
+           + right_.code( inputs ) + " )";
+   }
+
+ private:
+   // Vectors are held by reference, intermediate nodes by value.
+   using LeftStorage
+      = std::conditional_t< std::is_same_v< L, Vector >, const L&, const L >;
+   using RightStorage
+      = std::conditional_t< std::is_same_v< R, Vector >, const R&, const R >;
+
+   LeftStorage left_;
+   RightStorage right_;
+};
+
+template< typename L, typename R >
+using EnableExpressions = std::enable_if_t<
+   std::is_base_of_v< Expression, L > && std::is_base_of_v< Expression, R > >;
+
+template< typename L, typename R, typename = EnableExpressions< L, R > >
+Binary< '+', L, R > operator+( const L& left, const R& right ) {
+   return Binary< '+', L, R >( left, right );
+}
+
+template< typename L, typename R, typename = EnableExpressions< L, R > >
+Binary< '-', L, R > operator-( const L& left, const R& right ) {
+   return Binary< '-', L, R >( left, right );
+}
+
+template< typename L, typename R, typename = EnableExpressions< L, R > >
+Binary< '*', L, R > operator*( const L& left, const R& right ) {
+   return Binary< '*', L, R >( left, right );
+}
+
+template< typename L, typename R, typename = EnableExpressions< L, R > >
+Binary< '/', L, R > operator/( const L& left, const R& right ) {
+   return Binary< '/', L, R >( left, right );
+}
+
+// =================================================================
+// ---------------------- Engine Implementation --------------------
+// =================================================================
+
+template< typename Expr >
+void Engine::evaluate( const Expr& expr, Vector& output ) {
+
+   if( expr.size() != output.size() ) {
+      std::cout << "Fail to evaluate an expression of size " << expr.size()
+                << " into a vector of size " << output.size() << ".\n";
+      std::exit( 1 );
+   }
+
+   // (1) Number the input vectors and get the kernel of this expression.
+   std::vector< cl_mem > inputs;
+   expr.collect( inputs );
+   cl_kernel kernel
+      = getKernel( expr, expr.signature( inputs ), inputs.size() );
+
+   // (2) Set the inputs, the output and the size as kernel arguments.
+   cl_uint arg = 0;
+   for( cl_mem& input : inputs ) {
+      checkError( clSetKernelArg( kernel, arg++, sizeof( cl_mem ), &input ),
+                  "set an input of a fused kernel" );
+   }
+   cl_mem output_buffer = output.buffer();
+   checkError(
+      clSetKernelArg( kernel, arg++, sizeof( cl_mem ), &output_buffer ),
+      "set the output of a fused kernel" );
+   cl_uint size = static_cast< cl_uint >( output.size() );
+   checkError( clSetKernelArg( kernel, arg, sizeof( cl_uint ), &size ),
+               "set the size of a fused kernel" );
+
+   // (3) Launch one work-item per element.
+   size_t global_work_size[1] = { output.size() };
+   checkError( clEnqueueNDRangeKernel( queue_,
+                                       kernel,
+                                       1,
+                                       nullptr,
+                                       global_work_size,
+                                       nullptr,
+                                       0,
+                                       nullptr,
+                                       nullptr ),
+               "enqueue a fused kernel" );
+}
+
+template< typename Expr >
+cl_kernel Engine::getKernel( const Expr& expr,
+                             const std::string& signature,
+                             const size_t num_inputs ) {
+   auto found = kernels_.find( signature );
+   if( found != kernels_.end() ) {
+      return found->second;
+   }
+
+   // (1) Generate the kernel source: every input is loaded once into a
+   // register named after its index, and the expression is evaluated on
+   // those registers.
+   std::vector< cl_mem > inputs;
+   expr.collect( inputs );
+   std::string src = "#include \"utility.cl\"\n\n"
+                     "__kernel void fused( ";
+   for( size_t i = 0; i < num_inputs; i++ ) {
+      src += "__global const int* in" + std::to_string( i ) + ",\n"
+           + "                     ";
+   }
+   src += "__global int* output,\n"
+          "                     const unsigned int size ) {\n"
+          "   unsigned int gid = compute_flattened_global_id();\n"
+          "   if( gid >= size ) {\n"
+          "      return;\n"
+          "   }\n";
+   for( size_t i = 0; i < num_inputs; i++ ) {
+      std::string index = std::to_string( i );
+      src += "   const int v" + index + " = in" + index + "[gid];\n";
+   }
+   src += "   output[gid] = " + expr.code( inputs ) + ";\n}\n";
+
+   // (2) Build it and extract the kernel.
+   cl_int err = CL_SUCCESS;
+   const char* src_str = src.c_str();
+   cl_program program
+      = clCreateProgramWithSource( context_, 1, &src_str, nullptr, &err );
+   checkError( err, "create the program of a fused kernel" );
+   err = clBuildProgram( program, 1, &device_, "-I.", nullptr, nullptr );
+   if( err != CL_SUCCESS ) {
+      size_t log_size = 0;
+      clGetProgramBuildInfo( program,
+                             device_,
+                             CL_PROGRAM_BUILD_LOG,
+                             0,
+                             nullptr,
+                             &log_size );
+      std::string log( log_size, '\0' );
+      clGetProgramBuildInfo( program,
+                             device_,
+                             CL_PROGRAM_BUILD_LOG,
+                             log_size,
+                             &log[0],
+                             nullptr );
+      std::cout << "Fail to build fused kernel " << signature << ":\n"
+                << log << std::endl;
+      std::exit( 1 );
+   }
+   cl_kernel kernel = clCreateKernel( program, "fused", &err );
+   checkError( err, "create a fused kernel" );
+
+   // The kernel keeps a reference to its program.
+   clReleaseProgram( program );
+
+   kernels_.emplace( signature, kernel );
+   return kernel;
+}
+
+}   // namespace elementwise
+
+#endif
@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+///                     File Name: vecAddAndMulFused.cpp                     ///
+///                                                                          ///
+///   Compare output = ( x + y ) * z computed as in vecAddAndMul.cpp (run    ///
+///   vecAdd, read the result back, upload it with z and run vecMul) with    ///
+///   a single kernel fused at runtime by elementwise.hpp.                   ///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 300
+#include "elementwise.hpp"
+
+// Build the only kernel of a .cl file found in the current directory.
+cl_kernel buildKernel( cl_context context,
+                       cl_device_id device,
+                       const std::string& file_name,
+                       const std::string& kernel_name );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+int main() {
+   /* 1. get platform & device information */
+   // Use the default device of the first platform.
+   cl_int err = CL_SUCCESS;
+   cl_platform_id platform_id = nullptr;
+   err = clGetPlatformIDs( 1, &platform_id, nullptr );
+   if( err != CL_SUCCESS ) {
+      std::cout << "Your system has 0 OpenCL platform." << std::endl;
+      return err;
+   }
+   cl_device_id device_id = nullptr;
+   err = clGetDeviceIDs( platform_id,
+                         CL_DEVICE_TYPE_DEFAULT,
+                         1,
+                         &device_id,
+                         nullptr );
+   if( err != CL_SUCCESS ) {
+      std::cout << "Current platform has no supported device." << std::endl;
+      return err;
+   }
+   cl_ulong max_alloc_size = 0;
+   cl_ulong global_mem_size = 0;
+   clGetDeviceInfo( device_id,
+                    CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                    sizeof( cl_ulong ),
+                    &max_alloc_size,
+                    nullptr );
+   clGetDeviceInfo( device_id,
+                    CL_DEVICE_GLOBAL_MEM_SIZE,
+                    sizeof( cl_ulong ),
+                    &global_mem_size,
+                    nullptr );
+
+   /* 2. create context and command queue */
+   cl_context context
+      = clCreateContext( nullptr, 1, &device_id, nullptr, nullptr, &err );
+   elementwise::checkError( err, "create a context" );
+   cl_command_queue command_queue
+      = clCreateCommandQueueWithProperties( context, device_id, nullptr, &err );
+   elementwise::checkError( err, "create a command queue" );
+
+   /* 3. build the unfused kernels */
+   cl_kernel kernel_add
+      = buildKernel( context, device_id, "vecAdd.cl", "vecAdd" );
+   cl_kernel kernel_mul
+      = buildKernel( context, device_id, "vecMul.cl", "vecMul" );
+
+   /* 4. create the fusion engine */
+   elementwise::Engine engine( context, device_id, command_queue );
+
+   /* 5. run both paths from 1K to 1G elements */
+   constexpr int executions = 5;
+   bool equal = true;
+   std::cout << std::fixed << std::setprecision( 3 )
+             << "Mean execution time of output = ( x + y ) * z:" << std::endl;
+   for( size_t size = size_t( 1 ) << 10; size <= size_t( 1 ) << 30;
+        size <<= 2 ) {
+
+      // (1) Skip the sizes which do not fit in the device: both paths keep
+      // four vectors on it.
+      const size_t bytes = size * sizeof( int );
+      if( bytes > max_alloc_size || 4 * bytes > global_mem_size ) {
+         std::cout << "\t" << std::setw( 10 ) << size
+                   << " elements: skipped, not enough device memory."
+                   << std::endl;
+         continue;
+      }
+
+      // (2) Declare data in host.
+      std::vector< int > input_x( size );
+      std::vector< int > input_y( size );
+      std::vector< int > input_z( size );
+      std::vector< int > expected( size );
+      for( size_t i = 0; i < size; i++ ) {
+         input_x[i] = static_cast< int >( i % 1000 );
+         input_y[i] = static_cast< int >( 2 * ( i % 1000 ) );
+         input_z[i] = static_cast< int >( 3 * ( i % 1000 ) );
+         expected[i] = ( input_x[i] + input_y[i] ) * input_z[i];
+      }
+      std::vector< int > unfused( size );
+      std::vector< int > fused( size );
+
+      // (3) Unfused path: vecAdd, read the sum back, re-upload it with z and
+      // run vecMul, as vecAddAndMul.cpp does.
+      elementwise::Vector x( engine, size );
+      elementwise::Vector y( engine, size );
+      elementwise::Vector z( engine, size );
+      elementwise::Vector output( engine, size );
+      cl_mem mem_objects[4]
+         = { x.buffer(), y.buffer(), z.buffer(), output.buffer() };
+      size_t global_work_size[1] = { size };
+
+      auto start = std::chrono::steady_clock::now();
+      for( int i = 0; i < executions; i++ ) {
+         x.write( input_x.data() );
+         y.write( input_y.data() );
+         clSetKernelArg( kernel_add, 0, sizeof( cl_mem ), &mem_objects[0] );
+         clSetKernelArg( kernel_add, 1, sizeof( cl_mem ), &mem_objects[1] );
+         clSetKernelArg( kernel_add, 2, sizeof( cl_mem ), &mem_objects[3] );
+         elementwise::checkError( clEnqueueNDRangeKernel( command_queue,
+                                                          kernel_add,
+                                                          1,
+                                                          nullptr,
+                                                          global_work_size,
+                                                          nullptr,
+                                                          0,
+                                                          nullptr,
+                                                          nullptr ),
+                                  "enqueue kernel kernel_add" );
+         output.read( unfused.data() );
+
+         y.write( unfused.data() );
+         z.write( input_z.data() );
+         clSetKernelArg( kernel_mul, 0, sizeof( cl_mem ), &mem_objects[2] );
+         clSetKernelArg( kernel_mul, 1, sizeof( cl_mem ), &mem_objects[1] );
+         clSetKernelArg( kernel_mul, 2, sizeof( cl_mem ), &mem_objects[3] );
+         elementwise::checkError( clEnqueueNDRangeKernel( command_queue,
+                                                          kernel_mul,
+                                                          1,
+                                                          nullptr,
+                                                          global_work_size,
+                                                          nullptr,
+                                                          0,
+                                                          nullptr,
+                                                          nullptr ),
+                                  "enqueue kernel kernel_mul" );
+         output.read( unfused.data() );
+      }
+      double unfused_time = getElapsedTime( start ) / executions;
+
+      // (4) Fused path: upload x, y and z once and evaluate the expression
+      // with one kernel. The first evaluation compiles the kernel, so it is
+      // kept out of the measurement.
+      x.write( input_x.data() );
+      y.write( input_y.data() );
+      z.write( input_z.data() );
+      output = ( x + y ) * z;
+      clFinish( command_queue );
+
+      start = std::chrono::steady_clock::now();
+      for( int i = 0; i < executions; i++ ) {
+         x.write( input_x.data() );
+         y.write( input_y.data() );
+         z.write( input_z.data() );
+         output = ( x + y ) * z;
+         output.read( fused.data() );
+      }
+      double fused_time = getElapsedTime( start ) / executions;
+
+      // (5) Check the results and print the times.
+      bool size_equal = unfused == expected && fused == expected;
+      equal = equal && size_equal;
+      std::cout << "\t" << std::setw( 10 ) << size
+                << " elements: Unfused: " << unfused_time
+                << " ms; Fused: " << fused_time
+                << " ms; Speedup: " << unfused_time / fused_time << "x"
+                << ( size_equal ? "" : " (FAILED)" ) << std::endl;
+   }
+   std::cout << "Fused kernels compiled: " << engine.cachedKernels()
+             << std::endl;
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+
+   /* 6. clean up */
+   clReleaseKernel( kernel_add );
+   clReleaseKernel( kernel_mul );
+   clReleaseCommandQueue( command_queue );
+   clReleaseContext( context );
+
+   return 0;
+}
+
+// Build the only kernel of a .cl file found in the current directory.
+cl_kernel buildKernel( cl_context context,
+                       cl_device_id device,
+                       const std::string& file_name,
+                       const std::string& kernel_name ) {
+   std::ifstream kernel_file( file_name, std::ios::in );
+   std::ostringstream oss;
+   oss << kernel_file.rdbuf();
+   std::string src_std_str = oss.str();
+   const char* src_str = src_std_str.c_str();
+
+   cl_int err = CL_SUCCESS;
+   cl_program program
+      = clCreateProgramWithSource( context, 1, &src_str, nullptr, &err );
+   elementwise::checkError( err, "create program from " + file_name );
+   err = clBuildProgram( program, 1, &device, "-I.", nullptr, nullptr );
+   elementwise::checkError( err, "build program from " + file_name );
+   cl_kernel kernel = clCreateKernel( program, kernel_name.c_str(), &err );
+   elementwise::checkError( err, "create kernel " + kernel_name );
+
+   // The kernel keeps a reference to its program.
+   clReleaseProgram( program );
+   return kernel;
+}
+
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
@@ -0,0 +1,117 @@
+/**
+ * Declare the structures the host builds in coarse-grained SVM, with the
+ * layout of their host counterparts. Their members point to other SVM
+ * allocations, which the kernels follow directly: the host passes those
+ * allocations as indirect SVM pointers of the kernels.
+ */
+
+#define EMPTY_KEY 0xffffffffu
+#define NOT_FOUND 0xffffffffu
+#define UNVISITED 0xffffffffu
+
+// Open-addressing hash table with linear probing; capacity is a power of
+// two and empty slots hold EMPTY_KEY.
+typedef struct {
+   uint capacity;
+   __global uint* keys;
+   __global uint* values;
+} HashTable;
+
+// Graph in compressed sparse row format: the neighbors of vertex v are
+// edges[offsets[v]] to edges[offsets[v + 1] - 1].
+typedef struct {
+   uint vertices;
+   __global uint* offsets;
+   __global uint* edges;
+} Graph;
+
+/**
+ * Return the first slot of key: the finalizer of MurmurHash3, so that
+ * consecutive keys spread over the table. The host code uses the same.
+ */
+
+uint hashKey( uint key ) {
+   key ^= key >> 16;
+   key *= 0x85ebca6bu;
+   key ^= key >> 13;
+   key *= 0xc2b2ae35u;
+   key ^= key >> 16;
+   return key;
+}
+
+/**
+ * This kernel function inserts the pair keys[i], values[i] of every
+ * work-item into table. A slot is claimed by swapping EMPTY_KEY for the key
+ * with atomic_cmpxchg; when another work-item claimed it first, the next
+ * slot is probed. Keys must be unique and the table must not be full.
+ */
+
+__kernel void insertKeys( __global HashTable* table,
+                          const __global uint* keys,
+                          const __global uint* values ) {
+   int index = (int)get_global_id( 0 );
+   uint key = keys[index];
+   uint mask = table->capacity - 1;
+   uint slot = hashKey( key ) & mask;
+   for( ;; ) {
+      uint previous = atomic_cmpxchg( &table->keys[slot], EMPTY_KEY, key );
+      if( previous == EMPTY_KEY || previous == key ) {
+         table->values[slot] = values[index];
+         return;
+      }
+      slot = ( slot + 1 ) & mask;
+   }
+}
+
+/**
+ * This kernel function looks up keys[i] of every work-item in table and
+ * stores its value in results[i], or NOT_FOUND when it is absent.
+ */
+
+__kernel void lookupKeys( const __global HashTable* table,
+                          const __global uint* keys,
+                          __global uint* results ) {
+   int index = (int)get_global_id( 0 );
+   uint key = keys[index];
+   uint mask = table->capacity - 1;
+   uint slot = hashKey( key ) & mask;
+   for( ;; ) {
+      uint current = table->keys[slot];
+      if( current == key ) {
+         results[index] = table->values[slot];
+         return;
+      }
+      if( current == EMPTY_KEY ) {
+         results[index] = NOT_FOUND;
+         return;
+      }
+      slot = ( slot + 1 ) & mask;
+   }
+}
+
+/**
+ * This kernel function expands a level of a breadth-first search: every
+ * vertex of the frontier, whose level is level, visits its unvisited
+ * neighbors, which take level + 1. A neighbor is claimed with
+ * atomic_cmpxchg, so a single work-item visits it, and *changed is set
+ * when any vertex was visited.
+ */
+
+__kernel void bfsLevel( const __global Graph* graph,
+                        __global uint* levels,
+                        const uint level,
+                        __global int* changed ) {
+   uint vertex = (uint)get_global_id( 0 );
+   if( vertex >= graph->vertices || levels[vertex] != level ) {
+      return;
+   }
+
+   uint end = graph->offsets[vertex + 1];
+   for( uint e = graph->offsets[vertex]; e < end; e++ ) {
+      uint neighbor = graph->edges[e];
+      if( atomic_cmpxchg( &levels[neighbor], UNVISITED, level + 1 )
+          == UNVISITED ) {
+         atomic_xchg( changed, 1 );
+      }
+   }
+}
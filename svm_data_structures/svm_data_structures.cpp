@@ -0,0 +1,617 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ---------------------------- Types -----------------------------
+// =================================================================
+
+// Open-addressing hash table with linear probing, with the layout of its
+// counterpart in svm_data_structures.cl: capacity is a power of two and
+// empty slots hold EMPTY_KEY.
+struct HashTable {
+   cl_uint capacity;
+   cl_uint* keys;
+   cl_uint* values;
+};
+
+// Graph in compressed sparse row format, with the layout of its
+// counterpart in svm_data_structures.cl.
+struct Graph {
+   cl_uint vertices;
+   cl_uint* offsets;
+   cl_uint* edges;
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Inicialize device and compile kernel code.
+void initializeDevice();
+// Allocate count elements of T in coarse-grained SVM.
+template< typename T >
+T* allocateSvm( const size_t count );
+// Map the SVM region [ptr, ptr + bytes) for the host with flags.
+void mapSvm( void* ptr, const size_t bytes, const cl_map_flags flags );
+// Unmap the SVM region at ptr.
+void unmapSvm( void* ptr );
+// Return the first slot of key, as hashKey does.
+cl_uint hashKey( cl_uint key );
+// Sequentially insert the pairs keys[i], values[i] into table.
+void seqInsertKeys( HashTable& table,
+                    const cl_uint* keys,
+                    const cl_uint* values,
+                    const size_t n );
+// Sequentially look up keys in table.
+void seqLookupKeys( const HashTable& table,
+                    const cl_uint* keys,
+                    cl_uint* results,
+                    const size_t n );
+// Sequentially compute the breadth-first search levels of graph.
+void seqBfs( const Graph& graph, const cl_uint source, cl_uint* levels );
+// Parallelly compute the breadth-first search levels of the SVM graph,
+// whose arrays are offsets and edges, one launch per level, and return the
+// number of levels.
+cl_uint parBfs( Graph* graph,
+                cl_uint* offsets,
+                cl_uint* edges,
+                const cl_uint source,
+                cl_uint* levels );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;      // The program that will run on the device.
+cl::Context context;      // The context which holds the device.
+cl::Device device;        // The device where the kernel will run.
+cl::CommandQueue queue;   // The queue of every command.
+
+constexpr cl_uint EMPTY_KEY = 0xffffffffu;
+constexpr cl_uint NOT_FOUND = 0xffffffffu;
+constexpr cl_uint UNVISITED = 0xffffffffu;
+
+// Slots of the hash tables and keys inserted: half of the table is used.
+// Half of the keys looked up are present.
+constexpr cl_uint TABLE_CAPACITY = 1 << 22;
+constexpr size_t KEYS = 1 << 21;
+// Vertices of the graph and neighbors of every vertex.
+constexpr cl_uint VERTICES = 1 << 20;
+constexpr cl_uint DEGREE = 8;
+// Runs measured of every operation.
+constexpr int EXECUTIONS = 5;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Initialize OpenCL device. The structures hold host pointers which
+    * the kernels follow, so the device must have the address size of the
+    * host.
+    * */
+
+   initializeDevice();
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << std::endl;
+
+   /**
+    * Create the keys, spread over the 32 bits and never EMPTY_KEY, and
+    * allocate the hash table and the arrays of the kernels in SVM. The
+    * keys looked up are the second half of the inserted keys and as many
+    * absent keys.
+    * */
+
+   HashTable* table = allocateSvm< HashTable >( 1 );
+   cl_uint* table_keys = allocateSvm< cl_uint >( TABLE_CAPACITY );
+   cl_uint* table_values = allocateSvm< cl_uint >( TABLE_CAPACITY );
+   cl_uint* keys = allocateSvm< cl_uint >( KEYS );
+   cl_uint* values = allocateSvm< cl_uint >( KEYS );
+   cl_uint* lookups = allocateSvm< cl_uint >( KEYS );
+   cl_uint* results = allocateSvm< cl_uint >( KEYS );
+
+   mapSvm( table, sizeof( HashTable ), CL_MAP_WRITE_INVALIDATE_REGION );
+   mapSvm( keys, KEYS * sizeof( cl_uint ), CL_MAP_WRITE_INVALIDATE_REGION );
+   mapSvm( values, KEYS * sizeof( cl_uint ), CL_MAP_WRITE_INVALIDATE_REGION );
+   mapSvm(
+      lookups, KEYS * sizeof( cl_uint ), CL_MAP_WRITE_INVALIDATE_REGION );
+   *table = { TABLE_CAPACITY, table_keys, table_values };
+   for( size_t i = 0; i < KEYS; i++ ) {
+      keys[i] = static_cast< cl_uint >( i ) * 2654435761u + 1u;
+      values[i] = static_cast< cl_uint >( i );
+      lookups[i] = static_cast< cl_uint >( i + KEYS / 2 ) * 2654435761u + 1u;
+   }
+
+   /**
+    * Insert and look up the keys sequentially, in a table of the host
+    * memory, reading the arrays while they are mapped.
+    * */
+
+   std::vector< cl_uint > host_keys( TABLE_CAPACITY );
+   std::vector< cl_uint > host_values( TABLE_CAPACITY );
+   HashTable host_table = { TABLE_CAPACITY,
+                            host_keys.data(),
+                            host_values.data() };
+   std::vector< cl_uint > expected( KEYS );
+   double seq_insert_time = 0.0, seq_lookup_time = 0.0;
+   for( int i = 0; i < EXECUTIONS; i++ ) {
+      std::fill( host_keys.begin(), host_keys.end(), EMPTY_KEY );
+      auto start = std::chrono::steady_clock::now();
+      seqInsertKeys( host_table, keys, values, KEYS );
+      seq_insert_time += getElapsedTime( start ) / EXECUTIONS;
+
+      start = std::chrono::steady_clock::now();
+      seqLookupKeys( host_table, lookups, expected.data(), KEYS );
+      seq_lookup_time += getElapsedTime( start ) / EXECUTIONS;
+   }
+   unmapSvm( table );
+   unmapSvm( keys );
+   unmapSvm( values );
+   unmapSvm( lookups );
+
+   /**
+    * Insert and look up the keys on the device. The kernels reach the
+    * slots of the table through its pointers, so those allocations are
+    * passed as indirect SVM pointers. The table is emptied before every
+    * insertion, out of the measured time; the first run warms up.
+    * */
+
+   cl::Kernel insert_kernel( program, "insertKeys" );
+   insert_kernel.setArg( 0, table );
+   insert_kernel.setArg( 1, keys );
+   insert_kernel.setArg( 2, values );
+   cl::Kernel lookup_kernel( program, "lookupKeys" );
+   lookup_kernel.setArg( 0, table );
+   lookup_kernel.setArg( 1, lookups );
+   lookup_kernel.setArg( 2, results );
+   void* table_arrays[] = { table_keys, table_values };
+   for( cl::Kernel* kernel : { &insert_kernel, &lookup_kernel } ) {
+      clSetKernelExecInfo( ( *kernel )(),
+                           CL_KERNEL_EXEC_INFO_SVM_PTRS,
+                           sizeof( table_arrays ),
+                           table_arrays );
+   }
+
+   double par_insert_time = 0.0, par_lookup_time = 0.0;
+   for( int i = 0; i <= EXECUTIONS; i++ ) {
+      mapSvm( table_keys,
+              TABLE_CAPACITY * sizeof( cl_uint ),
+              CL_MAP_WRITE_INVALIDATE_REGION );
+      std::fill( table_keys, table_keys + TABLE_CAPACITY, EMPTY_KEY );
+      unmapSvm( table_keys );
+      queue.finish();
+
+      auto start = std::chrono::steady_clock::now();
+      queue.enqueueNDRangeKernel(
+         insert_kernel, cl::NullRange, cl::NDRange( KEYS ) );
+      queue.finish();
+      double insert_time = getElapsedTime( start );
+
+      start = std::chrono::steady_clock::now();
+      queue.enqueueNDRangeKernel(
+         lookup_kernel, cl::NullRange, cl::NDRange( KEYS ) );
+      queue.finish();
+      double lookup_time = getElapsedTime( start );
+
+      if( i > 0 ) {
+         par_insert_time += insert_time / EXECUTIONS;
+         par_lookup_time += lookup_time / EXECUTIONS;
+      }
+   }
+
+   mapSvm( results, KEYS * sizeof( cl_uint ), CL_MAP_READ );
+   bool table_equal = std::equal( expected.begin(), expected.end(), results );
+   unmapSvm( results );
+
+   /**
+    * Build a random graph in the host memory: DEGREE neighbors per vertex,
+    * from a linear congruential generator, plus the next vertex, so every
+    * vertex is reachable from vertex 0.
+    * */
+
+   std::vector< cl_uint > offsets( VERTICES + 1 );
+   std::vector< cl_uint > edges;
+   edges.reserve( static_cast< size_t >( VERTICES ) * ( DEGREE + 1 ) );
+   cl_uint seed = 12345;
+   for( cl_uint v = 0; v < VERTICES; v++ ) {
+      offsets[v] = static_cast< cl_uint >( edges.size() );
+      for( cl_uint d = 0; d < DEGREE; d++ ) {
+         seed = seed * 1664525u + 1013904223u;
+         edges.push_back( seed % VERTICES );
+      }
+      if( v + 1 < VERTICES ) {
+         edges.push_back( v + 1 );
+      }
+   }
+   offsets[VERTICES] = static_cast< cl_uint >( edges.size() );
+   Graph host_graph = { VERTICES, offsets.data(), edges.data() };
+
+   /**
+    * Copy the graph to SVM, where the kernel follows its pointers.
+    * */
+
+   Graph* graph = allocateSvm< Graph >( 1 );
+   cl_uint* svm_offsets = allocateSvm< cl_uint >( offsets.size() );
+   cl_uint* svm_edges = allocateSvm< cl_uint >( edges.size() );
+   cl_uint* levels = allocateSvm< cl_uint >( VERTICES );
+   mapSvm( graph, sizeof( Graph ), CL_MAP_WRITE_INVALIDATE_REGION );
+   mapSvm( svm_offsets,
+           offsets.size() * sizeof( cl_uint ),
+           CL_MAP_WRITE_INVALIDATE_REGION );
+   mapSvm( svm_edges,
+           edges.size() * sizeof( cl_uint ),
+           CL_MAP_WRITE_INVALIDATE_REGION );
+   *graph = { VERTICES, svm_offsets, svm_edges };
+   std::copy( offsets.begin(), offsets.end(), svm_offsets );
+   std::copy( edges.begin(), edges.end(), svm_edges );
+   unmapSvm( graph );
+   unmapSvm( svm_offsets );
+   unmapSvm( svm_edges );
+
+   /**
+    * Run the breadth-first search from vertex 0, sequentially and on the
+    * device; the first parallel run warms up.
+    * */
+
+   std::vector< cl_uint > expected_levels( VERTICES );
+   double seq_bfs_time = 0.0, par_bfs_time = 0.0;
+   for( int i = 0; i < EXECUTIONS; i++ ) {
+      auto start = std::chrono::steady_clock::now();
+      seqBfs( host_graph, 0, expected_levels.data() );
+      seq_bfs_time += getElapsedTime( start ) / EXECUTIONS;
+   }
+   cl_uint bfs_levels = 0;
+   for( int i = 0; i <= EXECUTIONS; i++ ) {
+      auto start = std::chrono::steady_clock::now();
+      bfs_levels = parBfs( graph, svm_offsets, svm_edges, 0, levels );
+      if( i > 0 ) {
+         par_bfs_time += getElapsedTime( start ) / EXECUTIONS;
+      }
+   }
+
+   mapSvm( levels, VERTICES * sizeof( cl_uint ), CL_MAP_READ );
+   bool bfs_equal = std::equal(
+      expected_levels.begin(), expected_levels.end(), levels );
+   unmapSvm( levels );
+   queue.finish();
+
+   /**
+    * Print results: millions of keys per second for the hash table and
+    * millions of traversed edges per second for the search.
+    * */
+
+   std::cout << std::fixed << std::setprecision( 2 ) << std::setw( 12 )
+             << "Operation" << std::setw( 14 ) << "Host (ms)" << std::setw( 14 )
+             << "Device (ms)" << std::setw( 14 ) << "Host (M/s)"
+             << std::setw( 14 ) << "Device (M/s)" << std::endl;
+   const char* names[] = { "insert", "lookup", "bfs" };
+   double seq_times[] = { seq_insert_time, seq_lookup_time, seq_bfs_time };
+   double par_times[] = { par_insert_time, par_lookup_time, par_bfs_time };
+   double counts[] = { KEYS, KEYS, static_cast< double >( edges.size() ) };
+   for( int op = 0; op < 3; op++ ) {
+      std::cout << std::setw( 12 ) << names[op] << std::setw( 14 )
+                << seq_times[op] << std::setw( 14 ) << par_times[op]
+                << std::setw( 14 ) << counts[op] / seq_times[op] / 1e3
+                << std::setw( 14 ) << counts[op] / par_times[op] / 1e3
+                << std::endl;
+   }
+   std::cout << "BFS levels: " << bfs_levels << std::endl;
+
+   bool equal = table_equal && bfs_equal;
+   double seq_time = seq_insert_time + seq_lookup_time + seq_bfs_time;
+   double par_time = par_insert_time + par_lookup_time + par_bfs_time;
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << seq_time
+             << " ms;\n\tParallel: " << par_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( seq_time - par_time ) / par_time ) << "%\n";
+
+   for( void* ptr : std::vector< void* >{ table,
+                                          table_keys,
+                                          table_values,
+                                          keys,
+                                          values,
+                                          lookups,
+                                          results,
+                                          graph,
+                                          svm_offsets,
+                                          svm_edges,
+                                          levels } ) {
+      clSVMFree( context(), ptr );
+   }
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Inicialize device and compile kernel code. The structures hold pointers,
+ * so the device must support SVM with the address size of the host.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device and check its SVM support.
+    * */
+
+   device = getDefaultDevice();
+   if( !( device.getInfo< CL_DEVICE_SVM_CAPABILITIES >()
+          & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER ) ) {
+      std::cerr << "The device does not support SVM!" << std::endl;
+      exit( 1 );
+   }
+   if( device.getInfo< CL_DEVICE_ADDRESS_BITS >() != 8 * sizeof( void* ) ) {
+      std::cerr << "The device pointers differ from the host ones!"
+                << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "svm_data_structures.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+   queue = cl::CommandQueue( context, device );
+
+   auto err = program.build( "-cl-std=CL2.0" );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Allocate count elements of T in coarse-grained SVM; exit when it fails.
+ * */
+
+template< typename T >
+T* allocateSvm( const size_t count ) {
+   T* ptr = static_cast< T* >(
+      clSVMAlloc( context(), CL_MEM_READ_WRITE, count * sizeof( T ), 0 ) );
+   if( !ptr ) {
+      std::cerr << "Failed to allocate SVM!" << std::endl;
+      exit( 1 );
+   }
+   return ptr;
+}
+
+/**
+ * Map the SVM region [ptr, ptr + bytes) for the host with flags, blocking
+ * until it is mapped.
+ * */
+
+void mapSvm( void* ptr, const size_t bytes, const cl_map_flags flags ) {
+   cl_int err = clEnqueueSVMMap(
+      queue(), CL_TRUE, flags, ptr, bytes, 0, nullptr, nullptr );
+   if( err != CL_SUCCESS ) {
+      std::cerr << "Failed to map SVM! Error Code: " << err << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Unmap the SVM region at ptr, so the kernels enqueued after it can use it.
+ * */
+
+void unmapSvm( void* ptr ) {
+   clEnqueueSVMUnmap( queue(), ptr, 0, nullptr, nullptr );
+}
+
+/**
+ * Return the first slot of key, as hashKey does.
+ * */
+
+cl_uint hashKey( cl_uint key ) {
+   key ^= key >> 16;
+   key *= 0x85ebca6bu;
+   key ^= key >> 13;
+   key *= 0xc2b2ae35u;
+   key ^= key >> 16;
+   return key;
+}
+
+/**
+ * Sequentially insert the pairs keys[i], values[i] into table, probing as
+ * insertKeys does.
+ * */
+
+void seqInsertKeys( HashTable& table,
+                    const cl_uint* keys,
+                    const cl_uint* values,
+                    const size_t n ) {
+   const cl_uint mask = table.capacity - 1;
+   for( size_t i = 0; i < n; i++ ) {
+      cl_uint slot = hashKey( keys[i] ) & mask;
+      while( table.keys[slot] != EMPTY_KEY && table.keys[slot] != keys[i] ) {
+         slot = ( slot + 1 ) & mask;
+      }
+      table.keys[slot] = keys[i];
+      table.values[slot] = values[i];
+   }
+}
+
+/**
+ * Sequentially look up keys in table and store their values in results,
+ * or NOT_FOUND when they are absent.
+ * */
+
+void seqLookupKeys( const HashTable& table,
+                    const cl_uint* keys,
+                    cl_uint* results,
+                    const size_t n ) {
+   const cl_uint mask = table.capacity - 1;
+   for( size_t i = 0; i < n; i++ ) {
+      cl_uint slot = hashKey( keys[i] ) & mask;
+      while( table.keys[slot] != EMPTY_KEY && table.keys[slot] != keys[i] ) {
+         slot = ( slot + 1 ) & mask;
+      }
+      results[i] = table.keys[slot] == keys[i] ? table.values[slot]
+                                               : NOT_FOUND;
+   }
+}
+
+/**
+ * Sequentially compute the breadth-first search levels of graph from
+ * source with a queue; unreachable vertices keep UNVISITED.
+ * */
+
+void seqBfs( const Graph& graph, const cl_uint source, cl_uint* levels ) {
+   std::fill( levels, levels + graph.vertices, UNVISITED );
+   std::queue< cl_uint > frontier;
+   levels[source] = 0;
+   frontier.push( source );
+   while( !frontier.empty() ) {
+      cl_uint vertex = frontier.front();
+      frontier.pop();
+      for( cl_uint e = graph.offsets[vertex]; e < graph.offsets[vertex + 1];
+           e++ ) {
+         cl_uint neighbor = graph.edges[e];
+         if( levels[neighbor] == UNVISITED ) {
+            levels[neighbor] = levels[vertex] + 1;
+            frontier.push( neighbor );
+         }
+      }
+   }
+}
+
+/**
+ * Parallelly compute the breadth-first search levels of the SVM graph from
+ * source: bfsLevel expands a level per launch, and the changed flag, read
+ * between a map and an unmap, tells when no vertex was visited. offsets
+ * and edges are the arrays graph points to, which the host cannot read
+ * through graph while it is unmapped. Return the number of levels.
+ * */
+
+cl_uint parBfs( Graph* graph,
+                cl_uint* offsets,
+                cl_uint* edges,
+                const cl_uint source,
+                cl_uint* levels ) {
+
+   /**
+    * Reset the levels.
+    * */
+
+   mapSvm( levels,
+           VERTICES * sizeof( cl_uint ),
+           CL_MAP_WRITE_INVALIDATE_REGION );
+   std::fill( levels, levels + VERTICES, UNVISITED );
+   levels[source] = 0;
+   unmapSvm( levels );
+
+   /**
+    * Expand a level per launch.
+    * */
+
+   cl_int* changed = allocateSvm< cl_int >( 1 );
+   cl::Kernel kernel( program, "bfsLevel" );
+   kernel.setArg( 0, graph );
+   kernel.setArg( 1, levels );
+   kernel.setArg( 3, changed );
+   void* graph_arrays[] = { offsets, edges };
+   clSetKernelExecInfo( kernel(),
+                        CL_KERNEL_EXEC_INFO_SVM_PTRS,
+                        sizeof( graph_arrays ),
+                        graph_arrays );
+
+   cl_uint level = 0;
+   for( ;; level++ ) {
+      mapSvm( changed, sizeof( cl_int ), CL_MAP_WRITE_INVALIDATE_REGION );
+      *changed = 0;
+      unmapSvm( changed );
+
+      kernel.setArg( 2, level );
+      queue.enqueueNDRangeKernel(
+         kernel, cl::NullRange, cl::NDRange( VERTICES ) );
+
+      mapSvm( changed, sizeof( cl_int ), CL_MAP_READ );
+      bool done = *changed == 0;
+      unmapSvm( changed );
+      if( done ) {
+         break;
+      }
+   }
+   queue.finish();
+   clSVMFree( context(), changed );
+   return level + 1;
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
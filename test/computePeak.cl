@@ -0,0 +1,86 @@
+/**
+ * Measure the arithmetic peak of the device. The loop of the testQueue
+ * kernels is a single dependent chain, so every operation waits for the
+ * previous one and the kernels measure latency. Here every work-item runs
+ * CHAINS independent chains of multiply-adds, which the device can
+ * pipeline. The host code defines:
+ *    - TYPE, the type of the chains (e.g. float, half4, int16);
+ *    - SCALAR, the type of the kernel arguments a and b: the element type
+ *      of TYPE, or float for half, which is not a valid argument type;
+ *    - INTEGER, when TYPE is an integer type;
+ *    - USE_HALF or USE_DOUBLE, to enable their extension.
+ * Every step computes x = x * a + b. The host passes a = -1 and b = 1, so
+ * every chain alternates between two small integers, exact in every type,
+ * and never overflows; the compiler cannot fold the loop since a and b are
+ * only known at run time.
+ */
+
+#include "utility.cl"
+
+#ifdef USE_HALF
+   #pragma OPENCL EXTENSION cl_khr_fp16 : enable
+#endif
+#ifdef USE_DOUBLE
+   #pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef TYPE
+   #define TYPE float
+#endif
+#ifndef SCALAR
+   #define SCALAR float
+#endif
+
+#ifdef INTEGER
+   #define MAD( x ) x = x * a + b
+#else
+   #define MAD( x ) x = mad( x, a, b )
+#endif
+
+// One step of the CHAINS independent chains, run UNROLL times per
+// iteration.
+#define CHAINS 8
+#define UNROLL 4
+#define STEP   \
+   MAD( x0 );  \
+   MAD( x1 );  \
+   MAD( x2 );  \
+   MAD( x3 );  \
+   MAD( x4 );  \
+   MAD( x5 );  \
+   MAD( x6 );  \
+   MAD( x7 );
+
+/**
+ * This kernel function runs iterations times UNROLL steps of CHAINS
+ * multiply-adds on every element of TYPE, that is 2 * UNROLL * CHAINS
+ * operations per element and iteration, and stores the sum of its chains
+ * in output. The chains start at the low bits of the global id.
+ */
+
+__kernel void computePeak( __global TYPE* output,
+                           const SCALAR scalar_a,
+                           const SCALAR scalar_b,
+                           const int iterations ) {
+   unsigned int gid = compute_flattened_global_id();
+   const TYPE a = (TYPE)( scalar_a );
+   const TYPE b = (TYPE)( scalar_b );
+   const TYPE start = (TYPE)( gid & 0x3f );
+   TYPE x0 = start;
+   TYPE x1 = start + (TYPE)( 1 );
+   TYPE x2 = start + (TYPE)( 2 );
+   TYPE x3 = start + (TYPE)( 3 );
+   TYPE x4 = start + (TYPE)( 4 );
+   TYPE x5 = start + (TYPE)( 5 );
+   TYPE x6 = start + (TYPE)( 6 );
+   TYPE x7 = start + (TYPE)( 7 );
+
+   for( int i = 0; i < iterations; i++ ) {
+      STEP
+      STEP
+      STEP
+      STEP
+   }
+
+   output[gid] = x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7;
+}
@@ -0,0 +1,372 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Return whether the device supports the arithmetic of type.
+bool isSupported( const std::string& type );
+// Measure the peak of type with vectors of width elements and return it in
+// GFLOP/s or GIOP/s, or a negative value when the results are wrong.
+double measurePeak( const std::string& type, const int width );
+// Return the expected sum of the chains of work-item gid.
+double getExpected( const size_t gid, const int steps );
+// Return element i of data, which holds values of type, as a double.
+double getElement( const std::vector< unsigned char >& data,
+                   const std::string& type,
+                   const size_t i );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Context context;      // The context which holds the device.
+cl::Device device;        // The device where the kernel will run.
+cl::CommandQueue queue;   // The profiling queue of every launch.
+std::string source;       // The source of computePeak.cl.
+size_t global_size;       // The work-items of every launch.
+size_t local_size = 0;    // The work-group size, or 0 to let OpenCL choose.
+int base_iterations;      // The iterations of scalar chains.
+
+// The measured types and vector widths.
+const std::vector< std::string > TYPES = { "float", "half", "double", "int" };
+const std::vector< int > WIDTHS = { 1, 2, 4, 8, 16 };
+// Default work-items per compute unit, enough to hide the latency of the
+// chains on GPUs.
+constexpr size_t ITEMS_PER_COMPUTE_UNIT = 2048;
+// Default iterations of scalar chains; vectors of width elements run
+// 1 / width of them, so every launch does about the same work.
+constexpr int ITERATIONS = 2048;
+// Timed launches of every type and width; the fastest one is kept.
+constexpr int REPETITIONS = 5;
+// These must match computePeak.cl: independent chains per work-item and
+// steps per iteration; every step is a multiply and an add.
+constexpr int CHAINS = 8;
+constexpr int UNROLL = 4;
+constexpr int OPS_PER_STEP = 2;
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main( int argc, char** argv ) {
+
+   /**
+    * Create auxiliary variables.
+    * */
+
+   device = getDefaultDevice();
+   context = cl::Context( device );
+   queue = cl::CommandQueue( context, device, CL_QUEUE_PROFILING_ENABLE );
+   global_size = ITEMS_PER_COMPUTE_UNIT
+               * device.getInfo< CL_DEVICE_MAX_COMPUTE_UNITS >();
+   base_iterations = ITERATIONS;
+
+   /**
+    * Parse the work size. Every value must be positive.
+    * */
+
+   bool valid = true;
+   for( int i = 1; i < argc && valid; i++ ) {
+      long value = 0;
+      try {
+         if( strcmp( argv[i], "--global" ) == 0 && i + 1 < argc ) {
+            value = std::stol( argv[++i] );
+            global_size = static_cast< size_t >( value );
+         } else if( strcmp( argv[i], "--local" ) == 0 && i + 1 < argc ) {
+            value = std::stol( argv[++i] );
+            local_size = static_cast< size_t >( value );
+         } else if( strcmp( argv[i], "--iterations" ) == 0 && i + 1 < argc ) {
+            value = std::stoi( argv[++i] );
+            base_iterations = static_cast< int >( value );
+         }
+      } catch( const std::logic_error& ) {
+      }
+      valid = value > 0;
+   }
+   if( !valid ) {
+      std::cerr << "Usage: " << argv[0]
+                << " [--global items] [--local items] [--iterations n],"
+                << " all > 0" << std::endl;
+      return 1;
+   }
+   if( local_size > 0 ) {
+      global_size = ( global_size + local_size - 1 ) / local_size * local_size;
+   }
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "computePeak.cl" );
+   source = std::string( std::istreambuf_iterator< char >( kernel_file ),
+                         ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Measure every type and width.
+    * */
+
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >()
+             << "\nWork size: " << global_size << " work-items, "
+             << ( local_size > 0 ? std::to_string( local_size ) : "default" )
+             << " per work-group, " << base_iterations << " iterations\n"
+             << std::setw( 16 ) << "Width";
+   for( int width : WIDTHS ) {
+      std::cout << std::setw( 10 ) << width;
+   }
+   std::cout << std::setw( 10 ) << "Peak" << std::endl;
+
+   bool equal = true;
+   std::cout << std::fixed << std::setprecision( 1 );
+   for( const std::string& type : TYPES ) {
+      std::string unit = type == "int" ? " (GIOP/s)" : " (GFLOP/s)";
+      std::cout << std::setw( 16 ) << type + unit;
+      if( !isSupported( type ) ) {
+         std::cout << std::setw( 10 ) << "-" << std::endl;
+         continue;
+      }
+
+      double peak = 0.0;
+      for( int width : WIDTHS ) {
+         double rate = measurePeak( type, width );
+         equal = equal && rate >= 0.0;
+         peak = std::max( peak, rate );
+         std::cout << std::setw( 10 ) << rate << std::flush;
+      }
+      std::cout << std::setw( 10 ) << peak << std::endl;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
+
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Return whether the device supports the arithmetic of type: half and
+ * double need their extension.
+ * */
+
+bool isSupported( const std::string& type ) {
+   std::string extensions = device.getInfo< CL_DEVICE_EXTENSIONS >();
+   if( type == "half" ) {
+      return extensions.find( "cl_khr_fp16" ) != std::string::npos;
+   } else if( type == "double" ) {
+      return extensions.find( "cl_khr_fp64" ) != std::string::npos;
+   }
+   return true;
+}
+
+/**
+ * Measure the peak of type with vectors of width elements: compile
+ * computePeak for them, launch it REPETITIONS times after a warm-up and
+ * divide the operations by the fastest kernel time, taken from the
+ * profiling events so that launch overhead is left out. Return it in
+ * GFLOP/s or GIOP/s, or a negative value when the results are wrong.
+ * */
+
+double measurePeak( const std::string& type, const int width ) {
+
+   /**
+    * Compile the kernel for type and width.
+    * */
+
+   std::string vector_type
+      = width == 1 ? type : type + std::to_string( width );
+   std::string options = "-I. -DTYPE=" + vector_type;
+   if( type == "int" ) {
+      options += " -DSCALAR=int -DINTEGER";
+   } else if( type == "double" ) {
+      options += " -DSCALAR=double -DUSE_DOUBLE";
+   } else if( type == "half" ) {
+      options += " -DSCALAR=float -DUSE_HALF";
+   }
+
+   cl::Program::Sources sources{ source };
+   cl::Program program( context, sources );
+   auto err = program.build( device, options.c_str() );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Options: " << options << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Set the arguments: a = -1 and b = 1.
+    * */
+
+   size_t element_size = type == "double" ? sizeof( cl_double )
+                       : type == "half"   ? sizeof( cl_half )
+                                          : sizeof( cl_int );
+   size_t output_size = global_size * width * element_size;
+   int iterations = std::max( base_iterations / width, 1 );
+   cl::Buffer output_buf( context, CL_MEM_WRITE_ONLY, output_size );
+
+   cl::Kernel kernel( program, "computePeak" );
+   kernel.setArg( 0, output_buf );
+   if( type == "int" ) {
+      kernel.setArg( 1, cl_int( -1 ) );
+      kernel.setArg( 2, cl_int( 1 ) );
+   } else if( type == "double" ) {
+      kernel.setArg( 1, cl_double( -1.0 ) );
+      kernel.setArg( 2, cl_double( 1.0 ) );
+   } else {
+      kernel.setArg( 1, cl_float( -1.0f ) );
+      kernel.setArg( 2, cl_float( 1.0f ) );
+   }
+   kernel.setArg( 3, iterations );
+
+   /**
+    * Launch it and keep the fastest run.
+    * */
+
+   cl::NDRange local = local_size > 0 ? cl::NDRange( local_size )
+                                      : cl::NullRange;
+   double best_time = 0.0;
+   for( int i = 0; i <= REPETITIONS; i++ ) {
+      cl::Event event;
+      queue.enqueueNDRangeKernel( kernel,
+                                  cl::NullRange,
+                                  cl::NDRange( global_size ),
+                                  local,
+                                  nullptr,
+                                  &event );
+      event.wait();
+      cl_ulong start = event.getProfilingInfo< CL_PROFILING_COMMAND_START >();
+      cl_ulong end = event.getProfilingInfo< CL_PROFILING_COMMAND_END >();
+      double time = 1e-9 * ( end - start );
+      // The first run is a warm-up.
+      if( i == 1 || ( i > 1 && time < best_time ) ) {
+         best_time = time;
+      }
+   }
+
+   /**
+    * Check the sums of the chains of every work-item; every element of a
+    * vector holds the same value.
+    * */
+
+   std::vector< unsigned char > output( output_size );
+   queue.enqueueReadBuffer(
+      output_buf, CL_TRUE, 0, output_size, output.data() );
+   for( size_t gid = 0; gid < global_size; gid++ ) {
+      double expected = getExpected( gid, iterations * UNROLL );
+      for( int lane = 0; lane < width; lane++ ) {
+         if( getElement( output, type, gid * width + lane ) != expected ) {
+            return -1.0;
+         }
+      }
+   }
+
+   double operations = static_cast< double >( global_size ) * width
+                      * iterations * UNROLL * CHAINS * OPS_PER_STEP;
+   return operations / best_time / 1e9;
+}
+
+/**
+ * Return the expected sum of the chains of work-item gid after steps
+ * steps of x = -x + 1: chain c starts at (gid & 0x3f) + c and alternates
+ * between its start and 1 minus it.
+ * */
+
+double getExpected( const size_t gid, const int steps ) {
+   double sum = 0.0;
+   for( int c = 0; c < CHAINS; c++ ) {
+      double start = static_cast< double >( ( gid & 0x3f ) + c );
+      sum += steps % 2 == 0 ? start : 1.0 - start;
+   }
+   return sum;
+}
+
+/**
+ * Return element i of data, which holds values of type, as a double; half
+ * values are decoded from their bits, since C++ has no half type.
+ * */
+
+double getElement( const std::vector< unsigned char >& data,
+                   const std::string& type,
+                   const size_t i ) {
+   if( type == "float" ) {
+      cl_float value;
+      std::memcpy( &value, &data[i * sizeof( value )], sizeof( value ) );
+      return value;
+   } else if( type == "double" ) {
+      cl_double value;
+      std::memcpy( &value, &data[i * sizeof( value )], sizeof( value ) );
+      return value;
+   } else if( type == "int" ) {
+      cl_int value;
+      std::memcpy( &value, &data[i * sizeof( value )], sizeof( value ) );
+      return value;
+   }
+
+   cl_half bits;
+   std::memcpy( &bits, &data[i * sizeof( bits )], sizeof( bits ) );
+   int exponent = ( bits >> 10 ) & 0x1f;
+   int mantissa = bits & 0x3ff;
+   double value = exponent == 0
+                     ? std::ldexp( mantissa, -24 )
+                     : std::ldexp( mantissa + 1024, exponent - 25 );
+   return ( bits & 0x8000 ) ? -value : value;
+}
@@ -6,61 +6,38 @@
  ************************************************************************/
 
 #include "utility.cl"
-static const int limit = 100000000;
 
-__kernel void testQueue1( __global float* output ) {
-   unsigned int gid = compute_flattened_global_id();
-   static int Test_Queue1 = 0;
+/**
+ * Run a dependent loop of limit iterations, long enough for the launches
+ * of several queues to overlap on the device, and return its result. The
+ * testQueue kernels are identical, so the timeline shows which queue each
+ * launch came from.
+ */
+
+float spin( const int limit ) {
    __private float counter = 1;
    for( int i = 0; i < limit; i++ ) {
       counter += i * counter;
    }
-   output[gid] = counter;
-   if( gid == 1 ) {
-      ++Test_Queue1;
-      printf( "testQueue1, %d\n", Test_Queue1 );
-   }
+   return counter;
 }
 
-__kernel void testQueue2( __global float* output ) {
+__kernel void testQueue1( __global float* output, const int limit ) {
    unsigned int gid = compute_flattened_global_id();
-   static int Test_Queue2 = 0;
-   __private float counter = 1;
-   for( int i = 0; i < limit; i++ ) {
-      counter += i * counter;
-   }
-   output[gid] = counter;
-   if( gid == 1 ) {
-      ++Test_Queue2;
-      printf( "testQueue2, %d\n", Test_Queue2 );
-   }
+   output[gid] = spin( limit );
 }
 
-__kernel void testQueue3( __global float* output ) {
+__kernel void testQueue2( __global float* output, const int limit ) {
    unsigned int gid = compute_flattened_global_id();
-   static int Test_Queue3 = 0;
-   __private float counter = 1;
-   for( int i = 0; i < limit; i++ ) {
-      counter += i * counter;
-   }
-   output[gid] = counter;
-   if( gid == 1 ) {
-      ++Test_Queue3;
-      printf( "testQueue3, %d\n", Test_Queue3 );
-   }
+   output[gid] = spin( limit );
 }
 
-__kernel void testQueue4( __global float* output ) {
+__kernel void testQueue3( __global float* output, const int limit ) {
    unsigned int gid = compute_flattened_global_id();
-   static int Test_Queue4 = 0;
-   __private float counter = 1;
-   for( int i = 0; i < limit; i++ ) {
-      counter += i * counter;
-   }
-   output[gid] = counter;
-   if( gid == 1 ) {
-      ++Test_Queue4;
-      printf( "testQueue4, %d\n", Test_Queue4 );
-   }
+   output[gid] = spin( limit );
 }
 
+__kernel void testQueue4( __global float* output, const int limit ) {
+   unsigned int gid = compute_flattened_global_id();
+   output[gid] = spin( limit );
+}
@@ -5,387 +5,503 @@
   > Created Time: Mon 08 Aug 2022 09:16:47 PM CST
  ************************************************************************/
 
-#include <cstdint>
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <sstream>
-#include <stddef.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
-#define CL_HPP_TARGET_OPENCL_VERSION 300
-#include <CL/opencl.hpp>
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
 
-#define DATA_SIZE 512
-
-int main() {
-   /* 1. get platform & device information */
-   // (1) Check how many OpenCL platforms current system has.
-   cl_uint num_platforms;
-   cl_int err = CL_SUCCESS;
-   err = clGetPlatformIDs( 0, nullptr, &num_platforms );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Your system has 0 OpenCL platform." << std::endl;
-      return err;
-   }
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernels will run.
 
-   // (2) According to the number of OpenCL platforms current system has to
-   // mallocate memory so that we can store the information of all available
-   // OpenCL platforms.
-   std::vector< cl_platform_id > platform_ids( num_platforms );
-   err = clGetPlatformIDs( num_platforms, &platform_ids[0], nullptr );
-   if( CL_SUCCESS != err ) {
-      std::cout << "Your system has no OpenCL platforms for you to use."
-                << std::endl;
-      return err;
-   }
+// Work-items of every launch: a couple of work-groups, which leave most of
+// the device idle, so launches from different queues can run side by side.
+// The work-groups are smaller when the kernels do not support this size.
+constexpr size_t DATA_SIZE = 512;
+constexpr size_t MAX_LOCAL_SIZE = 256;
+// Default loop iterations of every launch and maximum number of queues;
+// every configuration runs MAX_QUEUES launches.
+constexpr int ITERATIONS = 10000000;
+constexpr int MAX_QUEUES = 4;
+// The kernels of the launches, used in turn.
+const char* KERNELS[]
+   = { "testQueue1", "testQueue2", "testQueue3", "testQueue4" };
 
-   // (3) Obtain the length of all platforms name and version and store them.
-   size_t string_length;
-   std::vector< std::string > platform_names( num_platforms );
-   std::vector< std::string > platform_versions( num_platforms );
-   for( uint32_t i = 0; i < num_platforms; i++ ) {
-      clGetPlatformInfo( platform_ids[i],
-                         CL_PLATFORM_NAME,
-                         0,
-                         nullptr,
-                         &string_length );
-      platform_names[i].resize( string_length );
-      clGetPlatformInfo( platform_ids[i],
-                         CL_PLATFORM_NAME,
-                         string_length,
-                         &platform_names[i][0],
-                         nullptr );
-
-      clGetPlatformInfo( platform_ids[i],
-                         CL_PLATFORM_VERSION,
-                         0,
-                         nullptr,
-                         &string_length );
-      platform_versions[i].resize( string_length );
-      clGetPlatformInfo( platform_ids[i],
-                         CL_PLATFORM_VERSION,
-                         string_length,
-                         &platform_versions[i][0],
-                         nullptr );
-   }
+// A way to submit the launches.
+struct Configuration {
+   std::string name;
+   int queues;          // In-order queues, or 1 for the out-of-order one.
+   bool out_of_order;   // Whether the queue is out-of-order.
+   bool threads;        // Whether every queue has its own host thread.
+};
+
+// A launch of a configuration and its profiling timestamps, in ns.
+struct Launch {
+   int queue;
+   std::string kernel;
+   cl_ulong start;
+   cl_ulong end;
+};
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first device found in this OpenCL platform.
+cl::Device getDefaultDevice();
+// Initialize device and compile the testQueue kernels.
+void initializeDevice();
+// Run launches kernels with configuration, and return their timestamps;
+// wall_time is the host time until all of them finished, in ms, and equal
+// whether their results match expected, which is set by the first call.
+std::vector< Launch > runConfiguration( const Configuration& configuration,
+                                        const int launches,
+                                        const int iterations,
+                                        double& wall_time,
+                                        std::vector< float >& expected,
+                                        bool& equal );
+// Return the largest power-of-two work-group size, up to MAX_LOCAL_SIZE,
+// which every kernel of kernels supports.
+size_t getLocalSize( const std::vector< cl::Kernel >& kernels );
+// Return the time during which at least one launch ran, in ns.
+cl_ulong getSpan( const std::vector< Launch >& launches );
+// Return the sum of the times of the launches, in ns.
+cl_ulong getBusyTime( const std::vector< Launch >& launches );
+// Write the launches of every configuration as a Chrome trace.
+void writeTrace( const std::string& file_name,
+                 const std::vector< Configuration >& configurations,
+                 const std::vector< std::vector< Launch > >& timelines );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
 
-   // (4) Select platform
-   std::vector< std::string > candidate_platforms = { "Intel(R)", "NVIDIA" };
-   uint32_t select_platform = 1;
-   cl_platform_id selected_platform_id = nullptr;
-   for( uint32_t platform_index = 0; platform_index < num_platforms;
-        platform_index++ ) {
-      if( platform_names[platform_index].find(
-             candidate_platforms[select_platform] )
-          != std::string::npos ) {
-         selected_platform_id = platform_ids[platform_index];
-         break;
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main( int argc, char** argv ) {
+
+   /**
+    * Parse the number of queues, the iterations of every launch and the
+    * trace file.
+    * */
+
+   int max_queues = MAX_QUEUES;
+   int iterations = ITERATIONS;
+   std::string trace_file = "testQueues_trace.json";
+   bool valid = true;
+   for( int i = 1; i < argc && valid; i++ ) {
+      int value = 0;
+      try {
+         if( strcmp( argv[i], "--queues" ) == 0 && i + 1 < argc ) {
+            value = std::stoi( argv[++i] );
+            max_queues = value;
+         } else if( strcmp( argv[i], "--iterations" ) == 0 && i + 1 < argc ) {
+            value = std::stoi( argv[++i] );
+            iterations = value;
+         } else if( strcmp( argv[i], "--trace" ) == 0 && i + 1 < argc ) {
+            trace_file = argv[++i];
+            value = 1;
+         }
+      } catch( const std::logic_error& ) {
       }
+      valid = value > 0;
    }
-   if( selected_platform_id == nullptr ) {
-      std::cout << "Your system has no such OpenCL platform "
-                << candidate_platforms[select_platform] << "." << std::endl;
+   if( !valid ) {
+      std::cerr << "Usage: " << argv[0]
+                << " [--queues n] [--iterations n] [--trace file], n > 0"
+                << std::endl;
+      return 1;
    }
 
-   // (5)Check how many devices current platform has and store their
-   // information.
-   cl_uint num_devices = 0;
-   // Select one device type.
-   cl_device_type device_type = CL_DEVICE_TYPE_GPU;
-   // Get the number of devices.
-   err = clGetDeviceIDs( selected_platform_id,
-                         device_type,
-                         0,
-                         nullptr,
-                         &num_devices );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Current platform " << candidate_platforms[select_platform]
-                << " has no supported device." << std::endl;
-      return err;
+   /**
+    * Create the configurations: 1 to max_queues in-order queues, an
+    * out-of-order queue when the device has them, and max_queues queues
+    * fed by a host thread each. All of them run max_queues launches.
+    * */
+
+   initializeDevice();
+   std::vector< Configuration > configurations;
+   for( int queues = 1; queues <= max_queues; queues++ ) {
+      configurations.push_back(
+         { std::to_string( queues ) + " in-order queue"
+              + ( queues > 1 ? "s" : "" ),
+           queues,
+           false,
+           false } );
    }
-   // Get all devices' ids.
-   std::vector< cl_device_id > device_ids( num_devices );
-   err = clGetDeviceIDs( selected_platform_id,
-                         device_type,
-                         num_devices,
-                         &device_ids[0],
-                         nullptr );
-
-   // (6)Obtain device info like obtaining platform info.
-   std::vector< std::string > device_names( num_devices );
-   for( uint32_t i = 0; i < num_devices; i++ ) {
-      err = clGetDeviceInfo( device_ids[i],
-                             CL_DEVICE_NAME,
-                             0,
-                             nullptr,
-                             &string_length );
-      device_names[i].resize( string_length );
-      err = clGetDeviceInfo( device_ids[i],
-                             CL_DEVICE_NAME,
-                             string_length,
-                             &device_names[i][0],
-                             nullptr );
+   if( device.getInfo< CL_DEVICE_QUEUE_ON_HOST_PROPERTIES >()
+       & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE ) {
+      configurations.push_back( { "1 out-of-order queue", 1, true, false } );
    }
+   configurations.push_back(
+      { std::to_string( max_queues ) + " queues, 1 thread each",
+        max_queues,
+        false,
+        true } );
 
-   // (7)Select device like selecting platform.
-   std::vector< std::string > candidate_devices = { "Intel(R)", "NVIDIA" };
-   uint32_t select_device = 1;
-   cl_device_id selected_device_id = nullptr;
-   for( uint32_t device_index = 0; device_index < num_devices;
-        device_index++ ) {
-      if( device_names[device_index].find( candidate_devices[select_device] )
-          != std::string::npos ) {
-         selected_device_id = device_ids[device_index];
-         break;
+   /**
+    * Run every configuration and measure the overlap of its launches: the
+    * sum of their times over the time during which any of them ran. It is
+    * 1 when they run one after the other, and up to the number of launches
+    * when they all run at once.
+    * */
+
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << "\n"
+             << max_queues << " launches of " << DATA_SIZE
+             << " work-items and " << iterations << " iterations\n"
+             << std::setw( 26 ) << "Configuration" << std::setw( 12 )
+             << "Wall (ms)" << std::setw( 12 ) << "Busy (ms)" << std::setw( 12 )
+             << "Span (ms)" << std::setw( 10 ) << "Overlap" << std::endl;
+
+   bool equal = true;
+   std::vector< float > expected;
+   std::vector< std::vector< Launch > > timelines;
+   double base_time = 0.0;
+   double best_time = 0.0;
+   std::cout << std::fixed << std::setprecision( 2 );
+   for( const Configuration& configuration : configurations ) {
+      double wall_time;
+      timelines.push_back( runConfiguration(
+         configuration, max_queues, iterations, wall_time, expected, equal ) );
+      double busy = getBusyTime( timelines.back() ) * 1e-6;
+      double span = getSpan( timelines.back() ) * 1e-6;
+
+      if( timelines.size() == 1 ) {
+         base_time = wall_time;
+         best_time = wall_time;
       }
-   }
-   if( selected_device_id == nullptr ) {
-      std::cout << "Your system has no such OpenCL device "
-                << candidate_devices[select_device] << "." << std::endl;
+      best_time = std::min( best_time, wall_time );
+      std::cout << std::setw( 26 ) << configuration.name << std::setw( 12 )
+                << wall_time << std::setw( 12 ) << busy << std::setw( 12 )
+                << span << std::setw( 10 ) << busy / span << std::endl;
    }
 
-   // 2. create context
-   // The context is the core of the opencl program and the only channel for the
-   // interaction between the host and the device. It is the basis for functions
-   // such as memory application maintenance and command queue creation.
-   // Different plaforms can apply for different contexts. The memory in
-   // different contexts cannot be directly shared. The memory of different
-   // devices under the same context is the same and can be accessed by each
-   // other.
-   cl_context context = nullptr;
-   cl_context_properties context_properties[]
-      = { CL_CONTEXT_PLATFORM,
-          reinterpret_cast< cl_context_properties >( selected_platform_id ),
-          0 };
-   context = clCreateContextFromType( context_properties,
-                                      CL_DEVICE_TYPE_GPU,
-                                      nullptr,
-                                      nullptr,
-                                      &err );
-   if( ( CL_SUCCESS != err ) || ( nullptr == context ) ) {
-      std::cout
-         << "Couldn't create a context, clCreateContextFromType() returned "
-         << err << std::endl;
-      return err;
-   }
+   /**
+    * Write the timeline and print results.
+    * */
 
-   // 3. create command queue
-   // Communication with a device occurs by submitting commands to a command
-   // queue. The command queue is the mechanism that the host uses to request
-   // action by the device. Once the host decides which devices to work with and
-   // a context is created, one command queue needs to be created per device
-   // (i.e., each command queue is associated with only one device). Whenever
-   // the host needs an action to be performed by a device, it will submit
-   // commands to the proper command queue. Any API that specifies hostdevice
-   // interaction will always begin with clEnqueue and require a command queue
-   // as a parameter
-   auto command_queue1 = clCreateCommandQueueWithProperties( context,
-                                                             selected_device_id,
-                                                             nullptr,
-                                                             nullptr );
-   auto command_queue2 = clCreateCommandQueueWithProperties( context,
-                                                             selected_device_id,
-                                                             nullptr,
-                                                             nullptr );
-   auto command_queue3 = clCreateCommandQueueWithProperties( context,
-                                                             selected_device_id,
-                                                             nullptr,
-                                                             nullptr );
-   auto command_queue4 = clCreateCommandQueueWithProperties( context,
-                                                             selected_device_id,
-                                                             nullptr,
-                                                             nullptr );
-
-   // 4. create program
-   // OpenCL C code (written to run on an OpenCL device) is called a program. A
-   // program is a collection of functions called kernels, where kernels are
-   // units of execution that can be scheduled to run on a device.
-   std::ifstream kernel_file( "testQueues.cl", std::ios::in );
-   std::ostringstream oss;
-
-   oss << kernel_file.rdbuf();
-   std::string src_std_str = oss.str();
-   const char* src_str = src_std_str.c_str();
-   auto program
-      = clCreateProgramWithSource( context, 1, &src_str, nullptr, nullptr );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to create program program.\n";
-   }
+   writeTrace( trace_file, configurations, timelines );
+   std::cout << "Timeline: " << trace_file << std::endl;
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << base_time
+             << " ms;\n\tParallel: " << best_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( base_time - best_time ) / best_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first device found in this OpenCL platform.
+ * */
 
-   // 5. build program
-   err = clBuildProgram( program,
-                         1,
-                         &selected_device_id,
-                         "-I.",
-                         nullptr,
-                         nullptr );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to build program program.\n";
+cl::Device getDefaultDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
    }
 
-   // 6. create kernel
-   // The final stage to obtain a cl_kernel object that can be used to execute
-   // kernels on a device is to extract the kernel from the cl_program.
-   // Extracting a kernel from a program is similar to obtaining an exported
-   // function from a dynamic library. The name of the kernel that the program
-   // exports is used to request it from the compiled program object.
-   auto test_queue1 = clCreateKernel( program, "testQueue1", &err );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to create kernel testQueue1.\n";
+   /**
+    * Search for all the devices on the first platform and check if
+    * there are any available.
+    * */
+
+   auto platform = platforms.front();
+   std::vector< cl::Device > devices;
+   platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
    }
-   auto test_queue2 = clCreateKernel( program, "testQueue2", &err );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to create kernel testQueue2.\n";
+
+   /**
+    * Return the first device found.
+    * */
+
+   return devices.front();
+}
+
+/**
+ * Initialize device and compile the testQueue kernels.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first available device.
+    * */
+
+   device = getDefaultDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file( "testQueues.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device; it includes
+    * utility.cl from this folder.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build( device, "-I." );
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
    }
-   auto test_queue3 = clCreateKernel( program, "testQueue3", &err );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to create kernel testQueue3.\n";
+}
+
+/**
+ * Run launches kernels with configuration: launch i goes to queue
+ * i % queues and runs KERNELS[i % 4] into its own output buffer. The
+ * kernels and buffers are created beforehand, so that only the submission
+ * is timed. With threads, every queue is fed and finished by its own host
+ * thread. Return the profiling timestamps of the launches; wall_time is
+ * the host time until all of them finished, in ms, and equal whether
+ * their results match expected, which is set by the first call.
+ * */
+
+std::vector< Launch > runConfiguration( const Configuration& configuration,
+                                        const int launches,
+                                        const int iterations,
+                                        double& wall_time,
+                                        std::vector< float >& expected,
+                                        bool& equal ) {
+
+   /**
+    * Create the queues, and the kernel and output of every launch.
+    * */
+
+   cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE;
+   if( configuration.out_of_order ) {
+      properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
    }
-   auto test_queue4 = clCreateKernel( program, "testQueue4", &err );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to create kernel testQueue4.\n";
+   std::vector< cl::CommandQueue > queues;
+   for( int q = 0; q < configuration.queues; q++ ) {
+      queues.push_back( cl::CommandQueue( context, device, properties ) );
    }
 
-   // 7. set input data && create memory object
-   // In order for data to be transferred to a device, it must first be
-   // encapsulated as a memory object. OpenCL defines two types of memory
-   // objects: buffers and images.
-   // Buffers are equivalent to arrays in C, created using malloc(),where data
-   // elements are stored contiguously in memory.
-   // Whenever a memory object is created, it is valid only within a single
-   // context.
-   // (1) Declare data in host
-   float output[DATA_SIZE];
-   // (2) Encapsulate them so that we can transfer date into and from devices.
-   auto mem_object_output = clCreateBuffer( context,
-                                            CL_MEM_READ_WRITE,
-                                            sizeof( float ) * DATA_SIZE,
-                                            nullptr,
-                                            &err );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to create buffer mem_object_output.\n";
+   std::vector< cl::Kernel > kernels;
+   std::vector< cl::Buffer > outputs;
+   for( int i = 0; i < launches; i++ ) {
+      outputs.push_back( cl::Buffer(
+         context, CL_MEM_WRITE_ONLY, DATA_SIZE * sizeof( float ) ) );
+      kernels.push_back( cl::Kernel( program, KERNELS[i % 4] ) );
+      kernels.back().setArg( 0, outputs.back() );
+      kernels.back().setArg( 1, iterations );
    }
+   const size_t local_size = getLocalSize( kernels );
+
+   /**
+    * Submit the launches of every queue, from this thread or from a thread
+    * per queue, and wait for all of them.
+    * */
+
+   std::vector< cl::Event > events( launches );
+   auto submit = [&]( const int q ) {
+      for( int i = q; i < launches; i += configuration.queues ) {
+         queues[q].enqueueNDRangeKernel( kernels[i],
+                                         cl::NullRange,
+                                         cl::NDRange( DATA_SIZE ),
+                                         cl::NDRange( local_size ),
+                                         nullptr,
+                                         &events[i] );
+      }
+      queues[q].flush();
+   };
 
-   // 8. set kernel argument
-   // A few more steps are required before the kernel can actually be executed.
-   // Unlike calling functions in regular C programs, we cannot simply call a
-   // kernel by providing a list of arguments.
-   // Executing a kernel requires dispatching it through an enqueue function.
-   err = clSetKernelArg( test_queue1,
-                         0,
-                         sizeof( cl_mem ),
-                         static_cast< const void* >( &mem_object_output ) );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to set arg 0 for test_queue1.\n";
+   auto start = std::chrono::steady_clock::now();
+   if( configuration.threads ) {
+      std::vector< std::thread > threads;
+      for( int q = 0; q < configuration.queues; q++ ) {
+         threads.emplace_back( [&, q] {
+            submit( q );
+            queues[q].finish();
+         } );
+      }
+      for( std::thread& thread : threads ) {
+         thread.join();
+      }
+   } else {
+      for( int q = 0; q < configuration.queues; q++ ) {
+         submit( q );
+      }
+      for( cl::CommandQueue& queue : queues ) {
+         queue.finish();
+      }
    }
-   err = clSetKernelArg( test_queue2,
-                         0,
-                         sizeof( cl_mem ),
-                         static_cast< const void* >( &mem_object_output ) );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to set arg 0 for test_queue2.\n";
+   wall_time = getElapsedTime( start );
+
+   /**
+    * Collect the timestamps and check the outputs: every launch computes
+    * the same values.
+    * */
+
+   std::vector< Launch > timeline;
+   std::vector< float > output( DATA_SIZE );
+   for( int i = 0; i < launches; i++ ) {
+      timeline.push_back(
+         { i % configuration.queues,
+           KERNELS[i % 4],
+           events[i].getProfilingInfo< CL_PROFILING_COMMAND_START >(),
+           events[i].getProfilingInfo< CL_PROFILING_COMMAND_END >() } );
+
+      queues[0].enqueueReadBuffer( outputs[i],
+                                   CL_TRUE,
+                                   0,
+                                   DATA_SIZE * sizeof( float ),
+                                   output.data() );
+      if( expected.empty() ) {
+         expected = output;
+      }
+      equal = equal && output == expected;
    }
-   err = clSetKernelArg( test_queue3,
-                         0,
-                         sizeof( cl_mem ),
-                         static_cast< const void* >( &mem_object_output ) );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to set arg 0 for test_queue3.\n";
+   return timeline;
+}
+
+/**
+ * Return the largest power-of-two work-group size, up to MAX_LOCAL_SIZE,
+ * which every kernel of kernels supports on the device; a power of two
+ * divides DATA_SIZE.
+ * */
+
+size_t getLocalSize( const std::vector< cl::Kernel >& kernels ) {
+   size_t limit = MAX_LOCAL_SIZE;
+   for( const cl::Kernel& kernel : kernels ) {
+      limit = std::min(
+         limit,
+         kernel.getWorkGroupInfo< CL_KERNEL_WORK_GROUP_SIZE >( device ) );
    }
-   err = clSetKernelArg( test_queue4,
-                         0,
-                         sizeof( cl_mem ),
-                         static_cast< const void* >( &mem_object_output ) );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to set arg 0 for test_queue4.\n";
+   size_t local_size = 1;
+   while( 2 * local_size <= limit ) {
+      local_size *= 2;
    }
+   return local_size;
+}
 
-   // 9. send kernel to execute
-   // After any required memory objects are transferred to the device and the
-   // kernel arguments are set, the kernel is ready to be executed.
-   // The clEnqueueNDRangeKernel() call is asynchronous: it will return
-   // immediately after the command is enqueued in the command queue and likely
-   // before the kernel has even started execution. Either clWaitForEvents() or
-   // clFinish() can be used to block execution on the host until the kernel
-   // completes.
-   // global_work_size must be a multiple of local_work_size in each dimension
-   // when using clEnqueueNDRangeKernel. If they are not, OpenCL will return an
-   // error or produce unexpected behavior.
-   constexpr size_t work_dim = 3;
-   size_t global_work_size[work_dim] = { DATA_SIZE, 1, 1 };
-   size_t local_work_size[work_dim] = { 256, 1, 1 };
-   err = clEnqueueNDRangeKernel( command_queue1,
-                                 test_queue1,
-                                 work_dim,
-                                 nullptr,
-                                 global_work_size,
-                                 local_work_size,
-                                 0,
-                                 nullptr,
-                                 nullptr );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to enqueue kernel testQueue1.\n";
-   }
-   err = clEnqueueNDRangeKernel( command_queue2,
-                                 test_queue2,
-                                 work_dim,
-                                 nullptr,
-                                 global_work_size,
-                                 local_work_size,
-                                 0,
-                                 nullptr,
-                                 nullptr );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to enqueue kernel testQueue2.\n";
+/**
+ * Return the time during which at least one launch ran, in ns: the union
+ * of their intervals, so idle gaps between launches are not counted.
+ * */
+
+cl_ulong getSpan( const std::vector< Launch >& launches ) {
+   std::vector< Launch > sorted = launches;
+   std::sort( sorted.begin(),
+              sorted.end(),
+              []( const Launch& a, const Launch& b ) {
+                 return a.start < b.start;
+              } );
+
+   cl_ulong span = 0;
+   cl_ulong covered = 0;
+   for( const Launch& launch : sorted ) {
+      cl_ulong start = std::max( launch.start, covered );
+      if( launch.end > start ) {
+         span += launch.end - start;
+      }
+      covered = std::max( covered, launch.end );
    }
-   err = clEnqueueNDRangeKernel( command_queue3,
-                                 test_queue3,
-                                 work_dim,
-                                 nullptr,
-                                 global_work_size,
-                                 local_work_size,
-                                 0,
-                                 nullptr,
-                                 nullptr );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to enqueue kernel testQueue3.\n";
+   return span;
+}
+
+/**
+ * Return the sum of the times of the launches, in ns.
+ * */
+
+cl_ulong getBusyTime( const std::vector< Launch >& launches ) {
+   cl_ulong busy = 0;
+   for( const Launch& launch : launches ) {
+      busy += launch.end - launch.start;
    }
-   err = clEnqueueNDRangeKernel( command_queue4,
-                                 test_queue4,
-                                 work_dim,
-                                 nullptr,
-                                 global_work_size,
-                                 local_work_size,
-                                 0,
-                                 nullptr,
-                                 nullptr );
-   if( err != CL_SUCCESS ) {
-      std::cout << "Fail to enqueue kernel testQueue4.\n";
+   return busy;
+}
+
+/**
+ * Write the launches of every configuration as a Chrome trace, which
+ * chrome://tracing and Perfetto open: every configuration is a process and
+ * every queue a thread, and times are in microseconds from the first
+ * launch of the configuration.
+ * */
+
+void writeTrace( const std::string& file_name,
+                 const std::vector< Configuration >& configurations,
+                 const std::vector< std::vector< Launch > >& timelines ) {
+   std::ofstream trace( file_name );
+   if( !trace.is_open() ) {
+      std::cerr << "Fail to open " << file_name << "." << std::endl;
+      exit( 1 );
    }
 
-   err = clEnqueueReadBuffer( command_queue1,
-                              mem_object_output,
-                              CL_TRUE,
-                              0,
-                              DATA_SIZE * sizeof( int ),
-                              &output[0],
-                              0,
-                              nullptr,
-                              nullptr );
-
-   // 12. clean up
-   clReleaseCommandQueue( command_queue1 );
-   clReleaseCommandQueue( command_queue2 );
-   clReleaseCommandQueue( command_queue3 );
-   clReleaseCommandQueue( command_queue4 );
-   clReleaseMemObject( mem_object_output );
-   clReleaseKernel( test_queue1 );
-   clReleaseKernel( test_queue2 );
-   clReleaseKernel( test_queue3 );
-   clReleaseKernel( test_queue4 );
-   clReleaseProgram( program );
-   clReleaseContext( context );
+   trace << std::fixed << std::setprecision( 3 ) << "{\"traceEvents\": [\n";
+   bool first = true;
+   for( size_t c = 0; c < configurations.size(); c++ ) {
+      trace << ( first ? "" : ",\n" ) << "{\"name\": \"process_name\", "
+            << "\"ph\": \"M\", \"pid\": " << c << ", \"args\": {\"name\": \""
+            << configurations[c].name << "\"}}";
+      first = false;
 
-   return 0;
+      for( int q = 0; q < configurations[c].queues; q++ ) {
+         trace << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": "
+               << c << ", \"tid\": " << q
+               << ", \"args\": {\"name\": \"queue " << q << "\"}}";
+      }
+
+      cl_ulong origin = timelines[c].front().start;
+      for( const Launch& launch : timelines[c] ) {
+         origin = std::min( origin, launch.start );
+      }
+      for( const Launch& launch : timelines[c] ) {
+         trace << ",\n{\"name\": \"" << launch.kernel
+               << "\", \"ph\": \"X\", \"pid\": " << c
+               << ", \"tid\": " << launch.queue
+               << ", \"ts\": " << ( launch.start - origin ) * 1e-3
+               << ", \"dur\": " << ( launch.end - launch.start ) * 1e-3 << "}";
+      }
+   }
+   trace << "\n]}\n";
 }
 
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
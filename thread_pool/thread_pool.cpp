@@ -0,0 +1,315 @@
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/opencl.hpp>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+// Return the first CPU device found, or the first device when there is none.
+cl::Device getCpuDevice();
+// Initialize device and compile the kernels of matrix_multiplication.
+void initializeDevice();
+// Multiply the matrices of job on queue, with buffers from pool, and return
+// the product.
+std::vector< int > parMultiply( const int job,
+                                const cl::CommandQueue& queue,
+                                BufferPool& pool );
+// Multiply the matrices of job sequentially and return the product.
+std::vector< int > seqMultiply( const int job );
+// Fill the matrices of job.
+void fillMatrices( const int job,
+                   std::vector< int >& a,
+                   std::vector< int >& b );
+// Return the milliseconds elapsed since start.
+double getElapsedTime( const std::chrono::steady_clock::time_point& start );
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;   // The program that will run on the device.
+cl::Context context;   // The context which holds the device.
+cl::Device device;     // The device where the kernel will run.
+
+// Independent jobs of every run: small square matrix products, as a
+// service answering many requests would run.
+constexpr int JOBS = 256;
+constexpr int MATRIX_SIZE = 128;
+// The worker counts measured.
+const std::vector< size_t > WORKER_COUNTS = { 1, 2, 4, 8, 16 };
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main() {
+
+   /**
+    * Create auxiliary variables and the expected products.
+    * */
+
+   initializeDevice();
+   std::cout << "Device: " << device.getInfo< CL_DEVICE_NAME >() << "\n"
+             << JOBS << " jobs of " << MATRIX_SIZE << "x" << MATRIX_SIZE
+             << " matrix products" << std::endl;
+
+   std::vector< std::vector< int > > expected( JOBS );
+   for( int job = 0; job < JOBS; job++ ) {
+      expected[job] = seqMultiply( job );
+   }
+
+   /**
+    * Run the jobs from the main thread, one after the other, with blocking
+    * reads, as the examples do.
+    * */
+
+   bool equal = true;
+   cl::CommandQueue queue( context, device );
+   BufferPool pool( context );
+   auto start = std::chrono::steady_clock::now();
+   for( int job = 0; job < JOBS; job++ ) {
+      bool job_equal = parMultiply( job, queue, pool ) == expected[job];
+      equal = equal && job_equal;
+   }
+   double base_time = getElapsedTime( start );
+
+   std::cout << std::fixed << std::setprecision( 2 ) << std::setw( 14 )
+             << "Workers" << std::setw( 12 ) << "Time (ms)" << std::setw( 12 )
+             << "Jobs/s" << std::setw( 12 ) << "Speedup" << std::setw( 12 )
+             << "Buffers" << "\n"
+             << std::setw( 14 ) << "main thread" << std::setw( 12 )
+             << base_time << std::setw( 12 ) << JOBS / base_time * 1e3
+             << std::setw( 12 ) << 1.0 << std::setw( 12 )
+             << pool.allocations() << std::endl;
+
+   /**
+    * Run the jobs on pools of every size: all of them are submitted at
+    * once, then their futures are collected. Buffers counts the device
+    * buffers allocated: at most three per worker, since the pools reuse
+    * them.
+    * */
+
+   double best_time = base_time;
+   for( size_t workers : WORKER_COUNTS ) {
+      ThreadPool thread_pool( context, device, workers );
+      std::vector< std::future< std::vector< int > > > results;
+      results.reserve( JOBS );
+
+      start = std::chrono::steady_clock::now();
+      for( int job = 0; job < JOBS; job++ ) {
+         results.push_back( thread_pool.submit( [job]( Worker& worker ) {
+            return parMultiply( job, worker.queue, worker.pool );
+         } ) );
+      }
+      for( int job = 0; job < JOBS; job++ ) {
+         bool job_equal = results[job].get() == expected[job];
+         equal = equal && job_equal;
+      }
+      double time = getElapsedTime( start );
+      best_time = std::min( best_time, time );
+
+      // The futures are ready, so the pools are no longer in use.
+      size_t allocations = 0;
+      for( size_t w = 0; w < workers; w++ ) {
+         allocations += thread_pool.worker( w ).pool.allocations();
+      }
+      std::cout << std::setw( 14 ) << workers << std::setw( 12 ) << time
+                << std::setw( 12 ) << JOBS / time * 1e3 << std::setw( 12 )
+                << base_time / time << std::setw( 12 ) << allocations
+                << std::endl;
+   }
+
+   /**
+    * Print results.
+    * */
+
+   std::cout << "Status: " << ( equal ? "SUCCESS!" : "FAILED!" ) << std::endl;
+   std::cout << "Mean execution time: \n\tSequential: " << base_time
+             << " ms;\n\tParallel: " << best_time << " ms." << std::endl;
+   std::cout << "Performance gain: "
+             << ( 100 * ( base_time - best_time ) / best_time ) << "%\n";
+   return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the first CPU device found in any platform: the workers scale
+ * with the cores of the host, which a CPU device shares with them. When
+ * there is none, return the first device of the first platform.
+ * */
+
+cl::Device getCpuDevice() {
+
+   /**
+    * Search for all the OpenCL platforms available and check
+    * if there are any.
+    * */
+
+   std::vector< cl::Platform > platforms;
+   cl::Platform::get( &platforms );
+
+   if( platforms.empty() ) {
+      std::cerr << "No platforms found!" << std::endl;
+      exit( 1 );
+   }
+
+   /**
+    * Search for a CPU device on every platform.
+    * */
+
+   std::vector< cl::Device > devices;
+   for( const cl::Platform& platform : platforms ) {
+      platform.getDevices( CL_DEVICE_TYPE_ALL, &devices );
+      for( const cl::Device& candidate : devices ) {
+         if( candidate.getInfo< CL_DEVICE_TYPE >() & CL_DEVICE_TYPE_CPU ) {
+            return candidate;
+         }
+      }
+   }
+
+   /**
+    * Return the first device found.
+    * */
+
+   platforms.front().getDevices( CL_DEVICE_TYPE_ALL, &devices );
+   if( devices.empty() ) {
+      std::cerr << "No devices found!" << std::endl;
+      exit( 1 );
+   }
+   std::cerr << "No CPU device found, using the first device." << std::endl;
+   return devices.front();
+}
+
+/**
+ * Initialize device and compile the kernels of matrix_multiplication.
+ * */
+
+void initializeDevice() {
+
+   /**
+    * Select the first CPU device.
+    * */
+
+   device = getCpuDevice();
+
+   /**
+    * Read OpenCL kernel file as a string.
+    * */
+
+   std::ifstream kernel_file(
+      "../matrix_multiplication/matrix_multiplication.cl" );
+   std::string src( std::istreambuf_iterator< char >( kernel_file ),
+                    ( std::istreambuf_iterator< char >() ) );
+
+   /**
+    * Compile kernel program which will run on the device.
+    * */
+
+   cl::Program::Sources sources{ src };
+   context = cl::Context( device );
+   program = cl::Program( context, sources );
+
+   auto err = program.build();
+   if( err != CL_BUILD_SUCCESS ) {
+      std::cerr << "Error!\nBuild Status: "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_STATUS >( device )
+                << "\nBuild Log:\t "
+                << program.getBuildInfo< CL_PROGRAM_BUILD_LOG >( device )
+                << std::endl;
+      exit( 1 );
+   }
+}
+
+/**
+ * Multiply the matrices of job on queue and return the product. The
+ * buffers come from pool and go back to it once the blocking read is done;
+ * the kernel object is created by every job, since kernels must not be
+ * shared between threads which set their arguments.
+ * */
+
+std::vector< int > parMultiply( const int job,
+                                const cl::CommandQueue& queue,
+                                BufferPool& pool ) {
+   constexpr size_t bytes = MATRIX_SIZE * MATRIX_SIZE * sizeof( int );
+   std::vector< int > a, b, c( MATRIX_SIZE * MATRIX_SIZE );
+   fillMatrices( job, a, b );
+
+   cl::Buffer a_buf = pool.acquire( bytes, CL_MEM_READ_ONLY );
+   cl::Buffer b_buf = pool.acquire( bytes, CL_MEM_READ_ONLY );
+   cl::Buffer c_buf = pool.acquire( bytes, CL_MEM_WRITE_ONLY );
+   queue.enqueueWriteBuffer( a_buf, CL_FALSE, 0, bytes, a.data() );
+   queue.enqueueWriteBuffer( b_buf, CL_FALSE, 0, bytes, b.data() );
+
+   cl::Kernel kernel( program, "multiplyMatrices" );
+   kernel.setArg( 0, a_buf );
+   kernel.setArg( 1, b_buf );
+   kernel.setArg( 2, c_buf );
+   kernel.setArg( 3, MATRIX_SIZE );
+   kernel.setArg( 4, MATRIX_SIZE );
+   kernel.setArg( 5, MATRIX_SIZE );
+   queue.enqueueNDRangeKernel(
+      kernel, cl::NullRange, cl::NDRange( MATRIX_SIZE, MATRIX_SIZE ) );
+   queue.enqueueReadBuffer( c_buf, CL_TRUE, 0, bytes, c.data() );
+
+   pool.release( a_buf );
+   pool.release( b_buf );
+   pool.release( c_buf );
+   return c;
+}
+
+/**
+ * Multiply the matrices of job sequentially and return the product.
+ * */
+
+std::vector< int > seqMultiply( const int job ) {
+   std::vector< int > a, b, c( MATRIX_SIZE * MATRIX_SIZE );
+   fillMatrices( job, a, b );
+   for( int row = 0; row < MATRIX_SIZE; row++ ) {
+      for( int col = 0; col < MATRIX_SIZE; col++ ) {
+         int sum = 0;
+         for( int z = 0; z < MATRIX_SIZE; z++ ) {
+            sum += a[row * MATRIX_SIZE + z] * b[z * MATRIX_SIZE + col];
+         }
+         c[row * MATRIX_SIZE + col] = sum;
+      }
+   }
+   return c;
+}
+
+/**
+ * Fill the matrices of job with small values which depend on it, so every
+ * job has its own product.
+ * */
+
+void fillMatrices( const int job,
+                   std::vector< int >& a,
+                   std::vector< int >& b ) {
+   a.resize( MATRIX_SIZE * MATRIX_SIZE );
+   b.resize( MATRIX_SIZE * MATRIX_SIZE );
+   for( int i = 0; i < MATRIX_SIZE * MATRIX_SIZE; i++ ) {
+      a[i] = ( i + job ) % 7;
+      b[i] = ( i * 3 + job ) % 5;
+   }
+}
+
+/**
+ * Return the milliseconds elapsed since start.
+ * */
+
+double getElapsedTime( const std::chrono::steady_clock::time_point& start ) {
+   return std::chrono::duration< double, std::milli >(
+             std::chrono::steady_clock::now() - start )
+      .count();
+}
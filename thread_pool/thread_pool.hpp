@@ -0,0 +1,337 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+   #define CL_HPP_TARGET_OPENCL_VERSION 300
+#endif
+#include <CL/opencl.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Submit independent jobs to an OpenCL device from a pool of host threads.
+ * Every worker thread owns a command queue of a shared context and a pool
+ * of buffers, so jobs running on different workers never share a queue or
+ * wait for each other's blocking calls. Jobs are taken from a lock-free
+ * multi-producer multi-consumer queue, and every submission returns a
+ * future of the job result:
+ *
+ *    ThreadPool pool( context, device, 4 );
+ *    std::future< int > result = pool.submit( []( Worker& worker ) {
+ *       cl::Buffer buffer = worker.pool.acquire( size );
+ *       ...
+ *       worker.pool.release( buffer );
+ *       return value;
+ *    } );
+ * */
+
+// =================================================================
+// --------------------------- MPMCQueue ---------------------------
+// =================================================================
+
+/**
+ * Bounded lock-free queue for any number of producers and consumers, after
+ * Dmitry Vyukov's design: every cell carries a sequence number which tells
+ * whether it is free for the push of a given position or holds the value
+ * for the pop of that position, so producers and consumers only contend on
+ * their own position counter.
+ * */
+
+template< typename T >
+class MPMCQueue {
+ public:
+   // capacity is rounded up to a power of two.
+   explicit MPMCQueue( const size_t capacity ) {
+      size_t size = 1;
+      while( size < capacity ) {
+         size *= 2;
+      }
+      mask_ = size - 1;
+      cells_.reset( new Cell[size] );
+      for( size_t i = 0; i < size; i++ ) {
+         cells_[i].sequence.store( i, std::memory_order_relaxed );
+      }
+      enqueue_position_.store( 0, std::memory_order_relaxed );
+      dequeue_position_.store( 0, std::memory_order_relaxed );
+   }
+
+   // Push value and return true, or return false, leaving value untouched,
+   // when the queue is full.
+   bool tryPush( T&& value ) {
+      Cell* cell;
+      size_t position = enqueue_position_.load( std::memory_order_relaxed );
+      for( ;; ) {
+         cell = &cells_[position & mask_];
+         size_t sequence = cell->sequence.load( std::memory_order_acquire );
+         intptr_t difference = static_cast< intptr_t >( sequence )
+                             - static_cast< intptr_t >( position );
+         if( difference == 0 ) {
+            if( enqueue_position_.compare_exchange_weak(
+                   position, position + 1, std::memory_order_relaxed ) ) {
+               break;
+            }
+         } else if( difference < 0 ) {
+            return false;
+         } else {
+            position = enqueue_position_.load( std::memory_order_relaxed );
+         }
+      }
+      cell->value = std::move( value );
+      cell->sequence.store( position + 1, std::memory_order_release );
+      return true;
+   }
+
+   // Pop the oldest value into value and return true, or return false when
+   // the queue is empty.
+   bool tryPop( T& value ) {
+      Cell* cell;
+      size_t position = dequeue_position_.load( std::memory_order_relaxed );
+      for( ;; ) {
+         cell = &cells_[position & mask_];
+         size_t sequence = cell->sequence.load( std::memory_order_acquire );
+         intptr_t difference = static_cast< intptr_t >( sequence )
+                             - static_cast< intptr_t >( position + 1 );
+         if( difference == 0 ) {
+            if( dequeue_position_.compare_exchange_weak(
+                   position, position + 1, std::memory_order_relaxed ) ) {
+               break;
+            }
+         } else if( difference < 0 ) {
+            return false;
+         } else {
+            position = dequeue_position_.load( std::memory_order_relaxed );
+         }
+      }
+      value = std::move( cell->value );
+      cell->sequence.store( position + mask_ + 1, std::memory_order_release );
+      return true;
+   }
+
+ private:
+   // Size of a cache line; the two positions are kept on different lines.
+   static constexpr size_t CACHE_LINE = 64;
+
+   struct Cell {
+      std::atomic< size_t > sequence;
+      T value;
+   };
+
+   std::unique_ptr< Cell[] > cells_;
+   size_t mask_;
+   alignas( CACHE_LINE ) std::atomic< size_t > enqueue_position_;
+   alignas( CACHE_LINE ) std::atomic< size_t > dequeue_position_;
+};
+
+// =================================================================
+// -------------------------- BufferPool ---------------------------
+// =================================================================
+
+/**
+ * Pool of the device buffers of a single worker. Buffers are grouped by
+ * flags and by size, rounded up to a power of two, and released buffers
+ * are handed out again instead of being freed, which saves the allocation
+ * on every job. It is not thread safe: only its worker uses it.
+ * */
+
+class BufferPool {
+ public:
+   // Smallest size class, in bytes.
+   static constexpr size_t MIN_SIZE = 256;
+
+   explicit BufferPool( const cl::Context& context ) : context_( context ) {}
+
+   // Return a buffer of at least size bytes with flags.
+   cl::Buffer acquire( const size_t size,
+                       const cl_mem_flags flags = CL_MEM_READ_WRITE ) {
+      Key key( flags, getSizeClass( size ) );
+      std::vector< cl::Buffer >& free_buffers = free_[key];
+      if( !free_buffers.empty() ) {
+         cl::Buffer buffer = free_buffers.back();
+         free_buffers.pop_back();
+         reuses_++;
+         return buffer;
+      }
+
+      cl::Buffer buffer( context_, flags, key.second );
+      keys_[buffer()] = key;
+      allocations_++;
+      return buffer;
+   }
+
+   // Return buffer, which came from acquire, to the pool. The commands
+   // which use it must be complete, or at least enqueued on the queue of
+   // the worker, which runs them in order.
+   void release( const cl::Buffer& buffer ) {
+      free_[keys_.at( buffer() )].push_back( buffer );
+   }
+
+   // Number of buffers created and of buffers handed out again.
+   size_t allocations() const { return allocations_; }
+   size_t reuses() const { return reuses_; }
+
+ private:
+   using Key = std::pair< cl_mem_flags, size_t >;
+
+   // Return the power of two, at least MIN_SIZE, which holds size bytes.
+   static size_t getSizeClass( const size_t size ) {
+      size_t size_class = MIN_SIZE;
+      while( size_class < size ) {
+         size_class *= 2;
+      }
+      return size_class;
+   }
+
+   cl::Context context_;
+   std::map< Key, std::vector< cl::Buffer > > free_;
+   std::map< cl_mem, Key > keys_;
+   size_t allocations_ = 0;
+   size_t reuses_ = 0;
+};
+
+// =================================================================
+// ---------------------------- Worker -----------------------------
+// =================================================================
+
+// The resources a job runs with: those of the worker thread running it.
+struct Worker {
+   size_t index;
+   cl::CommandQueue queue;
+   BufferPool pool;
+};
+
+// =================================================================
+// -------------------------- ThreadPool ---------------------------
+// =================================================================
+
+class ThreadPool {
+ public:
+   // Default capacity of the job queue; submit waits while it is full.
+   static constexpr size_t QUEUE_CAPACITY = 1024;
+   // Failed pops of an idle worker before it sleeps.
+   static constexpr int SPIN_COUNT = 64;
+
+   // Start workers threads, each with a queue of properties on device.
+   ThreadPool( const cl::Context& context,
+               const cl::Device& device,
+               const size_t workers,
+               const size_t capacity = QUEUE_CAPACITY,
+               const cl_command_queue_properties properties = 0 )
+      : jobs_( capacity ) {
+      for( size_t i = 0; i < workers; i++ ) {
+         workers_.emplace_back(
+            new Worker{ i,
+                        cl::CommandQueue( context, device, properties ),
+                        BufferPool( context ) } );
+      }
+      for( size_t i = 0; i < workers; i++ ) {
+         threads_.emplace_back( [this, i] { run( *workers_[i] ); } );
+      }
+   }
+
+   // Run the jobs still queued, then stop the workers.
+   ~ThreadPool() {
+      stop_.store( true );
+      {
+         std::lock_guard< std::mutex > lock( mutex_ );
+      }
+      wake_.notify_all();
+      for( std::thread& thread : threads_ ) {
+         thread.join();
+      }
+   }
+
+   ThreadPool( const ThreadPool& ) = delete;
+   ThreadPool& operator=( const ThreadPool& ) = delete;
+
+   // Queue function, called as function( worker ) by the first free
+   // worker, and return the future of its result. Exceptions thrown by
+   // function are stored in the future.
+   template< typename Function >
+   auto submit( Function&& function )
+      -> std::future< std::invoke_result_t< Function, Worker& > > {
+      using Result = std::invoke_result_t< Function, Worker& >;
+      auto task = std::make_shared< std::packaged_task< Result( Worker& ) > >(
+         std::forward< Function >( function ) );
+      std::future< Result > future = task->get_future();
+
+      // Count the job before it can be popped, so pending_ never goes
+      // below the number of jobs queued.
+      Job job = [task]( Worker& worker ) { ( *task )( worker ); };
+      pending_.fetch_add( 1 );
+      while( !jobs_.tryPush( std::move( job ) ) ) {
+         std::this_thread::yield();
+      }
+      if( sleeping_.load() > 0 ) {
+         {
+            std::lock_guard< std::mutex > lock( mutex_ );
+         }
+         wake_.notify_one();
+      }
+      return future;
+   }
+
+   // Number of workers.
+   size_t size() const { return workers_.size(); }
+
+   // The worker with index, to inspect its pool once the jobs are done.
+   const Worker& worker( const size_t index ) const {
+      return *workers_[index];
+   }
+
+ private:
+   using Job = std::function< void( Worker& ) >;
+
+   // Run jobs until the pool stops and the job queue is empty. An idle
+   // worker spins for SPIN_COUNT attempts, then sleeps until a job is
+   // submitted; sleeping_ and pending_ are sequentially consistent, so
+   // either the worker sees the job or submit sees the worker sleeping.
+   void run( Worker& worker ) {
+      Job job;
+      int failures = 0;
+      for( ;; ) {
+         if( jobs_.tryPop( job ) ) {
+            pending_.fetch_sub( 1 );
+            job( worker );
+            job = nullptr;
+            failures = 0;
+            continue;
+         }
+         if( stop_.load() && pending_.load() == 0 ) {
+            return;
+         }
+         if( ++failures < SPIN_COUNT ) {
+            std::this_thread::yield();
+            continue;
+         }
+
+         std::unique_lock< std::mutex > lock( mutex_ );
+         sleeping_.fetch_add( 1 );
+         wake_.wait( lock, [this] {
+            return pending_.load() > 0 || stop_.load();
+         } );
+         sleeping_.fetch_sub( 1 );
+         failures = 0;
+      }
+   }
+
+   MPMCQueue< Job > jobs_;
+   std::vector< std::unique_ptr< Worker > > workers_;
+   std::vector< std::thread > threads_;
+   std::atomic< long > pending_{ 0 };
+   std::atomic< int > sleeping_{ 0 };
+   std::atomic< bool > stop_{ false };
+   std::mutex mutex_;
+   std::condition_variable wake_;
+};
+
+#endif